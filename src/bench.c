@@ -0,0 +1,483 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   -------
+ *   bench.c
+ *   end-to-end benchmark: corpus replay
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "ooconfig.h"
+#include "oomnik.h"
+#include "benchalloc.h"
+
+#define BENCH_MAX_THREADS 256
+
+static const char *options_string = "c:i:t:w:r:o:dh?";
+
+static struct option main_options[] =
+{
+    {"config", 1, NULL, 'c'},
+    {"corpus", 1, NULL, 'i'},
+    {"threads", 1, NULL, 't'},
+    {"warmup", 1, NULL, 'w'},
+    {"reps", 1, NULL, 'r'},
+    {"output", 1, NULL, 'o'},
+    {"documents", 0, NULL, 'd'},
+    {"help", 0, NULL, 'h'},
+    { NULL, 0, NULL, 0 }
+};
+
+
+/******************* CORPUS ***************************/
+
+typedef struct ooBenchCorpus {
+    char **inputs;
+    size_t num_inputs;
+    size_t num_bytes;
+} ooBenchCorpus;
+
+static int
+bench_add_input(struct ooBenchCorpus *corpus,
+		const char *buf,
+		size_t len)
+{
+    char **inputs;
+    char *input;
+
+    if (!len) return oo_OK;
+
+    input = malloc(len + 1);
+    if (!input) return oo_NOMEM;
+    memcpy(input, buf, len);
+    input[len] = '\0';
+
+    inputs = realloc(corpus->inputs,
+		     sizeof(char*) * (corpus->num_inputs + 1));
+    if (!inputs) {
+	free(input);
+	return oo_NOMEM;
+    }
+    inputs[corpus->num_inputs] = input;
+    corpus->inputs = inputs;
+    corpus->num_inputs++;
+    corpus->num_bytes += len;
+
+    return oo_OK;
+}
+
+/**
+ * read the corpus: one input per line
+ * or whole documents separated by blank lines
+ */
+static int
+bench_read_corpus(struct ooBenchCorpus *corpus,
+		  const char *filename,
+		  bool documents)
+{
+    FILE *f;
+    char *line = NULL, *doc = NULL, *newdoc;
+    size_t line_size = 0, doc_len = 0;
+    ssize_t len;
+    int ret = oo_OK;
+
+    f = fopen(filename, "r");
+    if (!f) {
+	fprintf(stderr, " -- Couldn't open corpus file \"%s\" :(\n", filename);
+	return oo_FAIL;
+    }
+
+    /* lines of any length are read whole */
+    while ((len = getline(&line, &line_size, f)) != -1) {
+	if (!documents) {
+	    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+		line[--len] = '\0';
+	    ret = bench_add_input(corpus, line, len);
+	    if (ret != oo_OK) break;
+	    continue;
+	}
+
+	/* document boundary */
+	if (line[0] == '\n' || (line[0] == '\r' && line[1] == '\n')) {
+	    ret = bench_add_input(corpus, doc, doc_len);
+	    if (ret != oo_OK) break;
+	    doc_len = 0;
+	    continue;
+	}
+
+	newdoc = realloc(doc, doc_len + len + 1);
+	if (!newdoc) {
+	    ret = oo_NOMEM;
+	    break;
+	}
+	doc = newdoc;
+	memcpy(doc + doc_len, line, len);
+	doc_len += len;
+    }
+
+    if (ret == oo_OK && documents)
+	ret = bench_add_input(corpus, doc, doc_len);
+
+    if (ret == oo_OK && ferror(f)) {
+	fprintf(stderr, " -- Couldn't read corpus file \"%s\" :(\n", filename);
+	ret = oo_FAIL;
+    }
+
+    if (doc) free(doc);
+    if (line) free(line);
+    fclose(f);
+
+    return ret;
+}
+
+
+/******************* WORKERS ***************************/
+
+typedef struct ooBenchWorker {
+    pthread_t thread;
+    size_t id;
+    size_t num_workers;
+
+    struct OOmnik *oomnik;
+    struct ooBenchCorpus *corpus;
+    size_t reps;
+
+    /* measured latencies in seconds */
+    double *latencies;
+    size_t num_latencies;
+    size_t num_failures;
+} ooBenchWorker;
+
+static double
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void*
+bench_worker_run(void *arg)
+{
+    struct ooBenchWorker *worker = (struct ooBenchWorker*)arg;
+    struct ooBenchCorpus *corpus = worker->corpus;
+    const char *result;
+    double start;
+    size_t i, rep;
+
+    for (rep = 0; rep < worker->reps; rep++) {
+	/* inputs are shared round-robin among workers */
+	for (i = worker->id; i < corpus->num_inputs; i += worker->num_workers) {
+	    start = bench_now();
+	    result = OOmnik_process(worker->oomnik, corpus->inputs[i],
+				    worker->oomnik->default_format);
+	    if (worker->latencies)
+		worker->latencies[worker->num_latencies++] = bench_now() - start;
+
+	    if (!result) {
+		worker->num_failures++;
+		continue;
+	    }
+	    OOmnik_free_result(result);
+	}
+    }
+
+    return NULL;
+}
+
+/* run all workers: latencies are not recorded during the warm-up */
+static int
+bench_run(struct ooBenchWorker *workers,
+	  size_t num_workers,
+	  size_t reps,
+	  bool measure)
+{
+    size_t i, share;
+    int ret;
+
+    for (i = 0; i < num_workers; i++) {
+	workers[i].reps = reps;
+	workers[i].num_latencies = 0;
+	workers[i].num_failures = 0;
+	workers[i].latencies = NULL;
+
+	if (!measure) continue;
+
+	share = (workers[i].corpus->num_inputs / num_workers + 1) * reps;
+	workers[i].latencies = malloc(sizeof(double) * share);
+	if (!workers[i].latencies) return oo_NOMEM;
+    }
+
+    /* a single worker runs in the main thread */
+    if (num_workers == 1) {
+	bench_worker_run(&workers[0]);
+	return oo_OK;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+	ret = pthread_create(&workers[i].thread, NULL,
+			     bench_worker_run, &workers[i]);
+	if (ret) {
+	    fprintf(stderr, " -- Failed to start worker %zu :(\n", i);
+	    return oo_FAIL;
+	}
+    }
+
+    for (i = 0; i < num_workers; i++)
+	pthread_join(workers[i].thread, NULL);
+
+    return oo_OK;
+}
+
+
+/******************* REPORT ***************************/
+
+static int
+bench_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    if (x < y) return -1;
+    if (x > y) return 1;
+    return 0;
+}
+
+static double
+bench_percentile(double *values,
+		 size_t num_values,
+		 double pct)
+{
+    size_t pos;
+
+    if (!num_values) return 0.0;
+
+    pos = (size_t)(pct / 100.0 * (num_values - 1) + 0.5);
+    if (pos >= num_values) pos = num_values - 1;
+
+    return values[pos];
+}
+
+static long
+bench_peak_rss_kb(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage)) return -1;
+
+    /* kilobytes on Linux */
+    return usage.ru_maxrss;
+}
+
+static void display_usage(void)
+{
+    fprintf(stderr, "\nUsage: oomnik-bench --config=path_to_your_oomniconf_xml"
+	    " --corpus=path_to_corpus\n"
+	    "          [--threads=N] [--warmup=N] [--reps=N]"
+	    " [--documents] [--output=results.json]\n\n"
+	    "  --corpus     one input per line"
+	    " (with --documents: blank-line separated documents)\n"
+	    "  --threads    number of worker threads sharing the controller (1)\n"
+	    "  --warmup     unmeasured passes over the corpus (1)\n"
+	    "  --reps       measured passes over the corpus (3)\n"
+	    "  --output     JSON results file (stdout)\n\n");
+}
+
+/******************* MAIN ***************************/
+
+int main(int argc, char *argv[])
+{
+    struct OOmnik *oom;
+    struct ooBenchCorpus corpus = { NULL, 0, 0 };
+    struct ooBenchWorker *workers;
+    const char *config = "oomniconf.xml";
+    const char *corpus_name = NULL;
+    const char *output_name = NULL;
+    size_t num_workers = 1, warmup = 1, reps = 3;
+    bool documents = false;
+    double *latencies, start, elapsed;
+    size_t i, num_latencies = 0, num_failures = 0;
+    struct ooAllocCounts counts_before, counts;
+    size_t num_processed;
+    long rss_after_load;
+    FILE *out = stdout;
+    int long_option;
+    int opt, ret;
+
+    while ((opt = getopt_long(argc, argv,
+			     options_string, main_options, &long_option)) >= 0) {
+	switch (opt)
+	{
+	case 'c':
+	    config = optarg;
+	    break;
+	case 'i':
+	    corpus_name = optarg;
+	    break;
+	case 't':
+	    num_workers = (size_t)atoi(optarg);
+	    break;
+	case 'w':
+	    warmup = (size_t)atoi(optarg);
+	    break;
+	case 'r':
+	    reps = (size_t)atoi(optarg);
+	    break;
+	case 'o':
+	    output_name = optarg;
+	    break;
+	case 'd':
+	    documents = true;
+	    break;
+	case 'h':
+	case '?':
+	default:
+	    display_usage();
+	    exit(-1);
+	}
+    }
+
+    if (!corpus_name || !reps ||
+	!num_workers || num_workers > BENCH_MAX_THREADS) {
+	display_usage();
+	exit(-1);
+    }
+
+    ret = bench_read_corpus(&corpus, corpus_name, documents);
+    if (ret != oo_OK || !corpus.num_inputs) {
+	fprintf(stderr, " -- Empty corpus: \"%s\" :(\n", corpus_name);
+	exit(-2);
+    }
+
+    oom = (struct OOmnik*)OOmnik_create(config);
+    if (!oom) {
+	display_usage();
+	exit(-2);
+    }
+    rss_after_load = bench_peak_rss_kb();
+
+    workers = malloc(sizeof(struct ooBenchWorker) * num_workers);
+    if (!workers) exit(-3);
+
+    for (i = 0; i < num_workers; i++) {
+	workers[i].id = i;
+	workers[i].num_workers = num_workers;
+	workers[i].oomnik = oom;
+	workers[i].corpus = &corpus;
+    }
+
+    fprintf(stderr, "\n  oomnik-bench: %zu inputs (%zu bytes), "
+	    "%zu threads, warm-up %zu, reps %zu\n",
+	    corpus.num_inputs, corpus.num_bytes, num_workers, warmup, reps);
+
+    if (warmup)
+	bench_run(workers, num_workers, warmup, false);
+
+    bench_alloc_counts(&counts_before);
+
+    start = bench_now();
+    ret = bench_run(workers, num_workers, reps, true);
+    elapsed = bench_now() - start;
+    bench_alloc_counts(&counts);
+    if (ret != oo_OK) exit(-3);
+
+    /* merge the latencies of all workers */
+    for (i = 0; i < num_workers; i++) {
+	num_latencies += workers[i].num_latencies;
+	num_failures += workers[i].num_failures;
+    }
+
+    latencies = malloc(sizeof(double) * (num_latencies + 1));
+    if (!latencies) exit(-3);
+
+    num_latencies = 0;
+    for (i = 0; i < num_workers; i++) {
+	memcpy(latencies + num_latencies, workers[i].latencies,
+	       sizeof(double) * workers[i].num_latencies);
+	num_latencies += workers[i].num_latencies;
+	free(workers[i].latencies);
+    }
+    qsort(latencies, num_latencies, sizeof(double), bench_compare_doubles);
+
+    num_processed = corpus.num_inputs * reps;
+
+    if (output_name) {
+	out = fopen(output_name, "w");
+	if (!out) {
+	    fprintf(stderr, " -- Couldn't open \"%s\" :(\n", output_name);
+	    out = stdout;
+	}
+    }
+
+    fprintf(out, "{\"config\":\"%s\",\"corpus\":\"%s\","
+	    "\"inputs\":%zu,\"bytes\":%zu,\"documents\":%s,"
+	    "\"threads\":%zu,\"warmup\":%zu,\"reps\":%zu,"
+	    "\"processed\":%zu,\"failures\":%zu,"
+	    "\"elapsed_s\":%.6f,\"inputs_per_s\":%.2f,\"mb_per_s\":%.4f,"
+	    "\"latency_ms\":{\"min\":%.4f,\"p50\":%.4f,\"p90\":%.4f,"
+	    "\"p99\":%.4f,\"p999\":%.4f,\"max\":%.4f},"
+	    "\"peak_rss_kb\":%ld,\"rss_after_load_kb\":%ld,",
+	    config, corpus_name,
+	    corpus.num_inputs, corpus.num_bytes, documents ? "true" : "false",
+	    num_workers, warmup, reps,
+	    num_processed, num_failures,
+	    elapsed, num_processed / elapsed,
+	    (double)corpus.num_bytes * reps / elapsed / (1024.0 * 1024.0),
+	    num_latencies ? latencies[0] * 1e3 : 0.0,
+	    bench_percentile(latencies, num_latencies, 50.0) * 1e3,
+	    bench_percentile(latencies, num_latencies, 90.0) * 1e3,
+	    bench_percentile(latencies, num_latencies, 99.0) * 1e3,
+	    bench_percentile(latencies, num_latencies, 99.9) * 1e3,
+	    num_latencies ? latencies[num_latencies - 1] * 1e3 : 0.0,
+	    bench_peak_rss_kb(), rss_after_load);
+
+    if (bench_counts_allocs)
+	fprintf(out, "\"allocs\":%zu,\"reallocs\":%zu,\"frees\":%zu,"
+		"\"allocs_per_input\":%.2f}\n",
+		counts.num_allocs - counts_before.num_allocs,
+		counts.num_reallocs - counts_before.num_reallocs,
+		counts.num_frees - counts_before.num_frees,
+		(double)(counts.num_allocs - counts_before.num_allocs) /\
+		num_processed);
+    else
+	fprintf(out, "\"allocs\":null,\"reallocs\":null,\"frees\":null,"
+		"\"allocs_per_input\":null}\n");
+
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "  == %.2f inputs/s, p50 %.3f ms, p99 %.3f ms, peak RSS %ld KB\n",
+	    num_processed / elapsed,
+	    bench_percentile(latencies, num_latencies, 50.0) * 1e3,
+	    bench_percentile(latencies, num_latencies, 99.0) * 1e3,
+	    bench_peak_rss_kb());
+
+    free(latencies);
+    free(workers);
+    for (i = 0; i < corpus.num_inputs; i++)
+	free(corpus.inputs[i]);
+    free(corpus.inputs);
+
+    oom->del(oom);
+
+    exit(0);
+}
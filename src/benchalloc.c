@@ -0,0 +1,85 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   -------
+ *   benchalloc.c
+ *   allocation counters of the benchmark programs
+ */
+
+#include <stdlib.h>
+
+#include "benchalloc.h"
+
+/* the glibc allocator is interposed for the whole process,
+ * the counters are shared by all its threads */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static volatile size_t num_allocs = 0;
+static volatile size_t num_reallocs = 0;
+static volatile size_t num_frees = 0;
+static volatile size_t num_bytes = 0;
+
+const int bench_counts_allocs = 1;
+
+void *malloc(size_t size)
+{
+    __sync_fetch_and_add(&num_allocs, 1);
+    __sync_fetch_and_add(&num_bytes, size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    __sync_fetch_and_add(&num_allocs, 1);
+    __sync_fetch_and_add(&num_bytes, nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (ptr)
+	__sync_fetch_and_add(&num_reallocs, 1);
+    else
+	__sync_fetch_and_add(&num_allocs, 1);
+    __sync_fetch_and_add(&num_bytes, size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr) __sync_fetch_and_add(&num_frees, 1);
+    __libc_free(ptr);
+}
+#else
+static size_t num_allocs = 0;
+static size_t num_reallocs = 0;
+static size_t num_frees = 0;
+static size_t num_bytes = 0;
+
+const int bench_counts_allocs = 0;
+#endif
+
+extern void
+bench_alloc_counts(struct ooAllocCounts *counts)
+{
+    counts->num_allocs = num_allocs;
+    counts->num_reallocs = num_reallocs;
+    counts->num_frees = num_frees;
+    counts->num_bytes = num_bytes;
+}
@@ -0,0 +1,46 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   benchalloc.h
+ *   allocation counters of the benchmark programs
+ */
+
+#ifndef OO_BENCHALLOC_H
+#define OO_BENCHALLOC_H
+
+#include <stddef.h>
+
+typedef struct ooAllocCounts {
+    /* malloc, calloc and realloc of NULL */
+    size_t num_allocs;
+
+    /* realloc of a live block */
+    size_t num_reallocs;
+
+    size_t num_frees;
+
+    /* bytes asked for, a resize counts its whole new size */
+    size_t num_bytes;
+} ooAllocCounts;
+
+/* 1 if the allocator is interposed, 
+ * otherwise the counters stay at 0 */
+extern const int bench_counts_allocs;
+
+/* the counters of the whole process so far */
+extern void bench_alloc_counts(struct ooAllocCounts *counts);
+
+#endif /* OO_BENCHALLOC_H */
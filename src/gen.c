@@ -0,0 +1,722 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   -------
+ *   gen.c
+ *   synthetic knowledge base and corpus generator
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ooconfig.h"
+
+#define GEN_PATH_BUF_SIZE 1024
+#define GEN_MAX_SEQ_LEN 64
+#define GEN_MAX_NEW_WORD_ATTEMPTS 64
+
+/* letters of the generated alphabet */
+#define GEN_LATIN_SIZE 26
+#define GEN_CYRILLIC_SIZE 32
+#define GEN_GREEK_SIZE 24
+#define GEN_MAX_ALPHABET (GEN_LATIN_SIZE + GEN_CYRILLIC_SIZE + GEN_GREEK_SIZE)
+
+/* names of the generated code systems */
+#define GEN_UTF8_CS "Gen Text encoded as UTF-8"
+#define GEN_UNICODE_CS "Gen Unicode"
+#define GEN_ALPHABET_CS "Gen Alphabet"
+#define GEN_LEXICON_CS "Gen Lexicon"
+#define GEN_CLASSID "gen"
+
+static const char *options_string = "o:n:a:l:L:D:f:d:t:m:s:c:i:w:u:h?";
+
+static struct option main_options[] =
+{
+    {"output-dir", 1, NULL, 'o'},
+    {"codes", 1, NULL, 'n'},
+    {"alphabet", 1, NULL, 'a'},
+    {"seq-min", 1, NULL, 'l'},
+    {"seq-max", 1, NULL, 'L'},
+    {"seq-dist", 1, NULL, 'D'},
+    {"fanout", 1, NULL, 'f'},
+    {"derivs", 1, NULL, 'd'},
+    {"topics", 1, NULL, 't'},
+    {"matrix-depth", 1, NULL, 'm'},
+    {"seed", 1, NULL, 's'},
+    {"corpus", 1, NULL, 'c'},
+    {"inputs", 1, NULL, 'i'},
+    {"words-per-input", 1, NULL, 'w'},
+    {"unknown-rate", 1, NULL, 'u'},
+    {"help", 0, NULL, 'h'},
+    { NULL, 0, NULL, 0 }
+};
+
+/* operations used by the generated specs and derivations */
+static const char *gen_opers[] = { "OO_ATTR", "OO_ARG", "OO_AGGREGATES" };
+
+#define GEN_NUM_OPERS (sizeof(gen_opers) / sizeof(gen_opers[0]))
+
+typedef enum gen_dist_type { GEN_DIST_UNIFORM,
+			     GEN_DIST_GEOMETRIC } gen_dist_type;
+
+typedef struct ooGenParams {
+    const char *output_dir;
+    size_t num_codes;
+    size_t alphabet_size;
+    size_t seq_min;
+    size_t seq_max;
+    gen_dist_type seq_dist;
+    size_t fanout;
+    size_t num_derivs;
+    size_t num_topics;
+    size_t matrix_depth;
+    unsigned long seed;
+
+    const char *corpus_name;
+    size_t num_inputs;
+    size_t words_per_input;
+    double unknown_rate;
+} ooGenParams;
+
+typedef struct ooGenLexicon {
+    /* letter index sequences */
+    unsigned char **words;
+    size_t *word_lens;
+    size_t num_words;
+
+    /* open addressing over word contents */
+    size_t *slots;
+    size_t num_slots;
+} ooGenLexicon;
+
+
+/******************* RANDOM ***************************/
+
+/* xorshift64*: identical output on every platform for a given seed */
+static unsigned long long gen_state = 88172645463325252ULL;
+
+static void
+gen_srand(unsigned long seed)
+{
+    gen_state = 88172645463325252ULL ^ ((unsigned long long)seed * 2685821657736338717ULL);
+    if (!gen_state) gen_state = 88172645463325252ULL;
+}
+
+static unsigned long long
+gen_rand(void)
+{
+    gen_state ^= gen_state >> 12;
+    gen_state ^= gen_state << 25;
+    gen_state ^= gen_state >> 27;
+    return gen_state * 2685821657736338717ULL;
+}
+
+static size_t
+gen_rand_below(size_t limit)
+{
+    if (!limit) return 0;
+    return (size_t)(gen_rand() % limit);
+}
+
+static double
+gen_rand_unit(void)
+{
+    return (double)(gen_rand() >> 11) / 9007199254740992.0;
+}
+
+static size_t
+gen_seq_len(struct ooGenParams *params)
+{
+    size_t len = params->seq_min;
+
+    if (params->seq_dist == GEN_DIST_UNIFORM)
+	return params->seq_min + gen_rand_below(params->seq_max - params->seq_min + 1);
+
+    /* geometric: short sequences dominate as in natural lexicons */
+    while (len < params->seq_max && gen_rand_unit() < 0.6)
+	len++;
+
+    return len;
+}
+
+
+/******************* ALPHABET ***************************/
+
+static unsigned int
+gen_letter_codepoint(size_t letter)
+{
+    if (letter < GEN_LATIN_SIZE)
+	return 0x61 + letter;
+    letter -= GEN_LATIN_SIZE;
+
+    if (letter < GEN_CYRILLIC_SIZE)
+	return 0x0430 + letter;
+    letter -= GEN_CYRILLIC_SIZE;
+
+    /* skip the final sigma */
+    return 0x03B1 + letter + (letter >= 17 ? 1 : 0);
+}
+
+static size_t
+gen_write_utf8(unsigned int cp,
+	       char *buf)
+{
+    if (cp < 0x80) {
+	buf[0] = (char)cp;
+	return 1;
+    }
+    buf[0] = (char)(0xC0 | (cp >> 6));
+    buf[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+}
+
+static int
+gen_fputs_word(const unsigned char *word,
+	       size_t len,
+	       FILE *f)
+{
+    char buf[2];
+    size_t i, buf_len;
+
+    for (i = 0; i < len; i++) {
+	buf_len = gen_write_utf8(gen_letter_codepoint(word[i]), buf);
+	fwrite(buf, 1, buf_len, f);
+    }
+    return oo_OK;
+}
+
+
+/******************* LEXICON ***************************/
+
+static size_t
+gen_hash_word(const unsigned char *word,
+	      size_t len)
+{
+    size_t i, h = 5381;
+
+    for (i = 0; i < len; i++)
+	h = h * 33 + word[i];
+    return h;
+}
+
+/* returns true if the word is not yet taken */
+static bool
+gen_lexicon_insert(struct ooGenLexicon *lex,
+		   unsigned char *word,
+		   size_t len)
+{
+    size_t pos, id;
+
+    pos = gen_hash_word(word, len) % lex->num_slots;
+
+    while (lex->slots[pos]) {
+	id = lex->slots[pos] - 1;
+	if (lex->word_lens[id] == len && !memcmp(lex->words[id], word, len))
+	    return false;
+	pos = (pos + 1) % lex->num_slots;
+    }
+
+    lex->words[lex->num_words] = word;
+    lex->word_lens[lex->num_words] = len;
+    lex->num_words++;
+    lex->slots[pos] = lex->num_words;
+
+    return true;
+}
+
+static int
+gen_lexicon_build(struct ooGenLexicon *lex,
+		  struct ooGenParams *params)
+{
+    unsigned char *word;
+    size_t i, len, attempts;
+
+    lex->num_words = 0;
+    lex->num_slots = params->num_codes * 2 + 1;
+
+    lex->words = malloc(sizeof(unsigned char*) * params->num_codes);
+    lex->word_lens = malloc(sizeof(size_t) * params->num_codes);
+    lex->slots = calloc(lex->num_slots, sizeof(size_t));
+    if (!lex->words || !lex->word_lens || !lex->slots) return oo_NOMEM;
+
+    while (lex->num_words < params->num_codes) {
+	len = gen_seq_len(params);
+
+	word = malloc(GEN_MAX_SEQ_LEN);
+	if (!word) return oo_NOMEM;
+
+	for (attempts = 0; attempts < GEN_MAX_NEW_WORD_ATTEMPTS; attempts++) {
+	    for (i = 0; i < len; i++)
+		word[i] = (unsigned char)gen_rand_below(params->alphabet_size);
+	    if (gen_lexicon_insert(lex, word, len)) break;
+
+	    /* the short lengths may be exhausted */
+	    if (len < params->seq_max) len++;
+	}
+
+	if (attempts == GEN_MAX_NEW_WORD_ATTEMPTS) {
+	    free(word);
+	    fprintf(stderr, " -- Couldn't find %zu distinct sequences: "
+		    "increase --alphabet or --seq-max :(\n", params->num_codes);
+	    return oo_FAIL;
+	}
+    }
+
+    return oo_OK;
+}
+
+static void
+gen_lexicon_del(struct ooGenLexicon *lex)
+{
+    size_t i;
+
+    for (i = 0; i < lex->num_words; i++)
+	free(lex->words[i]);
+    free(lex->words);
+    free(lex->word_lens);
+    free(lex->slots);
+}
+
+
+/******************* XML OUTPUT ***************************/
+
+static FILE*
+gen_open(struct ooGenParams *params,
+	 const char *filename)
+{
+    char path[GEN_PATH_BUF_SIZE];
+    FILE *f;
+
+    snprintf(path, GEN_PATH_BUF_SIZE, "%s/%s", params->output_dir, filename);
+
+    f = fopen(path, "w");
+    if (!f) {
+	fprintf(stderr, " -- Couldn't open \"%s\" :(\n", path);
+	return NULL;
+    }
+
+    fprintf(f, "<?xml version=\"1.0\"?>\n\n"
+	    "<!-- generated by oomnik-gen: seed %lu -->\n\n", params->seed);
+
+    return f;
+}
+
+static int
+gen_write_codesystems(struct ooGenParams *params)
+{
+    FILE *f;
+    char buf[2];
+    size_t i;
+
+    /* atomic UTF-8 layer */
+    f = gen_open(params, "gen_utf8.xml");
+    if (!f) return oo_FAIL;
+    fprintf(f, "<conceptlist>\n\n"
+	    "<codesystem name=\"" GEN_UTF8_CS "\"\n"
+	    "            codetype=\"UTF-8\">\n"
+	    "</codesystem>\n\n"
+	    "</conceptlist>\n");
+    fclose(f);
+
+    /* code points */
+    f = gen_open(params, "gen_unicode.xml");
+    if (!f) return oo_FAIL;
+    fprintf(f, "<conceptlist>\n\n"
+	    "<codesystem name=\"" GEN_UNICODE_CS "\"\n"
+	    "              polysemy=\"false\"\n"
+	    "              use_numcodes=\"true\">\n\n"
+	    "<codestruct>\n"
+	    "  <providers>\n"
+	    "    <provider name=\"" GEN_UTF8_CS "\"/>\n"
+	    "  </providers>\n"
+	    "</codestruct>\n\n"
+	    "  <codeset>\n"
+	    "        <code name=\"0x20\" type=\"Separator\"/>\n");
+    for (i = 0; i < params->alphabet_size; i++)
+	fprintf(f, "        <code name=\"0x%x\" denot=\"LETTER %zu\"/>\n",
+		gen_letter_codepoint(i), i);
+    fprintf(f, "  </codeset>\n\n"
+	    "</codesystem>\n\n"
+	    "</conceptlist>\n");
+    fclose(f);
+
+    /* letters */
+    f = gen_open(params, "gen_alphabet.xml");
+    if (!f) return oo_FAIL;
+    fprintf(f, "<conceptlist>\n\n"
+	    "<codesystem name=\"" GEN_ALPHABET_CS "\"\n"
+	    "              polysemy=\"false\">\n\n"
+	    "<codestruct>\n"
+	    "  <providers>\n"
+	    "    <provider name=\"" GEN_UNICODE_CS "\"/>\n"
+	    "  </providers>\n"
+	    "</codestruct>\n\n"
+	    "  <codeset>\n");
+    for (i = 0; i < params->alphabet_size; i++) {
+	fprintf(f, "        <code name=\"LETTER %zu\"/> <!-- ", i);
+	fwrite(buf, 1, gen_write_utf8(gen_letter_codepoint(i), buf), f);
+	fprintf(f, " -->\n");
+    }
+    fprintf(f, "  </codeset>\n\n"
+	    "</codesystem>\n\n"
+	    "</conceptlist>\n");
+    fclose(f);
+
+    return oo_OK;
+}
+
+static int
+gen_write_lexicon(struct ooGenParams *params,
+		  struct ooGenLexicon *lex)
+{
+    FILE *f;
+    size_t i, j;
+
+    f = gen_open(params, "gen_lexicon.xml");
+    if (!f) return oo_FAIL;
+
+    fprintf(f, "<conceptlist>\n\n"
+	    "<codesystem name=\"" GEN_LEXICON_CS "\"\n"
+	    "              polysemy=\"false\">\n\n"
+	    "<initcache enable=\"1\" unittype=\"" GEN_ALPHABET_CS "\""
+	    " matrix_depth=\"%zu\"/>\n\n"
+	    "  <codeset>\n", params->matrix_depth);
+
+    for (i = 0; i < lex->num_words; i++) {
+	fprintf(f, "    <code name=\"W%06zu\">\n"
+		"      <cache><units seq=\"", i);
+	gen_fputs_word(lex->words[i], lex->word_lens[i], f);
+	fprintf(f, "\"/></cache>\n");
+
+	if (params->fanout) {
+	    fprintf(f, "      <specs>\n");
+	    for (j = 0; j < params->fanout; j++)
+		fprintf(f, "        <spec oper=\"%s\" operand=\"W%06zu\""
+			" linear_order=\"%s\"/>\n",
+			gen_opers[gen_rand_below(GEN_NUM_OPERS)],
+			gen_rand_below(lex->num_words),
+			gen_rand_below(2) ? "prepos" : "postpos");
+	    fprintf(f, "      </specs>\n");
+	}
+
+	fprintf(f, "      <usages>\n"
+		"        <usage concref=\"C%06zu:" GEN_CLASSID "\" name=\"main\"",
+		i);
+
+	if (!params->num_derivs) {
+	    fprintf(f, "/>\n      </usages>\n    </code>\n");
+	    continue;
+	}
+
+	fprintf(f, ">\n          <derivs>\n");
+	for (j = 0; j < params->num_derivs; j++)
+	    fprintf(f, "            <deriv name=\"W%06zu\" oper=\"%s\""
+		    " usage_name=\"main\" arg_name=\"W%06zu\""
+		    " arg_usage_name=\"main\"/>\n",
+		    gen_rand_below(lex->num_words),
+		    gen_opers[gen_rand_below(GEN_NUM_OPERS)],
+		    gen_rand_below(lex->num_words));
+	fprintf(f, "          </derivs>\n"
+		"        </usage>\n"
+		"      </usages>\n"
+		"    </code>\n");
+    }
+
+    fprintf(f, "  </codeset>\n\n"
+	    "</codesystem>\n\n"
+	    "</conceptlist>\n");
+    fclose(f);
+
+    return oo_OK;
+}
+
+static int
+gen_write_domain(struct ooGenParams *params)
+{
+    FILE *f;
+    size_t i;
+
+    f = gen_open(params, "gen_domain.xml");
+    if (!f) return oo_FAIL;
+
+    fprintf(f, "<domain name=\"Generated\" id=\"" GEN_CLASSID "\">\n"
+	    "  <title text=\"Synthetic concepts\"/>\n");
+    for (i = 0; i < params->num_codes; i++)
+	fprintf(f, "  <concept name=\"C%06zu\" classid=\"" GEN_CLASSID "\"/>\n", i);
+    fprintf(f, "</domain>\n");
+    fclose(f);
+
+    return oo_OK;
+}
+
+static int
+gen_write_topics(struct ooGenParams *params)
+{
+    FILE *f;
+    size_t i, j, num_ingredients;
+
+    f = gen_open(params, "gen_topics.xml");
+    if (!f) return oo_FAIL;
+
+    fprintf(f, "<topics>\n");
+    for (i = 0; i < params->num_topics; i++) {
+	fprintf(f, "  <topic name=\"T%04zu\">\n"
+		"    <concepts>\n", i);
+
+	num_ingredients = 1 + gen_rand_below(NUM_TOPIC_INGREDIENTS);
+	for (j = 0; j < num_ingredients; j++)
+	    fprintf(f, "      <concept name=\"C%06zu:" GEN_CLASSID "\""
+		    " relev=\"%.2f\"/>\n",
+		    gen_rand_below(params->num_codes),
+		    0.1 + 0.9 * gen_rand_unit());
+
+	fprintf(f, "    </concepts>\n"
+		"  </topic>\n");
+    }
+    fprintf(f, "</topics>\n");
+    fclose(f);
+
+    return oo_OK;
+}
+
+static int
+gen_write_config(struct ooGenParams *params)
+{
+    FILE *f;
+
+    f = gen_open(params, "oomniconf.xml");
+    if (!f) return oo_FAIL;
+
+    fprintf(f, "<oomniconfig>\n"
+	    "   <db filename=\"%s/gen.mm\"/>\n\n"
+	    "   <codesystem name=\"" GEN_LEXICON_CS "\"/>\n"
+	    "   <output format=\"JSON\"/>\n\n"
+	    "   <includes path=\"%s/\">\n"
+	    "     <include filename=\"gen_utf8.xml\"/>\n"
+	    "     <include filename=\"gen_unicode.xml\"/>\n"
+	    "     <include filename=\"gen_alphabet.xml\"/>\n"
+	    "     <include filename=\"gen_lexicon.xml\"/>\n"
+	    "     <include filename=\"gen_domain.xml\"/>\n",
+	    params->output_dir, params->output_dir);
+    if (params->num_topics)
+	fprintf(f, "     <include filename=\"gen_topics.xml\"/>\n");
+    fprintf(f, "  </includes>\n"
+	    "</oomniconfig>\n");
+    fclose(f);
+
+    return oo_OK;
+}
+
+
+/******************* CORPUS ***************************/
+
+/**
+ * one input per line: lexicon words separated by spaces,
+ * some of them replaced by unknown letter sequences
+ */
+static int
+gen_write_corpus(struct ooGenParams *params,
+		 struct ooGenLexicon *lex)
+{
+    unsigned char word[GEN_MAX_SEQ_LEN];
+    FILE *f;
+    size_t i, j, k, len, id;
+
+    f = fopen(params->corpus_name, "w");
+    if (!f) {
+	fprintf(stderr, " -- Couldn't open \"%s\" :(\n", params->corpus_name);
+	return oo_FAIL;
+    }
+
+    for (i = 0; i < params->num_inputs; i++) {
+	for (j = 0; j < params->words_per_input; j++) {
+	    if (j) fputc(' ', f);
+
+	    if (gen_rand_unit() < params->unknown_rate) {
+		len = gen_seq_len(params);
+		for (k = 0; k < len; k++)
+		    word[k] = (unsigned char)gen_rand_below(params->alphabet_size);
+		gen_fputs_word(word, len, f);
+		continue;
+	    }
+
+	    id = gen_rand_below(lex->num_words);
+	    gen_fputs_word(lex->words[id], lex->word_lens[id], f);
+	}
+	fputc('\n', f);
+    }
+
+    fclose(f);
+
+    return oo_OK;
+}
+
+
+/******************* MAIN ***************************/
+
+static void display_usage(void)
+{
+    fprintf(stderr, "\nUsage: oomnik-gen --output-dir=DIR [--codes=N] [--alphabet=N]\n"
+	    "          [--seq-min=N] [--seq-max=N] [--seq-dist=uniform|geometric]\n"
+	    "          [--fanout=N] [--derivs=N] [--topics=N] [--matrix-depth=N]\n"
+	    "          [--seed=N] [--corpus=FILE [--inputs=N]"
+	    " [--words-per-input=N] [--unknown-rate=R]]\n\n"
+	    "  --output-dir       where oomniconf.xml and its includes are written\n"
+	    "  --codes            number of cached lexicon codes (1000)\n"
+	    "  --alphabet         number of letters, at most %d (26)\n"
+	    "  --seq-min/max      cached sequence length range (2..8)\n"
+	    "  --seq-dist         sequence length distribution (geometric)\n"
+	    "  --fanout           specs per code (2)\n"
+	    "  --derivs           derivations per code usage (1)\n"
+	    "  --topics           number of topics (10)\n"
+	    "  --matrix-depth     linear cache matrix depth (2)\n"
+	    "  --corpus           also write a corpus for oomnik-bench\n"
+	    "  --inputs           corpus lines (1000)\n"
+	    "  --words-per-input  words per corpus line (8)\n"
+	    "  --unknown-rate     share of words missing from the lexicon (0.05)\n\n",
+	    GEN_MAX_ALPHABET);
+}
+
+int main(int argc, char *argv[])
+{
+    struct ooGenParams params;
+    struct ooGenLexicon lex;
+    int long_option;
+    int opt, ret;
+
+    params.output_dir = NULL;
+    params.num_codes = 1000;
+    params.alphabet_size = GEN_LATIN_SIZE;
+    params.seq_min = 2;
+    params.seq_max = 8;
+    params.seq_dist = GEN_DIST_GEOMETRIC;
+    params.fanout = 2;
+    params.num_derivs = 1;
+    params.num_topics = 10;
+    params.matrix_depth = 2;
+    params.seed = 1;
+    params.corpus_name = NULL;
+    params.num_inputs = 1000;
+    params.words_per_input = 8;
+    params.unknown_rate = 0.05;
+
+    while ((opt = getopt_long(argc, argv,
+			     options_string, main_options, &long_option)) >= 0) {
+	switch (opt)
+	{
+	case 'o':
+	    params.output_dir = optarg;
+	    break;
+	case 'n':
+	    params.num_codes = (size_t)atol(optarg);
+	    break;
+	case 'a':
+	    params.alphabet_size = (size_t)atoi(optarg);
+	    break;
+	case 'l':
+	    params.seq_min = (size_t)atoi(optarg);
+	    break;
+	case 'L':
+	    params.seq_max = (size_t)atoi(optarg);
+	    break;
+	case 'D':
+	    if (!strcmp(optarg, "uniform"))
+		params.seq_dist = GEN_DIST_UNIFORM;
+	    else if (!strcmp(optarg, "geometric"))
+		params.seq_dist = GEN_DIST_GEOMETRIC;
+	    else {
+		display_usage();
+		exit(-1);
+	    }
+	    break;
+	case 'f':
+	    params.fanout = (size_t)atoi(optarg);
+	    break;
+	case 'd':
+	    params.num_derivs = (size_t)atoi(optarg);
+	    break;
+	case 't':
+	    params.num_topics = (size_t)atoi(optarg);
+	    break;
+	case 'm':
+	    params.matrix_depth = (size_t)atoi(optarg);
+	    break;
+	case 's':
+	    params.seed = (unsigned long)atol(optarg);
+	    break;
+	case 'c':
+	    params.corpus_name = optarg;
+	    break;
+	case 'i':
+	    params.num_inputs = (size_t)atol(optarg);
+	    break;
+	case 'w':
+	    params.words_per_input = (size_t)atoi(optarg);
+	    break;
+	case 'u':
+	    params.unknown_rate = atof(optarg);
+	    break;
+	case 'h':
+	case '?':
+	default:
+	    display_usage();
+	    exit(-1);
+	}
+    }
+
+    if (!params.output_dir || !params.num_codes ||
+	!params.alphabet_size || params.alphabet_size > GEN_MAX_ALPHABET ||
+	!params.seq_min || params.seq_min > params.seq_max ||
+	params.seq_max >= GEN_MAX_SEQ_LEN || !params.matrix_depth) {
+	display_usage();
+	exit(-1);
+    }
+
+    if (mkdir(params.output_dir, 0755) && access(params.output_dir, W_OK)) {
+	fprintf(stderr, " -- Couldn't create \"%s\" :(\n", params.output_dir);
+	exit(-2);
+    }
+
+    gen_srand(params.seed);
+
+    memset(&lex, 0, sizeof(struct ooGenLexicon));
+    ret = gen_lexicon_build(&lex, &params);
+    if (ret != oo_OK) exit(-2);
+
+    ret = gen_write_codesystems(&params);
+    if (ret == oo_OK) ret = gen_write_lexicon(&params, &lex);
+    if (ret == oo_OK) ret = gen_write_domain(&params);
+    if (ret == oo_OK && params.num_topics) ret = gen_write_topics(&params);
+    if (ret == oo_OK) ret = gen_write_config(&params);
+    if (ret == oo_OK && params.corpus_name) ret = gen_write_corpus(&params, &lex);
+    if (ret != oo_OK) exit(-2);
+
+    fprintf(stderr, "  oomnik-gen: %zu codes, %zu letters, fan-out %zu, "
+	    "%zu derivs, %zu topics -> %s/oomniconf.xml\n",
+	    lex.num_words, params.alphabet_size, params.fanout,
+	    params.num_derivs, params.num_topics, params.output_dir);
+    if (params.corpus_name)
+	fprintf(stderr, "  corpus: %zu inputs -> %s\n",
+		params.num_inputs, params.corpus_name);
+
+    gen_lexicon_del(&lex);
+
+    exit(0);
+}
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <string.h>
+#include <signal.h>
 
 /* win options not needed under Linux */
 #if defined(_WIN32) || defined(WIN32)
@@ -31,12 +32,27 @@
 
 #include "ooconfig.h"
 #include "oomnik.h"
+#include "ooserver.h"
+#include "oobatch.h"
 
-static const char *options_string = "c:h?";
+static const char *options_string = "c:t:s:b:e:i:Sl:w:I:o:f:T:r:h?";
 
 static struct option main_options[] =
 {
     {"config", 1, NULL, 'c'},
+    {"trace", 1, NULL, 't'},
+    {"trace-subsystems", 1, NULL, 's'},
+    {"build-store", 1, NULL, 'b'},
+    {"export-db", 1, NULL, 'e'},
+    {"import-db", 1, NULL, 'i'},
+    {"save-concepts", 0, NULL, 'S'},
+    {"serve", 1, NULL, 'l'},
+    {"workers", 1, NULL, 'w'},
+    {"input", 1, NULL, 'I'},
+    {"output", 1, NULL, 'o'},
+    {"format", 1, NULL, 'f'},
+    {"threads", 1, NULL, 'T'},
+    {"records", 1, NULL, 'r'},
     {"help", 0, NULL, 'h'},
     { NULL, 0, NULL, 0 }
 };
@@ -45,7 +61,29 @@ void display_usage(void);
 
 void display_usage(void)
 {
-    fprintf(stderr, "\nUsage: oomnik --config=path_to_your_oomniconf_xml\n\n");
+    fprintf(stderr, "\nUsage: oomnik --config=path_to_your_oomniconf_xml\n"
+	    "              [--trace=trace_file.json]\n"
+	    "              [--trace-subsystems=load,decoder,segm,cache,"
+	    "agenda,conc,complex,present]\n"
+	    "              [--build-store=concept_store_file]\n"
+	    "              [--import-db=mindmap_dump_file]\n"
+	    "              [--save-concepts]\n"
+	    "              [--export-db=mindmap_dump_file]\n"
+	    "              [--serve=unix:/path/to/socket|host:port|port]\n"
+	    "              [--workers=num_worker_threads]\n"
+	    "              [--input=input_file|- [--output=output_file|-]\n"
+	    "               [--format=json|xml] [--threads=num_threads]\n"
+	    "               [--records=lines|nul|whole]]\n\n");
+}
+
+/* the server to stop on a signal */
+static struct ooServer *server = NULL;
+
+static void
+stop_server(int signum)
+{
+    if (server)
+	server->stop(server);
 }
 
 /******************* MAIN ***************************/
@@ -54,6 +92,22 @@ int main(int argc, char *argv[])
 {
     struct OOmnik *oom;
     const char *config = "oomniconf.xml";
+    const char *trace_filename = NULL;
+    const char *trace_subsystems = NULL;
+    const char *store_filename = NULL;
+    const char *export_filename = NULL;
+    const char *import_filename = NULL;
+    const char *serve_address = NULL;
+    size_t num_workers = 0;
+    const char *input_filename = NULL;
+    const char *output_filename = NULL;
+    output_type format = FORMAT_JSON;
+    oo_batch_records records = OO_RECORDS_LINES;
+    size_t num_threads = 0;
+    struct ooBatch *batch = NULL;
+    struct sigaction sa;
+    int save_concepts = 0;
+    int ret;
     int long_option;
     int opt;
     
@@ -64,7 +118,62 @@ int main(int argc, char *argv[])
 	case 'c':
 	    if (optarg) {
 		config = optarg;
-		printf("%s\n", optarg);
+		fprintf(stderr, "%s\n", optarg);
+	    }
+	    break;
+	case 't':
+	    trace_filename = optarg;
+	    break;
+	case 's':
+	    trace_subsystems = optarg;
+	    break;
+	case 'b':
+	    store_filename = optarg;
+	    break;
+	case 'e':
+	    export_filename = optarg;
+	    break;
+	case 'i':
+	    import_filename = optarg;
+	    break;
+	case 'S':
+	    save_concepts = 1;
+	    break;
+	case 'l':
+	    serve_address = optarg;
+	    break;
+	case 'w':
+	    num_workers = (size_t)strtoul(optarg, NULL, 10);
+	    break;
+	case 'I':
+	    input_filename = optarg;
+	    break;
+	case 'o':
+	    output_filename = optarg;
+	    break;
+	case 'f':
+	    if (!strcmp(optarg, "json"))
+		format = FORMAT_JSON;
+	    else if (!strcmp(optarg, "xml"))
+		format = FORMAT_XML;
+	    else {
+		display_usage();
+		exit(-1);
+	    }
+	    break;
+	case 'T':
+	    num_threads = (size_t)strtoul(optarg, NULL, 10);
+	    break;
+	case 'r':
+	    if (!strcmp(optarg, "lines"))
+		records = OO_RECORDS_LINES;
+	    else if (!strcmp(optarg, "nul"))
+		records = OO_RECORDS_NUL;
+	    else if (!strcmp(optarg, "whole"))
+		records = OO_RECORDS_WHOLE;
+	    else {
+		display_usage();
+		exit(-1);
 	    }
 	    break;
 	case 'h':
@@ -81,11 +190,72 @@ int main(int argc, char *argv[])
 	}
     }
 
+    if (trace_filename) {
+	if (OOmnik_set_trace(NULL, trace_filename, trace_subsystems) != oo_OK) {
+	    display_usage();
+	    exit(-1);
+	}
+    }
+
+    /* the input and output are checked before the long load */
+    if (input_filename) {
+	ret = ooBatch_new(&batch, input_filename, output_filename,
+			  format, records, num_threads);
+	if (ret != oo_OK) exit(-6);
+    }
+
     oom = (struct OOmnik*)OOmnik_create(config);
     if (!oom) {
+	if (batch) batch->del(batch);
 	display_usage();
 	exit(-2);
     }
+
+    /* MindMap DB maintenance: run the requested steps in order and quit */
+    if (import_filename || save_concepts ||
+	export_filename || store_filename) {
+	ret = oo_OK;
+	if (import_filename)
+	    ret = OOmnik_import_db(oom, import_filename);
+	if (ret == oo_OK && save_concepts)
+	    ret = OOmnik_save_concepts(oom);
+	if (ret == oo_OK && export_filename)
+	    ret = OOmnik_export_db(oom, export_filename);
+	if (ret == oo_OK && store_filename)
+	    ret = OOmnik_build_store(oom, store_filename);
+	oom->del(oom);
+	exit(ret == oo_OK ? 0 : -3);
+    }
+
+    /* batch mode: nothing but the results goes to the output */
+    if (batch) {
+	ret = batch->run(batch, oom);
+	batch->del(batch);
+	oom->del(oom);
+	exit(ret == oo_OK ? 0 : -6);
+    }
+
+    if (serve_address) {
+	ret = ooServer_new(&server, oom, serve_address, num_workers);
+	if (ret != oo_OK) {
+	    oom->del(oom);
+	    exit(-4);
+	}
+
+	memset(&sa, 0, sizeof(struct sigaction));
+	sa.sa_handler = stop_server;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	ret = server->serve(server);
+
+	server->del(server);
+	server = NULL;
+	oom->del(oom);
+	exit(ret == oo_OK ? 0 : -5);
+    }
+
     oom->interact(oom);
     oom->del(oom);
 
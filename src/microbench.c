@@ -0,0 +1,827 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ------------
+ *   microbench.c
+ *   component benchmarks: core building blocks in isolation
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+
+#include "ooconfig.h"
+#include "oomnik.h"
+#include "benchalloc.h"
+#include "oomindmap.h"
+#include "oocodesystem.h"
+#include "oocode.h"
+#include "oodict.h"
+#include "oodecoder.h"
+#include "oosegmentizer.h"
+#include "oocache.h"
+#include "ooagenda.h"
+#include "ooaccumulator.h"
+#include "ooconcunit.h"
+#include "oocomplex.h"
+
+#define MB_KEY_BUF_SIZE 32
+#define MB_LINE_BUF_SIZE 64 * 1024
+#define MB_NUM_DICT_SIZES 3
+#define MB_COMPLEX_BATCH 1000
+#define MB_COMPLEX_SPAN 16
+
+static const char *options_string = "c:i:m:f:o:h?";
+
+static struct option main_options[] =
+{
+    {"config", 1, NULL, 'c'},
+    {"input", 1, NULL, 'i'},
+    {"min-time", 1, NULL, 'm'},
+    {"filter", 1, NULL, 'f'},
+    {"output", 1, NULL, 'o'},
+    {"help", 0, NULL, 'h'},
+    { NULL, 0, NULL, 0 }
+};
+
+static const size_t mb_dict_sizes[MB_NUM_DICT_SIZES] = { 1000, 10000, 100000 };
+
+static const char *mb_text_ascii =
+    "The quick brown fox jumps over the lazy dog while 42 clerks count "
+    "1234567 coins, and the jury keeps quiet about it for a while.";
+
+static const char *mb_text_cyrillic =
+    "Съешь же ещё этих мягких французских булок, да выпей чаю: "
+    "широкая электрификация южных губерний.";
+
+static const char *mb_text_mixed =
+    "Mixed input: 12 книг, 7 pens, цена 345 руб., "
+    "delivery завтра at 9:30, код ABC-42.";
+
+/* default window for the cache and decoding benchmarks */
+static const char *mb_default_window = "12345 42 and 7";
+
+
+/******************* CONTEXT ***************************/
+
+typedef struct ooMicroContext {
+    struct OOmnik *oomnik;
+
+    const char *window;
+    size_t window_len;
+
+    /* dictionary */
+    char **keys;
+    char **missing_keys;
+    size_t num_keys;
+    struct ooDict *dict;
+
+    /* atomic segmentation */
+    struct ooDecoder *atomic_dec;
+    const char *text;
+
+    /* linear cache */
+    struct ooDecoder *cache_dec;
+
+    /* complexes */
+    struct ooDecoder *complex_dec;
+    struct ooComplex *join_parent;
+    struct ooComplex *join_child;
+    struct ooComplex *cross_parent;
+    struct ooComplex *cross_child;
+    struct ooComplex *aggr;
+    struct ooCodeSpec spec;
+
+    /* full decoding */
+    struct ooDecoder *root_dec;
+    char *output_buf;
+} ooMicroContext;
+
+typedef struct ooMicroBench {
+    char name[64];
+
+    /* untimed: restores the state consumed by a run */
+    int (*prepare)(struct ooMicroContext *ctx);
+
+    /* timed: performs ops_per_run operations */
+    int (*run)(struct ooMicroContext *ctx);
+
+    size_t ops_per_run;
+} ooMicroBench;
+
+static double
+mb_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+/******************* DICTIONARY ***************************/
+
+static int
+mb_dict_setup(struct ooMicroContext *ctx,
+	      size_t num_keys)
+{
+    size_t i;
+    int ret;
+
+    ctx->keys = malloc(sizeof(char*) * num_keys);
+    ctx->missing_keys = malloc(sizeof(char*) * num_keys);
+    if (!ctx->keys || !ctx->missing_keys) return oo_NOMEM;
+
+    for (i = 0; i < num_keys; i++) {
+	ctx->keys[i] = malloc(MB_KEY_BUF_SIZE);
+	ctx->missing_keys[i] = malloc(MB_KEY_BUF_SIZE);
+	if (!ctx->keys[i] || !ctx->missing_keys[i]) return oo_NOMEM;
+
+	/* code names of a typical knowledge base */
+	snprintf(ctx->keys[i], MB_KEY_BUF_SIZE, "CODE %zu", i);
+	snprintf(ctx->missing_keys[i], MB_KEY_BUF_SIZE, "NONE %zu", i);
+    }
+    ctx->num_keys = num_keys;
+
+    ret = ooDict_new(&ctx->dict);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; i < num_keys; i++) {
+	ret = ctx->dict->set(ctx->dict, ctx->keys[i], ctx->keys[i]);
+	if (ret != oo_OK) return ret;
+    }
+
+    return oo_OK;
+}
+
+static void
+mb_dict_teardown(struct ooMicroContext *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->num_keys; i++) {
+	free(ctx->keys[i]);
+	free(ctx->missing_keys[i]);
+    }
+    free(ctx->keys);
+    free(ctx->missing_keys);
+    if (ctx->dict) ctx->dict->del(ctx->dict);
+
+    ctx->keys = NULL;
+    ctx->missing_keys = NULL;
+    ctx->num_keys = 0;
+    ctx->dict = NULL;
+}
+
+static int
+mb_dict_renew(struct ooMicroContext *ctx)
+{
+    if (ctx->dict) ctx->dict->del(ctx->dict);
+    return ooDict_new(&ctx->dict);
+}
+
+static int
+mb_dict_insert(struct ooMicroContext *ctx)
+{
+    size_t i;
+    int ret;
+
+    for (i = 0; i < ctx->num_keys; i++) {
+	ret = ctx->dict->set(ctx->dict, ctx->keys[i], ctx->keys[i]);
+	if (ret != oo_OK) return ret;
+    }
+    return oo_OK;
+}
+
+static int
+mb_dict_get_hit(struct ooMicroContext *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->num_keys; i++)
+	if (!ctx->dict->get(ctx->dict, ctx->keys[i])) return oo_FAIL;
+    return oo_OK;
+}
+
+static int
+mb_dict_get_miss(struct ooMicroContext *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->num_keys; i++)
+	if (ctx->dict->get(ctx->dict, ctx->missing_keys[i])) return oo_FAIL;
+    return oo_OK;
+}
+
+
+/******************* DECODERS ***************************/
+
+static struct ooDecoder*
+mb_new_decoder(struct ooMicroContext *ctx,
+	       struct ooCodeSystem *cs,
+	       bool is_root,
+	       output_type format)
+{
+    struct ooDecoder *dec;
+    int ret;
+
+    ret = ooDecoder_new(&dec);
+    if (ret != oo_OK) return NULL;
+
+    dec->oomnik = ctx->oomnik;
+    dec->is_root = is_root;
+    dec->format = format;
+
+    ret = dec->set_codesystem(dec, cs);
+    if (ret != oo_OK) {
+	dec->del(dec);
+	return NULL;
+    }
+
+    return dec;
+}
+
+static struct ooCodeSystem*
+mb_find_codesystem(struct ooMicroContext *ctx,
+		   bool atomic_utf8)
+{
+    struct ooMindMap *mm = ctx->oomnik->mindmap;
+    struct ooCodeSystem *cs;
+    int i;
+
+    for (i = 0; i < mm->num_codesystems; i++) {
+	cs = mm->codesystems[i];
+	if (atomic_utf8) {
+	    if (cs->is_atomic && cs->atomic_codesystem_type == ATOMIC_UTF8)
+		return cs;
+	    continue;
+	}
+	if (cs->cache) return cs;
+    }
+
+    return NULL;
+}
+
+/* atomic segmentation includes the agenda reset it begins with */
+static int
+mb_utf8_parse(struct ooMicroContext *ctx)
+{
+    struct ooSegmentizer *segm = ctx->atomic_dec->segm;
+
+    segm->input = (ooATOM*)ctx->text;
+    segm->input_len = strlen(ctx->text);
+
+    return segm->segmentize(segm);
+}
+
+/* same steps as the cache branch of the decoder */
+static int
+mb_cache_lookup(struct ooMicroContext *ctx)
+{
+    struct ooDecoder *dec = ctx->cache_dec;
+    struct ooLinearCache *cache = dec->codesystem->cache;
+
+    dec->agenda->reset(dec->agenda);
+    dec->segm->reset(dec->segm);
+
+    return cache->lookup(cache, dec->segm,
+			 (ooATOM*)ctx->window, ctx->window_len,
+			 0, dec->agenda);
+}
+
+static int
+mb_agenda_prepare(struct ooMicroContext *ctx)
+{
+    struct ooDecoder *dec = ctx->root_dec;
+
+    dec->input = (ooATOM*)ctx->window;
+    dec->input_len = ctx->window_len;
+
+    return dec->decode(dec);
+}
+
+static int
+mb_agenda_reset(struct ooMicroContext *ctx)
+{
+    return ctx->root_dec->agenda->reset(ctx->root_dec->agenda);
+}
+
+static int
+mb_present(struct ooMicroContext *ctx)
+{
+    struct ooAccu *accu = ctx->root_dec->agenda->accu;
+
+    return accu->present_solution(accu, ctx->output_buf, OUTPUT_BUF_SIZE);
+}
+
+
+/******************* COMPLEXES ***************************/
+
+static struct ooComplex*
+mb_new_complex(struct ooAgenda *agenda,
+	       struct ooCode *code,
+	       int linear_begin,
+	       int linear_end)
+{
+    struct ooConcUnit *cu;
+    struct ooComplex *complex;
+    int i;
+
+    cu = agenda->alloc_unit(agenda);
+    if (!cu) return NULL;
+
+    cu->make_instance(cu, code, NULL);
+    cu->linear_pos = linear_begin;
+    cu->coverage = linear_end - linear_begin;
+
+    complex = cu->complexes[0];
+    complex->reset(complex);
+    complex->is_free = false;
+    complex->weight = linear_end - linear_begin;
+    complex->linear_begin = linear_begin;
+    complex->linear_end = linear_end;
+
+    for (i = 0; i < INPUT_BUF_SIZE; i++)
+	complex->linear_index[i] = NULL;
+
+    return complex;
+}
+
+/* a terminal complex at every position in the list */
+static int
+mb_fill_terminals(struct ooAgenda *agenda,
+		  struct ooCode *code,
+		  struct ooComplex *complex,
+		  const int *positions,
+		  size_t num_positions,
+		  int coverage)
+{
+    struct ooComplex *term;
+    size_t i;
+
+    for (i = 0; i < num_positions; i++) {
+	term = mb_new_complex(agenda, code,
+			      positions[i], positions[i] + coverage);
+	if (!term) return oo_NOMEM;
+	term->is_terminal = true;
+	complex->linear_index[positions[i]] = term;
+    }
+
+    return oo_OK;
+}
+
+/**
+ * join: two adjacent branches of MB_COMPLEX_SPAN / 2 terminals
+ * intersection: the branches overlap at the very end of the span
+ * so the whole linear index gets scanned before the conflict is found
+ */
+static int
+mb_complex_setup(struct ooMicroContext *ctx,
+		 struct ooCodeSystem *cs)
+{
+    struct ooAgenda *agenda;
+    struct ooCode *parent_code = NULL, *child_code = NULL, *code;
+    int positions[MB_COMPLEX_SPAN];
+    size_t i, num_positions;
+    int half = MB_COMPLEX_SPAN / 2;
+    int ret;
+
+    for (i = 1; i < cs->num_codes && !child_code; i++) {
+	code = cs->codes->get(cs->codes, cs->code_names[i]);
+	if (!code) continue;
+	if (!parent_code) parent_code = code;
+	else child_code = code;
+    }
+    if (!child_code) return oo_FAIL;
+
+    ctx->complex_dec = mb_new_decoder(ctx, cs, false, FORMAT_JSON);
+    if (!ctx->complex_dec) return oo_FAIL;
+
+    agenda = ctx->complex_dec->agenda;
+    agenda->reset(agenda);
+
+    memset(&ctx->spec, 0, sizeof(struct ooCodeSpec));
+    ctx->spec.operid = OO_ATTR;
+    ctx->spec.code = child_code;
+    ctx->spec.stackable = false;
+
+    ctx->join_parent = mb_new_complex(agenda, parent_code, 0, half);
+    ctx->join_child = mb_new_complex(agenda, child_code, half, MB_COMPLEX_SPAN);
+    ctx->cross_parent = mb_new_complex(agenda, parent_code, 0, MB_COMPLEX_SPAN);
+    ctx->cross_child = mb_new_complex(agenda, child_code, half / 2, MB_COMPLEX_SPAN);
+    ctx->aggr = mb_new_complex(agenda, parent_code, 0, 0);
+    if (!ctx->join_parent || !ctx->join_child || !ctx->cross_parent ||
+	!ctx->cross_child || !ctx->aggr) return oo_NOMEM;
+
+    for (i = 0; i < (size_t)half; i++)
+	positions[i] = i;
+    ret = mb_fill_terminals(agenda, parent_code, ctx->join_parent,
+			    positions, half, 1);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; i < (size_t)half; i++)
+	positions[i] = half + i;
+    ret = mb_fill_terminals(agenda, child_code, ctx->join_child,
+			    positions, half, 1);
+    if (ret != oo_OK) return ret;
+
+    /* parent: a head and a single last terminal */
+    num_positions = 0;
+    for (i = 0; i < (size_t)half / 2; i++)
+	positions[num_positions++] = i;
+    positions[num_positions++] = MB_COMPLEX_SPAN - 1;
+    ret = mb_fill_terminals(agenda, parent_code, ctx->cross_parent,
+			    positions, num_positions, 1);
+    if (ret != oo_OK) return ret;
+
+    /* child: everything in-between, its last terminal covers two atoms */
+    num_positions = 0;
+    for (i = half / 2; i < MB_COMPLEX_SPAN - 2; i++)
+	positions[num_positions++] = i;
+    ret = mb_fill_terminals(agenda, child_code, ctx->cross_child,
+			    positions, num_positions, 1);
+    if (ret != oo_OK) return ret;
+    positions[0] = MB_COMPLEX_SPAN - 2;
+    ret = mb_fill_terminals(agenda, child_code, ctx->cross_child,
+			    positions, 1, 2);
+    if (ret != oo_OK) return ret;
+
+    /* both must behave as expected */
+    ret = ctx->join_parent->join(ctx->join_parent, ctx->join_child,
+				 ctx->aggr, &ctx->spec);
+    if (ret != oo_OK) return oo_FAIL;
+    ret = ctx->cross_parent->join(ctx->cross_parent, ctx->cross_child,
+				  ctx->aggr, &ctx->spec);
+    if (ret == oo_OK) return oo_FAIL;
+
+    return oo_OK;
+}
+
+static int
+mb_complex_join(struct ooMicroContext *ctx)
+{
+    size_t i;
+    int ret;
+
+    for (i = 0; i < MB_COMPLEX_BATCH; i++) {
+	ret = ctx->join_parent->join(ctx->join_parent, ctx->join_child,
+				     ctx->aggr, &ctx->spec);
+	if (ret != oo_OK) return ret;
+    }
+    return oo_OK;
+}
+
+/* ooComplex_check_linear_intersection is reached through a failing join */
+static int
+mb_complex_intersection(struct ooMicroContext *ctx)
+{
+    size_t i;
+    int ret;
+
+    for (i = 0; i < MB_COMPLEX_BATCH; i++) {
+	ret = ctx->cross_parent->join(ctx->cross_parent, ctx->cross_child,
+				      ctx->aggr, &ctx->spec);
+	if (ret == oo_OK) return oo_FAIL;
+    }
+    return oo_OK;
+}
+
+
+/******************* HARNESS ***************************/
+
+static int
+mb_measure(struct ooMicroContext *ctx,
+	   struct ooMicroBench *bench,
+	   const char *filter,
+	   double min_time,
+	   FILE *out,
+	   size_t *num_reported)
+{
+    double start, elapsed = 0.0;
+    size_t allocs = 0, alloc_bytes = 0, num_ops = 0;
+    struct ooAllocCounts counts_before, counts;
+    int ret;
+
+    if (filter && !strstr(bench->name, filter)) return oo_OK;
+
+    /* warm-up run */
+    if (bench->prepare) {
+	ret = bench->prepare(ctx);
+	if (ret != oo_OK) return ret;
+    }
+    ret = bench->run(ctx);
+    if (ret != oo_OK) {
+	fprintf(stderr, " -- \"%s\" failed :(\n", bench->name);
+	return ret;
+    }
+
+    while (elapsed < min_time) {
+	if (bench->prepare) {
+	    ret = bench->prepare(ctx);
+	    if (ret != oo_OK) return ret;
+	}
+
+	bench_alloc_counts(&counts_before);
+
+	start = mb_now();
+	ret = bench->run(ctx);
+	elapsed += mb_now() - start;
+
+	bench_alloc_counts(&counts);
+
+	/* a resize costs as much as a new block here */
+	allocs += counts.num_allocs - counts_before.num_allocs +\
+	    counts.num_reallocs - counts_before.num_reallocs;
+	alloc_bytes += counts.num_bytes - counts_before.num_bytes;
+	num_ops += bench->ops_per_run;
+
+	if (ret != oo_OK) return ret;
+    }
+
+    fprintf(out, "%s{\"name\":\"%s\",\"ops\":%zu,\"ns_per_op\":%.2f,",
+	    (*num_reported) ? ",\n " : "", bench->name, num_ops,
+	    elapsed * 1e9 / num_ops);
+    if (bench_counts_allocs)
+	fprintf(out, "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}",
+		(double)allocs / num_ops, (double)alloc_bytes / num_ops);
+    else
+	fprintf(out, "\"allocs_per_op\":null,\"bytes_per_op\":null}");
+
+    fprintf(stderr, "  %-28s %12.2f ns/op %10.3f allocs/op %12.1f B/op\n",
+	    bench->name, elapsed * 1e9 / num_ops,
+	    (double)allocs / num_ops, (double)alloc_bytes / num_ops);
+
+    (*num_reported)++;
+
+    return oo_OK;
+}
+
+static int
+mb_read_window(struct ooMicroContext *ctx,
+	       const char *filename)
+{
+    char *line, *c;
+    size_t len;
+    FILE *f;
+
+    f = fopen(filename, "r");
+    if (!f) {
+	fprintf(stderr, " -- Couldn't open input file \"%s\" :(\n", filename);
+	return oo_FAIL;
+    }
+
+    line = malloc(MB_LINE_BUF_SIZE);
+    if (!line) {
+	fclose(f);
+	return oo_NOMEM;
+    }
+
+    if (!fgets(line, MB_LINE_BUF_SIZE, f)) {
+	free(line);
+	fclose(f);
+	return oo_FAIL;
+    }
+    fclose(f);
+
+    len = strlen(line);
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+	line[--len] = '\0';
+
+    /* a single decoding window, cut at a space */
+    if (len >= INPUT_BUF_SIZE) {
+	line[INPUT_BUF_SIZE - 1] = '\0';
+	c = strrchr(line, ' ');
+	if (c) *c = '\0';
+	len = strlen(line);
+    }
+
+    ctx->window = line;
+    ctx->window_len = len;
+
+    return oo_OK;
+}
+
+static void display_usage(void)
+{
+    fprintf(stderr, "\nUsage: oomnik-microbench --config=path_to_your_oomniconf_xml\n"
+	    "          [--input=corpus_file] [--min-time=ms] [--filter=name]"
+	    " [--output=results.json]\n\n"
+	    "  --input      the first line is the cache and decoding window"
+	    " (\"%s\")\n"
+	    "  --min-time   measured time per benchmark in ms (200)\n"
+	    "  --filter     run the benchmarks whose name contains the string\n"
+	    "  --output     JSON results file (stdout)\n\n",
+	    mb_default_window);
+}
+
+/******************* MAIN ***************************/
+
+int main(int argc, char *argv[])
+{
+    struct ooMicroContext ctx;
+    struct ooMicroBench bench;
+    struct ooCodeSystem *cs;
+    const char *config = "oomniconf.xml";
+    const char *input_name = NULL;
+    const char *filter = NULL;
+    const char *output_name = NULL;
+    const char *texts[3];
+    const char *text_names[3] = { "ascii", "cyrillic", "mixed" };
+    double min_time = 0.2;
+    size_t i, num_reported = 0;
+    FILE *out = stdout;
+    int long_option;
+    int opt, ret;
+
+    while ((opt = getopt_long(argc, argv,
+			     options_string, main_options, &long_option)) >= 0) {
+	switch (opt)
+	{
+	case 'c':
+	    config = optarg;
+	    break;
+	case 'i':
+	    input_name = optarg;
+	    break;
+	case 'm':
+	    min_time = atof(optarg) / 1000.0;
+	    break;
+	case 'f':
+	    filter = optarg;
+	    break;
+	case 'o':
+	    output_name = optarg;
+	    break;
+	case 'h':
+	case '?':
+	default:
+	    display_usage();
+	    exit(-1);
+	}
+    }
+
+    memset(&ctx, 0, sizeof(struct ooMicroContext));
+    ctx.window = mb_default_window;
+    ctx.window_len = strlen(mb_default_window);
+
+    if (input_name) {
+	ret = mb_read_window(&ctx, input_name);
+	if (ret != oo_OK) exit(-2);
+    }
+
+    ctx.oomnik = (struct OOmnik*)OOmnik_create(config);
+    if (!ctx.oomnik) {
+	display_usage();
+	exit(-2);
+    }
+
+    ctx.output_buf = malloc(OUTPUT_BUF_SIZE);
+    if (!ctx.output_buf) exit(-3);
+
+    if (output_name) {
+	out = fopen(output_name, "w");
+	if (!out) {
+	    fprintf(stderr, " -- Couldn't open \"%s\" :(\n", output_name);
+	    out = stdout;
+	}
+    }
+
+    fprintf(stderr, "\n  oomnik-microbench: window \"%s\" (%zu bytes)\n\n",
+	    ctx.window, ctx.window_len);
+    fprintf(out, "{\"config\":\"%s\",\"window_bytes\":%zu,\"benchmarks\":[",
+	    config, ctx.window_len);
+
+    /* dictionary */
+    for (i = 0; i < MB_NUM_DICT_SIZES; i++) {
+	ret = mb_dict_setup(&ctx, mb_dict_sizes[i]);
+	if (ret != oo_OK) exit(-3);
+
+	memset(&bench, 0, sizeof(struct ooMicroBench));
+	bench.ops_per_run = mb_dict_sizes[i];
+
+	snprintf(bench.name, sizeof(bench.name), "dict_set/%zu", mb_dict_sizes[i]);
+	bench.prepare = mb_dict_renew;
+	bench.run = mb_dict_insert;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+
+	/* the last insert run left all the keys in place */
+	snprintf(bench.name, sizeof(bench.name), "dict_get_hit/%zu", mb_dict_sizes[i]);
+	bench.prepare = NULL;
+	bench.run = mb_dict_get_hit;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+
+	snprintf(bench.name, sizeof(bench.name), "dict_get_miss/%zu", mb_dict_sizes[i]);
+	bench.run = mb_dict_get_miss;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+
+	mb_dict_teardown(&ctx);
+    }
+
+    /* atomic segmentation */
+    cs = mb_find_codesystem(&ctx, true);
+    if (cs) ctx.atomic_dec = mb_new_decoder(&ctx, cs, false, FORMAT_JSON);
+    if (ctx.atomic_dec) {
+	texts[0] = mb_text_ascii;
+	texts[1] = mb_text_cyrillic;
+	texts[2] = mb_text_mixed;
+
+	for (i = 0; i < 3; i++) {
+	    memset(&bench, 0, sizeof(struct ooMicroBench));
+	    snprintf(bench.name, sizeof(bench.name), "utf8_parse/%s/%zuB",
+		     text_names[i], strlen(texts[i]));
+	    bench.run = mb_utf8_parse;
+	    bench.ops_per_run = 1;
+	    ctx.text = texts[i];
+	    mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+	}
+    }
+    else
+	fprintf(stderr, "  -- no UTF-8 code system: utf8_parse skipped\n");
+
+    /* linear cache */
+    cs = mb_find_codesystem(&ctx, false);
+    if (cs) ctx.cache_dec = mb_new_decoder(&ctx, cs, false, FORMAT_JSON);
+    if (ctx.cache_dec) {
+	memset(&bench, 0, sizeof(struct ooMicroBench));
+	snprintf(bench.name, sizeof(bench.name), "cache_lookup/window");
+	bench.run = mb_cache_lookup;
+	bench.ops_per_run = 1;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+    }
+    else
+	fprintf(stderr, "  -- no cached code system: cache_lookup skipped\n");
+
+    /* complexes: over the cached code system if there is one */
+    if (!cs) cs = ctx.oomnik->default_codesystem;
+    if (cs && mb_complex_setup(&ctx, cs) == oo_OK) {
+	memset(&bench, 0, sizeof(struct ooMicroBench));
+	bench.ops_per_run = MB_COMPLEX_BATCH;
+
+	snprintf(bench.name, sizeof(bench.name), "complex_join");
+	bench.run = mb_complex_join;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+
+	snprintf(bench.name, sizeof(bench.name), "complex_linear_intersection");
+	bench.run = mb_complex_intersection;
+	mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+    }
+    else
+	fprintf(stderr, "  -- no suitable code system: complex benchmarks skipped\n");
+
+    /* agenda and presentation over the default code system */
+    cs = ctx.oomnik->default_codesystem;
+    for (i = 0; cs && i < 2; i++) {
+	ctx.root_dec = mb_new_decoder(&ctx, cs, true,
+				      i ? FORMAT_XML : FORMAT_JSON);
+	if (!ctx.root_dec) break;
+
+	if (!i) {
+	    memset(&bench, 0, sizeof(struct ooMicroBench));
+	    snprintf(bench.name, sizeof(bench.name), "agenda_reset");
+	    bench.prepare = mb_agenda_prepare;
+	    bench.run = mb_agenda_reset;
+	    bench.ops_per_run = 1;
+	    mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+	}
+
+	/* a complete request fills the accumulator */
+	ret = ctx.root_dec->process(ctx.root_dec, ctx.window);
+	if (ret == oo_OK) {
+	    memset(&bench, 0, sizeof(struct ooMicroBench));
+	    snprintf(bench.name, sizeof(bench.name), "accu_present/%s",
+		     i ? "xml" : "json");
+	    bench.run = mb_present;
+	    bench.ops_per_run = 1;
+	    mb_measure(&ctx, &bench, filter, min_time, out, &num_reported);
+	}
+
+	ctx.root_dec->del(ctx.root_dec);
+	ctx.root_dec = NULL;
+    }
+
+    fprintf(out, "]}\n");
+    if (out != stdout) fclose(out);
+
+    if (ctx.atomic_dec) ctx.atomic_dec->del(ctx.atomic_dec);
+    if (ctx.cache_dec) ctx.cache_dec->del(ctx.cache_dec);
+    if (ctx.complex_dec) ctx.complex_dec->del(ctx.complex_dec);
+    free(ctx.output_buf);
+    if (input_name) free((char*)ctx.window);
+
+    ctx.oomnik->del(ctx.oomnik);
+
+    exit(0);
+}
@@ -56,16 +56,42 @@ ooAccu_str(struct ooAccu *self)
 }
 
 
+/**
+ * forget the solution of the previous request,
+ * only the index slots it has taken are cleared
+ */
 static int
 ooAccu_reset(struct ooAccu *self)
 {
+    struct ooTopicSolution *topsol;
+    size_t i;
 
-    /* reset agenda index with NULLs */
-    /* for (i = 0; i < AGENDA_INDEX_SIZE; i++) {
-	self->index[i] = NULL;
-	self->tail_index[i] = NULL;
-	}*/
+    for (i = 0; i < self->num_concfreqs; i++)
+	self->concept_index[self->freq_storage[i].conc->numid] = NULL;
+    self->num_concfreqs = 0;
+    self->freq_top = NULL;
+    self->freq_tail = NULL;
 
+    for (i = 0; i < self->num_topic_solutions; i++) {
+	topsol = &self->topic_solution_storage[i];
+	self->topic_index[topsol->topic->id] = NULL;
+	ooTopicSolution_init(topsol);
+    }
+    self->num_topic_solutions = 0;
+    self->rating_count = 0;
+
+    for (i = 0; i < TOPIC_POOL_SIZE; i++)
+	self->topic_rating[i] = NULL;
+
+    self->output_buf[0] = '\0';
+    self->curr_output_buf = self->output_buf;
+    self->output_free_space = self->output_total_space;
+
+    self->is_partial = false;
+    self->solution = NULL;
+    self->begin_table = false;
+    self->begin_row = false;
+    self->begin_cell = false;
 
     return oo_OK;
 }
@@ -167,6 +193,14 @@ ooAccu_present_solution(struct ooAccu *self,
     buf++;
     out_size++;
 
+    if (self->is_partial) {
+	sprintf(buf, "\"partial\": true,");
+	curr = strlen(buf);
+	buf += curr;
+	out_size += curr;
+	curr = 0;
+    }
+
     ooAccu_present_conc_rating(self, buf, &curr);
     buf += curr;
     out_size += curr;
@@ -433,6 +467,7 @@ ooAccu_init(struct ooAccu *self)
 	self->topic_rating[i] = NULL;
     }
 
+    self->is_partial = false;
     self->solution = NULL;
     self->begin_table = false;
     self->begin_row = false;
@@ -442,6 +477,7 @@ ooAccu_init(struct ooAccu *self)
     self->del = ooAccu_del;
     self->str = ooAccu_str;
     self->init = ooAccu_init;
+    self->reset = ooAccu_reset;
 
     self->build_indices = ooAccu_build_indices;
     self->update_conc_rating = ooAccu_update_conc_rating;
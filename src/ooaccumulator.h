@@ -70,6 +70,9 @@ typedef struct ooAccu {
     struct ooConcFreq **concept_index;
     size_t num_concepts;
 
+    /* the work budget ran out before the search was over:
+     * the solution is the best one found so far */
+    bool is_partial;
 
     /* temp variables */
     const char *solution;
@@ -82,6 +85,9 @@ typedef struct ooAccu {
     int (*str)(struct ooAccu *self);
     int (*init)(struct ooAccu *self);
 
+    /* ready for the next request of the same decoder */
+    int (*reset)(struct ooAccu *self);
+
     int (*build_indices)(struct ooAccu *self, 
 			 struct ooMindMap *mindmap);
 
@@ -33,6 +33,7 @@
 #include "oocodesystem.h"
 #include "oodecoder.h"
 #include "ooaccumulator.h"
+#include "ootrace.h"
 
 
 static int
@@ -54,7 +55,7 @@ static int
 ooAgenda_str(ooAgenda *self)
 {
     struct ooConcUnit *cu;
-    char *conc_name = "Unrec";
+    const char *conc_name = "Unrec";
     struct ooComplex *complex, *best_complex = NULL;
 
     int curr_weight = 0;
@@ -494,95 +495,358 @@ ooAgenda_register_unit(struct ooAgenda *self,
 }
 
 
-static struct ooConcUnit*
-ooAgenda_add_shared_code(struct ooAgenda *self,
-			  struct ooCodeUnit *code_unit,
-			  struct ooConcUnit *terminal,
-			  struct ooConcUnit *common_unit)
+static size_t
+ooAgenda_prediction_span_hash(struct ooCode *code,
+			      oo_oper_type operid,
+			      size_t linear_begin,
+			      size_t linear_end)
 {
-    struct ooConcUnit *cu, *child;
-    struct ooCodeUnit *child_code_unit;
-    struct ooComplex *complex, *child_complex;
-    size_t i, j, concid, operid, pos;
-    int ret;
+    size_t h;
 
-    if (DEBUG_AGENDA_LEVEL_4)
-	printf(" .. Adding shared code..\n");
+    h = code->id;
+    h = h * 31 + operid;
+    h = h * 31 + linear_begin;
+    h = h * 31 + linear_end;
 
-    cu = self->alloc_unit(self);
-    if (!cu) return NULL;
+    return h;
+}
 
-    cu->make_instance(cu, code_unit->code, terminal);
-    cu->is_present = true;
+static size_t
+ooAgenda_prediction_hash(struct ooCode *code,
+			 oo_oper_type operid,
+			 size_t linear_begin,
+			 size_t linear_end,
+			 struct ooConcUnit *child_unit,
+			 struct ooComplex *child)
+{
+    size_t h;
 
-    /* - all units in the complex code will share 
-         the reference to their top parent 
-       - the top parent makes a reference to itself */
-    if (!common_unit) {
-	cu->common_unit = cu;
-	common_unit = cu;
+    h = ooAgenda_prediction_span_hash(code, operid, linear_begin, linear_end);
+    h = h * 31 + ((size_t)child_unit >> 4);
+    h = h * 31 + ((size_t)child >> 4);
+
+    return h % AGENDA_PREDICTION_INDEX_SIZE;
+}
+
+/* find the prediction of a parent made by the same child
+ * over the given span */
+static struct ooPrediction*
+ooAgenda_lookup_prediction(struct ooAgenda *self,
+			   struct ooCode *code,
+			   oo_oper_type operid,
+			   size_t linear_begin,
+			   size_t linear_end,
+			   struct ooConcUnit *child_unit,
+			   struct ooComplex *child)
+{
+    struct ooPrediction *pred;
+    size_t h;
+
+    h = ooAgenda_prediction_hash(code, operid, linear_begin, linear_end,
+				 child_unit, child);
+
+    for (pred = self->prediction_index[h]; pred; pred = pred->next) {
+	if (pred->code != code) continue;
+	if (pred->operid != operid) continue;
+	if (pred->linear_begin != linear_begin) continue;
+	if (pred->linear_end != linear_end) continue;
+	if (pred->child_unit != child_unit) continue;
+	if (pred->child != child) continue;
+	return pred;
     }
-    else cu->common_unit = common_unit;
 
-    /* nested children should be linked and registered first */
-    if (!code_unit->num_specs) goto agenda_register;
+    return NULL;
+}
 
-    child_code_unit = code_unit->specs[0]->unit;
-    child = ooAgenda_add_shared_code(self, child_code_unit, terminal, common_unit);
-    if (!child) goto agenda_register;
+/* the heaviest prediction of a parent over the given span */
+static struct ooPrediction*
+ooAgenda_best_prediction(struct ooAgenda *self,
+			 struct ooCode *code,
+			 oo_oper_type operid,
+			 size_t linear_begin,
+			 size_t linear_end)
+{
+    struct ooPrediction *pred, *best = NULL;
+    size_t h;
+
+    h = ooAgenda_prediction_span_hash(code, operid, linear_begin, linear_end);
+    h %= AGENDA_PREDICTION_INDEX_SIZE;
+
+    for (pred = self->prediction_span_index[h]; pred; pred = pred->next_span) {
+	if (pred->code != code) continue;
+	if (pred->operid != operid) continue;
+	if (pred->linear_begin != linear_begin) continue;
+	if (pred->linear_end != linear_end) continue;
+	if (best && pred->weight <= best->weight) continue;
+	best = pred;
+    }
 
-    operid = code_unit->specs[0]->operid;
+    return best;
+}
+
+/* reserve a new memo entry: NULL if the pool is exhausted */
+static struct ooPrediction*
+ooAgenda_save_prediction(struct ooAgenda *self,
+			 struct ooCode *code,
+			 oo_oper_type operid,
+			 size_t linear_begin,
+			 size_t linear_end,
+			 struct ooConcUnit *child_unit,
+			 struct ooComplex *child)
+{
+    struct ooPrediction *pred;
+    size_t h;
+
+    if (self->num_predictions == AGENDA_PREDICTION_POOL_SIZE) 
+	return NULL;
+
+    pred = &self->prediction_storage[self->num_predictions];
+    self->num_predictions++;
+
+    pred->code = code;
+    pred->operid = operid;
+    pred->linear_begin = linear_begin;
+    pred->linear_end = linear_end;
+    pred->child_unit = child_unit;
+    pred->child = child;
+    pred->weight = 0;
+    pred->unit = NULL;
+
+    h = ooAgenda_prediction_hash(code, operid, linear_begin, linear_end,
+				 child_unit, child);
+    pred->next = self->prediction_index[h];
+    self->prediction_index[h] = pred;
+
+    h = ooAgenda_prediction_span_hash(code, operid, linear_begin, linear_end);
+    h %= AGENDA_PREDICTION_INDEX_SIZE;
+    pred->next_span = self->prediction_span_index[h];
+    self->prediction_span_index[h] = pred;
+
+    return pred;
+}
 
-    child->fixed_parent = cu;
-    child->fixed_operid = operid;
 
-    if (DEBUG_AGENDA_LEVEL_4) {
-	printf("\n   ++ CHILD of \"%s\" IN A SHARED CODE:\n", 
-	       code_unit->code->name);
-	child->str(child, 1);
+static struct ooBeamSlot*
+ooAgenda_beam_slot(struct ooAgenda *self,
+		   struct ooCode *code,
+		   size_t linear_begin,
+		   size_t linear_end)
+{
+    struct ooBeamSlot *slot;
+    size_t h;
+
+    h = code ? code->id + 1 : 0;
+    h = h * 31 + linear_begin;
+    h = h * 31 + linear_end;
+    h %= AGENDA_BEAM_INDEX_SIZE;
+
+    for (slot = self->beam_index[h]; slot; slot = slot->next) {
+	if (slot->code != code) continue;
+	if (slot->linear_begin != linear_begin) continue;
+	if (slot->linear_end != linear_end) continue;
+	return slot;
     }
 
-    pos = cu->linear_pos;
-    cu->num_complexes = 0;
+    if (self->num_beam_slots == AGENDA_BEAM_POOL_SIZE) 
+	return NULL;
+
+    slot = &self->beam_storage[self->num_beam_slots];
+    self->num_beam_slots++;
 
-    /* establish fixed links between complexes */
-    for (i = 0; i < child->num_complexes; i++) {
-	complex = cu->complexes[i];
-	child_complex = child->complexes[i];
+    slot->code = code;
+    slot->linear_begin = linear_begin;
+    slot->linear_end = linear_end;
+    slot->count = 0;
+    slot->best_weight = 0;
 
-	complex->base = cu;
-	complex->linear_begin = pos;
-	complex->linear_end = pos + cu->coverage;
-	complex->linear_index[pos] = complex;
-	complex->weight = child_complex->weight;
+    slot->next = self->beam_index[h];
+    self->beam_index[h] = slot;
 
-	if (child_complex->linear_begin < complex->linear_begin) 
-	    complex->linear_begin = child_complex->linear_begin;
-	if (child_complex->linear_end > complex->linear_end) 
-	    complex->linear_end = child_complex->linear_end;
+    return slot;
+}
+
+static bool
+ooAgenda_beam_fits(struct ooBeamSlot *slot,
+		   struct ooBeam *beam,
+		   size_t width,
+		   int weight)
+{
+    if (!slot->count) return true;
 
-	/* merge linear indices */
-	for (j = child_complex->linear_begin; j < child_complex->linear_end; j++)
-	    complex->linear_index[j] = child_complex->linear_index[j];
+    /* NB: admission is first-come, nothing is ever evicted:
+       admitted complexes are linked into their aggregates at once,
+       so a full slot turns away a candidate that would beat
+       its current worst entry unless it is a new leader */
 
-	complex->specs[operid] = child_complex;
-	complex->is_free = false;
+    /* a new leader is always welcome */
+    if (weight > slot->best_weight) return true;
 
-	cu->num_complexes++;
-	/*cu->str(cu, 1);*/
+    if (slot->best_weight > 0 && 
+	weight < slot->best_weight * beam->threshold)
+	return false;
+
+    if (width && slot->count >= width) return false;
+
+    return true;
+}
+
+/**
+ * beam search: decide whether a new complex 
+ * of a given code and weight may occupy the span
+ */
+static int
+ooAgenda_beam_admit(struct ooAgenda *self,
+		    struct ooCode *code,
+		    size_t linear_begin,
+		    size_t linear_end,
+		    int weight)
+{
+    struct ooBeamSlot *span, *code_span;
+
+    if (!self->beam || !self->beam->enabled) return oo_OK;
+
+    span = ooAgenda_beam_slot(self, NULL, linear_begin, linear_end);
+    code_span = ooAgenda_beam_slot(self, code, linear_begin, linear_end);
+
+    /* out of bookkeeping space: no pruning */
+    if (!span || !code_span) return oo_OK;
+
+    if (!ooAgenda_beam_fits(span, self->beam, 
+			    self->beam->span_width, weight) ||
+	!ooAgenda_beam_fits(code_span, self->beam, 
+			    self->beam->code_width, weight)) {
+
+	if (DEBUG_AGENDA_LEVEL_3)
+	    printf("  -- beam: \"%s\" [%zu, %zu) weight %d pruned "
+		   "(best: %d)\n", code->name, linear_begin, linear_end,
+		   weight, span->best_weight);
+
+	self->num_beam_pruned++;
+	return oo_FAIL;
     }
 
-    if (DEBUG_AGENDA_LEVEL_4) {
-	printf("    == Shared CU after adding its child:\n");
-	cu->str(cu,1);
+    if (!span->count || weight > span->best_weight)
+	span->best_weight = weight;
+    span->count++;
+
+    if (!code_span->count || weight > code_span->best_weight)
+	code_span->best_weight = weight;
+    code_span->count++;
+
+    return oo_OK;
+}
+
+
+/**
+ * work budget: the counters are compared on every check,
+ * the clock is read once per BUDGET_CLOCK_INTERVAL checks
+ * unless the caller asks for it
+ */
+static int
+ooAgenda_budget_admit(struct ooAgenda *self,
+		      bool read_clock)
+{
+    struct ooBudget *budget = self->budget;
+
+    if (!budget || !budget->enabled) return oo_OK;
+    if (budget->is_exhausted) return oo_FAIL;
+
+    if (budget->max_units && budget->num_units >= budget->max_units)
+	goto exhausted;
+
+    if (budget->max_complexes && 
+	budget->num_complexes >= budget->max_complexes)
+	goto exhausted;
+
+    budget->num_checks++;
+    if (!(budget->num_checks % BUDGET_CLOCK_INTERVAL))
+	read_clock = true;
+
+    if (budget->deadline && read_clock &&
+	oo_read_nsec() >= budget->deadline)
+	goto exhausted;
+
+    return oo_OK;
+
+ exhausted:
+    if (DEBUG_AGENDA_LEVEL_2)
+	printf("  -- budget exhausted: %zu units, %zu complexes\n",
+	       budget->num_units, budget->num_complexes);
+
+    budget->is_exhausted = true;
+    return oo_FAIL;
+}
+
+
+/**
+ * give back the last units handed out by alloc_unit
+ */
+static void
+ooAgenda_release_units(struct ooAgenda *self,
+		       size_t num_units)
+{
+    self->storage_space_used -= num_units;
+    self->num_allocated_units -= num_units;
+    if (self->budget)
+	self->budget->num_units -= num_units;
+}
+
+
+/**
+ * instantiate a shared code template 
+ * over the span of the terminal
+ */
+static struct ooConcUnit*
+ooAgenda_add_shared_code(struct ooAgenda *self,
+			 struct ooCodeTemplate *tmpl,
+			 struct ooConcUnit *terminal)
+{
+    struct ooConcUnit *units[MAX_SHARED_CODE_DEPTH] = { NULL };
+    struct ooConcUnit *cu, *child = NULL;
+    size_t i, num_units;
+    int ret;
+
+    if (!tmpl->num_levels) return NULL;
+
+    if (DEBUG_AGENDA_LEVEL_4)
+	printf(" .. Adding shared code \"%s\" (%zu levels)..\n",
+	       tmpl->levels[0].code->name, tmpl->num_levels);
+
+    /* top unit goes first */
+    for (num_units = 0; num_units < tmpl->num_levels; num_units++) {
+	cu = self->alloc_unit(self);
+	if (!cu) {
+	    /* a truncated complex is never registered:
+	       give back the units taken so far */
+	    ooAgenda_release_units(self, num_units);
+	    return NULL;
+	}
+	units[num_units] = cu;
     }
 
-agenda_register:
-    ret = cu->link(cu);
+    /* - all units in the complex code will share 
+         the reference to their top parent 
+       - the top parent makes a reference to itself 
+       - nested children are linked and registered first */
+    for (i = num_units; i > 0; i--) {
+	cu = units[i - 1];
+	cu->common_unit = units[0];
 
-    ret = ooAgenda_register_unit(self, cu, cu->code);
+	cu->make_template_instance(cu, &tmpl->levels[i - 1], terminal, child);
 
-    return cu;
+	if (DEBUG_AGENDA_LEVEL_4) {
+	    printf("    == Shared CU at level %zu:\n", i - 1);
+	    cu->str(cu, 1);
+	}
+
+	ret = cu->link(cu);
+
+	ret = ooAgenda_register_unit(self, cu, cu->code);
+
+	child = cu;
+    }
+
+    return units[0];
 }
 
 
@@ -619,6 +883,8 @@ ooAgenda_explore_code_denots(struct ooAgenda *self,
 	denot = cu->code->denots[i];
 	if (!denot) continue;
 
+	if (self->budget_admit(self, false) != oo_OK) break;
+
 	if (DEBUG_AGENDA_LEVEL_3) {
 	    printf("\n   !! linking code %lu) %s (%lu)\n",
 		   (unsigned long)i, denot->name, 
@@ -626,8 +892,10 @@ ooAgenda_explore_code_denots(struct ooAgenda *self,
 	    denot->str(denot);
 	}
 
-	if (denot->shared) {
-	    ret = ooAgenda_add_shared_code(self, denot->shared, cu, NULL);
+	if (denot->shared_template) {
+	    if (!denot->shared_template->num_levels) continue;
+	    if (!ooAgenda_add_shared_code(self, denot->shared_template, cu))
+		return oo_NOMEM;
 	    continue;
 	}
 
@@ -720,6 +988,7 @@ ooAgenda_complex_update(struct ooAgenda *self,
 			struct ooAgenda *segm_agenda)
 {   size_t i;
     struct ooConcUnit *cu;
+    oo_ticks begin;
     int ret;
 
     if (DEBUG_AGENDA_LEVEL_1)
@@ -735,6 +1004,9 @@ ooAgenda_complex_update(struct ooAgenda *self,
      * - batched */
 
     for (i = 0; i < segm_agenda->last_idx_pos; i++) {
+	/* out of budget: the units added so far make the solution */
+	if (self->budget_admit(self, false) != oo_OK) break;
+
 	/* get a list of concept units at a given linear position */
 	cu = segm_agenda->index[i];
 	if (!cu) continue;
@@ -778,6 +1050,7 @@ ooAgenda_complex_update(struct ooAgenda *self,
     if (DEBUG_AGENDA_LEVEL_1)
 	self->str(self);
 
+    begin = oo_read_ticks();
     ret = ooAgenda_build_linear_index(self);
 
    
@@ -789,6 +1062,9 @@ ooAgenda_complex_update(struct ooAgenda *self,
 
     if (self->best_complex)
 	self->accu->solution = (const char*)self->accu->output_buf;
+
+    if (self->stats)
+	ooStats_add_stage(self->stats, OO_STAGE_SOLUTION, begin);
  
 
     return oo_OK;
@@ -803,21 +1079,34 @@ ooAgenda_update(struct ooAgenda *self,
 		struct ooAgenda *segm_agenda)
 {   size_t i, coverage;
     struct ooConcUnit *cu;
+    oo_ticks begin, trace_begin;
     int ret;
 
     if (segm_agenda->best_complex) {
 	self->accu->solution = segm_agenda->accu->solution;
     }
 
+    trace_begin = OO_TRACE_BEGIN(OO_TRACE_AGENDA);
+    begin = oo_read_ticks();
+
     switch (self->codesystem->type) {
     case AGENDA_OPERATIONAL:
-	return ooAgenda_complex_update(self, segm_agenda);
     case AGENDA_POSITIONAL:
-	return ooAgenda_complex_update(self, segm_agenda);
+	ret = ooAgenda_complex_update(self, segm_agenda);
+	if (self->stats)
+	    ooStats_add_stage(self->stats, OO_STAGE_COMPLEX_UPDATE, begin);
+	OO_TRACE_END(OO_TRACE_AGENDA, "link", self->codesystem->name, trace_begin);
+	break;
     default:
-	return ooAgenda_denotational_update(self, segm_agenda);
+	ret = ooAgenda_denotational_update(self, segm_agenda);
+	if (self->stats)
+	    ooStats_add_stage(self->stats, OO_STAGE_DENOT_UPDATE, begin);
+	OO_TRACE_END(OO_TRACE_AGENDA, "denot_update", self->codesystem->name, 
+		     trace_begin);
+	break;
     }
 
+    return ret;
 }
 
 
@@ -828,6 +1117,14 @@ ooAgenda_reset(struct ooAgenda *self)
     size_t i;
     int ret;
 
+    /* remember the high-water marks of the pools */
+    if (self->storage_space_used > self->max_units)
+	self->max_units = self->storage_space_used;
+    if (self->num_predictions > self->max_predictions)
+	self->max_predictions = self->num_predictions;
+    if (self->num_beam_slots > self->max_beam_slots)
+	self->max_beam_slots = self->num_beam_slots;
+
     /* reset agenda index with NULLs */
     for (i = 0; i < AGENDA_INDEX_SIZE; i++) {
 	self->index[i] = NULL;
@@ -857,9 +1154,41 @@ ooAgenda_reset(struct ooAgenda *self)
     self->num_complexes = 0;
     self->has_garbage = false;
 
+    /* forget the predictions of the previous request */
+    for (i = 0; i < AGENDA_PREDICTION_INDEX_SIZE; i++) {
+	self->prediction_index[i] = NULL;
+	self->prediction_span_index[i] = NULL;
+    }
+    self->num_predictions = 0;
+
+    for (i = 0; i < AGENDA_BEAM_INDEX_SIZE; i++)
+	self->beam_index[i] = NULL;
+    self->num_beam_slots = 0;
+
     return oo_OK;
 }
 
+static int
+ooAgenda_clear(struct ooAgenda *self)
+{
+    /* the pools of the last window go first:
+     * their usage belongs to the previous request */
+    ooAgenda_reset(self);
+
+    self->best_complex = NULL;
+
+    self->num_reused_predictions = 0;
+    self->num_pruned_predictions = 0;
+    self->num_beam_pruned = 0;
+
+    self->num_allocated_units = 0;
+    self->num_created_complexes = 0;
+    self->max_units = 0;
+    self->max_predictions = 0;
+    self->max_beam_slots = 0;
+
+    return oo_OK;
+}
 
 /* give a unit to the caller */
 static struct ooConcUnit* 
@@ -887,6 +1216,9 @@ ooAgenda_alloc_unit(struct ooAgenda *self)
     cu->agenda = self;
 
     self->storage_space_used++;
+    self->num_allocated_units++;
+    if (self->budget)
+	self->budget->num_units++;
 
     return cu;
 } 
@@ -926,13 +1258,42 @@ ooAgenda_new(struct ooAgenda **agenda)
     self->linear_last = NULL;
     self->has_garbage = false;
 
+    for (i = 0; i < AGENDA_PREDICTION_INDEX_SIZE; i++) {
+	self->prediction_index[i] = NULL;
+	self->prediction_span_index[i] = NULL;
+    }
+    self->num_predictions = 0;
+    self->num_reused_predictions = 0;
+    self->num_pruned_predictions = 0;
+
+    self->beam = NULL;
+    for (i = 0; i < AGENDA_BEAM_INDEX_SIZE; i++)
+	self->beam_index[i] = NULL;
+    self->num_beam_slots = 0;
+    self->num_beam_pruned = 0;
+
+    self->budget = NULL;
+
+    self->num_allocated_units = 0;
+    self->num_created_complexes = 0;
+    self->max_units = 0;
+    self->max_predictions = 0;
+    self->max_beam_slots = 0;
+    self->stats = NULL;
+
     /* bind your methods */
     self->del = ooAgenda_del;
     self->str = ooAgenda_str;
     self->alloc_unit = ooAgenda_alloc_unit;
     self->update = ooAgenda_update;
     self->register_unit = ooAgenda_register_unit;
+    self->lookup_prediction = ooAgenda_lookup_prediction;
+    self->best_prediction = ooAgenda_best_prediction;
+    self->save_prediction = ooAgenda_save_prediction;
+    self->beam_admit = ooAgenda_beam_admit;
+    self->budget_admit = ooAgenda_budget_admit;
     self->reset = ooAgenda_reset;
+    self->clear = ooAgenda_clear;
     self->present_solution = ooAgenda_present_linear_solution;
 
     *agenda = self;
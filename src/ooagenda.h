@@ -27,12 +27,95 @@
 
 #include "ooconcunit.h"
 #include "ooconfig.h"
+#include "oostats.h"
 
 typedef enum agenda_t { AGENDA_LINEAR, 
 			AGENDA_OPERATIONAL, 
 			AGENDA_POSITIONAL } agenda_t;
 
 
+/**
+ *  Predicted parent memo entry:
+ *  one prediction per parent code, operation, linear span
+ *  and the child complex it was predicted from
+ */
+typedef struct ooPrediction {
+    struct ooCode *code;
+    oo_oper_type operid;
+    size_t linear_begin;
+    size_t linear_end;
+
+    /* the child unit and its complex that produced the prediction */
+    struct ooConcUnit *child_unit;
+    struct ooComplex *child;
+    int weight;
+
+    struct ooConcUnit *unit;
+
+    /* same key */
+    struct ooPrediction *next;
+
+    /* same parent code over the same span */
+    struct ooPrediction *next_span;
+} ooPrediction;
+
+
+/**
+ *  Beam search settings:
+ *  shared by all agendas of the controller
+ */
+typedef struct ooBeam {
+    bool enabled;
+
+    /* max number of complexes kept per linear span (0: unlimited) */
+    size_t span_width;
+
+    /* max number of complexes of the same code per span (0: unlimited) */
+    size_t code_width;
+
+    /* min weight relative to the best complex of the span */
+    float threshold;
+} ooBeam;
+
+/**
+ *  Work budget of a request:
+ *  shared by all agendas of the decoder hierarchy,
+ *  once it is spent no more hypotheses are expanded
+ *  and the best ones found so far make the result
+ */
+typedef struct ooBudget {
+    bool enabled;
+
+    /* time limit of a request in microseconds (0: unlimited) */
+    size_t deadline_usec;
+
+    /* max number of units allocated per request (0: unlimited) */
+    size_t max_units;
+
+    /* max number of complexes joined per request (0: unlimited) */
+    size_t max_complexes;
+
+    /* the running request: deadline on the oo_read_nsec clock */
+    oo_ticks deadline;
+    size_t num_units;
+    size_t num_complexes;
+    size_t num_checks;
+    bool is_exhausted;
+} ooBudget;
+
+/* beam occupancy of a span (code == NULL) or of a code over a span */
+typedef struct ooBeamSlot {
+    struct ooCode *code;
+    size_t linear_begin;
+    size_t linear_end;
+
+    size_t count;
+    int best_weight;
+
+    struct ooBeamSlot *next;
+} ooBeamSlot;
+
+
 /** 
  *  Solution Agenda:
  *  operational short-term memory 
@@ -83,12 +166,47 @@ typedef struct ooAgenda {
 
     bool has_garbage;
 
+    /* predicted parents memo */
+    struct ooPrediction prediction_storage[AGENDA_PREDICTION_POOL_SIZE];
+    size_t num_predictions;
+    struct ooPrediction *prediction_index[AGENDA_PREDICTION_INDEX_SIZE];
+    struct ooPrediction *prediction_span_index[AGENDA_PREDICTION_INDEX_SIZE];
+
+    /* beam search */
+    struct ooBeam *beam;
+    struct ooBeamSlot beam_storage[AGENDA_BEAM_POOL_SIZE];
+    size_t num_beam_slots;
+    struct ooBeamSlot *beam_index[AGENDA_BEAM_INDEX_SIZE];
+
+    /* work budget of the request, NULL: unlimited */
+    struct ooBudget *budget;
+
+    /* pruning statistics: 
+     * accumulated until the agenda is cleared */
+    size_t num_reused_predictions;
+    size_t num_pruned_predictions;
+    size_t num_beam_pruned;
+
+    /* pool usage: accumulated until the agenda is cleared */
+    size_t num_allocated_units;
+    size_t num_created_complexes;
+    size_t max_units;
+    size_t max_predictions;
+    size_t max_beam_slots;
+
+    /* stage timings of the owning decoder */
+    struct ooStats *stats;
+
     /***********  public methods ***********/
     int (*del)(struct ooAgenda *self);
     int (*str)(struct ooAgenda *self);
 
     int (*reset)(struct ooAgenda *self);
 
+    /* forget the best complex and the counters
+     * of the previous request */
+    int (*clear)(struct ooAgenda *self);
+
     struct ooConcUnit* (*alloc_unit)(struct ooAgenda *self);
 
     int (*register_unit)(struct ooAgenda *self, 
@@ -98,6 +216,43 @@ typedef struct ooAgenda {
     int (*update)(struct ooAgenda *self, 
 		  struct ooAgenda *segm_agenda);
 
+    /* predicted parents memo */
+    struct ooPrediction* (*lookup_prediction)(struct ooAgenda *self,
+					      struct ooCode *code,
+					      oo_oper_type operid,
+					      size_t linear_begin,
+					      size_t linear_end,
+					      struct ooConcUnit *child_unit,
+					      struct ooComplex *child);
+
+    /* the heaviest prediction of any child over the span */
+    struct ooPrediction* (*best_prediction)(struct ooAgenda *self,
+					    struct ooCode *code,
+					    oo_oper_type operid,
+					    size_t linear_begin,
+					    size_t linear_end);
+
+    struct ooPrediction* (*save_prediction)(struct ooAgenda *self,
+					    struct ooCode *code,
+					    oo_oper_type operid,
+					    size_t linear_begin,
+					    size_t linear_end,
+					    struct ooConcUnit *child_unit,
+					    struct ooComplex *child);
+
+    /* beam search: may a new complex of this code and weight 
+     * be created over the span? */
+    int (*beam_admit)(struct ooAgenda *self,
+		      struct ooCode *code,
+		      size_t linear_begin,
+		      size_t linear_end,
+		      int weight);
+
+    /* work budget: may the search go on expanding hypotheses?
+     * the clock is read on demand or once in a while */
+    int (*budget_admit)(struct ooAgenda *self,
+			bool read_clock);
+
     /* present solution */
     int (*present_solution)(struct ooAgenda *self,
 			    struct ooComplex *c, 
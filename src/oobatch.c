@@ -0,0 +1,560 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oobatch.c
+ *   OOmnik batch processing of input files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "ooconfig.h"
+#include "oomnik.h"
+#include "oobatch.h"
+
+/**
+ * cut the complete records of the data into the window,
+ * the last piece of the input is a record even without
+ * its separator
+ */
+static size_t
+ooBatch_cut(struct ooBatch *self,
+	    const char *data,
+	    size_t size,
+	    bool is_last)
+{
+    struct ooBatchRecord *rec;
+    const char *end;
+    size_t pos = 0, rec_size;
+    int sep = self->records == OO_RECORDS_NUL ? '\0' : '\n';
+
+    while (self->num_records < BATCH_WINDOW_SIZE && pos < size) {
+	if (self->records == OO_RECORDS_WHOLE) {
+	    if (!is_last) break;
+	    end = data + size;
+	}
+	else {
+	    end = memchr(data + pos, sep, size - pos);
+	    if (!end) {
+		if (!is_last) break;
+		end = data + size;
+	    }
+	}
+
+	rec_size = (size_t)(end - (data + pos));
+
+	rec = &self->window[self->num_records];
+	rec->input = data + pos;
+	rec->input_size = rec_size;
+	rec->output = NULL;
+	rec->output_size = 0;
+	rec->is_done = false;
+
+	/* CRLF line endings */
+	if (self->records == OO_RECORDS_LINES &&
+	    rec_size && rec->input[rec_size - 1] == '\r')
+	    rec->input_size--;
+
+	self->bytes_in += rec->input_size;
+	self->num_records++;
+
+	pos += rec_size;
+	if (pos < size) pos++;
+    }
+
+    return pos;
+}
+
+static int
+ooBatch_read(struct ooBatch *self)
+{
+    ssize_t num_bytes;
+
+    while (1) {
+	num_bytes = read(self->input_fd, self->buf + self->buf_used,
+			 self->buf_size - self->buf_used);
+	if (num_bytes < 0) {
+	    if (errno == EINTR) continue;
+	    fprintf(stderr, "  -- OOmnik batch: read failed: %s\n",
+		    strerror(errno));
+	    return oo_FAIL;
+	}
+	break;
+    }
+
+    if (!num_bytes)
+	self->is_eof = true;
+
+    self->buf_used += (size_t)num_bytes;
+
+    return oo_OK;
+}
+
+/*  the next window of records */
+static int
+ooBatch_fill(struct ooBatch *self)
+{
+    char *buf;
+    size_t buf_size;
+    int ret;
+
+    self->num_records = 0;
+
+    if (self->map) {
+	self->map_pos += ooBatch_cut(self, self->map + self->map_pos,
+				     self->map_size - self->map_pos, true);
+	return oo_OK;
+    }
+
+    if (!self->buf) return oo_OK;
+
+    /* the records of the previous window are written:
+     * its unfinished tail goes to the front */
+    if (self->buf_pos) {
+	self->buf_used -= self->buf_pos;
+	memmove(self->buf, self->buf + self->buf_pos, self->buf_used);
+	self->buf_pos = 0;
+    }
+
+    if (!self->is_eof && self->buf_used < self->buf_size) {
+	ret = ooBatch_read(self);
+	if (ret != oo_OK) return ret;
+    }
+
+    while (1) {
+	self->buf_pos += ooBatch_cut(self, self->buf + self->buf_pos,
+				     self->buf_used - self->buf_pos,
+				     self->is_eof);
+	if (self->num_records || self->is_eof) break;
+
+	/* not a single complete record yet */
+	if (self->buf_used == self->buf_size) {
+	    buf_size = self->buf_size * 2;
+	    buf = realloc(self->buf, buf_size);
+	    if (!buf) return oo_NOMEM;
+	    self->buf = buf;
+	    self->buf_size = buf_size;
+	}
+
+	ret = ooBatch_read(self);
+	if (ret != oo_OK) return ret;
+    }
+
+    return oo_OK;
+}
+
+static int
+ooBatch_flush(struct ooBatch *self,
+	      const char *data,
+	      size_t size)
+{
+    ssize_t num_bytes;
+
+    while (size) {
+	num_bytes = write(self->output_fd, data, size);
+	if (num_bytes < 0) {
+	    if (errno == EINTR) continue;
+	    fprintf(stderr, "  -- OOmnik batch: write failed: %s\n",
+		    strerror(errno));
+	    return oo_FAIL;
+	}
+	data += num_bytes;
+	size -= (size_t)num_bytes;
+	self->bytes_out += (size_t)num_bytes;
+    }
+
+    return oo_OK;
+}
+
+static int
+ooBatch_write(struct ooBatch *self,
+	      const char *data,
+	      size_t size)
+{
+    int ret;
+
+    if (self->out_used + size <= BATCH_WRITE_BUF_SIZE) {
+	memcpy(self->out + self->out_used, data, size);
+	self->out_used += size;
+	return oo_OK;
+    }
+
+    ret = ooBatch_flush(self, self->out, self->out_used);
+    self->out_used = 0;
+    if (ret != oo_OK) return ret;
+
+    /* too large to be buffered */
+    if (size > BATCH_WRITE_BUF_SIZE)
+	return ooBatch_flush(self, data, size);
+
+    memcpy(self->out, data, size);
+    self->out_used = size;
+
+    return oo_OK;
+}
+
+/**
+ * an unrecognized record leaves an empty result
+ * so that the output keeps in step with the input
+ */
+static int
+ooBatch_write_record(struct ooBatch *self,
+		     struct ooBatchRecord *rec)
+{
+    char sep = self->records == OO_RECORDS_NUL ? '\0' : '\n';
+    int ret = oo_OK;
+
+    if (rec->output) {
+	ret = ooBatch_write(self, rec->output, rec->output_size);
+	free(rec->output);
+	rec->output = NULL;
+    }
+    else if (rec->input_size)
+	self->num_failed++;
+
+    if (ret != oo_OK) return ret;
+
+    return ooBatch_write(self, &sep, 1);
+}
+
+static void*
+ooBatch_work(void *arg)
+{
+    struct ooBatch *self = (struct ooBatch*)arg;
+    struct ooBatchRecord *rec;
+    const char *result;
+    char *input = NULL, *buf;
+    size_t input_size = 0, i;
+    void *session;
+    int ret;
+
+    session = OOmnik_open_session(self->oomnik);
+
+    pthread_mutex_lock(&self->lock);
+
+    while (!self->stopping) {
+	if (self->next_record >= self->num_queued) {
+	    pthread_cond_wait(&self->work_cond, &self->lock);
+	    continue;
+	}
+
+	i = self->next_record++;
+	rec = &self->window[i];
+
+	pthread_mutex_unlock(&self->lock);
+
+	/* the decoder needs a terminated copy */
+	if (session && rec->input_size) {
+	    if (rec->input_size + 1 > input_size) {
+		buf = realloc(input, rec->input_size + 1);
+		if (buf) {
+		    input = buf;
+		    input_size = rec->input_size + 1;
+		}
+	    }
+
+	    if (input && rec->input_size + 1 <= input_size) {
+		memcpy(input, rec->input, rec->input_size);
+		input[rec->input_size] = '\0';
+
+		ret = OOmnik_session_process(session, input, self->format,
+					     NULL, &result);
+		if (ret == oo_OK) {
+		    rec->output_size = strlen(result);
+		    rec->output = malloc(rec->output_size + 1);
+		    if (rec->output)
+			memcpy(rec->output, result, rec->output_size + 1);
+		}
+	    }
+	}
+
+	pthread_mutex_lock(&self->lock);
+	rec->is_done = true;
+	if (i == self->next_write)
+	    pthread_cond_signal(&self->done_cond);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    if (input) free(input);
+    if (session) OOmnik_close_session(session);
+
+    return NULL;
+}
+
+static int
+ooBatch_start_workers(struct ooBatch *self)
+{
+    size_t i;
+
+    self->workers = malloc(sizeof(pthread_t) * self->num_threads);
+    if (!self->workers) return oo_NOMEM;
+
+    for (i = 0; i < self->num_threads; i++) {
+	if (pthread_create(&self->workers[i], NULL,
+			   ooBatch_work, (void*)self) != 0)
+	    break;
+	self->num_workers++;
+    }
+
+    if (!self->num_workers) return oo_FAIL;
+
+    return oo_OK;
+}
+
+static int
+ooBatch_run(struct ooBatch *self,
+	    struct OOmnik *oomnik)
+{
+    struct ooBatchRecord *rec;
+    size_t i, num_records;
+    int ret;
+
+    if (!oomnik || self->workers) return oo_FAIL;
+    self->oomnik = oomnik;
+
+    ret = ooBatch_start_workers(self);
+    if (ret != oo_OK) return ret;
+
+    while (1) {
+	ret = ooBatch_fill(self);
+	if (ret != oo_OK) break;
+
+	num_records = self->num_records;
+	if (!num_records) break;
+
+	pthread_mutex_lock(&self->lock);
+	self->num_queued = num_records;
+	self->next_record = 0;
+	self->next_write = 0;
+	pthread_cond_broadcast(&self->work_cond);
+	pthread_mutex_unlock(&self->lock);
+
+	/* results go out while the rest of the window is decoded */
+	for (i = 0; i < num_records; i++) {
+	    rec = &self->window[i];
+
+	    pthread_mutex_lock(&self->lock);
+	    self->next_write = i;
+	    while (!rec->is_done)
+		pthread_cond_wait(&self->done_cond, &self->lock);
+	    pthread_mutex_unlock(&self->lock);
+
+	    if (ret == oo_OK)
+		ret = ooBatch_write_record(self, rec);
+
+	    if (rec->output) {
+		free(rec->output);
+		rec->output = NULL;
+	    }
+	}
+
+	pthread_mutex_lock(&self->lock);
+	self->num_queued = 0;
+	pthread_mutex_unlock(&self->lock);
+
+	self->total_records += num_records;
+	if (ret != oo_OK) break;
+    }
+
+    if (self->out_used) {
+	if (ret == oo_OK)
+	    ret = ooBatch_flush(self, self->out, self->out_used);
+	self->out_used = 0;
+    }
+
+    fprintf(stderr, "  OOmnik batch: %zu records (%zu bytes), "
+	    "%zu not recognized, %zu bytes written\n",
+	    self->total_records, self->bytes_in,
+	    self->num_failed, self->bytes_out);
+
+    return ret;
+}
+
+static int
+ooBatch_open_input(struct ooBatch *self)
+{
+    struct stat st;
+    void *map;
+
+    if (!self->input_name || !strcmp(self->input_name, "-"))
+	self->input_fd = STDIN_FILENO;
+    else {
+	self->input_fd = open(self->input_name, O_RDONLY);
+	if (self->input_fd < 0) {
+	    fprintf(stderr, "  -- OOmnik batch: couldn't open \"%s\": %s\n",
+		    self->input_name, strerror(errno));
+	    return oo_FAIL;
+	}
+    }
+
+    /* a regular file is read through the page cache directly */
+    if (!fstat(self->input_fd, &st) && S_ISREG(st.st_mode)) {
+	if (!st.st_size) return oo_OK;
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+		   self->input_fd, 0);
+	if (map != MAP_FAILED) {
+	    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+	    self->map = (const char*)map;
+	    self->map_size = (size_t)st.st_size;
+	    return oo_OK;
+	}
+    }
+
+    self->buf = malloc(BATCH_READ_BUF_SIZE);
+    if (!self->buf) return oo_NOMEM;
+    self->buf_size = BATCH_READ_BUF_SIZE;
+
+    return oo_OK;
+}
+
+static int
+ooBatch_open_output(struct ooBatch *self)
+{
+    /* the library reports its progress on stdout */
+    if (!self->output_name || !strcmp(self->output_name, "-")) {
+	fflush(stdout);
+	self->output_fd = dup(STDOUT_FILENO);
+	if (self->output_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+	    fprintf(stderr, "  -- OOmnik batch: couldn't take over "
+		    "the standard output: %s\n", strerror(errno));
+	    return oo_FAIL;
+	}
+	self->owns_stdout = true;
+	return oo_OK;
+    }
+
+    self->output_fd = open(self->output_name,
+			   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (self->output_fd < 0) {
+	fprintf(stderr, "  -- OOmnik batch: couldn't create \"%s\": %s\n",
+		self->output_name, strerror(errno));
+	return oo_FAIL;
+    }
+
+    return oo_OK;
+}
+
+static int
+ooBatch_del(struct ooBatch *self)
+{
+    size_t i;
+
+    pthread_mutex_lock(&self->lock);
+    self->stopping = true;
+    pthread_cond_broadcast(&self->work_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 0; i < self->num_workers; i++)
+	pthread_join(self->workers[i], NULL);
+
+    if (self->window) {
+	for (i = 0; i < self->num_records; i++)
+	    if (self->window[i].output) free(self->window[i].output);
+	free(self->window);
+    }
+
+    if (self->map) munmap((void*)self->map, self->map_size);
+
+    if (self->owns_stdout) {
+	fflush(stdout);
+	dup2(self->output_fd, STDOUT_FILENO);
+    }
+
+    if (self->input_fd > STDIN_FILENO) close(self->input_fd);
+    if (self->output_fd > STDERR_FILENO) close(self->output_fd);
+
+    if (self->buf) free(self->buf);
+    if (self->out) free(self->out);
+    if (self->workers) free(self->workers);
+
+    pthread_cond_destroy(&self->done_cond);
+    pthread_cond_destroy(&self->work_cond);
+    pthread_mutex_destroy(&self->lock);
+
+    free(self);
+
+    return oo_OK;
+}
+
+extern int
+ooBatch_new(struct ooBatch **batch,
+	    const char *input_name,
+	    const char *output_name,
+	    output_type format,
+	    oo_batch_records records,
+	    size_t num_threads)
+{
+    struct ooBatch *self;
+    long num_cpus;
+    int ret = oo_NOMEM;
+
+    self = malloc(sizeof(struct ooBatch));
+    if (!self) return oo_NOMEM;
+
+    memset(self, 0, sizeof(struct ooBatch));
+
+    self->input_name = input_name;
+    self->output_name = output_name;
+    self->format = format;
+    self->records = records;
+    self->input_fd = -1;
+    self->output_fd = -1;
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->work_cond, NULL);
+    pthread_cond_init(&self->done_cond, NULL);
+
+    self->del = ooBatch_del;
+    self->run = ooBatch_run;
+
+    self->window = malloc(sizeof(struct ooBatchRecord) * BATCH_WINDOW_SIZE);
+    if (!self->window) goto error;
+
+    self->out = malloc(BATCH_WRITE_BUF_SIZE);
+    if (!self->out) goto error;
+
+    ret = ooBatch_open_input(self);
+    if (ret != oo_OK) goto error;
+
+    ret = ooBatch_open_output(self);
+    if (ret != oo_OK) goto error;
+
+    if (!num_threads) {
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	num_threads = num_cpus > 0 ? (size_t)num_cpus : 1;
+    }
+    if (num_threads > BATCH_MAX_THREADS)
+	num_threads = BATCH_MAX_THREADS;
+    self->num_threads = num_threads;
+
+    *batch = self;
+
+    return oo_OK;
+
+ error:
+    ooBatch_del(self);
+    return ret;
+}
@@ -0,0 +1,133 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oobatch.h
+ *   OOmnik batch processing of input files
+ */
+
+#ifndef OO_BATCH_H
+#define OO_BATCH_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ooconfig.h"
+
+struct OOmnik;
+
+/* how the input is cut into records */
+typedef enum oo_batch_records { OO_RECORDS_LINES,
+				OO_RECORDS_NUL,
+				OO_RECORDS_WHOLE
+} oo_batch_records;
+
+typedef struct ooBatchRecord {
+    const char *input;
+    size_t input_size;
+
+    /* the result, NULL if the record was not recognized */
+    char *output;
+    size_t output_size;
+
+    bool is_done;
+} ooBatchRecord;
+
+/**
+ *  Batch:
+ *  the main thread cuts the input into a window of records
+ *  and writes their results in the input order
+ *  while the workers are still decoding the rest,
+ *  each worker with a session of its own.
+ *
+ *  A regular file is mapped into memory,
+ *  any other input is read as a stream.
+ *  The results get the standard output to themselves:
+ *  whatever else is printed there goes to stderr
+ *  while the batch exists.
+ */
+typedef struct ooBatch {
+    struct OOmnik *oomnik;
+
+    const char *input_name;
+    const char *output_name;
+    output_type format;
+    oo_batch_records records;
+
+    int input_fd;
+    int output_fd;
+
+    /* the standard output taken over by the results */
+    bool owns_stdout;
+
+    /* mapped input */
+    const char *map;
+    size_t map_size;
+    size_t map_pos;
+
+    /* streamed input */
+    char *buf;
+    size_t buf_size;
+    size_t buf_used;
+    size_t buf_pos;
+    bool is_eof;
+
+    /* output not written yet */
+    char *out;
+    size_t out_used;
+
+    pthread_t *workers;
+    size_t num_workers;
+    size_t num_threads;
+
+    /* guards the window */
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    struct ooBatchRecord *window;
+    size_t num_records;
+
+    /* records handed over to the workers */
+    size_t num_queued;
+    size_t next_record;
+    size_t next_write;
+    bool stopping;
+
+    size_t total_records;
+    size_t num_failed;
+    size_t bytes_in;
+    size_t bytes_out;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooBatch *self);
+
+    /* process the whole input */
+    int (*run)(struct ooBatch *self, struct OOmnik *oomnik);
+} ooBatch;
+
+/**
+ *  input and output: file names, NULL or "-" for the standard streams;
+ *  0 threads means one per online CPU.
+ *  To be created before the knowledge base is loaded
+ *  so that its reports stay out of the results.
+ */
+extern int ooBatch_new(struct ooBatch **self,
+		       const char *input_name,
+		       const char *output_name,
+		       output_type format,
+		       oo_batch_records records,
+		       size_t num_threads);
+
+#endif /* OO_BATCH_H */
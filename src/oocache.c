@@ -28,6 +28,7 @@
 #include "oocode.h"
 #include "oocache.h"
 #include "oocodesystem.h"
+#include "ooregion.h"
 #include "oosegmentizer.h"
 #include "ooagenda.h"
 
@@ -35,11 +36,8 @@
 static int 
 ooLinearCache_del(struct ooLinearCache *self)
 {
-    size_t i, j, u, *num_codes;
+    size_t i, *num_codes;
     const char *seq;
-    struct ooLinearCacheCell *cell;
-    struct ooLinearCacheTail *tail;
-    struct ooCodeMatch *code_match, *next_code_match;
     struct ooCode **codes;
 
     /* remove all scaffoldings */
@@ -60,29 +58,12 @@ ooLinearCache_del(struct ooLinearCache *self)
     if (self->code_list_sizes)
 	self->code_list_sizes->del(self->code_list_sizes);
 
-    /* remove every cell */
-    for (i = 0; i < self->num_cells; i++) {
-	cell = self->matrix[i];
-	if (!cell) continue;
+    /* the cells with their tails and code matches */
+    if (self->region)
+	self->region->del(self->region);
 
-	/* remove all possibble tails */
-	for (j = 0; j < cell->num_tails; j++) {
-	    tail = cell->tails[j];
-	    if (!tail) continue;
-	    if (tail->units)
-		free(tail->units);
-
-	    code_match = tail->code_match;
-	    while (code_match) {
-		next_code_match = code_match->next;
-		free(code_match);
-		code_match = next_code_match;
-	    }
-	    free(tail);
-	}
-	free(cell->tails);
-	free(cell);
-    }
+    if (self->pending_seqs)
+	free(self->pending_seqs);
 
     if (self->row_sizes)
 	free(self->row_sizes);
@@ -162,7 +143,8 @@ struct ooLinearCacheTail*
 ooLinearCache_find_tail(struct ooLinearCache *self,
 			struct ooLinearCacheCell *cell,
 			size_t *newtail,
-			size_t newtail_len)
+			size_t newtail_len,
+			struct ooCacheStats *stats)
 {   size_t i;
     int ret;
     struct ooLinearCacheTail *tail = NULL;
@@ -175,6 +157,15 @@ ooLinearCache_find_tail(struct ooLinearCache *self,
 	    break;
 	}
     }
+
+    if (stats) {
+	if (i < cell->num_tails) i++;
+	stats->num_tail_scans++;
+	stats->num_tails_compared += i;
+	if (i > stats->max_tail_scan)
+	    stats->max_tail_scan = i;
+    }
+
     return tail;
 }
 
@@ -203,6 +194,8 @@ int ooLinearCache_calc_pos(struct ooLinearCache *self,
 	curr_id = (size_t)cu->concid;
 
 	if (cur_depth < self->matrix_depth) {
+	    /* no room for the code in the layout */
+	    if (curr_id >= self->radix) return oo_FAIL;
 
 	    /* using a multiplier */
 	    matrix_pos += self->row_sizes[cur_depth] * curr_id;
@@ -235,12 +228,16 @@ int ooLinearCache_calc_pos(struct ooLinearCache *self,
 
 
 
-/* put a single code into the matrix */
+/**
+ * put the codes of a segmentized sequence into the matrix:
+ * all the codes registered for it or just the given one
+ */
 static int 
 ooLinearCache_insert_code(struct ooLinearCache *self,
 		    const unsigned char *seq,
-		    struct ooSegmentizer *segm)
-{   size_t i, j, pos = 0, cu_count, *num_newcodes;
+		    struct ooSegmentizer *segm,
+		    struct ooCode *single_code)
+{   size_t i, j, pos = 0, cu_count, *num_newcodes, num_single = 1;
     struct ooCode *code, **newcodes;
     struct ooCodeMatch *code_match;
     struct ooLinearCacheCell *cell;
@@ -248,6 +245,7 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
     struct ooLinearCacheTail *tail = NULL;
     struct ooConcUnit *cu;
     struct ooAgenda *agenda = segm->agenda;
+    struct ooRegion *region = self->region;
     size_t *tail_units = NULL;
     size_t tail_len = 0, tail_start = 0, coverage = 0;
     bool register_newtail = false;
@@ -258,12 +256,18 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
 	       seq);
 
     /* get the codes that correspond to this atomic sequence */
-    newcodes = self->codes->get(self->codes, (const char*)seq);
-    if (!newcodes) return oo_FAIL;
+    if (single_code) {
+	newcodes = &single_code;
+	num_newcodes = &num_single;
+    }
+    else {
+	newcodes = self->codes->get(self->codes, (const char*)seq);
+	if (!newcodes) return oo_FAIL;
 
-    num_newcodes = self->code_list_sizes->get(self->code_list_sizes, 
-					      (const char*)seq);
-    if (!num_newcodes) return oo_FAIL;
+	num_newcodes = self->code_list_sizes->get(self->code_list_sizes, 
+						  (const char*)seq);
+	if (!num_newcodes || !*num_newcodes) return oo_FAIL;
+    }
 
     ret = ooLinearCache_calc_pos(self, segm, &pos, &tail_start, &tail_len, &coverage);
     if (ret != oo_OK) return oo_FAIL;
@@ -297,7 +301,7 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
 
     /* initialize the cell */
     if (!cell) {
-	cell = malloc(sizeof(struct ooLinearCacheCell));
+	cell = region->alloc(region, sizeof(struct ooLinearCacheCell));
 	if (!cell) {
 	    free(tail_units);
 	    return oo_NOMEM;
@@ -308,31 +312,41 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
     }
 
     /* add code as one of the cell tails  */
-    /* get the matching tail */
-    if (tail_units)
-	tail = ooLinearCache_find_tail(self, cell, tail_units, tail_len);
+    /* get the matching tail, an empty one included */
+    tail = ooLinearCache_find_tail(self, cell, tail_units, tail_len, NULL);
    
 
     if (!tail) {
-	tail = malloc(sizeof(struct ooLinearCacheTail));
+	tail = region->alloc(region, sizeof(struct ooLinearCacheTail) +
+			     sizeof(size_t) * tail_len);
 	if (!tail) {
 	    free(tail_units);
 	    return oo_NOMEM;
 	}
-	tail->units = tail_units;
+
+	/* the units are kept right after the tail */
+	tail->units = NULL;
+	if (tail_len) {
+	    tail->units = (size_t*)(tail + 1);
+	    memcpy(tail->units, tail_units, sizeof(size_t) * tail_len);
+	}
 	tail->num_units = tail_len;
 	tail->coverage = coverage;
 	tail->code_match = NULL;
 	register_newtail = true;
     }
-    else {
+
+    if (tail_units)
 	free(tail_units);
-    }
 
     for (i = 0; i < *num_newcodes; i++) {
 	code = newcodes[i];
 
-	code_match = malloc(sizeof(struct ooCodeMatch));
+	code_match = self->free_matches;
+	if (code_match)
+	    self->free_matches = code_match->next;
+	else
+	    code_match = region->alloc(region, sizeof(struct ooCodeMatch));
 	if (!code_match) return oo_NOMEM;
 
 	code_match->code = code;
@@ -355,8 +369,9 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
 
     /* add a new tail */
     if (register_newtail) {
-	tails = realloc(cell->tails, sizeof(struct ooLinearCacheTail*) *
-			(cell->num_tails + 1));
+	tails = region->realloc(region, cell->tails,
+				sizeof(struct ooLinearCacheTail*) *
+				(cell->num_tails + 1));
 	if (!tails) return oo_NOMEM;
 	tails[cell->num_tails] = tail;
 	cell->tails = tails;
@@ -371,25 +386,114 @@ ooLinearCache_insert_code(struct ooLinearCache *self,
     return oo_OK;
 }
 
-static
-int ooLinearCache_populate_matrix(struct ooLinearCache *self)
+/* walk over the matrix and count its cells, tails and code matches */
+static int
+ooLinearCache_measure_occupancy(struct ooLinearCache *self)
+{
+    struct ooLinearCacheOccupancy *occ = &self->occupancy;
+    struct ooLinearCacheCell *cell;
+    struct ooLinearCacheTail *tail;
+    struct ooCodeMatch *cm;
+    size_t i, j, num_code_matches;
+
+    memset(occ, 0, sizeof(struct ooLinearCacheOccupancy));
+
+    for (i = 0; i < self->num_cells; i++) {
+	cell = self->matrix[i];
+	if (!cell) continue;
+
+	occ->num_used_cells++;
+	occ->num_tails += cell->num_tails;
+	oo_hist_add(occ->tails_hist, cell->num_tails);
+
+	if (cell->num_tails > occ->max_tails) {
+	    occ->max_tails = cell->num_tails;
+	    occ->max_tails_cell = i;
+	}
+
+	for (j = 0; j < cell->num_tails; j++) {
+	    tail = cell->tails[j];
+	    oo_hist_add(occ->tail_len_hist, tail->num_units);
+
+	    num_code_matches = 0;
+	    for (cm = tail->code_match; cm; cm = cm->next)
+		num_code_matches++;
+
+	    occ->num_code_matches += num_code_matches;
+	    oo_hist_add(occ->code_matches_hist, num_code_matches);
+	    if (num_code_matches > occ->max_code_matches)
+		occ->max_code_matches = num_code_matches;
+	}
+    }
+
+    return oo_OK;
+}
+
+static int
+ooLinearCache_present_occupancy(struct ooLinearCache *self,
+				char *buf,
+				size_t buf_size)
+{
+    struct ooLinearCacheOccupancy *occ = &self->occupancy;
+    const size_t *hists[3];
+    const char *hist_names[3] = { "tails", "code_matches", "tail_len" };
+    size_t i, buf_used = 0;
+    int chunk_size, ret;
+
+    hists[0] = occ->tails_hist;
+    hists[1] = occ->code_matches_hist;
+    hists[2] = occ->tail_len_hist;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"name\":\"%s\",\"matrix_depth\":%zu,"
+			  "\"cells\":%zu,\"used_cells\":%zu,"
+			  "\"tails\":%zu,\"code_matches\":%zu,"
+			  "\"max_tails\":%zu,\"max_tails_cell\":%zu,"
+			  "\"max_code_matches\":%zu",
+			  self->cs ? self->cs->name : "", self->matrix_depth,
+			  self->num_cells, occ->num_used_cells,
+			  occ->num_tails, occ->num_code_matches,
+			  occ->max_tails, occ->max_tails_cell,
+			  occ->max_code_matches);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+    buf_used += chunk_size;
+
+    for (i = 0; i < 3; i++) {
+	chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			      ",\"%s_hist\":", hist_names[i]);
+	if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	    return oo_NOMEM;
+	buf_used += chunk_size;
+
+	ret = oo_hist_present(hists[i], buf + buf_used, buf_size - buf_used);
+	if (ret != oo_OK) return ret;
+	buf_used += strlen(buf + buf_used);
+    }
+
+    if (buf_used + 2 > buf_size) return oo_NOMEM;
+    strcpy(buf + buf_used, "}");
+
+    return oo_OK;
+}
+
+/*  segmentizer splitting the cached sequences by the provider */
+static int
+ooLinearCache_new_segmentizer(struct ooLinearCache *self,
+			      struct ooSegmentizer **result)
 {
     struct ooSegmentizer *segm;
     struct ooDecoder *dec;
-    size_t i;
-    const unsigned char *seq;
     int ret;
 
-    fprintf(stderr,"  ++ Populating the Linear Cache (provider: %s)...\n", 
-	    self->provider->name);
-
-    /* cache segmentizer */
     ret = ooSegmentizer_new(&segm);
     if (ret != oo_OK) return ret;
 
     segm->agenda->codesystem = self->provider;
     segm->decoders = malloc(sizeof(struct ooDecoder*));
-    if (!segm->decoders) return oo_NOMEM;
+    if (!segm->decoders) {
+	segm->del(segm);
+	return oo_NOMEM;
+    }
 
     /* subordinate decoder */
     ret = ooDecoder_new(&dec);
@@ -398,52 +502,390 @@ int ooLinearCache_populate_matrix(struct ooLinearCache *self)
 	return ret;
     }
 
+    segm->decoders[0] = dec;
+    segm->num_decoders = 1;
+
     ret = dec->set_codesystem(dec, self->provider);
-    if (ret != oo_OK) return ret;
+    if (ret != oo_OK) {
+	segm->del(segm);
+	return ret;
+    }
 
     dec->used_by_cache = true;
-    segm->decoders[0] = dec;
-    segm->num_decoders = 1;
 
     /* TODO: read the atomic encoding from XML-file */
     segm->pref_atomic_decoder = ATOMIC_UTF8;
 
+    *result = segm;
+
+    return oo_OK;
+}
+
+/*  split a cached sequence into the units of the provider */
+static int
+ooLinearCache_segmentize(struct ooLinearCache *self,
+			 struct ooSegmentizer *segm,
+			 const unsigned char *seq)
+{
+    int ret;
+
+    /* prepare the segmentizer to split this sequence */
+    segm->reset(segm);
+    segm->input = seq;
+    segm->input_len = (size_t)strlen((const char*)seq);
+
+    ret = segm->segmentize(segm);
+    if (ret != oo_OK) return ret;
+
+    if (!segm->agenda->last_idx_pos) {
+	if (DEBUG_CACHE_LEVEL_4)
+	    printf("   -- Nothing was recognized by Segmentizer :((\n");
+	return oo_NO_RESULTS;
+    }
+
+    if (DEBUG_CACHE_LEVEL_4)
+	printf("Total units found by Segmentizer: %u\n",
+	       segm->agenda->last_idx_pos - 1);
+
+    return oo_OK;
+}
+
+/*  remember a sequence the provider cannot split yet */
+static int
+ooLinearCache_add_pending(struct ooLinearCache *self,
+			  const unsigned char *seq)
+{
+    const unsigned char **seqs;
+
+    seqs = realloc(self->pending_seqs, sizeof(unsigned char*) *
+		   (self->num_pending_seqs + 1));
+    if (!seqs) return oo_NOMEM;
+
+    seqs[self->num_pending_seqs++] = seq;
+    self->pending_seqs = seqs;
+
+    return oo_OK;
+}
+
+static void
+ooLinearCache_drop_pending(struct ooLinearCache *self,
+			   const unsigned char *seq)
+{
+    size_t i;
+
+    for (i = 0; i < self->num_pending_seqs; i++) {
+	if (strcmp((const char*)self->pending_seqs[i], (const char*)seq))
+	    continue;
+	self->pending_seqs[i] = self->pending_seqs[--self->num_pending_seqs];
+	return;
+    }
+}
+
+static
+int ooLinearCache_populate_matrix(struct ooLinearCache *self)
+{
+    struct ooSegmentizer *segm;
+    size_t i;
+    const unsigned char *seq;
+    int ret;
+
+    fprintf(stderr,"  ++ Populating the Linear Cache (provider: %s)...\n", 
+	    self->provider->name);
+
+    /* cache segmentizer */
+    ret = ooLinearCache_new_segmentizer(self, &segm);
+    if (ret != oo_OK) return ret;
+
     for (i = 0; i < self->num_codes; i++) {
 	seq = (const unsigned char*)self->codeseqs[i];
 
 	if (DEBUG_CACHE_LEVEL_3)
 	    printf("\n   ...Adding CODESEQ \"%s\" to Cache...\n", seq);
 
-	/* prepare the segmentizer to split this sequence */
-	segm->reset(segm);
-	segm->input = seq;
-	segm->input_len = (size_t)strlen((const char*)seq);
+	ret = ooLinearCache_segmentize(self, segm, seq);
+	if (ret == oo_OK)
+	    ret = ooLinearCache_insert_code(self, seq, segm, NULL);
+	if (ret == oo_NOMEM) break;
+
+	/* another provider code may split it later */
+	if (ret != oo_OK)
+	    ret = ooLinearCache_add_pending(self, seq);
+	if (ret == oo_NOMEM) break;
+    }
+    
+    fprintf(stderr, "Total codes: %zu\n", i);
+
+    segm->del(segm);
+    if (ret == oo_NOMEM) return ret;
 
-	ret = segm->segmentize(segm);
-	if (ret != oo_OK) continue;
+    ooLinearCache_measure_occupancy(self);
 
-	if (!segm->agenda->last_idx_pos) {
-	    if (DEBUG_CACHE_LEVEL_4)
-		printf("   -- Nothing was recognized by Segmentizer :((\n");
+    fprintf(stderr, "  ++ Cache occupancy: %zu of %zu cells used, "
+	    "%zu tails, %zu code matches, busiest cell: %zu (%zu tails)\n",
+	    self->occupancy.num_used_cells, self->num_cells,
+	    self->occupancy.num_tails, self->occupancy.num_code_matches,
+	    self->occupancy.max_tails_cell, self->occupancy.max_tails);
+
+    return oo_OK;
+}
+
+/**
+ * put the sequences of a code added by set()
+ * into a populated matrix
+ */
+static int
+ooLinearCache_insert(struct ooLinearCache *self,
+		     struct ooCode *code)
+{
+    struct ooSegmentizer *segm;
+    const unsigned char *seq;
+    size_t i;
+    int ret;
+
+    /* the matrix is not populated yet */
+    if (!self->matrix) return oo_OK;
+
+    ret = ooLinearCache_new_segmentizer(self, &segm);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; i < code->cache->num_seqs; i++) {
+	seq = (const unsigned char*)code->cache->seqs[i];
+
+	ret = ooLinearCache_segmentize(self, segm, seq);
+	if (ret == oo_OK)
+	    ret = ooLinearCache_insert_code(self, seq, segm, code);
+	if (ret == oo_NOMEM) break;
+
+	/* the other codes of a pending sequence
+	 * are already waiting with it */
+	if (ret != oo_OK) {
+	    ooLinearCache_drop_pending(self, seq);
+	    ret = ooLinearCache_add_pending(self, seq);
+	    if (ret == oo_NOMEM) break;
+	}
+    }
+
+    segm->del(segm);
+
+    return ret == oo_NOMEM ? ret : oo_OK;
+}
+
+/*  take the code matches of a code out of the cell of a sequence */
+static int
+ooLinearCache_remove_matches(struct ooLinearCache *self,
+			     const unsigned char *seq,
+			     struct ooSegmentizer *segm,
+			     struct ooCode *code)
+{
+    struct ooLinearCacheCell *cell;
+    struct ooLinearCacheTail *tail;
+    struct ooCodeMatch **cm, *match;
+    struct ooConcUnit *cu;
+    struct ooAgenda *agenda = segm->agenda;
+    size_t tail_units[INPUT_BUF_SIZE];
+    size_t i, j, pos = 0, cu_count = 0;
+    size_t tail_len = 0, tail_start = 0, coverage = 0;
+    int ret;
+
+    ret = ooLinearCache_calc_pos(self, segm, &pos, &tail_start, &tail_len, &coverage);
+    if (ret != oo_OK) return ret;
+    if (tail_len > INPUT_BUF_SIZE) return oo_FAIL;
+
+    cell = self->matrix[pos];
+    if (!cell) return oo_OK;
+
+    /* the same tail units as in insert_code */
+    j = 0;
+    for (i = 0; i < agenda->last_idx_pos && j < tail_len; i++) {
+	cu = agenda->index[i];
+	if (!cu || cu->concid == 0) continue;
+	if (cu_count < tail_start) {
+	    cu_count++;
 	    continue;
 	}
+	tail_units[j++] = (size_t)cu->concid;
+    }
 
+    tail = ooLinearCache_find_tail(self, cell, tail_units, tail_len, NULL);
+    if (!tail) return oo_OK;
 
-	if (DEBUG_CACHE_LEVEL_4)
-	    printf("Total units found by Segmentizer: %u\n",
-		   segm->agenda->last_idx_pos - 1);
+    for (cm = &tail->code_match; *cm; ) {
+	if ((*cm)->code == code) {
+	    match = *cm;
+	    *cm = match->next;
+	    match->next = self->free_matches;
+	    self->free_matches = match;
+	    continue;
+	}
+	cm = &(*cm)->next;
+    }
 
-	ret = ooLinearCache_insert_code(self, seq, segm);
-	fprintf(stderr, "   .. codes added: %d...\r", i);
+    if (tail->code_match) return oo_OK;
+
+    /* an empty tail leaves the cell */
+    for (i = 0; i < cell->num_tails; i++) {
+	if (cell->tails[i] != tail) continue;
+	cell->num_tails--;
+	memmove(cell->tails + i, cell->tails + i + 1,
+		sizeof(struct ooLinearCacheTail*) * (cell->num_tails - i));
+	break;
     }
-    
-    fprintf(stderr, "Total codes: %d\n", i);
 
-    segm->del(segm);
+    return oo_OK;
+}
+
+/*  forget a code: its sequences go if no other code has them */
+static int
+ooLinearCache_remove(struct ooLinearCache *self,
+		     struct ooCode *code)
+{
+    struct ooSegmentizer *segm = NULL;
+    const unsigned char *seq;
+    struct ooCode **codes;
+    size_t i, j, *num_codes;
+    int ret;
+
+    if (self->matrix) {
+	ret = ooLinearCache_new_segmentizer(self, &segm);
+	if (ret != oo_OK) return ret;
+    }
+
+    for (i = 0; i < code->cache->num_seqs; i++) {
+	seq = (const unsigned char*)code->cache->seqs[i];
+
+	if (segm && ooLinearCache_segmentize(self, segm, seq) == oo_OK)
+	    ooLinearCache_remove_matches(self, seq, segm, code);
+
+	codes = self->codes->get(self->codes, (const char*)seq);
+	num_codes = self->code_list_sizes->get(self->code_list_sizes, 
+					       (const char*)seq);
+	if (!codes || !num_codes) continue;
+
+	for (j = 0; j < *num_codes; j++) {
+	    if (codes[j] != code) continue;
+	    (*num_codes)--;
+	    memmove(codes + j, codes + j + 1,
+		    sizeof(struct ooCode*) * (*num_codes - j));
+	    break;
+	}
+
+	if (*num_codes) continue;
+
+	/* nobody else is known by this sequence */
+	ooLinearCache_drop_pending(self, seq);
+	self->codes->remove(self->codes, (const char*)seq);
+	self->code_list_sizes->remove(self->code_list_sizes, (const char*)seq);
+	free(codes);
+	free(num_codes);
+
+	for (j = 0; j < self->num_codes; j++) {
+	    if (strcmp((const char*)self->codeseqs[j], (const char*)seq)) continue;
+	    self->num_codes--;
+	    memmove(self->codeseqs + j, self->codeseqs + j + 1,
+		    sizeof(unsigned char*) * (self->num_codes - j));
+	    break;
+	}
+    }
+
+    if (segm)
+	segm->del(segm);
+
+    return oo_OK;
+}
+
+/**
+ * build the matrix anew: the provider has outgrown
+ * the matrix layout; the old matrix keeps serving
+ * if the new one cannot be built
+ */
+static int
+ooLinearCache_rebuild(struct ooLinearCache *self)
+{
+    struct ooLinearCacheCell **matrix = self->matrix;
+    struct ooRegion *region = self->region;
+    size_t *row_sizes = self->row_sizes;
+    size_t num_cells = self->num_cells;
+    size_t matrix_size = self->matrix_size;
+    size_t radix = self->radix;
+    struct ooCodeMatch *free_matches = self->free_matches;
+    int ret;
+
+    self->matrix = NULL;
+    self->region = NULL;
+    self->row_sizes = NULL;
+    self->free_matches = NULL;
+    self->num_pending_seqs = 0;
+
+    ret = self->build_matrix(self);
+    if (ret == oo_OK)
+	ret = self->populate_matrix(self);
+
+    if (ret != oo_OK) {
+	if (self->matrix) free(self->matrix);
+	if (self->region) self->region->del(self->region);
+	if (self->row_sizes) free(self->row_sizes);
+
+	self->matrix = matrix;
+	self->region = region;
+	self->row_sizes = row_sizes;
+	self->num_cells = num_cells;
+	self->matrix_size = matrix_size;
+	self->radix = radix;
+	self->free_matches = free_matches;
+	return ret;
+    }
+
+    /* the old cells go all at once */
+    if (matrix) free(matrix);
+    if (region) region->del(region);
+    if (row_sizes) free(row_sizes);
 
     return oo_OK;
 }
 
+/**
+ * the provider has got a new code: the sequences in the matrix
+ * keep their cells, the ones it could not split are tried again
+ */
+static int
+ooLinearCache_extend(struct ooLinearCache *self)
+{
+    struct ooSegmentizer *segm;
+    const unsigned char *seq;
+    size_t i;
+    int ret = oo_OK;
+
+    if (!self->matrix) return oo_OK;
+
+    if (self->provider->num_codes > self->radix)
+	return self->rebuild(self);
+
+    if (!self->num_pending_seqs) return oo_OK;
+
+    ret = ooLinearCache_new_segmentizer(self, &segm);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; i < self->num_pending_seqs; ) {
+	seq = self->pending_seqs[i];
+
+	ret = ooLinearCache_segmentize(self, segm, seq);
+	if (ret == oo_OK)
+	    ret = ooLinearCache_insert_code(self, seq, segm, NULL);
+	if (ret == oo_NOMEM) break;
+
+	if (ret != oo_OK) {
+	    i++;
+	    continue;
+	}
+
+	self->pending_seqs[i] = self->pending_seqs[--self->num_pending_seqs];
+    }
+
+    segm->del(segm);
+
+    return ret == oo_NOMEM ? ret : oo_OK;
+}
+
 /* set a new cache item, remember its char sequence */
 static
 int ooLinearCache_set(struct ooLinearCache *self, 
@@ -515,7 +957,8 @@ int ooLinearCache_update_agenda(struct ooLinearCache *self,
 				size_t start_term_pos,
 				size_t end_term_pos,
 				bool is_sparse,
-				struct ooAgenda *agenda)
+				struct ooAgenda *agenda,
+				size_t *num_matches)
 {
     struct ooConcUnit *cu;
     struct ooCodeMatch *cm;
@@ -546,6 +989,7 @@ int ooLinearCache_update_agenda(struct ooLinearCache *self,
 	cu->next = agenda->index[linear_pos];
 	agenda->index[linear_pos] = cu;
 	agenda->last_idx_pos = linear_pos + 1;
+	(*num_matches)++;
 
 	cm = cm->next;
     }
@@ -558,7 +1002,9 @@ int ooLinearCache_match(struct ooLinearCache *self,
 		  size_t curr_pos,
 		  size_t *tail_buf,
 		  struct ooSegmentizer *segm,
-		  struct ooAgenda *agenda)
+		  struct ooAgenda *agenda,
+		  struct ooCacheStats *stats,
+		  size_t *num_matches)
 {
     struct ooConcUnit *cu, *first_cu = NULL, *prev_cu = NULL;
     struct ooLinearCacheCell *cell;
@@ -590,6 +1036,8 @@ int ooLinearCache_match(struct ooLinearCache *self,
 
 	/* calculate the position in the flat matrix */
 	if (cur_depth < self->matrix_depth) {
+	    if ((size_t)cu->concid >= self->radix) break;
+
 	    /* using a multiplier */
 	    pos += self->row_sizes[cur_depth] * (size_t)cu->concid;
 	    cur_depth++;
@@ -611,16 +1059,21 @@ int ooLinearCache_match(struct ooLinearCache *self,
 
 	max_tail_len = cell->max_tail_len;
 
-	tail = ooLinearCache_find_tail(self, cell, tail_buf, tail_len);
+	tail = ooLinearCache_find_tail(self, cell, tail_buf, tail_len, stats);
 	if (!tail) continue;
 	success = oo_OK;
 
+	if (stats) {
+	    oo_hist_add(stats->match_len_hist, cur_depth + tail_len);
+	    oo_hist_add(stats->coverage_hist, coverage);
+	}
+
 	/* register this tail */
 	ret = ooLinearCache_update_agenda(self, tail,
 					  curr_pos, coverage, 
 					  first_cu->start_term_pos, 
 					  cu->start_term_pos + cu->num_terminals, 
-					  is_sparse, agenda);
+					  is_sparse, agenda, num_matches);
     }
     return success;
 }
@@ -637,8 +1090,9 @@ int ooLinearCache_lookup(struct ooLinearCache *self,
 			 size_t               task_id,
 			 struct ooAgenda      *agenda)
 {   
-    size_t i, tail_buf[INPUT_BUF_SIZE];
+    size_t i, num_matches, tail_buf[INPUT_BUF_SIZE];
     struct ooConcUnit *cu = NULL, *src_cu = NULL;
+    struct ooCacheStats *stats = NULL;
     int ret;
 
     if (DEBUG_CACHE_LEVEL_1) 
@@ -654,6 +1108,11 @@ int ooLinearCache_lookup(struct ooLinearCache *self,
 
     agenda->linear_structure = true;
 
+    if (agenda->stats) {
+	stats = &agenda->stats->cache;
+	stats->num_lookups++;
+    }
+
     for (i = 0; i < segm->agenda->last_idx_pos; i++) {
 	src_cu = segm->agenda->index[i];
 	if (!src_cu) continue;
@@ -681,8 +1140,19 @@ int ooLinearCache_lookup(struct ooLinearCache *self,
 	/* now try to match sequences starting from this position
          * with the valid linear sequences 
          */
+	num_matches = 0;
 	ret = ooLinearCache_match(self, i, 
-				  tail_buf, segm, agenda);
+				  tail_buf, segm, agenda,
+				  stats, &num_matches);
+	if (!stats) continue;
+
+	stats->num_positions++;
+	stats->num_matches += num_matches;
+	oo_hist_add(stats->pos_matches_hist, num_matches);
+	if (ret == oo_OK)
+	    stats->num_hit_positions++;
+	else
+	    stats->num_unrec_positions++;
     }
 
 
@@ -696,6 +1166,7 @@ int ooLinearCache_lookup(struct ooLinearCache *self,
 static int ooLinearCache_build_matrix(struct ooLinearCache *self)
 {
     size_t i, num_cells = 0;
+    int ret;
 
     if (!self->provider) return oo_FAIL;
     if (self->matrix_depth == 0) return oo_FAIL;
@@ -706,16 +1177,27 @@ static int ooLinearCache_build_matrix(struct ooLinearCache *self)
     self->row_sizes = malloc(sizeof(size_t) * self->matrix_depth);
     if (!self->row_sizes) return oo_NOMEM;
 
-    num_cells = self->provider->num_codes;
+    /* room for the codes to be added, 
+     * unless it does not fit into the limit */
+    self->radix = self->provider->num_codes;
+    if (self->headroom)
+	self->radix += self->provider->num_codes * self->headroom / 100 + 1;
 
-    /* last multiplier equals to 1 */
-    self->row_sizes[self->matrix_depth - 1] = 1;
+    for (;;) {
+	num_cells = self->radix;
 
-    for (i = self->matrix_depth - 1; i > 0; i--) {
-	self->row_sizes[i-1] = num_cells;
-	/*if (DEBUG_CACHE_LEVEL_3)
-	  printf(" pos: %u: value: %u\n", i - 1, self->row_sizes[i - 1]);*/
-	num_cells = num_cells * self->provider->num_codes;
+	/* last multiplier equals to 1 */
+	self->row_sizes[self->matrix_depth - 1] = 1;
+
+	for (i = self->matrix_depth - 1; i > 0; i--) {
+	    self->row_sizes[i-1] = num_cells;
+	    num_cells = num_cells * self->radix;
+	}
+
+	if (self->radix == self->provider->num_codes) break;
+	if (sizeof(struct ooLinearCacheCell*) * num_cells <= MAX_MEMCACHE_SIZE)
+	    break;
+	self->radix = self->provider->num_codes;
     }
 
     self->num_cells = num_cells;
@@ -736,10 +1218,15 @@ static int ooLinearCache_build_matrix(struct ooLinearCache *self)
 	if (DEBUG_CACHE_LEVEL_3)
 	    printf("  -- Memcache limit reached :(\n");
 	free(self->row_sizes);
-	free(self);
+	self->row_sizes = NULL;
 	return oo_FAIL;
     }
 
+    if (!self->region) {
+	ret = ooRegion_new(&self->region);
+	if (ret != oo_OK) return ret;
+    }
+
     self->matrix = malloc(self->matrix_size);
     if (!self->matrix) return oo_NOMEM;
 
@@ -767,7 +1254,13 @@ int ooLinearCache_new(struct ooLinearCache **cache)
 
     self->row_sizes = NULL;
     self->matrix = NULL;
+    self->radix = 0;
+    self->region = NULL;
+    self->free_matches = NULL;
+    self->pending_seqs = NULL;
+    self->num_pending_seqs = 0;
     self->matrix_depth = DEFAULT_MATRIX_DEPTH;
+    self->headroom = DEFAULT_CACHE_HEADROOM;
     self->max_unrec_chars = DEFAULT_MAX_UNREC_CHARS;
     self->trust_separators = false;
     self->num_cells = 0;
@@ -789,13 +1282,20 @@ int ooLinearCache_new(struct ooLinearCache **cache)
     self->codeseqs = NULL;
     self->num_codes = 0;
 
+    memset(&self->occupancy, 0, sizeof(struct ooLinearCacheOccupancy));
+
     /* public methods */
     self->del = ooLinearCache_del;
     self->str = ooLinearCache_str;
     self->set = ooLinearCache_set;
     self->populate_matrix = ooLinearCache_populate_matrix;
+    self->insert = ooLinearCache_insert;
+    self->remove = ooLinearCache_remove;
+    self->rebuild = ooLinearCache_rebuild;
+    self->extend = ooLinearCache_extend;
     self->build_matrix = ooLinearCache_build_matrix;
     self->lookup = ooLinearCache_lookup;
+    self->present_occupancy = ooLinearCache_present_occupancy;
 
     *cache = self;
     return oo_OK;
@@ -23,6 +23,7 @@
 
 #include "ooconfig.h"
 
+#include "oostats.h"
 #include "oosegmentizer.h"
 #include "oocode.h"
 #include "oodict.h"
@@ -55,6 +56,26 @@ typedef struct ooLinearCacheCell {
 } ooLinearCacheCell;
 
 
+/* load-time occupancy of the matrix */
+typedef struct ooLinearCacheOccupancy {
+    size_t num_used_cells;
+    size_t num_tails;
+    size_t num_code_matches;
+
+    /* the busiest cell */
+    size_t max_tails;
+    size_t max_tails_cell;
+
+    size_t max_code_matches;
+
+    /* histograms: tails per cell, code matches per tail,
+     * units per tail */
+    size_t tails_hist[STATS_HIST_SIZE];
+    size_t code_matches_hist[STATS_HIST_SIZE];
+    size_t tail_len_hist[STATS_HIST_SIZE];
+} ooLinearCacheOccupancy;
+
+
 /**
  * OOmnik Linear Cache object stores the linear sequences of codes
  * mapped directly to their denotations
@@ -76,6 +97,24 @@ typedef struct ooLinearCache {
 
     size_t *row_sizes;
 
+    /* provider codes the matrix layout has room for */
+    size_t radix;
+
+    /* spare room for the codes to be added,
+     * in percent of the provider codes */
+    size_t headroom;
+
+    /* cells, tails and code matches of the matrix:
+     * a rebuild gives them all back at once */
+    struct ooRegion *region;
+
+    /* code matches taken out by remove, reused by insert */
+    struct ooCodeMatch *free_matches;
+
+    /* sequences the provider could not split yet */
+    const unsigned char **pending_seqs;
+    size_t num_pending_seqs;
+
     struct ooDict *codes;
     struct ooDict *code_list_sizes;
     unsigned char **codeseqs;
@@ -84,6 +123,8 @@ typedef struct ooLinearCache {
     /* string representation */
     char *repr;
 
+    struct ooLinearCacheOccupancy occupancy;
+
     /***********  public methods ***********/
     int (*del)(struct ooLinearCache *self);
     const char* (*str)(struct ooLinearCache *self);
@@ -98,6 +139,24 @@ typedef struct ooLinearCache {
     /* insert real values into matrix */
     int (*populate_matrix)(struct ooLinearCache *self);
 
+    /* put the sequences of a code added by set() 
+     * into a populated matrix */
+    int (*insert)(struct ooLinearCache *self, 
+		  struct ooCode *code);
+
+    /* take a code out of the dictionaries and the matrix */
+    int (*remove)(struct ooLinearCache *self, 
+		  struct ooCode *code);
+
+    /* build and populate the matrix anew
+     * after the provider has changed */
+    int (*rebuild)(struct ooLinearCache *self);
+
+    /* the provider has got a new code: the pending sequences
+     * are tried again, the matrix is only rebuilt
+     * once the layout has no room left */
+    int (*extend)(struct ooLinearCache *self);
+
     /* ask Cache about the meaning 
      * of a linear sequence of concepts */
     int (*lookup)(struct ooLinearCache *self, 
@@ -107,6 +166,11 @@ typedef struct ooLinearCache {
 		  size_t batch_id,
 		  struct ooAgenda *agenda);
 
+    /* JSON report of the matrix occupancy */
+    int (*present_occupancy)(struct ooLinearCache *self,
+			     char *buf,
+			     size_t buf_size);
+
 } ooLinearCache;
 
 
@@ -26,6 +26,9 @@
 #include "ooconcunit.h"
 #include "oocode.h"
 #include "oomindmap.h"
+#include "oostrpool.h"
+#include "ooregion.h"
+#include "ootrace.h"
 
 /* forward declarations */
 static int
@@ -34,161 +37,65 @@ ooCode_read_usages(struct ooCode *self, xmlNode *input_node,
 			 struct ooCodeUsage ***usages,
 			 size_t *num_usages);
 
-/*  Code Unit destructor */
-static
-int ooCodeUnit_del(struct ooCodeUnit *self)
-{
-    size_t i;
+int ooCodeDeriv_init(struct ooCodeDeriv **deriv, struct ooRegion *region);
+static int
+ooCode_build_template(struct ooCode *self);
+int ooCodeUsage_new(struct ooCodeUsage **usage, struct ooRegion *region);
 
-    for (i = 0; i < self->num_specs; i++) {
-	if (self->specs[i]) {
-	    if (self->specs[i]->unit)
-		ooCodeUnit_del(self->specs[i]->unit);
-	    free(self->specs[i]);
-	}
-    }
-    
-    if (self->specs) free(self->specs);
-    free(self);
+/*  handle of a name in the pool of the MindMap */
+static const char*
+ooCode_intern(struct ooCode *self,
+	      const char *name)
+{
+    struct ooStrPool *names = self->cs->mindmap->names;
 
-    return oo_OK;
+    return names->intern(names, name);
 }
 
-/*  Code destructor */
-static
-int ooCode_del(struct ooCode *self)
+/*  zeroed memory in the region of the MindMap */
+static void*
+ooCode_alloc(struct ooCode *self,
+	     size_t size)
 {
-    size_t i;
-    struct ooCodeSpec *spec, *next_spec;
-    struct ooAdaptContext *context;
-
-    if (self->cache->num_seqs) {
-	for (i = 0; i < self->cache->num_seqs; i++) {
-	    if (self->cache->seqs[i])
-		free(self->cache->seqs[i]);
-
-	    if (self->cache->contexts[i]) {
-		context = self->cache->contexts[i];
-		if (context->affects_prepos)
-		    context->affects_prepos->del(context->affects_prepos);
-		if (context->affects_postpos)
-		    context->affects_postpos->del(context->affects_postpos);
-
-		if (context->affected_prepos)
-		    context->affected_prepos->del(context->affected_prepos);
-		if (context->affected_postpos)
-		    context->affected_postpos->del(context->affected_postpos);
-
-		free(context);
-	    }
-	}
-	free(self->cache->seqs);
-	free(self->cache->contexts);
-    }
+    struct ooRegion *region = self->cs->region;
 
-    /* usages */
-    for (i = 0; i < self->num_usages; i++)
-	self->usages[i]->del(self->usages[i]);
-    if (self->usages)
-	free(self->usages);
-
-
-    /* discourse children and parents */
-    for (i = 0; i < OO_NUM_OPERS; i++) {
-
-	spec = self->children[i];
-	while (spec) {
-	    next_spec = spec->next;
-	    if (spec->code_name)
-		free(spec->code_name);
-	    free(spec);
-	    spec = next_spec;
-	}
-
-	spec = self->parents[i];
-	while (spec) {
-	    next_spec = spec->next;
-	    if (spec->code_name)
-		free(spec->code_name);
-	    free(spec);
-	    spec = next_spec;
-	}
-    }
-
-    /* code denotations */
-    for (i = 0; i < self->num_denots; i++)
-	if (self->denot_names[i])
-	    free(self->denot_names[i]);
-    if (self->denot_names)
-	free(self->denot_names);
-    if (self->denots)
-	free(self->denots);
- 
-    /* implied codes */
-    for (i = 0; i < self->num_implied_codes; i++)
-	if (self->implied_code_names[i])
-	    free(self->implied_code_names[i]);
-    if (self->implied_code_names)
-	free(self->implied_code_names);
-    if (self->implied_codes)
-	free(self->implied_codes);
-
-    if (self->cache)
-	free(self->cache);
-
-    if (self->shared)
-	ooCodeUnit_del(self->shared);
-
-    if (self->baseclass_name)
-	free(self->baseclass_name);
+    return region->alloc(region, size);
+}
 
-    if (self->name)
-	free(self->name);
+/*  growable array in the region of the MindMap */
+static void*
+ooCode_realloc(struct ooCode *self,
+	       void *ptr,
+	       size_t size)
+{
+    struct ooRegion *region = self->cs->region;
 
-    free(self);
+    return region->realloc(region, ptr, size);
+}
 
+/**
+ *  Code destructor:
+ *  the code with its specs, usages, derivations,
+ *  constraints and links belongs to the region of the MindMap
+ *  and is released together with the whole region
+ */
+static
+int ooCode_del(struct ooCode *self)
+{
     return oo_OK;
 }
 
-/*  ooCodeUsage destructor */
+/*  ooCodeUsage destructor: see ooCode_del */
 static
 int ooCodeUsage_del(struct ooCodeUsage *self)
 {
-    size_t i;
-
-    if (self->name) free(self->name);
-    if (self->conc_name) free(self->conc_name);
-
-    /* usages */
-    for (i = 0; i < self->num_usages; i++)
-	self->usages[i]->del(self->usages[i]);
-    if (self->usages)
-	free(self->usages);
-
-    /* derivs */
-    for (i = 0; i < self->num_derivs; i++)
-	self->derivs[i]->del(self->derivs[i]);
-    if (self->derivs)
-	free(self->derivs);
-
-
-
-    free(self);
-
     return oo_OK;
 }
 
-/*  ooCodeDeriv destructor */
+/*  ooCodeDeriv destructor: see ooCode_del */
 static
 int ooCodeDeriv_del(struct ooCodeDeriv *self)
 {
-    if (self->name) free(self->name);
-    if (self->usage_name) free(self->usage_name);
-    if (self->arg_code_name) free(self->arg_code_name);
-    if (self->arg_code_usage_name) free(self->arg_code_usage_name);
-
-    free(self);
-
     return oo_OK;
 }
 
@@ -323,7 +230,7 @@ ooCode_set_backref(struct ooCode *self,
     int ret;
     struct ooCodeSpec *spec;
 
-    spec = malloc(sizeof(struct ooCodeSpec));
+    spec = ooCode_alloc(self, sizeof(struct ooCodeSpec));
     if (!spec) return oo_NOMEM;
 
     spec->operid = operid;
@@ -359,6 +266,7 @@ ooCode_set_backref(struct ooCode *self,
 }
 
 
+/*  usage names are interned: the handles are compared */
 struct ooCodeUsage*
 ooCode_lookup_usage(struct ooCodeUsage **usages,
 		    size_t num_usages,
@@ -369,8 +277,7 @@ ooCode_lookup_usage(struct ooCodeUsage **usages,
 
     for (i = 0; i < num_usages; i++) {
 	usage = usages[i];
-	if (!usage->name) continue;
-	if (!strcmp(usage->name, usage_name)) return usage;
+	if (usage->name == usage_name) return usage;
     }
 
     /* nested usages */
@@ -384,6 +291,100 @@ ooCode_lookup_usage(struct ooCodeUsage **usages,
 }
 
 
+/** 
+  * compact derivation index of a single operation:
+  * entries are ordered by arg code id,
+  * equal ids keep the order of the deriv_matches list
+  */
+static int
+ooCode_build_deriv_index(struct ooCode *self,
+			 oo_oper_type operid)
+{
+    struct ooCodeDeriv *deriv;
+    struct ooCodeDerivRef *refs, tmp;
+    size_t num_refs = 0;
+    size_t i, j;
+
+    self->num_deriv_refs[operid] = 0;
+    self->num_unresolved_derivs[operid] = 0;
+
+    for (deriv = self->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	if (deriv->arg_code) num_refs++;
+	else if (deriv->arg_code_name)
+	    self->num_unresolved_derivs[operid]++;
+    }
+
+    if (!num_refs) return oo_OK;
+
+    /* a rebuilt index reuses its array */
+    refs = ooCode_realloc(self, self->deriv_index[operid],
+			  num_refs * sizeof(struct ooCodeDerivRef));
+    if (!refs) return oo_NOMEM;
+
+    i = 0;
+    for (deriv = self->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	if (!deriv->arg_code) continue;
+	refs[i].arg_code_id = deriv->arg_code->id;
+	refs[i].deriv = deriv;
+	i++;
+    }
+
+    /* stable insertion sort: 
+       derivation lists are short */
+    for (i = 1; i < num_refs; i++) {
+	tmp = refs[i];
+	j = i;
+	while (j > 0 && refs[j - 1].arg_code_id > tmp.arg_code_id) {
+	    refs[j] = refs[j - 1];
+	    j--;
+	}
+	refs[j] = tmp;
+    }
+
+    self->deriv_index[operid] = refs;
+    self->num_deriv_refs[operid] = num_refs;
+
+    return oo_OK;
+}
+
+static struct ooCodeDerivRef*
+ooCode_lookup_derivs(struct ooCode *self,
+		     oo_oper_type operid,
+		     struct ooCode *arg_code,
+		     size_t *num_refs)
+{
+    struct ooCodeDerivRef *refs;
+    size_t lo, hi, mid, count;
+
+    *num_refs = 0;
+
+    if (operid <= OO_NONE || operid >= OO_NUM_OPERS) return NULL;
+
+    refs = self->deriv_index[operid];
+    if (!refs) return NULL;
+
+    /* lower bound of arg code id */
+    lo = 0;
+    hi = self->num_deriv_refs[operid];
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (refs[mid].arg_code_id < arg_code->id) 
+	    lo = mid + 1;
+	else 
+	    hi = mid;
+    }
+
+    count = 0;
+    while (lo + count < self->num_deriv_refs[operid] &&
+	   refs[lo + count].arg_code_id == arg_code->id) 
+	count++;
+
+    if (!count) return NULL;
+
+    *num_refs = count;
+    return refs + lo;
+}
+
 static int
 ooCode_resolve_refs(struct ooCode *self)
 {
@@ -402,8 +403,8 @@ ooCode_resolve_refs(struct ooCode *self)
 
     /* baseclass reference */
     if (self->baseclass_name) {
-	ref = (struct ooCode*)self->cs->codes->get(self->cs->codes, 
-						   self->baseclass_name);
+	ref = (struct ooCode*)self->cs->codes->get_interned(self->cs->codes, 
+							    self->baseclass_name);
 	if (!ref) {
 	    if (DEBUG_CS_LEVEL_2)
 		printf(" -- no such baseclass: \"%s\" :(\n", 
@@ -419,7 +420,7 @@ ooCode_resolve_refs(struct ooCode *self)
 	/*printf("\nRESOLVE USAGE REF: %s\n", usage->conc_name);*/
 
 	if (!usage->conc_name) continue;
-	conc = mindmap->lookup(mindmap, (const char*)usage->conc_name);
+	conc = mindmap->lookup_interned(mindmap, usage->conc_name);
 	if (!conc) {
 	  printf("\n -- usage reference not resolved: %s :((\n", usage->conc_name);
 	  continue;
@@ -433,8 +434,27 @@ ooCode_resolve_refs(struct ooCode *self)
 	deriv = self->deriv_matches[operid];
 
 	while (deriv) {
-	    ref = (struct ooCode*)self->cs->codes->get(self->cs->codes, 
-						   deriv->name);
+	    /* argument code */
+	    if (deriv->arg_code_name) {
+		ref = (struct ooCode*)self->cs->codes->get_interned(self->cs->codes, 
+								    deriv->arg_code_name);
+		if (!ref) {
+		    /* a code of another CodeSystem: matched by name */
+		    if (DEBUG_CS_LEVEL_2)
+			printf(" -- deriv arg code \"%s\" is not local, "
+			       "matched by name\n", deriv->arg_code_name);
+		}
+		else {
+		    deriv->arg_code = ref;
+		    if (deriv->arg_code_usage_name && ref->num_usages)
+			deriv->arg_code_usage = ooCode_lookup_usage(ref->usages, 
+						    ref->num_usages, 
+						    deriv->arg_code_usage_name);
+		}
+	    }
+
+	    ref = (struct ooCode*)self->cs->codes->get_interned(self->cs->codes, 
+							    deriv->name);
 	    if (!ref) {
 		printf("\n -- deriv reference not resolved: %s :((\n", deriv->name);
 		goto next_deriv;
@@ -443,7 +463,7 @@ ooCode_resolve_refs(struct ooCode *self)
 	    deriv->code = ref;
 	    deriv->code_usage = ooCode_lookup_usage(ref->usages, 
 						    ref->num_usages, 
-						    (const char*)deriv->usage_name);
+						    deriv->usage_name);
 
 	    if (!deriv->code_usage) {
 		printf("\n  -- no such CodeUsage found: %s (deriv: %s) :((\n", 
@@ -455,6 +475,9 @@ ooCode_resolve_refs(struct ooCode *self)
 	    deriv = deriv->next;
 	}
 
+	ret = ooCode_build_deriv_index(self, operid);
+	if (ret != oo_OK) return ret;
+
 	/* children to parents */
 	child_spec = self->children[operid];
 	if (!child_spec) continue;
@@ -468,8 +491,8 @@ ooCode_resolve_refs(struct ooCode *self)
 		       child_spec->code_name, child_spec->linear_order);
 
 	    if (!child_spec->code_name) goto next_spec;
-	    child_code = (struct ooCode*)self->cs->codes->get(self->cs->codes, 
-							      child_spec->code_name);
+	    child_code = (struct ooCode*)self->cs->codes->get_interned(self->cs->codes, 
+								       child_spec->code_name);
 	    if (!child_code) break;
 
 	    /* replace the temporary code with the real one */
@@ -491,6 +514,350 @@ ooCode_resolve_refs(struct ooCode *self)
     
 
 
+/** 
+  * resolve the references still pending on a code
+  * added to a live CodeSystem: names are interned,
+  * so the handles are compared;
+  * relink tells whether the superclass chain has changed
+  */
+static int
+ooCode_resolve_ref(struct ooCode *self,
+		   struct ooCode *ref,
+		   bool *relink)
+{
+    struct ooCodeSpec *spec;
+    struct ooCodeDeriv *deriv;
+    bool has_new_args;
+    size_t i;
+    int operid, ret;
+
+    *relink = false;
+
+    if (!self->baseclass && self->baseclass_name == ref->name)
+	self->baseclass = ref;
+
+    for (i = 0; i < self->num_implied_codes; i++)
+	if (self->implied_code_names[i] == ref->name)
+	    self->implied_codes[i] = ref;
+
+    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	has_new_args = false;
+
+	for (deriv = self->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	    if (!deriv->arg_code && deriv->arg_code_name == ref->name) {
+		deriv->arg_code = ref;
+		if (deriv->arg_code_usage_name && ref->num_usages)
+		    deriv->arg_code_usage = ooCode_lookup_usage(ref->usages, 
+						    ref->num_usages, 
+						    deriv->arg_code_usage_name);
+		has_new_args = true;
+	    }
+
+	    if (!deriv->code && deriv->name == ref->name) {
+		deriv->code = ref;
+		if (ref->num_usages)
+		    deriv->code_usage = ooCode_lookup_usage(ref->usages, 
+							    ref->num_usages, 
+							    deriv->usage_name);
+	    }
+	}
+
+	if (has_new_args) {
+	    ret = ooCode_build_deriv_index(self, operid);
+	    if (ret != oo_OK) return ret;
+	}
+
+	for (spec = self->children[operid]; spec; spec = spec->next) {
+	    if (spec->code || spec->code_name != ref->name) continue;
+
+	    spec->code = ref;
+	    spec->concid = ref->id;
+
+	    ret = ooCode_set_backref(self, ref, operid, spec);
+	    if (ret != oo_OK) return ret;
+
+	    if (operid == OO_IS_SUBCLASS) *relink = true;
+	}
+    }
+
+    return oo_OK;
+}
+
+/** 
+  * drop all the references to a code removed
+  * from a live CodeSystem, the names are kept
+  * for a code that may come in its place;
+  * relink tells whether the linking tables are affected
+  */
+static int
+ooCode_unresolve_ref(struct ooCode *self,
+		     struct ooCode *ref,
+		     bool *relink)
+{
+    struct ooCodeSpec *spec, **prev;
+    struct ooCodeDeriv *deriv;
+    struct ooCodeUnit *unit;
+    bool has_lost_args;
+    size_t i;
+    int operid, ret;
+
+    *relink = false;
+
+    if (self->baseclass == ref)
+	self->baseclass = NULL;
+
+    for (i = 0; i < self->num_implied_codes; i++)
+	if (self->implied_codes[i] == ref)
+	    self->implied_codes[i] = NULL;
+
+    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	/* back references set by the removed code */
+	for (prev = &self->parents[operid]; *prev; ) {
+	    spec = *prev;
+	    if (spec->code != ref) {
+		prev = &spec->next;
+		continue;
+	    }
+	    *prev = spec->next;
+	    self->num_parents--;
+	    *relink = true;
+	}
+
+	has_lost_args = false;
+
+	for (deriv = self->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	    if (deriv->arg_code == ref) {
+		deriv->arg_code = NULL;
+		deriv->arg_code_usage = NULL;
+		has_lost_args = true;
+	    }
+
+	    if (deriv->code == ref) {
+		deriv->code = NULL;
+		deriv->code_usage = NULL;
+	    }
+	}
+
+	if (has_lost_args) {
+	    ret = ooCode_build_deriv_index(self, operid);
+	    if (ret != oo_OK) return ret;
+	}
+
+	for (spec = self->children[operid]; spec; spec = spec->next) {
+	    if (spec->code != ref) continue;
+
+	    spec->code = NULL;
+	    spec->concid = 0;
+
+	    if (operid == OO_IS_SUBCLASS) *relink = true;
+	}
+    }
+
+    /* a shared code made of the removed one is dropped */
+    for (unit = self->shared; unit; unit = unit->specs[0]->unit) {
+	if (unit->code == ref) {
+	    self->shared = NULL;
+	    return ooCode_build_template(self);
+	}
+	if (!unit->num_specs) break;
+    }
+
+    return oo_OK;
+}
+    
+
+/** 
+  * superclass chain: the code itself goes first
+  */
+static size_t
+ooCode_superclass_chain(struct ooCode *self,
+			struct ooCode **chain)
+{
+    struct ooCodeSpec *spec;
+    struct ooCode *code = self;
+    size_t depth = 0, i;
+
+    while (code && depth < MAX_INHERIT_DEPTH) {
+	/* cyclic inheritance? */
+	for (i = 0; i < depth; i++)
+	    if (chain[i] == code) return depth;
+
+	chain[depth] = code;
+	depth++;
+
+	spec = code->children[OO_IS_SUBCLASS];
+	if (!spec) break;
+	code = spec->code;
+    }
+
+    return depth;
+}
+
+/** 
+  * flatten the syntactic relations of the code
+  * and its superclasses into contiguous tables
+  * (must be called after all codes have resolved their refs)
+  */
+static int
+ooCode_build_links(struct ooCode *self)
+{
+    struct ooCode *chain[MAX_INHERIT_DEPTH];
+    struct ooCode *code;
+    struct ooCodeSpec *spec, *parent_spec;
+    struct ooCodeLink *links, *link;
+    size_t depth, num_links, i;
+    int operid;
+
+    /* rebuilt tables reuse their arrays */
+    self->num_parent_links = 0;
+    self->num_child_links = 0;
+
+    depth = ooCode_superclass_chain(self, chain);
+
+    /* candidate parents: the deepest superclass goes first */
+    num_links = 0;
+    for (i = 0; i < depth; i++) {
+	for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	    if (operid == OO_IS_SUBCLASS) continue;
+	    for (spec = chain[i]->parents[operid]; spec; spec = spec->next)
+		if (spec->code) num_links++;
+	}
+    }
+
+    if (num_links) {
+	links = ooCode_realloc(self, self->parent_links,
+			       num_links * sizeof(struct ooCodeLink));
+	if (!links) return oo_NOMEM;
+
+	link = links;
+	for (i = depth; i > 0; i--) {
+	    code = chain[i - 1];
+
+	    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+		if (operid == OO_IS_SUBCLASS) continue;
+
+		for (spec = code->parents[operid]; spec; spec = spec->next) {
+		    if (!spec->code) continue;
+
+		    parent_spec = spec->code->children[operid];
+
+		    link->operid = operid;
+		    link->code = spec->code;
+		    link->spec = parent_spec;
+		    link->linear_order = OO_ANY_POS;
+		    if (parent_spec) 
+			link->linear_order = parent_spec->linear_order;
+		    link->linear_contact = spec->linear_contact;
+		    link->implied_parent = spec->implied_parent;
+		    link++;
+		}
+	    }
+	}
+
+	self->parent_links = links;
+	self->num_parent_links = num_links;
+    }
+
+    /* child specs: the code itself goes first */
+    num_links = 0;
+    for (i = 0; i < depth; i++)
+	for (operid = 0; operid < OO_NUM_OPERS; operid++)
+	    if (chain[i]->children[operid]) num_links++;
+
+    if (!num_links) return oo_OK;
+
+    links = ooCode_realloc(self, self->child_links,
+			   num_links * sizeof(struct ooCodeLink));
+    if (!links) return oo_NOMEM;
+
+    link = links;
+    for (i = 0; i < depth; i++) {
+	code = chain[i];
+
+	for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	    spec = code->children[operid];
+	    if (!spec) continue;
+
+	    link->operid = operid;
+	    link->code = code;
+	    link->spec = spec;
+	    link->linear_order = spec->linear_order;
+	    link->linear_contact = spec->linear_contact;
+	    link->implied_parent = spec->implied_parent;
+	    link++;
+	}
+    }
+
+    self->child_links = links;
+    self->num_child_links = num_links;
+
+    if (DEBUG_CS_LEVEL_3)
+	printf("  .. \"%s\" linking tables: %zu parents, %zu children "
+	       "(inheritance depth: %zu)\n", 
+	       self->name, self->num_parent_links, 
+	       self->num_child_links, depth);
+
+    return oo_OK;
+}
+
+
+/** 
+  * flatten the nested units of the shared code 
+  * into a relocatable template
+  */
+static int
+ooCode_build_template(struct ooCode *self)
+{
+    struct ooCodeTemplate *tmpl;
+    struct ooCodeTemplateLevel *level;
+    struct ooCodeUsage *usage;
+    struct ooCodeUnit *unit;
+    size_t i;
+
+    if (!self->shared) {
+	self->shared_template = NULL;
+	return oo_OK;
+    }
+
+    /* a rebuilt template is written over the old one */
+    tmpl = self->shared_template;
+    if (!tmpl) {
+	tmpl = ooCode_alloc(self, sizeof(struct ooCodeTemplate));
+	if (!tmpl) return oo_NOMEM;
+    }
+    tmpl->num_levels = 0;
+
+    for (unit = self->shared; unit; unit = unit->specs[0]->unit) {
+	if (tmpl->num_levels == MAX_SHARED_CODE_DEPTH) {
+	    fprintf(stderr, " -- shared code of \"%s\" is too deep, "
+		    "truncated at %d levels\n", self->name, MAX_SHARED_CODE_DEPTH);
+	    break;
+	}
+
+	level = &tmpl->levels[tmpl->num_levels];
+	level->code = unit->code;
+	level->operid = OO_NONE;
+	level->num_interps = 0;
+
+	for (i = 0; i < unit->code->num_usages; i++) {
+	    usage = unit->code->usages[i];
+	    if (!usage->conc) continue;
+	    if (level->num_interps == INTERP_POOL_SIZE) break;
+	    level->interps[level->num_interps] = usage->conc;
+	    level->num_interps++;
+	}
+	tmpl->num_levels++;
+
+	if (!unit->num_specs) break;
+	level->operid = unit->specs[0]->operid;
+    }
+
+    self->shared_template = tmpl;
+
+    return oo_OK;
+}
+
+
 
 
 /* reading XML */
@@ -510,7 +877,7 @@ ooCode_read_position_constraints(struct ooCode *self,
 	if (cur_node->type != XML_ELEMENT_NODE) continue;
 
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"prepos"))) {
-	    ret = ooConstraintGroup_new(&cg);
+	    ret = ooConstraintGroup_new(&cg, self->cs->region);
 	    if (ret != oo_OK) return ret;
 	    ret = cg->read(cg, self, cur_node->children);
 	    if (ret != oo_OK) return ret;
@@ -518,7 +885,7 @@ ooCode_read_position_constraints(struct ooCode *self,
 	    else context->affected_prepos = cg; 
 	}
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"postpos"))) {
-	    ret = ooConstraintGroup_new(&cg);
+	    ret = ooConstraintGroup_new(&cg, self->cs->region);
 	    if (ret != oo_OK) return ret;
 	    ret = cg->read(cg, self, cur_node->children);
 	    if (ret != oo_OK) return ret;
@@ -573,14 +940,14 @@ ooCode_read_cache_unit(struct ooCode *self,
 
     if (!value) return oo_FAIL;
 
-    seqs = realloc(self->cache->seqs, (sizeof(char*) *
-				    (self->cache->num_seqs  + 1)));
+    seqs = ooCode_realloc(self, self->cache->seqs, (sizeof(char*) *
+						    (self->cache->num_seqs  + 1)));
     if (!seqs) {
 	xmlFree(value);
 	return oo_NOMEM;
     }
 
-    seq = malloc(strlen(value) + 1);
+    seq = ooCode_alloc(self, strlen(value) + 1);
     if (!seq) {
 	xmlFree(value);
 	return oo_NOMEM;
@@ -597,17 +964,12 @@ ooCode_read_cache_unit(struct ooCode *self,
 	if (cur_node->type != XML_ELEMENT_NODE) continue;
 
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"context"))) {
-	    context = malloc(sizeof(struct ooAdaptContext));
+	    context = ooCode_alloc(self, sizeof(struct ooAdaptContext));
 	    if (!context) return oo_NOMEM;
-	    context->affects_prepos = NULL;
-	    context->affects_postpos = NULL;
 
-	    context->affected_prepos = NULL;
-	    context->affected_postpos = NULL;
-
-	    contexts = realloc(self->cache->contexts, 
-			       (sizeof(struct ooAdaptContext*) *
-				(self->cache->num_seqs + 1)));
+	    contexts = ooCode_realloc(self, self->cache->contexts, 
+				      (sizeof(struct ooAdaptContext*) *
+				       (self->cache->num_seqs + 1)));
 	    if (!contexts) return oo_NOMEM;
 
 	    ret = ooCode_read_cache_unit_context(self,
@@ -623,9 +985,9 @@ ooCode_read_cache_unit(struct ooCode *self,
 
     /* no context was found.. make a NULL reference in index */
     if (!gotcha) {
-	contexts = realloc(self->cache->contexts, 
-			   (sizeof(struct ooAdaptContext*) *
-			    (self->cache->num_seqs + 1)));
+	contexts = ooCode_realloc(self, self->cache->contexts, 
+				  (sizeof(struct ooAdaptContext*) *
+				   (self->cache->num_seqs + 1)));
 	if (!contexts) return oo_NOMEM;
 	contexts[self->cache->num_seqs] = NULL;
 	self->cache->contexts = contexts;
@@ -705,7 +1067,7 @@ ooCode_read_specs(struct ooCode *self,
 		xmlFree(value);
 	    }
 
-	    spec = malloc(sizeof(struct ooCodeSpec));
+	    spec = ooCode_alloc(self, sizeof(struct ooCodeSpec));
 	    if (!spec) {
 		xmlFree(name);
 		return oo_NOMEM;
@@ -719,16 +1081,13 @@ ooCode_read_specs(struct ooCode *self,
 	    spec->next = NULL;
 	    spec->code = NULL;
 
-	    spec->code_name = malloc(strlen(name) + 1);
-	    if (!spec->code_name) {
-		free(spec);
-		xmlFree(name);
-		return oo_NOMEM;
-	    }
-	    strcpy(spec->code_name, name);
+	    spec->code_name = ooCode_intern(self, name);
 	    xmlFree(name);
+	    if (!spec->code_name) return oo_NOMEM;
 
-	    printf("%s OPERID: %d\n", spec->code_name, operid);
+	    if (OO_TRACE_ON(OO_TRACE_LOAD))
+		oo_trace_msg(OO_TRACE_LOAD, "spec \"%s\" of \"%s\": operid %d",
+			     spec->code_name, self->name, operid);
 
 	    spec->next = self->children[operid];
 	    self->children[operid] = spec;
@@ -747,7 +1106,7 @@ ooCode_read_implied_codes(struct ooCode *self,
 {
     xmlNode *cur_node = NULL;
     struct ooCode **implied_codes;
-    char **codenames;
+    const char **codenames;
     char *codename;
 
     for (cur_node = input_node; cur_node; cur_node = cur_node->next) {
@@ -757,39 +1116,31 @@ ooCode_read_implied_codes(struct ooCode *self,
 	    codename = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
 	    if (!codename) continue;
 
-	    codenames = realloc(self->implied_code_names,
-				sizeof(char*) * 
-				(self->num_implied_codes + 1));
+	    codenames = ooCode_realloc(self, self->implied_code_names,
+				       sizeof(char*) * 
+				       (self->num_implied_codes + 1));
 	    if (!codenames) {
 		xmlFree(codename);
 		return oo_NOMEM;
 	    }
+	    self->implied_code_names = codenames;
 
-	    codenames[self->num_implied_codes] = \
-		malloc(strlen(codename) + 1);
+	    codenames[self->num_implied_codes] = ooCode_intern(self, codename);
+	    xmlFree(codename);
 
-	    if (!codenames[self->num_implied_codes]) {
-		free(codenames);
-		xmlFree(codename);
+	    if (!codenames[self->num_implied_codes])
 		return oo_NOMEM;
-	    }
-	    strcpy(codenames[self->num_implied_codes], codename);
-	    xmlFree(codename);
 
 
-	    implied_codes = realloc(self->implied_codes,
-				    sizeof(struct ooCode*) *
-				    (self->num_implied_codes + 1));
-	    if (!implied_codes) {
-		free(codenames[self->num_implied_codes]);
-		free(codenames);
+	    implied_codes = ooCode_realloc(self, self->implied_codes,
+					   sizeof(struct ooCode*) *
+					   (self->num_implied_codes + 1));
+	    if (!implied_codes)
 		return oo_NOMEM;
-	    }
 	    implied_codes[self->num_implied_codes] = NULL;
 	    self->implied_codes = implied_codes;
 
 	    self->num_implied_codes++;
-	    self->implied_code_names = codenames;
 	}
     }
     return oo_OK;
@@ -819,7 +1170,7 @@ ooCode_read_shared_unit(struct ooCode *self,
     }
     xmlFree(code_name);
     
-    unit = malloc(sizeof(struct ooCodeUnit));
+    unit = ooCode_alloc(self, sizeof(struct ooCodeUnit));
     if (!unit) return NULL;
 
     unit->code = code;
@@ -850,11 +1201,13 @@ ooCode_read_shared_unit(struct ooCode *self,
 		aggr_unit = ooCode_read_shared_unit(self, aggr_node);
 		if (!aggr_unit) continue;
 
-		specs = realloc(unit->specs, (sizeof(struct ooCodeSpec*) *
-					((self->num_children)  + 1)));
+		specs = ooCode_realloc(self, unit->specs,
+				       (sizeof(struct ooCodeUnitSpec*) *
+					((unit->num_specs)  + 1)));
 		if (!specs) continue;
+		unit->specs = specs;
 
-		spec = malloc(sizeof(struct ooCodeUnitSpec));
+		spec = ooCode_alloc(self, sizeof(struct ooCodeUnitSpec));
 		if (!spec) continue;
 
 		spec->operid = operid;
@@ -937,14 +1290,17 @@ ooCode_read_usage_derivs(struct ooCode *self,
 	    }
 
 	    /* new derivation */
-	    ret = ooCodeDeriv_init(&deriv);
-	    deriv->name = malloc(strlen(value) + 1);
+	    ret = ooCodeDeriv_init(&deriv, self->cs->region);
+	    if (ret != oo_OK) {
+		xmlFree(value);
+		return ret;
+	    }
+	    deriv->name = ooCode_intern(self, value);
+	    xmlFree(value);
 	    if (!deriv->name) {
 		deriv->del(deriv);
 		return oo_NOMEM;
 	    }
-	    strcpy(deriv->name, value);
-	    xmlFree(value);
 
 	    /* operation id */
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"oper");
@@ -973,14 +1329,12 @@ ooCode_read_usage_derivs(struct ooCode *self,
 		deriv->del(deriv);
 		continue;
 	    }
-	    deriv->usage_name = malloc(strlen(value) + 1);
+	    deriv->usage_name = ooCode_intern(self, value);
+	    xmlFree(value);
 	    if (!deriv->usage_name) {
 		deriv->del(deriv);
-		xmlFree(value);
 		return oo_NOMEM;
 	    }
-	    strcpy(deriv->usage_name, value);
-	    xmlFree(value);
 
 	    /* argument name */
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"arg_name");
@@ -989,14 +1343,12 @@ ooCode_read_usage_derivs(struct ooCode *self,
 			self->name, deriv->name);
 	    }
 	    else {
-		deriv->arg_code_name = malloc(strlen(value) + 1);
+		deriv->arg_code_name = ooCode_intern(self, value);
+		xmlFree(value);
 		if (!deriv->arg_code_name) {
 		    deriv->del(deriv);
-		    xmlFree(value);
 		    return oo_NOMEM;
 		}
-		strcpy(deriv->arg_code_name, value);
-		xmlFree(value);
 	    }
 
 	    /* argument usage name */
@@ -1007,18 +1359,16 @@ ooCode_read_usage_derivs(struct ooCode *self,
 		deriv->del(deriv);
 		continue;
 	    }
-	    deriv->arg_code_usage_name = malloc(strlen(value) + 1);
+	    deriv->arg_code_usage_name = ooCode_intern(self, value);
+	    xmlFree(value);
 	    if (!deriv->arg_code_usage_name) {
 		deriv->del(deriv);
-		xmlFree(value);
 		return oo_NOMEM;
 	    }
-	    strcpy(deriv->arg_code_usage_name, value);
-	    xmlFree(value);
 
 	    /* register new derivation */
 	    derivs_size = (usage->num_derivs + 1) * sizeof(struct ooCodeDeriv*);
-	    usage->derivs = realloc(usage->derivs, derivs_size);
+	    usage->derivs = ooCode_realloc(self, usage->derivs, derivs_size);
 	    if (!usage->derivs) {
 		deriv->del(deriv);
 		return oo_NOMEM;
@@ -1093,7 +1443,7 @@ ooCode_read_usages(struct ooCode *self,
 		return oo_FAIL;
 	    }
 
-	    ret = ooCodeUsage_new(&usage);
+	    ret = ooCodeUsage_new(&usage, self->cs->region);
 	    if (ret != oo_OK) {
 		xmlFree(value);
 		return ret;
@@ -1101,29 +1451,26 @@ ooCode_read_usages(struct ooCode *self,
 	    usage->parent = parent_usage;
 	    usage->code = self;
 
-	    usage->conc_name = malloc(strlen(value) + 1);
+	    usage->conc_name = ooCode_intern(self, value);
+	    xmlFree(value);
 	    if (!usage->conc_name) {
 		usage->del(usage);
-		xmlFree(value);
 		return oo_NOMEM;
 	    }
-	    strcpy(usage->conc_name, value);
-	    xmlFree(value);
 
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
 	    if (value) {
-		usage->name = malloc(strlen(value) + 1);
+		usage->name = ooCode_intern(self, value);
+		xmlFree(value);
 		if (!usage->name) {
 		    usage->del(usage);
 		    return oo_NOMEM;
 		}
-		strcpy(usage->name, value);
-		xmlFree(value);
 	    }
 
 	    /* add new usage */
 	    usages_size = ((*num_usages) + 1) * sizeof(struct ooCodeUsage*);
-	    curr_usages = realloc((*usages), usages_size);
+	    curr_usages = ooCode_realloc(self, (*usages), usages_size);
 	    if (!curr_usages) {
 		usage->del(usage);
 		return oo_NOMEM;
@@ -1156,32 +1503,26 @@ ooCode_read_denots(struct ooCode *self,
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
 	    if (!value) continue;
 
-	    self->denot_names = realloc(self->denot_names,
-					(self->num_denots + 1) * sizeof(char*));
+	    self->denot_names = ooCode_realloc(self, self->denot_names,
+					       (self->num_denots + 1) * sizeof(char*));
 	    if (!self->denot_names) {
 		xmlFree(value);
 		return oo_NOMEM;
 	    }
 
-	    self->denots = realloc(self->denots,
-				   (self->num_denots + 1) * sizeof(struct ooCode*));
+	    self->denots = ooCode_realloc(self, self->denots,
+					  (self->num_denots + 1) * sizeof(struct ooCode*));
 	    if (!self->denots) {
 		xmlFree(value);
-		free(self->denot_names);
 		return oo_NOMEM;
 	    }
 
 	    self->denots[self->num_denots] = NULL;
-	    self->denot_names[self->num_denots] = malloc(strlen(value) + 1);
-	    if (!self->denot_names[self->num_denots]) {
-		xmlFree(value);
-		free(self->denot_names);
-		free(self->denots);
+	    self->denot_names[self->num_denots] = ooCode_intern(self, value);
+	    xmlFree(value);
+	    if (!self->denot_names[self->num_denots])
 		return oo_NOMEM;
-	    }
 
-	    strcpy(self->denot_names[self->num_denots], value);
-	    xmlFree(value);
 	    self->num_denots++;
 	}
     }
@@ -1206,13 +1547,10 @@ ooCode_read_XML(struct ooCode *self,
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"baseclass"))) {
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
 	    if (value) {
-		self->baseclass_name = malloc(strlen(value) + 1);
-		if (!self->baseclass_name) {
-		    xmlFree(value);
-		    return oo_NOMEM;
-		}
-		strcpy(self->baseclass_name, value);
+		self->baseclass_name = ooCode_intern(self, value);
 		xmlFree(value);
+		if (!self->baseclass_name)
+		    return oo_NOMEM;
 	    }
 	    continue;
 	}
@@ -1257,10 +1595,11 @@ ooCode_read_XML(struct ooCode *self,
 
 
 /*  ooCodeDeriv initializer */
-int ooCodeDeriv_init(struct ooCodeDeriv **deriv)
+int ooCodeDeriv_init(struct ooCodeDeriv **deriv,
+		     struct ooRegion *region)
 {   
     int i;
-    struct ooCodeDeriv *self = malloc(sizeof(struct ooCodeDeriv));
+    struct ooCodeDeriv *self = region->alloc(region, sizeof(struct ooCodeDeriv));
     if (!self) return oo_NOMEM;
 
     self->name = NULL;
@@ -1290,10 +1629,11 @@ int ooCodeDeriv_init(struct ooCodeDeriv **deriv)
 
 
 /*  ooCodeUsage initializer */
-int ooCodeUsage_new(struct ooCodeUsage **usage)
+int ooCodeUsage_new(struct ooCodeUsage **usage,
+		    struct ooRegion *region)
 {   
     int i;
-    struct ooCodeUsage *self = malloc(sizeof(struct ooCodeUsage));
+    struct ooCodeUsage *self = region->alloc(region, sizeof(struct ooCodeUsage));
     if (!self) return oo_NOMEM;
 
     self->name = NULL;
@@ -1314,11 +1654,12 @@ int ooCodeUsage_new(struct ooCodeUsage **usage)
 }
  
 
-/*  ooCode initializer */
-int ooCode_new(struct ooCode **code)
+/*  ooCode initializer: the code is allocated in the region */
+int ooCode_new(struct ooCode **code,
+	       struct ooRegion *region)
 {   
     int i;
-    struct ooCode *self = malloc(sizeof(struct ooCode));
+    struct ooCode *self = region->alloc(region, sizeof(struct ooCode));
     if (!self) return oo_NOMEM;
 
     self->id = 0;
@@ -1330,8 +1671,10 @@ int ooCode_new(struct ooCode **code)
     self->semclass = NULL;*/
 
     self->cs = NULL;
+    self->is_removed = false;
 
     self->shared = NULL;
+    self->shared_template = NULL;
 
     self->baseclass_name = NULL;
     self->baseclass = NULL;
@@ -1341,11 +1684,8 @@ int ooCode_new(struct ooCode **code)
     self->usages = NULL;
     self->num_usages = 0;
 
-    self->cache = malloc(sizeof(struct ooCodeCache));
-    if (!self->cache) {
-	free(self);
-	return oo_NOMEM;
-    }
+    self->cache = region->alloc(region, sizeof(struct ooCodeCache));
+    if (!self->cache) return oo_NOMEM;
     self->cache->seqs = NULL;
     self->cache->num_seqs = 0;
     self->cache->contexts = NULL;
@@ -1360,10 +1700,18 @@ int ooCode_new(struct ooCode **code)
 	self->parents[i] = NULL;
 	self->children[i] = NULL;
 	self->deriv_matches[i] = NULL;
+	self->deriv_index[i] = NULL;
+	self->num_deriv_refs[i] = 0;
+	self->num_unresolved_derivs[i] = 0;
     }
     self->num_parents = 0;
     self->num_children = 0;
 
+    self->parent_links = NULL;
+    self->num_parent_links = 0;
+    self->child_links = NULL;
+    self->num_child_links = 0;
+
     self->allows_grouping = true;
 
     self->denots = NULL;
@@ -1375,6 +1723,11 @@ int ooCode_new(struct ooCode **code)
     self->str = ooCode_str;
     self->read = ooCode_read_XML;
     self->resolve_refs = ooCode_resolve_refs;
+    self->build_links = ooCode_build_links;
+    self->build_template = ooCode_build_template;
+    self->lookup_derivs = ooCode_lookup_derivs;
+    self->resolve_ref = ooCode_resolve_ref;
+    self->unresolve_ref = ooCode_unresolve_ref;
 
     *code = self;
     return oo_OK;
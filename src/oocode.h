@@ -38,10 +38,11 @@ typedef enum code_type { CODE_NONE,
 
 /* forward declaration */
 struct ooCode;
+struct ooRegion;
 
 typedef struct ooCodeDeriv {
-    char *name;
-    char *usage_name;
+    const char *name;
+    const char *usage_name;
     struct ooCode *code;
     struct ooCodeUsage *code_usage;
 
@@ -49,8 +50,8 @@ typedef struct ooCodeDeriv {
     bool used_as_topic;
     oo_oper_type operid;
 
-    char *arg_code_name;
-    char *arg_code_usage_name;
+    const char *arg_code_name;
+    const char *arg_code_usage_name;
     struct ooCode *arg_code;
     struct ooCodeUsage *arg_code_usage;
 
@@ -63,10 +64,17 @@ typedef struct ooCodeDeriv {
 
 } ooCodeDeriv;
 
+/* derivation index entry:
+ * entries of each operation are kept sorted by arg code id */
+typedef struct ooCodeDerivRef {
+    size_t arg_code_id;
+    struct ooCodeDeriv *deriv;
+} ooCodeDerivRef;
+
 typedef struct ooCodeUsage {
 
-    char *name;
-    char *conc_name;
+    const char *name;
+    const char *conc_name;
     struct ooConcept *conc;
 
     struct ooCodeUsage *parent;
@@ -114,7 +122,7 @@ typedef struct ooCodeSpec {
     oo_oper_type operid;
     mindmap_size_t concid;
     
-    char *code_name;
+    const char *code_name;
     struct ooCode *code;
     
     linear_type linear_order;
@@ -132,19 +140,43 @@ typedef struct ooCodeSpec {
 } ooCodeSpec;
 
 
+/* Flattened linking table entry:
+ * parent tables hold candidate parent codes,
+ * child tables hold the child specs of the code
+ * and all its superclasses */
+typedef struct ooCodeLink {
+    oo_oper_type operid;
+    struct ooCode *code;
+
+    /* spec to be used when adding children */
+    struct ooCodeSpec *spec;
+
+    linear_type linear_order;
+    bool linear_contact;
+    bool implied_parent;
+} ooCodeLink;
+
+
 typedef struct ooCode {
     size_t id;
-    char *name;
+
+    /* this and all the other names of codes, usages and derivs
+     * are handles of the MindMap string pool */
+    const char *name;
     code_type type;
 
     struct ooCodeSystem *cs;
+
+    /* taken out of a live CodeSystem:
+     * the id is never given to another code */
+    bool is_removed;
   
     /* char *concref;
       char *gloss;
       char *semclass; */
 
     /* inherit syntactic properties from the baseclass */
-    char *baseclass_name;
+    const char *baseclass_name;
     struct ooCode *baseclass;
 
     /* human verification of code's correctness */
@@ -159,16 +191,17 @@ typedef struct ooCode {
 
     /* next level code denotation */
     struct ooCode **denots;
-    char **denot_names;
+    const char **denot_names;
     size_t num_denots;
 
     /* automatic implications */
     struct ooCode **implied_codes;
-    char **implied_code_names;
+    const char **implied_code_names;
     size_t num_implied_codes;
 
     /* shared code */
     struct ooCodeUnit *shared;
+    struct ooCodeTemplate *shared_template;
 
     /* syntax */
     struct ooCodeSpec *parents[OO_NUM_OPERS];
@@ -178,6 +211,14 @@ typedef struct ooCode {
     logic_opers spec_group_logic;
     size_t num_children;
 
+    /* inheritance-closed linking tables,
+     * precomputed after all refs are resolved */
+    struct ooCodeLink *parent_links;
+    size_t num_parent_links;
+
+    struct ooCodeLink *child_links;
+    size_t num_child_links;
+
     /* units that can be grouped */
     bool allows_grouping;
 
@@ -194,6 +235,15 @@ typedef struct ooCode {
      */
     struct ooCodeDeriv *deriv_matches[OO_NUM_OPERS];
 
+    /* compact index of resolved derivations,
+     * built from deriv_matches at resolve_refs time */
+    struct ooCodeDerivRef *deriv_index[OO_NUM_OPERS];
+    size_t num_deriv_refs[OO_NUM_OPERS];
+
+    /* derivations whose arg code is not in this CodeSystem:
+     * they stay in deriv_matches and are matched by name */
+    size_t num_unresolved_derivs[OO_NUM_OPERS];
+
     /***********  public methods ***********/
     int (*del)(struct ooCode *self);
     const char* (*str)(struct ooCode *self);
@@ -204,6 +254,30 @@ typedef struct ooCode {
     /* resolve references */
     int (*resolve_refs)(struct ooCode *self);
 
+    /* incremental updates: resolve the references pending
+     * on a code added later or drop those to a removed one,
+     * relink is set if the linking tables must be rebuilt */
+    int (*resolve_ref)(struct ooCode *self,
+		       struct ooCode *ref,
+		       bool *relink);
+    int (*unresolve_ref)(struct ooCode *self,
+			 struct ooCode *ref,
+			 bool *relink);
+
+    /* flatten the parent/child specs of the superclass chain */
+    int (*build_links)(struct ooCode *self);
+
+    /* precompute the template of the shared code */
+    int (*build_template)(struct ooCode *self);
+
+    /* find the derivations applicable to a given argument code:
+     * returns the first matching index entry or NULL,
+     * num_refs receives the number of adjacent matches */
+    struct ooCodeDerivRef* (*lookup_derivs)(struct ooCode *self,
+					    oo_oper_type operid,
+					    struct ooCode *arg_code,
+					    size_t *num_refs);
+
 } ooCode;
 
 typedef struct ooCodeUnitSpec {
@@ -218,5 +292,27 @@ typedef struct ooCodeUnit {
 
 } ooCodeUnit;
 
-extern int ooCode_new(struct ooCode **self); 
+/* single level of a shared code template */
+typedef struct ooCodeTemplateLevel {
+    struct ooCode *code;
+
+    /* operation linking the level below */
+    oo_oper_type operid;
+
+    /* concepts of the code usages */
+    struct ooConcept *interps[INTERP_POOL_SIZE];
+    size_t num_interps;
+} ooCodeTemplateLevel;
+
+/**
+ * Relocatable template of a shared code:
+ * levels go top-down, all of them cover 
+ * the linear span of the same terminal
+ */
+typedef struct ooCodeTemplate {
+    struct ooCodeTemplateLevel levels[MAX_SHARED_CODE_DEPTH];
+    size_t num_levels;
+} ooCodeTemplate;
+
+extern int ooCode_new(struct ooCode **self, struct ooRegion *region);
 #endif
@@ -23,15 +23,20 @@
 #include <string.h>
 
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "ooconfig.h"
 #include "ooconcept.h"
 #include "ooconstraint.h"
 #include "oocode.h"
 #include "oocodesystem.h"
+#include "oomindmap.h"
+#include "oostrpool.h"
+#include "ooregion.h"
 #include "oosegmentizer.h"
 #include "oocache.h"
 #include "oodecoder.h"
+#include "ootrace.h"
 
 static const char *ooCodeSystem_operids[] =			\
 { "NONE", "IS_SUBCLASS", "AGGREGATES", "HAS_ATTR", "TAKES_ARG", 
@@ -102,15 +107,16 @@ int ooCodeSystem_del(struct ooCodeSystem *self)
 	self->numeric_denotmap->del(self->denotmap);
     */
 
-    for (i = 0; i < self->num_codes; i++)
-	if (self->code_index[i]) self->code_index[i]->del(self->code_index[i]);
-   
+    /* the codes themselves belong to the region of the MindMap */
     if (self->code_names) free(self->code_names);
     if (self->code_index) free(self->code_index);
 
     if (self->codes)
 	self->codes->del(self->codes);
 
+    if (self->name_refs)
+	self->name_refs->del(self->name_refs);
+
     if (self->root_elem_name) free(self->root_elem_name);
 
     /* say bye to your unique beautiful name :(( */
@@ -133,6 +139,7 @@ ooCodeSystem_resolve_refs(struct ooCodeSystem *self)
 {
     int i;
     struct ooCode *code;
+    int ret;
 
     if (DEBUG_CS_LEVEL_2)
       printf("  Setting inner cross-references of CS \"%s\"...\n",
@@ -143,6 +150,82 @@ ooCodeSystem_resolve_refs(struct ooCodeSystem *self)
 	code->resolve_refs(code);
     }
 
+    /* all backrefs are in place: 
+     * precompute the linking tables and shared code templates */
+    for (i = 1; i < self->num_codes; i++) {
+	code = self->code_index[i];
+	ret = code->build_links(code);
+	if (ret != oo_OK) return ret;
+
+	ret = code->build_template(code);
+	if (ret != oo_OK) return ret;
+    }
+
+    return oo_OK;
+}
+
+/** point a single code of the provider CS
+ *  to its denotations in this CS
+ */
+static int
+ooCodeSystem_coordinate_code(struct ooCodeSystem *self, 
+			     struct ooCodeSystem *cs,
+			     struct ooCode *code)
+{
+    size_t code_value, denot_value, j;
+    const char *denot_name = NULL, *implied_name;
+    struct ooCode *denot, *implied;
+
+    /* add Numeric_Denotmap -> local id mappings */
+    if (cs->use_numeric_codes) {
+	code_value = strtoul(code->name, NULL, 16);
+	if (code_value > UCS2_MAX) return oo_OK;
+
+	denot_value = 0;
+	for (j = 0; j < code->num_denots; j++) {
+	    denot_name = code->denot_names[j];
+	    denot = self->codes->get_interned(self->codes, denot_name);
+	    if (!denot) continue;
+	    denot_value = denot->id;
+	}
+
+	if (DEBUG_CS_LEVEL_4)
+	    printf(" == REF: \"%s\" %s (%u) denotes \"%s\" (local id: %u)\n", 
+		   cs->name, code->name, code_value, denot_name, denot_value);
+
+	cs->numeric_denotmap[code_value] = denot_value;
+	return oo_OK;
+    }
+
+    for (j = 0; j < code->num_denots; j++) {
+	denot_name = code->denot_names[j];
+	denot = self->codes->get_interned(self->codes, denot_name);
+	if (!denot) { 
+	    if (DEBUG_CS_LEVEL_2) {
+		printf(" -- no such denot: \"%s\" :(\n", 
+		       denot_name);
+	    }
+	    continue;
+	}
+	code->denots[j] = denot;
+    }
+
+    /* any implied codes? */
+    if (code->num_implied_codes) {
+	for (j = 0; j < code->num_implied_codes; j++) {
+	    implied_name = code->implied_code_names[j];
+	    implied = cs->codes->get_interned(cs->codes, implied_name);
+	    if (!implied) continue;
+	    code->implied_codes[j] = implied;
+	    /*printf("IMPLIED by %s: %s %p\n", code->name, implied_name, implied);*/
+	}
+    }
+
+    if (DEBUG_CS_LEVEL_4) {
+	printf(" ++ CODE READY:\n");
+	code->str(code);
+    }
+
     return oo_OK;
 }
 
@@ -153,10 +236,9 @@ static int
 ooCodeSystem_coordinate_codesets(struct ooCodeSystem *self, 
                                    struct ooCodeSystem *cs)
 {
-    size_t code_value, denot_value, i, j, c;
-    char *code_name, *denot_name, *implied_name;
-    struct ooCode *code, *denot, *implied;
-    int ret;
+    const char *code_name;
+    struct ooCode *code;
+    size_t i;
 
     if (DEBUG_CS_LEVEL_3)
 	printf("  Setting coordination between \"%s\" (total codes: %u)\n\
@@ -167,58 +249,10 @@ ooCodeSystem_coordinate_codesets(struct ooCodeSystem *self,
     for (i = 1; i < cs->num_codes; i++) {
 	code_name = cs->code_names[i];
 
-	code = (struct ooCode*)cs->codes->get(cs->codes, code_name);
+	code = (struct ooCode*)cs->codes->get_interned(cs->codes, code_name);
 	if (!code) continue;
 
-	/* add Numeric_Denotmap -> local id mappings */
-	if (cs->use_numeric_codes) {
-	    code_value = strtoul(code_name, NULL, 16);
-	    if (code_value > UCS2_MAX) continue;
-	    
-	    denot_value = 0;
-	    for (j = 0; j < code->num_denots; j++) {
-		denot_name = code->denot_names[j];
-		denot = self->codes->get(self->codes, denot_name);
-		if (!denot) continue;
-		denot_value = denot->id;
-	    }
-
-	    if (DEBUG_CS_LEVEL_4)
-		printf(" == REF: \"%s\" %s (%u) denotes \"%s\" (local id: %u)\n", 
-		       cs->name, code_name, code_value, denot_name, denot_value);
-
-	    cs->numeric_denotmap[code_value] = denot_value;
-	    continue;
-	}
-
-	for (j = 0; j < code->num_denots; j++) {
-	    denot_name = code->denot_names[j];
-	    denot = self->codes->get(self->codes, denot_name);
-	    if (!denot) { 
-		if (DEBUG_CS_LEVEL_2) {
-		    printf(" -- no such denot: \"%s\" :(\n", 
-		       denot_name);
-		}
-		continue;
-	    }
-	    code->denots[j] = denot;
-	}
-
-	/* any implied codes? */
-	if (code->num_implied_codes) {
-	    for (j = 0; j < code->num_implied_codes; j++) {
-		implied_name = code->implied_code_names[j];
-		implied = cs->codes->get(cs->codes, implied_name);
-		if (!implied) continue;
-		code->implied_codes[j] = implied;
-		/*printf("IMPLIED by %s: %s %p\n", code->name, implied_name, implied);*/
-	    }
-	}
-
-	if (DEBUG_CS_LEVEL_4) {
-	    printf(" ++ CODE READY:\n");
-	    code->str(code);
-	}
+	ooCodeSystem_coordinate_code(self, cs, code);
     }
 
     return oo_OK;
@@ -404,6 +438,7 @@ ooCodeSystem_read_initcache(struct ooCodeSystem *self, xmlNode *input_node)
     char *provider_name;
     size_t matrix_depth = DEFAULT_MATRIX_DEPTH;
     size_t max_unrec_chars = DEFAULT_MAX_UNREC_CHARS;
+    size_t headroom = DEFAULT_CACHE_HEADROOM;
     bool trust_separators = false;
     int ret;
 
@@ -430,6 +465,13 @@ ooCodeSystem_read_initcache(struct ooCodeSystem *self, xmlNode *input_node)
 	xmlFree(value);
     }
 
+    /* spare room for live code updates, in percent */
+    value = (char*)xmlGetProp(input_node,  (const xmlChar *)"headroom");
+    if (value) {
+	headroom = atoi(value);
+	xmlFree(value);
+    }
+
     value = (char*)xmlGetProp(input_node,  (const xmlChar *)"trust_separators");
     if (value) {
 	trust_separators = (bool)atoi(value);
@@ -461,6 +503,7 @@ ooCodeSystem_read_initcache(struct ooCodeSystem *self, xmlNode *input_node)
 
     self->cache->trust_separators = trust_separators;
     self->cache->matrix_depth = matrix_depth;
+    self->cache->headroom = headroom;
     self->cache->max_unrec_chars = max_unrec_chars;
     self->cache->cs = self;
 
@@ -482,6 +525,8 @@ ooCodeSystem_build_cache(struct ooCodeSystem *self)
     self->cache->provider = provider;
 
     ret = self->cache->build_matrix(self->cache);
+    if (ret != oo_OK) return ret;
+
     ret = self->cache->populate_matrix(self->cache);
 
     return oo_OK;
@@ -489,52 +534,35 @@ ooCodeSystem_build_cache(struct ooCodeSystem *self)
 
 
 
-/* reading XML description of a new code */
+/**
+ *  reading XML description of a code 
+ *  without registering it: the code gets the next id,
+ *  the result of its own reader is returned
+ */
 static int
-ooCodeSystem_add_new_code(struct ooCodeSystem *self, 
-			  xmlNode *cur_node)
+ooCodeSystem_read_code(struct ooCodeSystem *self, 
+		       xmlNode *cur_node,
+		       const char *name,
+		       struct ooCode **result)
 {
-    struct ooCode *code, *denot_code;
+    struct ooCode *code;
+    struct ooStrPool *pool = self->mindmap->names;
     char *value;
-    size_t nameset_size;
-    char **names;
     int verif_level = 0;
     int ret;
 
-    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
-    if (!value) {
-	fprintf(stderr, "  -- No name given for the code %d"
-		" in the element \"%s\"...\n",
-		self->num_codes, cur_node->name);
-	return oo_FAIL;
-    }
-
-    /* check for doublets */
-    code = (struct ooCode*)self->codes->get(self->codes, value);
-    if (code) {
-	if (DEBUG_CS_LEVEL_1)
-	    fprintf(stderr, "  -- Ignoring the doublet of \"%s\"...\n", value);
-	xmlFree(value);
-	return oo_FAIL;
-    }
-
     /* create a new code instance */
-    ret = ooCode_new(&code);
-    if (ret != oo_OK) {
-	xmlFree(value);
-	return ret;
-    }
+    ret = ooCode_new(&code, self->region);
+    if (ret != oo_OK) return ret;
+
     code->id = self->num_codes;
     code->cs = self;
-    code->name = malloc(strlen(value) + 1);
+    code->name = pool->intern(pool, name);
     if (!code->name) {
-	xmlFree(value);
+	code->del(code);
 	return oo_NOMEM;
     }
 
-    strcpy(code->name, value);
-    xmlFree(value);
-
     /* code type? */
     value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"type");
     if (value) {
@@ -571,27 +599,22 @@ ooCodeSystem_add_new_code(struct ooCodeSystem *self,
     /* add a single denot name */
     value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"denot");
     if (value) {
-	code->denot_names = malloc(sizeof(char*));
-	if (!code->denot_names) {
-	    xmlFree(value);
-	    return oo_NOMEM;
-	}
-	code->denots = malloc(sizeof(struct ooCode*));
-	if (!code->denots) {
-	    free(code->denot_names);
+	/* more denots may follow in the code description */
+	code->denot_names = self->region->realloc(self->region, NULL,
+						  sizeof(char*));
+	code->denots = self->region->realloc(self->region, NULL,
+					     sizeof(struct ooCode*));
+	if (!code->denot_names || !code->denots) {
 	    xmlFree(value);
 	    return oo_NOMEM;
 	}
 
-	code->denot_names[0] = malloc(strlen(value) + 1);
+	code->denot_names[0] = pool->intern(pool, value);
 	if (!code->denot_names[0]) {
-	    free(code->denot_names);
-	    free(code->denots);
 	    xmlFree(value);
 	    return oo_NOMEM;
 	}
 
-	strcpy(code->denot_names[0], value);
 	code->denots[0] = NULL;
 	code->num_denots = 1;
 	xmlFree(value);
@@ -600,6 +623,18 @@ ooCodeSystem_add_new_code(struct ooCodeSystem *self,
     /* read XML-description of the code */
     ret = code->read(code, cur_node->children);
 
+    *result = code;
+    return ret;
+}
+
+/*  the code read last takes its id in the CodeSystem */
+static int
+ooCodeSystem_register_code(struct ooCodeSystem *self, 
+			   struct ooCode *code)
+{
+    const char **names;
+    int ret;
+
     /* register code's name */
     names = realloc(self->code_names, 
 		    sizeof(char*) * (self->num_codes + 1));
@@ -629,8 +664,9 @@ ooCodeSystem_add_new_code(struct ooCodeSystem *self,
     }
 
 
-    /* NB */
-    fprintf(stderr, "Reading XML entry: %d...\r", self->num_codes);
+    if (OO_TRACE_ON(OO_TRACE_LOAD))
+	oo_trace_msg(OO_TRACE_LOAD, "\"%s\": code %zu \"%s\" read",
+		     self->name, self->num_codes, code->name);
 
     /*  update index */
     self->code_index[code->id] = code;
@@ -643,19 +679,177 @@ ooCodeSystem_add_new_code(struct ooCodeSystem *self,
     return oo_OK;
 }
 
+/* reading XML description of a new code */
+static int
+ooCodeSystem_add_new_code(struct ooCodeSystem *self, 
+			  xmlNode *cur_node)
+{
+    struct ooCode *code = NULL;
+    char *value;
+    int ret;
+
+    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"name");
+    if (!value) {
+	fprintf(stderr, "  -- No name given for the code %d"
+		" in the element \"%s\"...\n",
+		self->num_codes, cur_node->name);
+	return oo_FAIL;
+    }
+
+    /* check for doublets */
+    code = (struct ooCode*)self->codes->get(self->codes, value);
+    if (code) {
+	if (DEBUG_CS_LEVEL_1)
+	    fprintf(stderr, "  -- Ignoring the doublet of \"%s\"...\n", value);
+	xmlFree(value);
+	return oo_FAIL;
+    }
+
+    ret = ooCodeSystem_read_code(self, cur_node, value, &code);
+    xmlFree(value);
+    if (!code) return ret;
+
+    return ooCodeSystem_register_code(self, code);
+}
+
+
+/*  make room for one more code in the index */
+static int
+ooCodeSystem_reserve_code(struct ooCodeSystem *self)
+{
+    struct ooCode **index;
+    size_t capacity;
+
+    if (!self->code_index) {
+	self->code_index = malloc(sizeof(struct ooCode*) * 
+				  (DEFAULT_INDEX_SIZE + 1));
+	if (!self->code_index) return oo_NOMEM;
+	self->code_index_capacity = DEFAULT_INDEX_SIZE;
+
+	/* 0 slot has a special meaning of an unrecognized value */
+	self->code_index[0] = NULL;
+	self->num_codes = 1;
+	return oo_OK;
+    }
+
+    if (self->num_codes <= self->code_index_capacity) return oo_OK;
+
+    capacity = self->code_index_capacity * INDEX_REALLOC_FACTOR;
+    index = realloc(self->code_index,
+		    sizeof(struct ooCode*) * (capacity + 1));
+    if (!index) return oo_NOMEM;
+
+    self->code_index = index;
+    self->code_index_capacity = capacity;
+
+    return oo_OK;
+}
+
+/*  give back the unused tail of the code index */
+static int
+ooCodeSystem_trim_codes(struct ooCodeSystem *self)
+{
+    struct ooCode **index;
+
+    if (!self->code_index) return oo_OK;
+    if (self->num_codes > self->code_index_capacity) return oo_OK;
+
+    index = realloc(self->code_index,
+		    sizeof(struct ooCode*) * (self->num_codes + 1));
+    if (!index) return oo_OK;
+
+    self->code_index = index;
+    self->code_index_capacity = self->num_codes;
+
+    fprintf(stderr,"  == Total number of codes read: %zu\n\n",
+	    self->num_codes - 1);
+
+    return oo_OK;
+}
+
+static int
+ooCodeSystem_read_codeset_include(struct ooCodeSystem *self, 
+				  xmlNode *input_node,
+				  const char *parent_filename);
+
+/*  a single child of <codeset>: a code or an include */
+static int
+ooCodeSystem_read_codeset_item(struct ooCodeSystem *self, 
+			       xmlNode *cur_node,
+			       const char *filename)
+{
+    int ret;
+
+    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"include")))
+	return ooCodeSystem_read_codeset_include(self, cur_node, filename);
+
+    if (xmlStrcmp(cur_node->name, (const xmlChar *)"code")) 
+	return oo_OK;
+
+    ret = ooCodeSystem_reserve_code(self);
+    if (ret != oo_OK) return ret;
+
+    /* read the new code and register it in the index */
+    return ooCodeSystem_add_new_code(self, cur_node);
+}
+
+/**
+ *  read the children of a <codeset> element
+ *  one at a time: only the current code is expanded
+ *  into a tree and the reader frees it on moving on,
+ *  so the memory does not depend on the file size
+ */
+static int
+ooCodeSystem_stream_codeset(struct ooCodeSystem *self, 
+			    xmlTextReaderPtr reader,
+			    const char *filename)
+{
+    xmlNodePtr cur_node;
+    int depth;
+    int ret;
+
+    if (xmlTextReaderIsEmptyElement(reader)) return oo_OK;
+
+    depth = xmlTextReaderDepth(reader);
+
+    ret = xmlTextReaderRead(reader);
+    while (ret == 1) {
+	if (xmlTextReaderDepth(reader) <= depth) break;
+
+	if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+	    ret = xmlTextReaderRead(reader);
+	    continue;
+	}
+
+	cur_node = xmlTextReaderExpand(reader);
+	if (!cur_node) return oo_FAIL;
+
+	ret = ooCodeSystem_read_codeset_item(self, cur_node, filename);
+	if (ret == oo_NOMEM) return ret;
+
+	/* skip the subtree */
+	ret = xmlTextReaderNext(reader);
+    }
+
+    if (ret < 0) {
+	fprintf(stderr,"  -- Document \"%s\" not parsed successfully :( \n",
+		filename);
+	return oo_FAIL;
+    }
+
+    return oo_OK;
+}
 
 static int
 ooCodeSystem_read_codeset_include(struct ooCodeSystem *self, 
 				  xmlNode *input_node,
-				  const char *parent_filename,
-				  bool need_parsing)
+				  const char *parent_filename)
 {
     const char *path;
     char *value;
     char *filename;
 
-    xmlDocPtr doc;
-    xmlNodePtr root, cur_node;
+    xmlTextReaderPtr reader;
     size_t chunk_size = 0, path_size = 0, filename_size;
     int errcode = 0;
     int ret;
@@ -690,23 +884,26 @@ ooCodeSystem_read_codeset_include(struct ooCodeSystem *self,
     filename[path_size + filename_size] ='\0';
     xmlFree(value);
 
-    doc = xmlParseFile(filename);
-    if (!doc) {
+    reader = xmlReaderForFile(filename, NULL, 0);
+    if (!reader) {
 	fprintf(stderr,"  -- Document \"%s\" not parsed successfully :( \n",
 	    filename);
 	errcode = -1;
 	goto final;
     }
 
-    root = xmlDocGetRootElement(doc);
-    if (!root) {
+    /* find the root element */
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+	if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) break;
+    }
+
+    if (ret != 1) {
 	fprintf(stderr,"  -- Empty document: \"%s\"\n", filename);
-	xmlFreeDoc(doc);
 	errcode = -2;
 	goto final;
     }
 
-    if (xmlStrcmp(root->name, (const xmlChar *) "codeset")) {
+    if (xmlStrcmp(xmlTextReaderConstName(reader), (const xmlChar *) "codeset")) {
 	fprintf(stderr,"  -- Document \"%s\" is of the wrong type,"
 		" the root node is not \"codeset\"",
 		filename);
@@ -717,33 +914,11 @@ ooCodeSystem_read_codeset_include(struct ooCodeSystem *self,
     if (DEBUG_CS_LEVEL_2)
 	fprintf(stderr,"  ... codeset include: \"%s\"\n", filename);
 
-    for (cur_node = root->children; cur_node; cur_node = cur_node->next) {
-        if (cur_node->type != XML_ELEMENT_NODE) continue;
-
-	/* read the include file */
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"include"))) {
-	    ret = ooCodeSystem_read_codeset_include(self,
-						    cur_node, 
-						    filename,
-						    need_parsing);
-	    continue;
-	}
-
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"code"))) {
-	    if (!need_parsing) { 
-		self->code_index_capacity++;
-		continue;
-	    }
-	    /* read the new code and regiser it in the index */
-	    ret = ooCodeSystem_add_new_code(self, cur_node);
-	}
-    }
-
-    errcode = oo_OK;
+    errcode = ooCodeSystem_stream_codeset(self, reader, filename);
 
 final: 
-    xmlFreeDoc(doc);
-    xmlCleanupParser();
+    if (reader)
+	xmlFreeTextReader(reader);
     free(filename);
 
     return errcode;
@@ -755,62 +930,19 @@ ooCodeSystem_read_codeset(struct ooCodeSystem *self,
 			  xmlNode *input_node)
 {
     xmlNode *cur_node = NULL;
-    char *value, *name;
-    size_t code_value, denot_id;
     int ret;
 
     if (DEBUG_CS_LEVEL_1)
 	printf("  Reading Codes in Codeset \"%s\"... (%s)\n", 
 	       self->name, self->filename);
 
-
-    /* calculate the expected total number of codes in CS */
-    for (cur_node = input_node; cur_node; cur_node = cur_node->next) {
-	if (cur_node->type != XML_ELEMENT_NODE) continue;
-
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"include"))) {
-	    ret = ooCodeSystem_read_codeset_include(self,
-						    cur_node, 
-						    self->filename, false);
-	    continue;
-	}
-
-	self->code_index_capacity++;
-    }
-
-    if (!self->code_index_capacity) return oo_FAIL;
-
-    fprintf(stderr,"  == Total number of codes to read: %d\n\n",
-	self->code_index_capacity);
-    
-    self->code_index = malloc(sizeof(struct ooCode*) * 
-			      (self->code_index_capacity + 1));
-    if (!self->code_index) return oo_NOMEM;
-
-    /* 0 slot has a special meaning of an unrecognized value */
-    self->code_index[0] = NULL;
-    self->num_codes = 1;
-
-    /* start reading the actual code descriptions */
     for (cur_node = input_node; cur_node; cur_node = cur_node->next) {
 	if (cur_node->type != XML_ELEMENT_NODE) continue;
 
-	/* index capacity exceeded for some reason? */
-	if (self->num_codes > self->code_index_capacity) return oo_FAIL;
-
-	/* read the include file */
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"include"))) {
-	    ret = ooCodeSystem_read_codeset_include(self,
-						    cur_node, 
-						    self->filename, true);
-	    continue;
-	}
-
-	/* read the new code and register it in the index */
-	ret = ooCodeSystem_add_new_code(self, cur_node);
+	ret = ooCodeSystem_read_codeset_item(self, cur_node, self->filename);
+	if (ret == oo_NOMEM) return ret;
     }
 
-
     if (DEBUG_CS_LEVEL_3) 
 	printf("\n-- Read %zu codes from Codeset %s...\n",
 	       self->num_codes, self->name);
@@ -934,17 +1066,12 @@ final:
 }
 
 
+/*  the attributes of <codesystem> */
 static int
-ooCodeSystem_read_XML(struct ooCodeSystem *self, xmlNode *input_node)
+ooCodeSystem_read_attrs(struct ooCodeSystem *self, xmlNode *input_node)
 {
-    xmlNode *cur_node = NULL;
-    xmlAttr *cur_attr = NULL;
     char *value = NULL;
     size_t i;
-    int ret;
-
-    if (DEBUG_CS_LEVEL_3)
-	printf("  ** Reading XML-representation of the Coding System...\n");
 
     value = (char*)xmlGetProp(input_node,  (const xmlChar *)"name");
     if (!value) return oo_FAIL;
@@ -1006,42 +1133,613 @@ ooCodeSystem_read_XML(struct ooCodeSystem *self, xmlNode *input_node)
 	xmlFree(value);
     }
 
+    return oo_OK;
+}
+
+/*  a child element of <codesystem> */
+static int
+ooCodeSystem_read_child(struct ooCodeSystem *self, xmlNode *cur_node)
+{
+    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codestruct")))
+	return ooCodeSystem_read_codestruct(self, cur_node);
+
+    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codeset")))
+	return ooCodeSystem_read_codeset(self, cur_node->children);
+
+    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"initcache")))
+	return ooCodeSystem_read_initcache(self, cur_node);
+
+    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"constraints")))
+	return ooCodeSystem_read_constraint_types(self, cur_node->children);
+
+    return oo_OK;
+}
+
+static int
+ooCodeSystem_read_XML(struct ooCodeSystem *self, xmlNode *input_node)
+{
+    xmlNode *cur_node = NULL;
+    int ret;
+
+    if (DEBUG_CS_LEVEL_3)
+	printf("  ** Reading XML-representation of the Coding System...\n");
+
+    ret = ooCodeSystem_read_attrs(self, input_node);
+    if (ret != oo_OK) return ret;
 
     /* read the children */
     for (cur_node = input_node->children; cur_node; cur_node = cur_node->next) {
         if (cur_node->type != XML_ELEMENT_NODE) continue;
 
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codestruct"))) {
-	    ret = ooCodeSystem_read_codestruct(self, cur_node);
+	ret = ooCodeSystem_read_child(self, cur_node);
+    }
+
+    /* now that all local ids are assigned
+     * use these for setting up back references */
+    /*ret = self->resolve_refs(self); */
+
+    return ooCodeSystem_trim_codes(self);
+}
+
+/**
+ *  the codes of <codeset> are streamed one by one,
+ *  any other child is expanded into a tree 
+ *  and passed to the same readers as in read_XML
+ */
+static int
+ooCodeSystem_read_stream(struct ooCodeSystem *self, xmlTextReaderPtr reader)
+{
+    xmlNodePtr cur_node;
+    int depth;
+    int ret;
+
+    if (DEBUG_CS_LEVEL_3)
+	printf("  ** Streaming XML-representation of the Coding System...\n");
+
+    cur_node = xmlTextReaderCurrentNode(reader);
+    if (!cur_node) return oo_FAIL;
+
+    ret = ooCodeSystem_read_attrs(self, cur_node);
+    if (ret != oo_OK) return ret;
+
+    if (xmlTextReaderIsEmptyElement(reader)) return oo_OK;
+
+    depth = xmlTextReaderDepth(reader);
+
+    ret = xmlTextReaderRead(reader);
+    while (ret == 1) {
+	if (xmlTextReaderDepth(reader) <= depth) break;
+
+	if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+	    ret = xmlTextReaderRead(reader);
 	    continue;
 	}
 
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codeset"))) {
-	    ret = ooCodeSystem_read_codeset(self, cur_node->children);
+	if (!xmlStrcmp(xmlTextReaderConstName(reader), (const xmlChar *)"codeset")) {
+	    if (DEBUG_CS_LEVEL_1)
+		printf("  Reading Codes in Codeset \"%s\"... (%s)\n", 
+		       self->name, self->filename);
+
+	    ret = ooCodeSystem_stream_codeset(self, reader, self->filename);
+	    if (ret == oo_NOMEM) return ret;
+	    ret = xmlTextReaderNext(reader);
 	    continue;
 	}
 
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"initcache"))) {
-	    ret = ooCodeSystem_read_initcache(self, cur_node);
-	    continue;
+	cur_node = xmlTextReaderExpand(reader);
+	if (!cur_node) return oo_FAIL;
+
+	ret = ooCodeSystem_read_child(self, cur_node);
+	if (ret == oo_NOMEM) return ret;
+
+	ret = xmlTextReaderNext(reader);
+    }
+
+    if (ret < 0) return oo_FAIL;
+
+    return ooCodeSystem_trim_codes(self);
+}
+
+
+/*  the code refers to the name */
+static int
+ooCodeSystem_add_name_ref(struct ooCodeSystem *self,
+			  const char *name,
+			  struct ooCode *code)
+{
+    struct ooCodeRefs *refs;
+    struct ooCode **codes;
+    size_t i;
+    int ret;
+
+    if (!name) return oo_OK;
+
+    refs = (struct ooCodeRefs*)self->name_refs->get_interned(self->name_refs, name);
+    if (!refs) {
+	refs = self->region->alloc(self->region, sizeof(struct ooCodeRefs));
+	if (!refs) return oo_NOMEM;
+
+	ret = self->name_refs->set(self->name_refs, name, refs);
+	if (ret == oo_NOMEM) return ret;
+    }
+
+    /* a code is listed once per name */
+    for (i = 0; i < refs->num_codes; i++)
+	if (refs->codes[i] == code) return oo_OK;
+
+    codes = self->region->realloc(self->region, refs->codes,
+				  sizeof(struct ooCode*) * (refs->num_codes + 1));
+    if (!codes) return oo_NOMEM;
+
+    codes[refs->num_codes] = code;
+    refs->codes = codes;
+    refs->num_codes++;
+
+    return oo_OK;
+}
+
+/*  every name a single code refers to */
+static int
+ooCodeSystem_index_code_refs(struct ooCodeSystem *self,
+			     struct ooCode *code)
+{
+    struct ooCodeSpec *spec;
+    struct ooCodeDeriv *deriv;
+    struct ooCodeUnit *unit;
+    size_t i;
+    int operid, ret;
+
+    ret = ooCodeSystem_add_name_ref(self, code->baseclass_name, code);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; i < code->num_implied_codes; i++) {
+	ret = ooCodeSystem_add_name_ref(self, code->implied_code_names[i], code);
+	if (ret != oo_OK) return ret;
+    }
+
+    /* denotations name the codes of the CS this one provides for */
+    for (i = 0; i < code->num_denots; i++) {
+	ret = ooCodeSystem_add_name_ref(self, code->denot_names[i], code);
+	if (ret != oo_OK) return ret;
+    }
+
+    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	for (deriv = code->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	    ret = ooCodeSystem_add_name_ref(self, deriv->name, code);
+	    if (ret != oo_OK) return ret;
+	    ret = ooCodeSystem_add_name_ref(self, deriv->arg_code_name, code);
+	    if (ret != oo_OK) return ret;
 	}
 
-	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"constraints"))) {
-	    ret = ooCodeSystem_read_constraint_types(self, cur_node->children);
-	    continue;
+	for (spec = code->children[operid]; spec; spec = spec->next) {
+	    ret = ooCodeSystem_add_name_ref(self, spec->code_name, code);
+	    if (ret != oo_OK) return ret;
 	}
+    }
 
+    for (unit = code->shared; unit; unit = unit->specs[0]->unit) {
+	ret = ooCodeSystem_add_name_ref(self, unit->code->name, code);
+	if (ret != oo_OK) return ret;
+	if (!unit->num_specs) break;
+    }
 
+    return oo_OK;
+}
 
+/**
+ *  the codes referring to a name:
+ *  the index is built on the first incremental update,
+ *  the initial load does not need it
+ */
+static struct ooCodeRefs*
+ooCodeSystem_name_refs(struct ooCodeSystem *self,
+		       const char *name,
+		       int *error)
+{
+    struct ooCode *code;
+    size_t i;
+    int ret;
+
+    *error = oo_OK;
+
+    if (!self->name_refs) {
+	ret = ooDict_new(&self->name_refs);
+	if (ret != oo_OK) {
+	    self->name_refs = NULL;
+	    *error = ret;
+	    return NULL;
+	}
+	self->name_refs->set_pool(self->name_refs, self->mindmap->names);
+
+	for (i = 1; i < self->num_codes; i++) {
+	    code = self->code_index[i];
+	    if (!code) continue;
+
+	    ret = ooCodeSystem_index_code_refs(self, code);
+	    if (ret != oo_OK) {
+		/* a partial index is never used */
+		self->name_refs->del(self->name_refs);
+		self->name_refs = NULL;
+		*error = ret;
+		return NULL;
+	    }
+	}
     }
 
-    /* now that all local ids are assigned
-     * use these for setting up back references */
-    /*ret = self->resolve_refs(self); */
+    return (struct ooCodeRefs*)self->name_refs->get_interned(self->name_refs, name);
+}
+
+/**
+ *  rebuild the linking tables of a code
+ *  and of all its subclasses
+ */
+static int
+ooCodeSystem_relink(struct ooCodeSystem *self,
+		    struct ooCode *code,
+		    size_t depth)
+{
+    struct ooCodeSpec *spec;
+    int ret;
+
+    if (code->is_removed) return oo_OK;
+
+    ret = code->build_links(code);
+    if (ret != oo_OK) return ret;
+
+    if (depth == MAX_INHERIT_DEPTH) return oo_OK;
+
+    for (spec = code->parents[OO_IS_SUBCLASS]; spec; spec = spec->next) {
+	if (!spec->code || spec->code == code) continue;
+	ret = ooCodeSystem_relink(self, spec->code, depth + 1);
+	if (ret != oo_OK) return ret;
+    }
+
+    return oo_OK;
+}
+
+/**
+ *  point the codes of the providers 
+ *  that denote the given name once more
+ */
+static int
+ooCodeSystem_recoordinate(struct ooCodeSystem *self,
+			  const char *name)
+{
+    struct ooCodeSystem *provider;
+    struct ooCodeRefs *refs;
+    struct ooCode *code;
+    bool is_denoted;
+    size_t i, j;
+    int k, ret;
+
+    if (!self->providers) return oo_OK;
+
+    for (k = 0; k < self->num_providers; k++) {
+	provider = self->providers[k];
+
+	refs = ooCodeSystem_name_refs(provider, name, &ret);
+	if (ret != oo_OK) return ret;
+	if (!refs) continue;
+
+	for (i = 0; i < refs->num_codes; i++) {
+	    code = refs->codes[i];
+	    if (code->is_removed) continue;
+
+	    is_denoted = false;
+	    for (j = 0; j < code->num_denots; j++) {
+		if (code->denot_names[j] != name) continue;
+		if (!provider->use_numeric_codes) code->denots[j] = NULL;
+		is_denoted = true;
+	    }
+	    if (!is_denoted) continue;
+
+	    ret = ooCodeSystem_coordinate_code(self, provider, code);
+	    if (ret != oo_OK) return ret;
+	}
+    }
 
     return oo_OK;
 }
 
+/**
+ *  the caches splitting their sequences by this CS
+ *  take its new code into their matrix
+ */
+static int
+ooCodeSystem_extend_dependent_caches(struct ooCodeSystem *self)
+{
+    struct ooMindMap *mindmap = self->mindmap;
+    struct ooCodeSystem *cs;
+    int i, ret;
+
+    for (i = 0; i < mindmap->num_codesystems; i++) {
+	cs = mindmap->codesystems[i];
+	if (!cs || !cs->cache) continue;
+	if (cs->cache->provider != self) continue;
+
+	ret = cs->cache->extend(cs->cache);
+	if (ret == oo_NOMEM) return ret;
+    }
+
+    return oo_OK;
+}
+
+/**
+ *  a code registered in a CodeSystem in use:
+ *  only the references to and from this code
+ *  are resolved, the caches get its sequences
+ */
+static int
+ooCodeSystem_link_code(struct ooCodeSystem *self, 
+		       struct ooCode *code)
+{
+    struct ooMindMap *mindmap = self->mindmap;
+    struct ooCodeSystem *cs;
+    struct ooCodeSpec *spec;
+    struct ooCodeRefs *refs;
+    struct ooCode *other;
+    bool relink;
+    size_t i;
+    int j, operid, ret;
+
+    ret = code->resolve_refs(code);
+    if (ret != oo_OK) return ret;
+
+    /* references pending on the name of the code */
+    refs = ooCodeSystem_name_refs(self, code->name, &ret);
+    if (ret != oo_OK) return ret;
+
+    /* the names the new code refers to */
+    ret = ooCodeSystem_index_code_refs(self, code);
+    if (ret != oo_OK) return ret;
+
+    for (i = 0; refs && i < refs->num_codes; i++) {
+	other = refs->codes[i];
+	if (other == code || other->is_removed) continue;
+
+	ret = other->resolve_ref(other, code, &relink);
+	if (ret != oo_OK) return ret;
+
+	if (!relink) continue;
+	ret = ooCodeSystem_relink(self, other, 0);
+	if (ret != oo_OK) return ret;
+    }
+
+    /* the children have got a new parent */
+    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	for (spec = code->children[operid]; spec; spec = spec->next) {
+	    if (!spec->code) continue;
+	    ret = ooCodeSystem_relink(self, spec->code, 0);
+	    if (ret != oo_OK) return ret;
+	}
+    }
+
+    ret = ooCodeSystem_relink(self, code, 0);
+    if (ret != oo_OK) return ret;
+
+    ret = code->build_template(code);
+    if (ret != oo_OK) return ret;
+
+    /* denotations of the new code */
+    for (j = 0; j < mindmap->num_codesystems; j++) {
+	cs = mindmap->codesystems[j];
+	if (!cs || !cs->providers) continue;
+
+	for (i = 0; i < cs->num_providers; i++) {
+	    if (cs->providers[i] != self) continue;
+	    ret = ooCodeSystem_coordinate_code(cs, self, code);
+	    if (ret != oo_OK) return ret;
+	}
+    }
+
+    /* provider codes denoting the new code */
+    ret = ooCodeSystem_recoordinate(self, code->name);
+    if (ret != oo_OK) return ret;
+
+    if (code->is_cached && self->cache) {
+	ret = self->cache->insert(self->cache, code);
+	if (ret != oo_OK) return ret;
+    }
+
+    return ooCodeSystem_extend_dependent_caches(self);
+}
+
+/*  add a single <code> to a CodeSystem in use */
+static int
+ooCodeSystem_add_code(struct ooCodeSystem *self, 
+		      xmlNode *input_node)
+{
+    struct ooCode *code;
+    int ret;
+
+    ret = ooCodeSystem_reserve_code(self);
+    if (ret != oo_OK) return ret;
+
+    ret = ooCodeSystem_add_new_code(self, input_node);
+    if (ret != oo_OK) return ret;
+
+    code = self->code_index[self->num_codes - 1];
+
+    ret = ooCodeSystem_link_code(self, code);
+    if (ret != oo_OK) return ret;
+
+    if (OO_TRACE_ON(OO_TRACE_LOAD))
+	oo_trace_msg(OO_TRACE_LOAD, "\"%s\": code %zu \"%s\" added",
+		     self->name, code->id, code->name);
+
+    return oo_OK;
+}
+
+/*  drop the references of a single code to a removed one */
+static int
+ooCodeSystem_unlink_ref(struct ooCodeSystem *self,
+			struct ooCode *code,
+			struct ooCode *ref)
+{
+    bool relink;
+    int ret;
+
+    ret = code->unresolve_ref(code, ref, &relink);
+    if (ret != oo_OK) return ret;
+
+    if (!relink) return oo_OK;
+    return ooCodeSystem_relink(self, code, 0);
+}
+
+/**
+ *  take a code out of a CodeSystem in use:
+ *  the code object stays in the region 
+ *  and its id is never given to another code
+ */
+static int
+ooCodeSystem_remove_code(struct ooCodeSystem *self, 
+			 const char *name)
+{
+    struct ooCode *code, *other;
+    struct ooCodeRefs *refs;
+    struct ooCodeSpec *spec;
+    size_t code_value, i;
+    int operid, ret;
+
+    code = (struct ooCode*)self->codes->get(self->codes, name);
+    if (!code) return oo_FAIL;
+
+    refs = ooCodeSystem_name_refs(self, code->name, &ret);
+    if (ret != oo_OK) return ret;
+
+    if (code->is_cached && self->cache) {
+	ret = self->cache->remove(self->cache, code);
+	if (ret != oo_OK) return ret;
+    }
+
+    self->codes->remove(self->codes, code->name);
+    code->is_removed = true;
+
+    if (self->root_elem_id == code->id)
+	self->root_elem_id = 0;
+
+    /* codes naming the removed one */
+    for (i = 0; refs && i < refs->num_codes; i++) {
+	other = refs->codes[i];
+	if (other->is_removed) continue;
+
+	ret = ooCodeSystem_unlink_ref(self, other, code);
+	if (ret != oo_OK) return ret;
+    }
+
+    /* its children keep a back reference to it */
+    for (operid = 0; operid < OO_NUM_OPERS; operid++) {
+	for (spec = code->children[operid]; spec; spec = spec->next) {
+	    if (!spec->code || spec->code->is_removed) continue;
+
+	    ret = ooCodeSystem_unlink_ref(self, spec->code, code);
+	    if (ret != oo_OK) return ret;
+	}
+    }
+
+    if (self->use_numeric_codes && self->numeric_denotmap) {
+	code_value = strtoul(code->name, NULL, 16);
+	if (code_value <= UCS2_MAX)
+	    self->numeric_denotmap[code_value] = 0;
+    }
+
+    /* provider codes denoting the removed code */
+    ret = ooCodeSystem_recoordinate(self, code->name);
+    if (ret != oo_OK) return ret;
+
+    /* the dependent caches keep their layout: the id of
+     * the removed code is not reused and no input is split
+     * by it any more, so its cells are just never reached */
+
+    if (OO_TRACE_ON(OO_TRACE_LOAD))
+	oo_trace_msg(OO_TRACE_LOAD, "\"%s\": code %zu \"%s\" removed",
+		     self->name, code->id, code->name);
+
+    return oo_OK;
+}
+
+/**
+ *  bring back a removed code after its replacement
+ *  has failed: the back references it got from
+ *  the other codes are set once more by linking
+ */
+static int
+ooCodeSystem_restore_code(struct ooCodeSystem *self, 
+			  struct ooCode *code)
+{
+    int operid, ret;
+
+    code->is_removed = false;
+
+    for (operid = 0; operid < OO_NUM_OPERS; operid++)
+	code->parents[operid] = NULL;
+    code->num_parents = 0;
+
+    ret = self->codes->set(self->codes, code->name, code);
+    if (ret != oo_OK) return ret;
+
+    if (code->is_cached && self->cache)
+	self->cache->set(self->cache, code);
+
+    if (self->root_elem_name && !strcmp(code->name, self->root_elem_name))
+	self->root_elem_id = code->id;
+
+    return ooCodeSystem_link_code(self, code);
+}
+
+/**
+ *  a new version of a code takes the place of the old one:
+ *  the new code is read before the old one is taken out,
+ *  and the old one is brought back if the new one cannot be linked
+ */
+static int
+ooCodeSystem_replace_code(struct ooCodeSystem *self, 
+			  xmlNode *input_node)
+{
+    struct ooCode *old_code, *code = NULL;
+    char *value;
+    int ret;
+
+    value = (char*)xmlGetProp(input_node,  (const xmlChar *)"name");
+    if (!value) return oo_FAIL;
+
+    old_code = (struct ooCode*)self->codes->get(self->codes, value);
+    if (!old_code) {
+	xmlFree(value);
+	return ooCodeSystem_add_code(self, input_node);
+    }
+
+    ret = ooCodeSystem_reserve_code(self);
+    if (ret == oo_OK)
+	ret = ooCodeSystem_read_code(self, input_node, value, &code);
+    xmlFree(value);
+    if (ret != oo_OK) return ret;
+
+    ret = ooCodeSystem_remove_code(self, old_code->name);
+    if (ret != oo_OK) goto restore;
+
+    ret = ooCodeSystem_register_code(self, code);
+    if (ret != oo_OK) goto restore;
+
+    ret = ooCodeSystem_link_code(self, code);
+    if (ret != oo_OK) {
+	ooCodeSystem_remove_code(self, code->name);
+	goto restore;
+    }
+
+    if (OO_TRACE_ON(OO_TRACE_LOAD))
+	oo_trace_msg(OO_TRACE_LOAD, "\"%s\": code %zu \"%s\" replaced",
+		     self->name, code->id, code->name);
+
+    return oo_OK;
+
+restore:
+    if (old_code->is_removed)
+	ooCodeSystem_restore_code(self, old_code);
+
+    return ret;
+}
+
 
 /*  find solutions */
 static
@@ -1083,6 +1781,8 @@ int ooCodeSystem_new(struct ooCodeSystem **cs)
     self->use_visual_separators = true;
 
     self->filename = NULL;
+    self->mindmap = NULL;
+    self->region = NULL;
 
     self->provider_names = NULL;
     self->providers = NULL;
@@ -1113,6 +1813,8 @@ int ooCodeSystem_new(struct ooCodeSystem **cs)
     self->code_index_capacity = 0;
     self->num_codes = 0;
 
+    self->name_refs = NULL;
+
     self->use_numeric_codes = false;
     self->numeric_denotmap = NULL;
 
@@ -1121,13 +1823,19 @@ int ooCodeSystem_new(struct ooCodeSystem **cs)
     self->constraints = NULL;
     self->num_constraints = 0;
 
+    ooStats_reset(&self->stats);
+
     /* bind your methods */
     self->del = ooCodeSystem_del;
     self->read = ooCodeSystem_read_XML;
+    self->read_stream = ooCodeSystem_read_stream;
     self->lookup = ooCodeSystem_lookup;
     self->coordinate_codesets = ooCodeSystem_coordinate_codesets;
     self->build_cache = ooCodeSystem_build_cache;
     self->resolve_refs = ooCodeSystem_resolve_refs;
+    self->add_code = ooCodeSystem_add_code;
+    self->replace_code = ooCodeSystem_replace_code;
+    self->remove_code = ooCodeSystem_remove_code;
 
     *cs = self;
     return oo_OK;
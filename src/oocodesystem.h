@@ -22,11 +22,14 @@
 #define OO_CODESYSTEM_H
 
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "ooconcept.h"
 #include "oodict.h"
+#include "oostats.h"
 
 struct ooMindMap;
+struct ooRegion;
 
 typedef enum codesystem_t { CS_DENOTATIONAL, 
 			    CS_OPERATIONAL, 
@@ -44,6 +47,12 @@ typedef struct ooConstraintType {
     size_t num_values;
 } ooConstraintType;
 
+/* codes of a CodeSystem referring to a single name */
+typedef struct ooCodeRefs {
+    struct ooCode **codes;
+    size_t num_codes;
+} ooCodeRefs;
+
 typedef struct ooCodeSystem {
 
     codesystem_t type;
@@ -66,6 +75,9 @@ typedef struct ooCodeSystem {
     /* main storage */
     struct ooMindMap *mindmap;
 
+    /* region of the MindMap holding the codes and the cache tails */
+    struct ooRegion *region;
+
     /* name of the XML source file */
     const char *filename;
 
@@ -84,7 +96,12 @@ typedef struct ooCodeSystem {
 
     /* concept storage by name */
     struct ooDict *codes;
-    char **code_names;
+    const char **code_names;
+
+    /* reverse references: the codes naming a given code
+     * as their baseclass, child, derivation, denotation etc.,
+     * built on the first incremental update */
+    struct ooDict *name_refs;
 
     /* in-memory main index of codes
      * key:   code id
@@ -107,9 +124,17 @@ typedef struct ooCodeSystem {
     struct ooConstraintType **constraints;
     size_t num_constraints;
 
+    /* decoding statistics of all Decoders of this CodeSystem */
+    struct ooStats stats;
+
     /* read the XML data */
     int (*read)(struct ooCodeSystem *self, xmlNode *node);
 
+    /* read the XML data from a reader standing
+     * on the <codesystem> start tag,
+     * the codes are never held as a whole tree */
+    int (*read_stream)(struct ooCodeSystem *self, xmlTextReaderPtr reader);
+
     int (*del)(struct ooCodeSystem *self);
 
     /* find the denotations of a Concept */
@@ -123,6 +148,12 @@ typedef struct ooCodeSystem {
 
     int (*resolve_refs)(struct ooCodeSystem *self);
 
+    /* incremental updates of a CodeSystem in use,
+     * the caller must keep the decoders away */
+    int (*add_code)(struct ooCodeSystem *self, xmlNode *node);
+    int (*replace_code)(struct ooCodeSystem *self, xmlNode *node);
+    int (*remove_code)(struct ooCodeSystem *self, const char *name);
+
 } ooCodeSystem;
 
 extern int ooCodeSystem_new(struct ooCodeSystem **self); 
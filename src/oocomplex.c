@@ -285,7 +285,7 @@ ooComplex_present_JSON_table_row(struct ooComplex *self,
     size_t i, curr_max_levels = 0, child_num_levels = 0;
     size_t global_term_pos = accu->decoder->term_count;
 
-    char *gloss;
+    const char *gloss;
 
     char output[TEMP_BUF_SIZE];
     char *curr_out_buf = output;
@@ -387,8 +387,6 @@ ooComplex_present_JSON_table_row(struct ooComplex *self,
 					 depth - 1, row_count);
     }
 
-    printf("Ready!\n");
-
     return oo_OK;
 }
 
@@ -459,8 +457,6 @@ ooComplex_present_XML(struct ooComplex *self,
 
     char buf[TEMP_BUF_SIZE];
 
-    printf("XML presentation!\n");
-
     if (self->base->agenda) 
 	operids = self->base->agenda->codesystem->operids;
 
@@ -868,6 +864,31 @@ ooComplex_forget(struct ooComplex *self,
     return oo_OK;
 }
 
+/**
+ * bind the result to a matching derivation
+ */
+static void
+ooComplex_apply_deriv(struct ooComplex *result,
+		      struct ooCodeDeriv *deriv)
+{
+    struct ooInterp *interp;
+
+    if (DEBUG_COMPLEX_LEVEL_3)
+	deriv->str(deriv);
+
+    if (deriv->code)
+	result->base->code = deriv->code;
+
+    if (result->num_interps >= INTERP_POOL_SIZE) return;
+    if (!deriv->code_usage) return;
+    if (!deriv->code_usage->conc) return;
+
+    /* valid reference to specific usage */
+    interp = result->interps[result->num_interps];
+    interp->conc = deriv->code_usage->conc;
+    result->num_interps++;
+}
+
 /**
  * try to perform conceptual binding of usages
  */
@@ -878,8 +899,9 @@ ooComplex_discriminate_usage(struct ooComplex *self,
 			     struct ooComplex *result)
 {
     struct ooCodeDeriv *deriv;
-    struct ooInterp *interp;
-    int i;
+    struct ooCodeDerivRef *refs;
+    struct ooCode *child_code;
+    size_t num_refs, i;
 
     if (DEBUG_COMPLEX_LEVEL_2) {
 	printf("  ... Evaluating conceptual bindings between "
@@ -892,29 +914,29 @@ ooComplex_discriminate_usage(struct ooComplex *self,
     if (DEBUG_COMPLEX_LEVEL_2) 
 	printf("  ... Checking fixed bindings...\n");
 
-    /* derivation check */
-    deriv = child_complex->base->code->deriv_matches[operid];
+    /* derivation check: single index probe */
+    child_code = child_complex->base->code;
+    refs = child_code->lookup_derivs(child_code, operid, 
+				     self->base->code, &num_refs);
 
-    while (deriv) {
-	deriv->str(deriv);
+    for (i = 0; i < num_refs; i++) {
+	deriv = refs[i].deriv;
 
-	if (strcmp(deriv->arg_code_name, self->base->code->name)) 
-	    goto next_deriv;
+	/* ids are local to a code system */
+	if (deriv->arg_code != self->base->code) continue;
 
-	if (deriv->code)
-	    result->base->code = deriv->code;
+	ooComplex_apply_deriv(result, deriv);
+    }
 
-	if (result->num_interps < INTERP_POOL_SIZE) {
-	    interp = result->interps[result->num_interps];
-	    if (!deriv->code_usage) continue;
-	    if (!deriv->code_usage->conc) continue;
-	    /* valid reference to specific usage */
-	    interp->conc = deriv->code_usage->conc;
-	    result->num_interps++;
-	}
+    /* arg codes of other code systems are matched by name */
+    if (operid <= OO_NONE || operid >= OO_NUM_OPERS) return oo_OK;
+    if (!child_code->num_unresolved_derivs[operid]) return oo_OK;
+
+    for (deriv = child_code->deriv_matches[operid]; deriv; deriv = deriv->next) {
+	if (deriv->arg_code || !deriv->arg_code_name) continue;
+	if (strcmp(deriv->arg_code_name, self->base->code->name)) continue;
 
-    next_deriv:
-	deriv = deriv->next;
+	ooComplex_apply_deriv(result, deriv);
     }
 
 
@@ -935,6 +957,7 @@ ooComplex_join(struct ooComplex *self,
 {   
     struct ooComplex *complex;
     struct ooConcUnit *result;
+    struct ooAgenda *agenda;
 
     char **operids = NULL, *opername = "???";
     size_t i;
@@ -1005,6 +1028,25 @@ ooComplex_join(struct ooComplex *self,
     if (operid != OO_NEXT)
 	aggr_complex->weight += OPER_SUCCESS_BONUS;
 
+    /* work budget and beam search */
+    agenda = self->base->agenda;
+    if (agenda) {
+	ret = agenda->budget_admit(agenda, false);
+	if (ret == oo_OK)
+	    ret = agenda->beam_admit(agenda, self->base->code,
+				     aggr_complex->linear_begin,
+				     aggr_complex->linear_end,
+				     aggr_complex->weight);
+	if (ret != oo_OK) {
+	    aggr_complex->is_free = true;
+	    aggr_complex->is_updated = false;
+	    return oo_FAIL;
+	}
+	agenda->num_created_complexes++;
+	if (agenda->budget)
+	    agenda->budget->num_complexes++;
+    }
+
 
      /* TODO: evaluate the discourse propositions, establish conceptual paths */
 
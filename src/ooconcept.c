@@ -27,6 +27,7 @@
 #include "ooconfig.h"
 #include "oomindmap.h"
 #include "ooconcept.h"
+#include "ooconcstore.h"
 #include "oodomain.h"
 #include "ooutils.h"
 
@@ -72,16 +73,18 @@ ooConcept_del(ooConcept *self)
 static const char* 
 ooConcept_str(ooConcept *self)
 {
-    size_t i;
+    struct ooAttrIter iter;
+    struct ooAttrView view;
+    size_t i = 0;
+
     printf("Concept id: %s name: %s\n", 
            self->id, self->name);
 
-    for (i = 0; i < self->_num_attrs; i++) {
-	if (!self->_attrs[i])
-	    continue;
-	printf("%d\n", i);
+    self->attr_iter(self, &iter);
+    while (self->next_attr(self, &iter, &view) == oo_OK) {
+	printf("%zu\n", i++);
 	printf("  -- attr >>> [%lu]\n",
-	       (unsigned long)self->_attrs[i]->concid );
+	       (unsigned long)view.concid);
     }
 
     return "Concept presentation";
@@ -105,39 +108,18 @@ size_t ooConcept_calc_valid_attrs(ooConcept *self)
     return num_valid_attrs; 
 }
 
-/*  calculate the size of packed attr */
-static 
-size_t ooConcept_calc_attrsize(void)
-{
-    static ooAttr attr;
-    static size_t s;
-
-    s = sizeof(attr.operid);
-    s += sizeof(attr.concid);
-    s += sizeof(attr.relevance);
-
-    if (DEBUG_LEVEL_3) {
-	printf("Estimated attr size: %d\n", s);
-    }
-    return s;
-}
-
 
 /*  pack a single attribute into the bytecode */
 static
 int ooConcept_pack_attr(ooAttr *attr, char *buf)
 {
-    static size_t operid_size = sizeof(attr->operid);
-    static size_t concid_size = sizeof(attr->concid);
-    static size_t relevance_size = sizeof(attr->relevance);
-
-    memcpy(buf, &attr->operid, operid_size);
-    buf += operid_size;
+    memcpy(buf, &attr->operid, sizeof(attr->operid));
+    buf += sizeof(attr->operid);
 
-    memcpy(buf, &attr->concid, concid_size);
-    buf += concid_size;
+    memcpy(buf, &attr->concid, sizeof(attr->concid));
+    buf += sizeof(attr->concid);
 
-    memcpy(buf, &attr->relevance, relevance_size);
+    memcpy(buf, &attr->relevance, sizeof(attr->relevance));
 
     return oo_OK;
 }
@@ -147,8 +129,7 @@ int ooConcept_pack_attr(ooAttr *attr, char *buf)
 static
 int ooConcept_pack_attrs(ooConcept *self, 
 			      char *buf, 
-		    unsigned short  num_attrs,
-                            size_t  attr_size)
+		    unsigned short  num_attrs)
 {   int i, ret;
 
     /* saving the actual number of valid attrs */
@@ -161,7 +142,7 @@ int ooConcept_pack_attrs(ooConcept *self,
 	ret = ooConcept_pack_attr(self->_attrs[i], buf);
 	if (ret != oo_OK)
 	    continue;
-	buf += attr_size;
+	buf += OO_PACKED_ATTR_SIZE;
     }
     return oo_OK;
 }
@@ -169,16 +150,15 @@ int ooConcept_pack_attrs(ooConcept *self,
 static
 int ooConcept_pack_header(ooConcept *self, char *buf)
 { 
-    static size_t uchar_size = sizeof(unsigned char);
     unsigned char conc_type, name_size;
     conc_type =  (unsigned char)self->type;
-    memcpy(buf, &conc_type, uchar_size);
+    memcpy(buf, &conc_type, sizeof(unsigned char));
 
     name_size =  (unsigned char)self->name_size;
-    buf += uchar_size;
+    buf += sizeof(unsigned char);
 
-    memcpy(buf, &name_size, uchar_size);
-    buf += uchar_size;
+    memcpy(buf, &name_size, sizeof(unsigned char));
+    buf += sizeof(unsigned char);
 
     if (self->name_size)
 	memcpy(buf, self->name, self->name_size);
@@ -187,12 +167,97 @@ int ooConcept_pack_header(ooConcept *self, char *buf)
 }
 
 
+/* read a packed attribute in place */
+static void
+ooConcept_read_packed_attr(const char *buf,
+			   struct ooAttrView *view)
+{
+    memcpy(&view->operid, buf, sizeof(view->operid));
+    buf += sizeof(view->operid);
+
+    memcpy(&view->concid, buf, sizeof(view->concid));
+    buf += sizeof(view->concid);
+
+    memcpy(&view->relevance, buf, sizeof(view->relevance));
+}
+
+
+/* a packed attribute of either the bytecode or the Concept Store */
+static void
+ooConcept_read_attr_at(ooConcept *self,
+		       size_t pos,
+		       struct ooAttrView *view)
+{
+    const struct ooPackedAttr *sa;
+
+    if (!self->_store_attrs) {
+	ooConcept_read_packed_attr(self->_packed_attrs +\
+				   pos * OO_PACKED_ATTR_SIZE, view);
+	return;
+    }
+
+    sa = &self->_store_attrs[pos];
+    view->operid = (enum oo_oper_type)sa->operid;
+    view->concid = (mindmap_size_t)sa->concid;
+    view->relevance = (grade_t)sa->relevance;
+}
+
+/**
+ *  turn the packed attributes into ooAttr objects:
+ *  required before any modification
+ */
+static int
+ooConcept_materialize(ooConcept *self)
+{
+    struct ooAttrView view;
+    ooAttr *attr;
+    size_t i;
+
+    if (!self->_packed_attrs && !self->_store_attrs) return oo_OK;
+
+    self->_attrs = malloc(sizeof(ooAttr*) * (self->_num_packed_attrs + 1));
+    if (!self->_attrs) return oo_NOMEM;
+
+    for (i = 0; i < self->_num_packed_attrs; i++) {
+	ooConcept_read_attr_at(self, i, &view);
+
+	attr = malloc(sizeof(ooAttr));
+	if (!attr) {
+	    self->_num_attrs = i;
+	    return oo_NOMEM;
+	}
+
+	attr->operid = view.operid;
+	attr->concid = view.concid;
+	attr->is_affirmed = true;
+	attr->baseclass = NULL;
+	attr->value = NULL;
+	attr->relevance = view.relevance;
+
+	self->_attrs[i] = attr;
+    }
+
+    self->_num_attrs = self->_num_packed_attrs;
+
+    /* the bytecode is not needed any more */
+    self->_packed_attrs = NULL;
+    self->_store_attrs = NULL;
+    self->_num_packed_attrs = 0;
+
+    free(self->bytecode);
+    self->bytecode = NULL;
+    self->bytecode_size = 0;
+
+    return oo_OK;
+}
+
+
 /*  serialize yourself as a DB record */
 static 
 int ooConcept_pack(struct ooConcept *self, pack_type pt)
 {
     char *buf;
-    size_t buf_size, header_size, num_attrs, attr_size;
+    size_t buf_size, header_size, num_attrs;
     int ret;
 
     /* packing the Concept:
@@ -200,15 +265,17 @@ int ooConcept_pack(struct ooConcept *self, pack_type pt)
      *   2. raw name string size:    1 byte
      *   3. raw name string bytes:   N bytes
      *   4. number of attrs:         2 bytes
-     *   5. attrs:                   (N * attr_size) bytes
+     *   5. attrs:                   (N * OO_PACKED_ATTR_SIZE) bytes
      */
-    attr_size = ooConcept_calc_attrsize();
+    ret = ooConcept_materialize(self);
+    if (ret != oo_OK) return ret;
+
     num_attrs = ooConcept_calc_valid_attrs(self);
 
     header_size = sizeof(unsigned char) * 2 + self->name_size;
     buf_size =  header_size +
                 sizeof(unsigned short) +
-                (num_attrs * attr_size);
+                (num_attrs * OO_PACKED_ATTR_SIZE);
 
     buf = malloc(buf_size);
     if (!buf)	return oo_FAIL;
@@ -217,11 +284,13 @@ int ooConcept_pack(struct ooConcept *self, pack_type pt)
     if (ret != oo_OK) return oo_FAIL;
 
     ret = ooConcept_pack_attrs(self, buf + header_size, 
-		  (unsigned short)num_attrs, attr_size);
+		  (unsigned short)num_attrs);
     if (ret != oo_OK) return oo_FAIL;
 
     /* TODO: pack the search indices */
 
+    if (self->bytecode) free(self->bytecode);
+
     self->bytecode = buf;
     self->bytecode_size = buf_size;
 
@@ -233,88 +302,31 @@ int ooConcept_pack(struct ooConcept *self, pack_type pt)
 }
 
 
-
-
-/*
- * Extract a single attribute 
- * and append it to the list self->_attrs.
- */
-static
-int ooConcept_unpack_attr(ooConcept *self, 
-                         const char *buf, 
-                             size_t  item_pos)
-{
-    oo_oper_type operid;
-    mindmap_size_t concid;
-    grade_t relevance = 0;
-    bool  is_affirmed = true;
-    char *ptr;
-    ooAttr *newattr;
-
-    ptr = (char*)buf;
-    memcpy(&operid, ptr, sizeof(operid));
-    ptr += sizeof(operid);
-
-    memcpy(&concid, ptr,  sizeof(concid));
-    ptr += sizeof(concid);
-
-    memcpy(&relevance, ptr,  sizeof(relevance));
-
-    /* allocating and initializing a new attribute */
-    newattr = malloc(sizeof(*newattr));
-    if (newattr == NULL) return oo_FAIL;
-
-    newattr->operid = operid;
-    newattr->concid = concid;
-    newattr->is_affirmed = is_affirmed;
-    newattr->baseclass = NULL;
-    newattr->relevance = relevance;
-
-    self->_attrs[item_pos] = newattr;
-
-    return oo_OK;
-}
-
-
 /**
- *  Extracting the attributes from the packed bytecode 
- *  that was retrieved from the MindMap DB.
+ *  Locating the attributes in the packed bytecode 
+ *  that was retrieved from the MindMap DB:
+ *  they are read in place until the concept is modified.
  */
 static
-int ooConcept_unpack_attrs(ooConcept *self, const char *buf)
+int ooConcept_unpack_attrs(ooConcept *self, size_t offset)
 {
-    static ooAttr attr;
-    size_t i, j, attr_array_size, num_attrs = 0;
-
-    static size_t operid_size = sizeof(attr.operid);
-    static size_t concid_size = sizeof(attr.concid);
-    static size_t relevance_size = sizeof(attr.relevance);
-
-    static size_t attr_ptr_size = sizeof(ooAttr*);
-    static size_t packed_attr_size;
-
-    packed_attr_size = operid_size + concid_size + relevance_size;
+    unsigned short num_attrs;
 
-    memcpy(&num_attrs, buf, sizeof(unsigned short));
-
-    /* create an array of attr pointers */
-    attr_array_size = attr_ptr_size * num_attrs;
-    self->_attrs = malloc(attr_array_size);
-    if (!self->_attrs) return oo_NOMEM;
+    if (offset + sizeof(unsigned short) > self->bytecode_size)
+	return oo_FAIL;
 
+    memcpy(&num_attrs, self->bytecode + offset, sizeof(unsigned short));
+    offset += sizeof(unsigned short);
 
-    /* initial position for reading the attributes */
-    j = sizeof(unsigned short);
+    if (offset + num_attrs * OO_PACKED_ATTR_SIZE > self->bytecode_size)
+	return oo_FAIL;
 
     if (DEBUG_LEVEL_3) {
-	printf("Unpacking the attributes, total: %d\n", num_attrs);
-    }
-    for (i = 0; i < num_attrs; i++) {
-	ooConcept_unpack_attr(self, &buf[j], i);
-	j += packed_attr_size;
+	printf("Packed attributes, total: %d\n", num_attrs);
     }
 
-    self->_num_attrs = num_attrs;
+    self->_packed_attrs = self->bytecode + offset;
+    self->_num_packed_attrs = num_attrs;
 
     return oo_OK;
 }
@@ -329,6 +341,8 @@ int ooConcept_unpack(ooConcept *self)
     size_t i = 0;
     int ret;
 
+    if (self->bytecode_size < 2) return oo_FAIL;
+
     /*** unpack the header ***/
     /* concept type */
     c = (unsigned char)self->bytecode[i++];
@@ -337,6 +351,8 @@ int ooConcept_unpack(ooConcept *self)
     /* encoded name (NAME) */
     c = (unsigned char)self->bytecode[i++];
     self->name_size = (size_t)c;
+    if (i + self->name_size > self->bytecode_size) return oo_FAIL;
+
     self->name = malloc(self->name_size + 1);
     if (!self->name)
 	return oo_FAIL;
@@ -349,16 +365,95 @@ int ooConcept_unpack(ooConcept *self)
 	printf("Unpacking concept %s bytecode size: %d\n",
                  self->id, self->bytecode_size);
     }
-    /*** unpack the attributes ***/
-    ret = ooConcept_unpack_attrs(self, &self->bytecode[i]);
+    /*** the attributes stay in the bytecode ***/
+    ret = ooConcept_unpack_attrs(self, i);
     if (ret != oo_OK)
 	return oo_FAIL;
 
-    self->bytecode = NULL;
-    self->bytecode_size = 0;
     return oo_OK;
 }
 
+/**
+ *  a concept of the mapped Concept Store:
+ *  the mapping outlives the concept, 
+ *  so its attributes are never copied
+ */
+static
+int ooConcept_unpack_store(ooConcept *self,
+			   const struct ooPackedConcept *pc)
+{
+    self->type = (conc_type)pc->type;
+
+    self->name_size = (size_t)pc->name_size;
+    self->name = malloc(self->name_size + 1);
+    if (!self->name) return oo_NOMEM;
+
+    memcpy(self->name, OO_PACKED_CONCEPT_NAME(pc), self->name_size + 1);
+
+    self->_store_attrs = pc->attrs;
+    self->_num_packed_attrs = (attr_size_t)pc->num_attrs;
+
+    return oo_OK;
+}
+
+/*  start walking the attributes */
+static int
+ooConcept_attr_iter(struct ooConcept *self,
+		    struct ooAttrIter *iter)
+{
+    iter->pos = 0;
+    return oo_OK;
+}
+
+/*  next valid attribute */
+static int
+ooConcept_next_attr(struct ooConcept *self,
+		    struct ooAttrIter *iter,
+		    struct ooAttrView *view)
+{
+    ooAttr *attr;
+
+    if (self->_packed_attrs || self->_store_attrs) {
+	if (iter->pos >= self->_num_packed_attrs) return oo_FAIL;
+
+	ooConcept_read_attr_at(self, iter->pos, view);
+	iter->pos++;
+	return oo_OK;
+    }
+
+    /* deleted attributes leave empty slots */
+    while (iter->pos < self->_num_attrs) {
+	attr = self->_attrs[iter->pos++];
+	if (!attr) continue;
+
+	view->operid = attr->operid;
+	view->concid = attr->concid;
+	view->relevance = attr->relevance;
+	return oo_OK;
+    }
+
+    return oo_FAIL;
+}
+
+/*  lookup without unpacking */
+static int
+ooConcept_find_attr(struct ooConcept *self,
+		    oo_oper_type operid,
+		    mindmap_size_t concid,
+		    struct ooAttrView *view)
+{
+    struct ooAttrIter iter;
+
+    ooConcept_attr_iter(self, &iter);
+    while (ooConcept_next_attr(self, &iter, view) == oo_OK) {
+	if (view->concid != concid) continue;
+	if (operid != OO_NONE && view->operid != operid) continue;
+	return oo_OK;
+    }
+
+    return oo_FAIL;
+}
+
 /* save concept as a MindMap DB record */
 static
 int ooConcept_put(struct ooConcept *self, DB *dbp)
@@ -387,11 +482,7 @@ int ooConcept_put(struct ooConcept *self, DB *dbp)
     memset(&data, 0, sizeof(DBT));
 
     /* prepare the key: the Concept id */
-    key.data = malloc(idsize);
-    if (!key.data)
-	return oo_FAIL;
-
-    memcpy(key.data, &(self->numid), idsize);
+    key.data = &self->numid;
     key.size  =  (u_int32_t)idsize;
 
     data.data  = self->bytecode;
@@ -417,6 +508,7 @@ int ooConcept_put(struct ooConcept *self, DB *dbp)
 
     /* free the resources */
     free(self->bytecode);
+    self->bytecode = NULL;
     self->bytecode_size = 0;
 
     return oo_OK;
@@ -427,6 +519,10 @@ static struct ooAttr*
 ooConcept_getattr(struct ooConcept *self,
 		  mindmap_size_t  concid)
 {   size_t i;
+
+    /* the caller may change the attribute */
+    if (ooConcept_materialize(self) != oo_OK) return NULL;
+
     for (i = 0; i < self->_num_attrs; i++)  {
 	if (self->_attrs[i] == NULL)
 	    continue;
@@ -462,11 +558,9 @@ ooConcept_initattr(struct ooConcept *self,
 		   unsigned short  relevance)
 {   ooAttr *newattr;
     ooAttr **ptr;
-    static size_t attr_size = sizeof(ooAttr);
-    static size_t attr_ptr_size = sizeof(ooAttr*);
     size_t attr_array_size;
 
-    newattr = malloc(attr_size);
+    newattr = malloc(sizeof(ooAttr));
     if (!newattr) return oo_FAIL;
 
     newattr->operid = operid;
@@ -478,7 +572,7 @@ ooConcept_initattr(struct ooConcept *self,
     /* TODO: find an empty slot in _attrs 
      * after deleted item */
 
-    attr_array_size = attr_ptr_size * (self->_num_attrs + 1);
+    attr_array_size = sizeof(ooAttr*) * (self->_num_attrs + 1);
     ptr = (ooAttr**)realloc(self->_attrs, attr_array_size);
     if (!ptr) return oo_FAIL;
 
@@ -528,6 +622,9 @@ static
 int ooConcept_delattr(struct ooConcept *self, mindmap_size_t concid)
 {
     size_t i;
+
+    if (ooConcept_materialize(self) != oo_OK) return oo_FAIL;
+
     for (i = 0; i < self->_num_attrs; i++) {
 	if (self->_attrs[i] == NULL)
 	    continue;
@@ -771,6 +868,10 @@ ooConcept_init(struct ooConcept *self)
     self->_num_attrs = 0;
     self->_attrs = NULL;
 
+    self->_packed_attrs = NULL;
+    self->_num_packed_attrs = 0;
+    self->_store_attrs = NULL;
+
     /* initialize the plain search RefList
     self->_reflist = malloc(sizeof(ooRefList));
     if (!self->_reflist)
@@ -793,6 +894,7 @@ ooConcept_init(struct ooConcept *self)
 
     self->pack = ooConcept_pack;
     self->unpack = ooConcept_unpack;
+    self->unpack_store = ooConcept_unpack_store;
 
     self->put = ooConcept_put;
 
@@ -801,6 +903,10 @@ ooConcept_init(struct ooConcept *self)
     self->setattr = ooConcept_setattr;
     self->getattr = ooConcept_getattr;
 
+    self->attr_iter = ooConcept_attr_iter;
+    self->next_attr = ooConcept_next_attr;
+    self->find_attr = ooConcept_find_attr;
+
     self->lookup = ooConcept_lookup;
 
     return oo_OK;
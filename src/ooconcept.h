@@ -28,6 +28,8 @@
 
 struct ooMindMap;
 struct ooDomain;
+struct ooPackedConcept;
+struct ooPackedAttr;
 
 typedef enum logic_opers { LOGIC_AND, LOGIC_OR } logic_opers;
 
@@ -64,6 +66,24 @@ typedef enum linear_type {
     OO_POST_POS 
 } linear_type;
 
+/* size of a packed attribute in the bytecode:
+ * operid, concid and relevance */
+#define OO_PACKED_ATTR_SIZE \
+    (sizeof(enum oo_oper_type) + sizeof(mindmap_size_t) + sizeof(grade_t))
+
+/* read-only copy of an attribute:
+ * taken right from the bytecode if the concept is not unpacked */
+typedef struct ooAttrView {
+    enum oo_oper_type operid;
+    mindmap_size_t concid;
+    grade_t relevance;
+} ooAttrView;
+
+/* position of an attribute walk */
+typedef struct ooAttrIter {
+    size_t pos;
+} ooAttrIter;
+
 /* Path:
    a list of points to get from to the destination concept */
 typedef struct ooPath {
@@ -177,6 +197,11 @@ typedef struct ooConcept {
        ie. expand the immediate attributes only! */
     int (*unpack)(struct ooConcept *self);
 
+    /* take a record of the mapped Concept Store:
+       the attributes are read in the mapping */
+    int (*unpack_store)(struct ooConcept *self,
+			const struct ooPackedConcept *pc);
+
     /* serialize yourself into a binary string:
        calculate the size of resulting string in bytes */
     int (*pack)(struct ooConcept *self, pack_type pt);
@@ -202,6 +227,24 @@ typedef struct ooConcept {
     struct ooAttr* (*getattr)(struct ooConcept *self,
 		         mindmap_size_t  concid);
 
+    /*** read-only attribute access: 
+         no attributes are allocated ***/
+
+    /* start walking the attributes */
+    int (*attr_iter)(struct ooConcept *self,
+		     struct ooAttrIter *iter);
+
+    /* next attribute or oo_FAIL at the end */
+    int (*next_attr)(struct ooConcept *self,
+		     struct ooAttrIter *iter,
+		     struct ooAttrView *view);
+
+    /* lookup by concept id, OO_NONE matches any operid */
+    int (*find_attr)(struct ooConcept *self,
+		     enum oo_oper_type operid,
+		     mindmap_size_t concid,
+		     struct ooAttrView *view);
+
     struct ooGuide* (*lookup)(struct ooConcept *self,
                                 mindmap_size_t  concid);
 
@@ -217,6 +260,14 @@ typedef struct ooConcept {
     struct ooAttr **_attrs;
     attr_size_t  _num_attrs;
 
+    /* attributes still packed in the bytecode:
+       they are unpacked on the first modification only */
+    const char *_packed_attrs;
+    attr_size_t _num_packed_attrs;
+
+    /* attributes in the mapped Concept Store */
+    const struct ooPackedAttr *_store_attrs;
+
     /* Concept Timeline for methods: 
        "panta rei, panta xorei, ouden menei..."  */
     struct ooTimeline *_timeline;
@@ -0,0 +1,447 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooconcstore.c
+ *   OOmnik Concept Store implementation
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ooconfig.h"
+#include "ooconcept.h"
+#include "ooconcstore.h"
+
+#define OO_CONCSTORE_ALIGNED(size) \
+    (((size) + OO_CONCSTORE_ALIGN - 1) & ~(size_t)(OO_CONCSTORE_ALIGN - 1))
+
+
+/*  unmap the file */
+static int
+ooConceptStore_close(struct ooConceptStore *self)
+{
+    if (self->map)
+	munmap((void*)self->map, self->map_size);
+
+    if (self->filename)
+	free(self->filename);
+
+    self->filename = NULL;
+    self->map = NULL;
+    self->map_size = 0;
+    self->offsets = NULL;
+    self->num_ids = 0;
+
+    return oo_OK;
+}
+
+/*  ConceptStore destructor */
+static int
+ooConceptStore_del(struct ooConceptStore *self)
+{
+    ooConceptStore_close(self);
+    free(self);
+
+    return oo_OK;
+}
+
+/* every record must lie within the records area */
+static int
+ooConceptStore_validate(struct ooConceptStore *self,
+			size_t records_offset)
+{
+    const struct ooPackedConcept *pc;
+    size_t i, offset;
+
+    for (i = 0; i < self->num_ids; i++) {
+	offset = (size_t)self->offsets[i];
+	if (!offset) continue;
+
+	if (offset < records_offset || offset % OO_CONCSTORE_ALIGN)
+	    return oo_FAIL;
+	if (offset + sizeof(struct ooPackedConcept) > self->map_size)
+	    return oo_FAIL;
+
+	pc = (const struct ooPackedConcept*)(self->map + offset);
+	if (offset + OO_PACKED_CONCEPT_SIZE(pc->num_attrs, pc->name_size) >\
+	    self->map_size)
+	    return oo_FAIL;
+	if (OO_PACKED_CONCEPT_NAME(pc)[pc->name_size] != '\0')
+	    return oo_FAIL;
+    }
+
+    return oo_OK;
+}
+
+/*  map the store file */
+static int
+ooConceptStore_open(struct ooConceptStore *self,
+		    const char *filename)
+{
+    const struct ooConceptStoreHeader *header;
+    struct stat st;
+    size_t records_offset;
+    void *map;
+    int fd, ret;
+
+    ooConceptStore_close(self);
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+	fprintf(stderr, "  -- Couldn't open the Concept Store \"%s\" :(\n",
+		filename);
+	return oo_FAIL;
+    }
+
+    if (fstat(fd, &st) < 0 ||\
+	(size_t)st.st_size < sizeof(struct ooConceptStoreHeader)) {
+	close(fd);
+	goto invalid;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	fprintf(stderr, "  -- Couldn't map the Concept Store \"%s\" :(\n",
+		filename);
+	return oo_FAIL;
+    }
+
+    self->map = (const char*)map;
+    self->map_size = (size_t)st.st_size;
+
+    header = (const struct ooConceptStoreHeader*)self->map;
+    if (memcmp(header->magic, OO_CONCSTORE_MAGIC, sizeof(header->magic)))
+	goto invalid;
+    if (header->version != OO_CONCSTORE_VERSION)
+	goto invalid;
+    if (header->num_ids > self->map_size / sizeof(uint64_t))
+	goto invalid;
+
+    records_offset = sizeof(struct ooConceptStoreHeader) +\
+	(size_t)header->num_ids * sizeof(uint64_t);
+    if (records_offset + (size_t)header->records_size > self->map_size)
+	goto invalid;
+
+    self->offsets = (const uint64_t*)(self->map +\
+				      sizeof(struct ooConceptStoreHeader));
+    self->num_ids = (size_t)header->num_ids;
+
+    ret = ooConceptStore_validate(self, records_offset);
+    if (ret != oo_OK) goto invalid;
+
+    self->filename = strdup(filename);
+
+    if (DEBUG_LEVEL_1)
+	printf("  ++ Concept Store \"%s\": %zu ids, %zu bytes\n",
+	       filename, self->num_ids, self->map_size);
+
+    return oo_OK;
+
+ invalid:
+    fprintf(stderr, "  -- \"%s\" is not a valid Concept Store :(\n", filename);
+    ooConceptStore_close(self);
+    return oo_FAIL;
+}
+
+/*  zero-copy lookup by concept id */
+static const struct ooPackedConcept*
+ooConceptStore_get(struct ooConceptStore *self,
+		   mindmap_size_t id)
+{
+    uint64_t offset;
+
+    if (id >= self->num_ids) return NULL;
+
+    offset = self->offsets[id];
+    if (!offset) return NULL;
+
+    return (const struct ooPackedConcept*)(self->map + offset);
+}
+
+
+/**
+ *  check the Berkeley DB bytecode of a concept,
+ *  see ooConcept_pack for the format
+ */
+static int
+ooConceptStore_parse_record(const DBT *key,
+			    const DBT *data,
+			    mindmap_size_t *id,
+			    size_t *name_size,
+			    size_t *num_attrs)
+{
+    const unsigned char *c = (const unsigned char*)data->data;
+    unsigned short n;
+
+    if (key->size != sizeof(mindmap_size_t)) return oo_FAIL;
+    memcpy(id, key->data, sizeof(mindmap_size_t));
+
+    if (data->size < 2) return oo_FAIL;
+    *name_size = c[1];
+
+    if (data->size < 2 + *name_size + sizeof(unsigned short)) return oo_FAIL;
+    memcpy(&n, c + 2 + *name_size, sizeof(unsigned short));
+    *num_attrs = n;
+
+    if (data->size < 2 + *name_size + sizeof(unsigned short) +\
+	*num_attrs * OO_PACKED_ATTR_SIZE)
+	return oo_FAIL;
+
+    return oo_OK;
+}
+
+/* lay out a concept record in the store format */
+static size_t
+ooConceptStore_pack_record(const DBT *data,
+			   size_t name_size,
+			   size_t num_attrs,
+			   char *buf)
+{
+    const char *c = (const char*)data->data;
+    struct ooPackedConcept *pc = (struct ooPackedConcept*)buf;
+    struct ooPackedAttr *attr;
+    oo_oper_type operid;
+    mindmap_size_t concid;
+    grade_t relevance;
+    size_t i, size;
+
+    size = OO_CONCSTORE_ALIGNED(OO_PACKED_CONCEPT_SIZE(num_attrs, name_size));
+    memset(buf, 0, size);
+
+    pc->type = (uint8_t)c[0];
+    pc->name_size = (uint8_t)name_size;
+    pc->num_attrs = (uint16_t)num_attrs;
+
+    c += 2 + name_size + sizeof(unsigned short);
+
+    for (i = 0; i < num_attrs; i++) {
+	memcpy(&operid, c, sizeof(operid));
+	c += sizeof(operid);
+	memcpy(&concid, c, sizeof(concid));
+	c += sizeof(concid);
+	memcpy(&relevance, c, sizeof(relevance));
+	c += sizeof(relevance);
+
+	attr = &pc->attrs[i];
+	attr->concid = (uint64_t)concid;
+	attr->operid = (uint32_t)operid;
+	attr->relevance = (uint8_t)relevance;
+    }
+
+    memcpy((char*)OO_PACKED_CONCEPT_NAME(pc),
+	   (const char*)data->data + 2, name_size);
+
+    return size;
+}
+
+/* walk the database, "f" is NULL on the first pass */
+static int
+ooConceptStore_walk_db(DB *dbp,
+		       FILE *f,
+		       uint64_t *offsets,
+		       size_t *max_id,
+		       size_t *records_size)
+{
+    DBT key, data;
+    DBC *dbcp;
+    mindmap_size_t id;
+    size_t name_size, num_attrs, size, offset;
+    char *buf = NULL;
+    int ret;
+
+    if ((ret = dbp->cursor(dbp, NULL, &dbcp, 0)) != 0) {
+	dbp->err(dbp, ret, "DB->cursor");
+	return oo_FAIL;
+    }
+
+    memset(&key, 0, sizeof(DBT));
+    memset(&data, 0, sizeof(DBT));
+
+    if (f) {
+	buf = malloc(OO_CONCSTORE_ALIGNED(OO_PACKED_CONCEPT_SIZE(ATTR_MAX,
+								 NAME_ATOMS_MAX)));
+	if (!buf) {
+	    dbcp->c_close(dbcp);
+	    return oo_NOMEM;
+	}
+    }
+
+    offset = sizeof(struct ooConceptStoreHeader) +\
+	(*max_id + 1) * sizeof(uint64_t);
+
+    while ((ret = dbcp->c_get(dbcp, &key, &data, DB_NEXT)) == 0) {
+	ret = ooConceptStore_parse_record(&key, &data, &id,
+					  &name_size, &num_attrs);
+	if (ret != oo_OK) {
+	    fprintf(stderr, "  -- Concept Store: skipping a broken record\n");
+	    continue;
+	}
+
+	/* first pass: sizes only */
+	if (!f) {
+	    if (id > *max_id) *max_id = id;
+	    *records_size += OO_CONCSTORE_ALIGNED(OO_PACKED_CONCEPT_SIZE(num_attrs,
+									name_size));
+	    continue;
+	}
+
+	/* added after the first pass */
+	if (id > *max_id) continue;
+
+	size = ooConceptStore_pack_record(&data, name_size, num_attrs, buf);
+	if (fwrite(buf, 1, size, f) != size) {
+	    ret = oo_FAIL;
+	    goto final;
+	}
+
+	offsets[id] = (uint64_t)offset;
+	offset += size;
+    }
+
+    if (ret != DB_NOTFOUND) {
+	dbp->err(dbp, ret, "DBcursor->get");
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    ret = oo_OK;
+
+ final:
+    dbcp->c_close(dbcp);
+    if (buf) free(buf);
+
+    return ret;
+}
+
+/**
+ *  two passes over the database:
+ *  the first one finds the id range and the size of the records,
+ *  the second one writes the records,
+ *  the result is renamed into place when complete
+ */
+extern int
+ooConceptStore_import(DB *dbp,
+		      const char *filename)
+{
+    struct ooConceptStoreHeader header;
+    uint64_t *offsets = NULL;
+    size_t max_id = 0, records_size = 0;
+    char *tmp_filename = NULL;
+    FILE *f = NULL;
+    int ret;
+
+    if (!dbp) return oo_FAIL;
+
+    ret = ooConceptStore_walk_db(dbp, NULL, NULL, &max_id, &records_size);
+    if (ret != oo_OK) return ret;
+
+    offsets = calloc(max_id + 1, sizeof(uint64_t));
+    if (!offsets) return oo_NOMEM;
+
+    tmp_filename = malloc(strlen(filename) + strlen(".tmp") + 1);
+    if (!tmp_filename) {
+	ret = oo_NOMEM;
+	goto final;
+    }
+    sprintf(tmp_filename, "%s.tmp", filename);
+
+    f = fopen(tmp_filename, "wb");
+    if (!f) {
+	fprintf(stderr, "  -- Couldn't create \"%s\" :(\n", tmp_filename);
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OO_CONCSTORE_MAGIC, sizeof(header.magic));
+    header.version = OO_CONCSTORE_VERSION;
+    header.num_ids = max_id + 1;
+    header.records_size = records_size;
+
+    /* the offset table is written when all records are in place */
+    ret = oo_FAIL;
+    if (fwrite(&header, sizeof(header), 1, f) != 1) goto final;
+    if (fseek(f, (long)((max_id + 1) * sizeof(uint64_t)), SEEK_CUR)) goto final;
+
+    ret = ooConceptStore_walk_db(dbp, f, offsets, &max_id, &records_size);
+    if (ret != oo_OK) goto final;
+
+    ret = oo_FAIL;
+    if (fseek(f, (long)sizeof(header), SEEK_SET)) goto final;
+    if (fwrite(offsets, sizeof(uint64_t), max_id + 1, f) != max_id + 1)
+	goto final;
+
+    ret = fclose(f);
+    f = NULL;
+    if (ret) {
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    if (rename(tmp_filename, filename)) {
+	fprintf(stderr, "  -- Couldn't rename \"%s\" :(\n", tmp_filename);
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    fprintf(stderr, "  ++ Concept Store \"%s\": %zu ids, %zu bytes of records\n",
+	    filename, max_id + 1, records_size);
+
+    ret = oo_OK;
+
+ final:
+    if (f) {
+	fclose(f);
+	unlink(tmp_filename);
+    }
+    if (tmp_filename) free(tmp_filename);
+    free(offsets);
+
+    return ret;
+}
+
+/*  ConceptStore initializer */
+extern int
+ooConceptStore_new(struct ooConceptStore **store)
+{
+    struct ooConceptStore *self = malloc(sizeof(struct ooConceptStore));
+    if (!self) return oo_NOMEM;
+
+    self->filename = NULL;
+
+    self->map = NULL;
+    self->map_size = 0;
+
+    self->offsets = NULL;
+    self->num_ids = 0;
+
+    /* bind your methods */
+    self->del = ooConceptStore_del;
+    self->open = ooConceptStore_open;
+    self->close = ooConceptStore_close;
+    self->get = ooConceptStore_get;
+
+    *store = self;
+    return oo_OK;
+}
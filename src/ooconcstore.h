@@ -0,0 +1,117 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooconcstore.h
+ *   OOmnik read-only memory-mapped Concept Store
+ */
+
+#ifndef OO_CONCSTORE_H
+#define OO_CONCSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <db.h>
+
+#include "ooconfig.h"
+
+/**
+ *  File layout, all offsets are counted from the start of the file:
+ *
+ *   1. header:        struct ooConceptStoreHeader
+ *   2. offset table:  num_ids * uint64_t, indexed by concept id,
+ *                     0 stands for a missing concept
+ *   3. records:       struct ooPackedConcept aligned to 8 bytes,
+ *                     followed by its attributes and the name
+ *
+ *  The records are read in place: no unpacking is needed.
+ */
+#define OO_CONCSTORE_MAGIC "OOMNIKCS"
+#define OO_CONCSTORE_VERSION 1
+#define OO_CONCSTORE_ALIGN 8
+
+typedef struct ooConceptStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_ids;
+    uint64_t records_size;
+} ooConceptStoreHeader;
+
+typedef struct ooPackedAttr {
+    uint64_t concid;
+    uint32_t operid;
+    uint8_t relevance;
+    uint8_t reserved[3];
+} ooPackedAttr;
+
+typedef struct ooPackedConcept {
+    uint8_t type;
+    uint8_t name_size;
+    uint16_t num_attrs;
+    uint32_t reserved;
+
+    /* num_attrs items */
+    struct ooPackedAttr attrs[];
+
+    /* the name of name_size bytes and a terminating zero
+     * follow the attributes */
+} ooPackedConcept;
+
+/* the zero terminated name of a packed concept */
+#define OO_PACKED_CONCEPT_NAME(pc) \
+    ((const char*)((pc)->attrs + (pc)->num_attrs))
+
+/* full size of a packed record without the alignment */
+#define OO_PACKED_CONCEPT_SIZE(num_attrs, name_size) \
+    (sizeof(struct ooPackedConcept) + \
+     (num_attrs) * sizeof(struct ooPackedAttr) + (name_size) + 1)
+
+
+/**
+ *  Concept Store:
+ *  once opened, the mapping is never written,
+ *  so any number of threads may read it without locking
+ */
+typedef struct ooConceptStore {
+    char *filename;
+
+    const char *map;
+    size_t map_size;
+
+    const uint64_t *offsets;
+    size_t num_ids;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooConceptStore *self);
+
+    /* map the file and validate its contents */
+    int (*open)(struct ooConceptStore *self, const char *filename);
+
+    /* unmap the file */
+    int (*close)(struct ooConceptStore *self);
+
+    /* packed concept by its id or NULL */
+    const struct ooPackedConcept* (*get)(struct ooConceptStore *self,
+					 mindmap_size_t id);
+} ooConceptStore;
+
+extern int ooConceptStore_new(struct ooConceptStore **self);
+
+/* write all the concepts of a Berkeley DB MindMap into a store file */
+extern int ooConceptStore_import(DB *dbp, const char *filename);
+
+#endif /* OO_CONCSTORE_H */
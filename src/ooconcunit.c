@@ -28,6 +28,7 @@
 #include "ooconcunit.h"
 #include "ooagenda.h"
 #include "oocomplex.h"
+#include "ootrace.h"
 
 /* forward declarations */
 static int
@@ -175,8 +176,10 @@ ooConcUnit_inform_parents(struct ooConcUnit *self,
 
     if (self->fixed_parent) {
 
-	printf("\n \"%s\" must inform my FIXED PARENT: %s operid: %d\n",
-	       self->code->name, self->fixed_parent->code->name,  self->fixed_operid);
+	if (OO_TRACE_ON(OO_TRACE_CONC))
+	    oo_trace_msg(OO_TRACE_CONC, "\"%s\" informs its fixed parent "
+			 "\"%s\" (operid: %d)", self->code->name, 
+			 self->fixed_parent->code->name, self->fixed_operid);
 
 	for (i = 0; i < self->fixed_parent->num_complexes; i++) {
 	    complex = self->fixed_parent->complexes[i];
@@ -493,10 +496,10 @@ ooConcUnit_join_predicted(struct ooConcUnit *self,
 			  struct ooConcUnit *pred_cu,
 			  struct ooCode *code)
 {
-    size_t i, j;
+    size_t i;
     struct ooConcUnit *child;
     struct ooComplex **specs;
-    struct ooCodeSpec *code_spec;
+    struct ooCodeLink *link;
     int ret;
 
     if (DEBUG_CONC_LEVEL_2) {
@@ -508,19 +511,18 @@ ooConcUnit_join_predicted(struct ooConcUnit *self,
     /* NB: there's only one complex in the predicted unit */
     specs = pred_cu->complexes[0]->specs;
 
-    /* check every child */
-    for (i = 0; i < OO_NUM_OPERS; i++) {
-	if (!specs[i]) continue;
+    /* check every child spec of the code and its superclasses */
+    for (i = 0; i < code->num_child_links; i++) {
+	link = &code->child_links[i];
+	if (!specs[link->operid]) continue;
 
-	child = specs[i]->base;
-	code_spec = code->children[i];
-	if (!code_spec) continue;
+	child = specs[link->operid]->base;
 
 	if (DEBUG_CONC_LEVEL_3)
-	    printf("    LINEAR ORDER CONSTRAINT: %d\n", code_spec->linear_order);
+	    printf("    LINEAR ORDER CONSTRAINT: %d\n", link->linear_order);
 	    
-	if (code_spec->linear_order == OO_PRE_POS) {
-	    ret = ooConcUnit_check_linear_order(self, child, code_spec->linear_order);
+	if (link->linear_order == OO_PRE_POS) {
+	    ret = ooConcUnit_check_linear_order(self, child, link->linear_order);
 
 	    if (DEBUG_CONC_LEVEL_3)
 		printf("  == linear order check verdict: %d\n", ret);
@@ -528,7 +530,7 @@ ooConcUnit_join_predicted(struct ooConcUnit *self,
 	    if (ret != oo_OK) continue;
 	}
 
-	ooConcUnit_add_children(self, child, code_spec);
+	ooConcUnit_add_children(self, child, link->spec);
     }
     return oo_OK;
 }
@@ -546,6 +548,8 @@ ooConcUnit_check_children(struct ooConcUnit *self,
 	printf("\n    ?? Anybody waiting for the parent \"%s\" (%d)?\n", 
 	   code->name, code->id);
 
+    if (!code->num_child_links) return oo_FAIL;
+
     concid = self->code->id;
     if (self->code->baseclass)
 	concid = self->code->baseclass->id;
@@ -574,28 +578,59 @@ ooConcUnit_check_children(struct ooConcUnit *self,
 	cu = cu->next;
     }
 
-    /* check inheritance */
-    if (code->num_children && code->children[OO_IS_SUBCLASS] != NULL)
-	    return ooConcUnit_check_children(self, code->children[OO_IS_SUBCLASS]->code);
-
     return oo_FAIL;
 }
 
 
+/**
+ * predicted parent takes over the solutions of its child
+ */
+static int
+ooConcUnit_copy_complexes(struct ooConcUnit *self, 
+			  struct ooConcUnit *parent,
+			  oo_oper_type operid)
+{
+    struct ooComplex *complex;
+    size_t i, j;
+
+    parent->num_complexes = 0;
+
+    for (i = 0; i < self->num_complexes; i++) {
+	complex = parent->complexes[i];
+	complex->reset(complex);
+
+	complex->weight = self->complexes[i]->weight;
+	complex->linear_begin = self->complexes[i]->linear_begin;
+	complex->linear_end = self->complexes[i]->linear_end;
+	complex->is_free = false;
+
+	complex->specs[operid] = self->complexes[i];
+	
+	for (j = complex->linear_begin; j < complex->linear_end; j++) 
+	    complex->linear_index[j] = self->complexes[i]->linear_index[j];
+
+	parent->num_complexes++;
+    }
+
+    return oo_OK;
+}
+
+
 static int
 ooConcUnit_check_parent(struct ooConcUnit *self, 
-			oo_oper_type operid, 
-			struct ooCodeSpec *child_spec)
+			struct ooCodeLink *link)
 {
     struct ooConcUnit *parent;
-    struct ooComplex *complex;
-    struct ooCodeSpec *spec;
+    struct ooComplex *child = NULL, *complex;
+    struct ooPrediction *pred, *best;
     struct ooCode *parent_code;
-    size_t i, j, concid;
+    oo_oper_type operid;
+    size_t i, concid, linear_begin, linear_end;
+    int child_weight = 0;
     int ret;
 
-    if (!child_spec->code) return oo_FAIL;
-    parent_code = child_spec->code;
+    parent_code = link->code;
+    operid = link->operid;
 
     concid = parent_code->id;
     if (parent_code->baseclass)
@@ -604,49 +639,110 @@ ooConcUnit_check_parent(struct ooConcUnit *self,
     if (concid >= AGENDA_INDEX_SIZE) return oo_FAIL;
 
     parent = self->agenda->index[concid];
-    spec = parent_code->children[operid];
 
     /* existing parents */
     while (parent) {
 	if (!parent->is_present) goto next_parent;
 
-	if (spec && spec->linear_order != OO_ANY_POS) {
+	if (link->linear_order != OO_ANY_POS) {
 
-	    ret = ooConcUnit_check_linear_order(parent, self, spec->linear_order);
+	    ret = ooConcUnit_check_linear_order(parent, self, link->linear_order);
 	    if (DEBUG_CONC_LEVEL_4) 
 		printf("    == linear order check result: %d\n", ret);
 
 	    if (ret != oo_OK) goto next_parent;
 	}
-	ooConcUnit_add_children(parent, self, spec);
+	ooConcUnit_add_children(parent, self, link->spec);
     next_parent:
 	parent = parent->next;
     }
 	
-    /* create new parent unit anyway */
-    /* STR */
+    /* all the child's solutions go to the parent:
+     * the span covers them all, the best one gives the weight */
+    linear_begin = self->linear_pos;
+    linear_end = self->linear_pos + self->coverage;
+    for (i = 0; i < self->num_complexes; i++) {
+	complex = self->complexes[i];
+	if (!i || complex->linear_begin < linear_begin)
+	    linear_begin = complex->linear_begin;
+	if (!i || complex->linear_end > linear_end)
+	    linear_end = complex->linear_end;
+	if (child && complex->weight <= child_weight) continue;
+	child = complex;
+	child_weight = complex->weight;
+    }
 
-    parent = self->agenda->alloc_unit(self->agenda);
-    if (!parent) return oo_NOMEM;
-    parent->make_instance(parent, parent_code, NULL);
+    /* has this child already predicted the parent over the same span? */
+    pred = self->agenda->lookup_prediction(self->agenda, parent_code, operid,
+					   linear_begin, linear_end,
+					   self, child);
+    if (pred && pred->weight >= child_weight) {
+	self->agenda->num_reused_predictions++;
 
+	if (DEBUG_CONC_LEVEL_3)
+	    printf("\n    == Parent CU %s is already predicted (mem: %p)\n", 
+		   parent_code->name, pred->unit);
+	return oo_OK;
+    }
 
-    /* fast linking with child's complexes */
-    for (i = 0; i < self->num_complexes; i++) {
-	complex = parent->complexes[i];
-	complex->reset(complex);
+    /* predictions of other children over the same span:
+     * alternatives of equal weight are all kept */
+    best = self->agenda->best_prediction(self->agenda, parent_code, operid,
+					 linear_begin, linear_end);
+    if (best) {
+	/* the new prediction would be dominated */
+	if (best->weight > child_weight) {
+	    self->agenda->num_pruned_predictions++;
+	    return oo_OK;
+	}
 
-	complex->weight = self->complexes[i]->weight;
-	complex->linear_begin = self->complexes[i]->linear_begin;
-	complex->linear_end = self->complexes[i]->linear_end;
-	complex->is_free = false;
+	/* the existing prediction is dominated: 
+	   replace its solutions in place */
+	if (best->weight < child_weight &&
+	    !link->implied_parent && !best->unit->is_present) {
+	    self->agenda->num_pruned_predictions++;
+	    ooConcUnit_copy_complexes(self, best->unit, operid);
+
+	    /* the memo entry of the overwritten unit
+	       carries the weight of its new solutions */
+	    best->weight = child_weight;
+
+	    if (!pred)
+		pred = self->agenda->save_prediction(self->agenda, parent_code,
+						     operid, linear_begin,
+						     linear_end, self, child);
+	    if (pred) {
+		pred->unit = best->unit;
+		pred->weight = child_weight;
+	    }
+	    return oo_OK;
+	}
+    }
 
-	complex->specs[operid] = self->complexes[i];
-	
-	for (j = complex->linear_begin; j < complex->linear_end; j++) 
-	    complex->linear_index[j] = self->complexes[i]->linear_index[j];
+    /* out of budget: no new hypotheses */
+    ret = self->agenda->budget_admit(self->agenda, false);
+    if (ret != oo_OK) return oo_OK;
 
-	parent->num_complexes++;
+    /* beam search */
+    ret = self->agenda->beam_admit(self->agenda, parent_code,
+				   linear_begin, linear_end, child_weight);
+    if (ret != oo_OK) return oo_OK;
+
+    /* create new parent unit */
+    parent = self->agenda->alloc_unit(self->agenda);
+    if (!parent) return oo_NOMEM;
+    parent->make_instance(parent, parent_code, NULL);
+
+    /* fast linking with child's complexes */
+    ooConcUnit_copy_complexes(self, parent, operid);
+
+    if (!pred)
+	pred = self->agenda->save_prediction(self->agenda, parent_code, operid,
+					     linear_begin, linear_end,
+					     self, child);
+    if (pred) {
+	pred->unit = parent;
+	pred->weight = child_weight;
     }
 
     if (DEBUG_CONC_LEVEL_3)
@@ -654,7 +750,7 @@ ooConcUnit_check_parent(struct ooConcUnit *self,
 	       parent_code->name, parent);
 
     /* implied parent linking */
-    if (child_spec->implied_parent) {
+    if (link->implied_parent) {
 	if (DEBUG_CONC_LEVEL_3)
 	    printf("\n    !! Parent \"%s\" is implied and needs to be linked!\n", 
 		   parent_code->name);
@@ -678,67 +774,28 @@ ooConcUnit_check_parent(struct ooConcUnit *self,
 static int
 ooConcUnit_check_parents(struct ooConcUnit *self, struct ooCode *code)
 {   size_t i;
-    struct ooCode *parent_code;
-    struct ooCodeSpec *spec;
-    bool gotcha = false;
-    int ret;
 
-    if (DEBUG_CONC_LEVEL_3)
+    if (DEBUG_CONC_LEVEL_3) {
 	printf("\n   .. Checking the parents of the CU \"%s\"...",
 	       self->code->name);
 
-    /* inheritance goes first */
-    if (code->num_children) {
-	if (code->children[OO_IS_SUBCLASS]) {
-	    if (DEBUG_CONC_LEVEL_3) {
-		printf("\n    NB: Before checking the parents of \"%s\"\n"
-		       "          we\'ll examine its superclass \"%s\"!\n", 
-		       code->name, code->children[OO_IS_SUBCLASS]->code->name);
-	    }
-	    ooConcUnit_check_parents(self, code->children[OO_IS_SUBCLASS]->code);
-
-
-	}
-    }
-    
-    if (DEBUG_CONC_LEVEL_3) {
-	printf("\n    ?? parent codes of \"%s\":\n      ", code->name);
+	printf("\n    ?? parent codes of \"%s\" (incl. superclasses):\n      ", 
+	       code->name);
 
 	/* list parent codes */
-	for (i = 0; i < OO_NUM_OPERS; i++) {
-	    if (i == OO_IS_SUBCLASS) continue;
-	    if (!code->parents[i]) continue;
-	    spec = code->parents[i];
-
-	    /* no need to check the implied parent */
-	    /*if (spec->implied_parent) continue;*/
-
-	    while (spec) {
-		printf("\"%s\"   ", spec->code->name);
-		spec = spec->next;
-		gotcha = true;
-	    }
-	}
-	if (!gotcha) 
+	for (i = 0; i < code->num_parent_links; i++)
+	    printf("\"%s\"   ", code->parent_links[i].code->name);
+
+	if (!code->num_parent_links) 
 	    printf("-- \"%s\" has no parents.\n",  code->name);
 	else
 	    printf("\n");
     }
 
-    /* check parent codes */
-    for (i = 0; i < OO_NUM_OPERS; i++) {
-	if (i == OO_IS_SUBCLASS) continue;
-	if (!code->parents[i]) continue;
-
-	spec = code->parents[i];
-	/* no need to check the implied parent */
-	/*if (spec->implied_parent) continue;*/
-	
-	while (spec) {
-	    ooConcUnit_check_parent(self, i, spec);
-	    spec = spec->next;
-	}
-    }
+    /* check parent codes:
+     * the table is inheritance-closed, superclasses go first */
+    for (i = 0; i < code->num_parent_links; i++)
+	ooConcUnit_check_parent(self, &code->parent_links[i]);
 
     return oo_OK;
 }
@@ -839,7 +896,7 @@ ooConcUnit_link(struct ooConcUnit *self)
       ret = ooConcUnit_check_peers(self);*/
 
 
-    if (code->num_children) {
+    if (code->num_child_links) {
 	ret = ooConcUnit_check_children(self, code);
 	if (ret == oo_OK) return ret;
     }
@@ -930,6 +987,87 @@ ooConcUnit_make_instance(struct ooConcUnit *self,
 }
 
 
+static int
+ooConcUnit_make_template_instance(struct ooConcUnit *self, 
+				  struct ooCodeTemplateLevel *level,
+				  struct ooConcUnit *terminal,
+				  struct ooConcUnit *child)
+{
+    struct ooComplex *complex, *child_complex;
+    size_t i, j, pos, coverage;
+
+    pos = terminal->linear_pos;
+    coverage = terminal->coverage;
+
+    self->code = level->code;
+    self->concid = level->code->id;
+    self->terminals = terminal;
+    self->is_present = true;
+
+    self->coverage = coverage;
+    self->linear_pos = pos;
+    self->start_term_pos = terminal->start_term_pos;
+    self->num_terminals = terminal->num_terminals;
+    self->context = terminal->context;
+
+    /* NB: complexes are fresh from the agenda's alloc_unit */
+    complex = self->complexes[0];
+    for (i = 0; i < level->num_interps; i++)
+	complex->interps[i]->conc = level->interps[i];
+    complex->num_interps = level->num_interps;
+
+    if (!child) {
+	complex->is_free = false;
+
+	/* see make_instance */
+	if (terminal->is_sparse)
+	    complex->weight = coverage;
+	else
+	    complex->weight = coverage * coverage * coverage;
+
+	if (level->code->verif_level > 0) 
+	    complex->weight *= level->code->verif_level * CODE_VERIFICATION_BONUS;
+
+	complex->linear_begin = pos;
+	complex->linear_end = pos + coverage;
+	complex->linear_index[pos] = complex;
+	self->num_complexes = 1;
+	return oo_OK;
+    }
+
+    child->fixed_parent = self;
+    child->fixed_operid = level->operid;
+
+    /* establish fixed links between complexes */
+    self->num_complexes = 0;
+    for (i = 0; i < child->num_complexes; i++) {
+	complex = self->complexes[i];
+	child_complex = child->complexes[i];
+
+	complex->linear_begin = pos;
+	complex->linear_end = pos + coverage;
+	complex->linear_index[pos] = complex;
+	complex->weight = child_complex->weight;
+
+	if (child_complex->linear_begin < complex->linear_begin) 
+	    complex->linear_begin = child_complex->linear_begin;
+	if (child_complex->linear_end > complex->linear_end) 
+	    complex->linear_end = child_complex->linear_end;
+
+	/* merge linear indices */
+	for (j = child_complex->linear_begin; j < child_complex->linear_end; j++)
+	    complex->linear_index[j] = child_complex->linear_index[j];
+
+	complex->specs[level->operid] = child_complex;
+	complex->is_free = false;
+
+	self->num_complexes++;
+    }
+
+    return oo_OK;
+}
+
+
 /*  ooConcUnit Erazer: setting zero values */
 static int 
 ooConcUnit_reset(struct ooConcUnit *self)
@@ -985,6 +1123,7 @@ ooConcUnit_init(struct ooConcUnit *self)
     self->link = ooConcUnit_link;
     self->add_children = ooConcUnit_add_children;
     self->make_instance = ooConcUnit_make_instance;
+    self->make_template_instance = ooConcUnit_make_template_instance;
     self->reset = ooConcUnit_reset;
 
     /* initialize the pool of complex solutions */
@@ -26,6 +26,9 @@
 #include "oocomplex.h"
 #include "ooconfig.h"
 
+/* forward declarations */
+struct ooCodeTemplateLevel;
+
 /* Concept Unit: storage of computed attributes 
    and hypothetical operations */
 
@@ -108,6 +111,15 @@ typedef struct ooConcUnit {
 			 struct ooCode *myclass,
 			 struct ooConcUnit *terminal);
 
+    /* instance of a shared code template level 
+     * over the span of the terminal: 
+     * the lowest level (child == NULL) gets the terminal weight,
+     * upper levels take over the complexes of their child */
+    int (*make_template_instance)(struct ooConcUnit *self, 
+				  struct ooCodeTemplateLevel *level,
+				  struct ooConcUnit *terminal,
+				  struct ooConcUnit *child);
+
     /* establish links with your peers and parents */
     int (*link)(struct ooConcUnit *self);
 
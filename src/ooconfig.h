@@ -67,6 +67,17 @@ enum { oo_OK, oo_FAIL, FAIL, oo_NOMEM, oo_NO_RESULTS } oo_err_codes;
 #define AGENDA_CONCUNIT_STORAGE_SIZE 1024
 #define AGENDA_INDEX_SIZE 1024
 
+/* memo of predicted parents: per request */
+#define AGENDA_PREDICTION_POOL_SIZE 1024
+#define AGENDA_PREDICTION_INDEX_SIZE 509
+
+/* beam search bookkeeping: per request */
+#define AGENDA_BEAM_POOL_SIZE 2048
+#define AGENDA_BEAM_INDEX_SIZE 509
+
+/* work budget: the clock is read once per this many checks */
+#define BUDGET_CLOCK_INTERVAL 16
+
 /* max number of complex solutions in a batch */
 #define AGENDA_COMPLEX_POOL_SIZE 24
 #define CONCUNIT_COMPLEX_POOL_SIZE 4
@@ -89,6 +100,33 @@ enum { oo_OK, oo_FAIL, FAIL, oo_NOMEM, oo_NO_RESULTS } oo_err_codes;
 #define OUTPUT_BUF_SIZE 1024 * 1024
 #define TEMP_BUF_SIZE 1024 * 1024
 
+/* stats report: space per CodeSystem */
+#define STATS_ENTRY_BUF_SIZE 2048
+
+/* memory report: space per CodeSystem */
+#define MEMORY_ENTRY_BUF_SIZE 512
+
+/* number of histogram buckets, the last one collects the overflow */
+#define STATS_HIST_SIZE 16
+
+/* max length of a trace message */
+#define TRACE_MSG_BUF_SIZE 512
+
+/* MindMap DB cache */
+#define MINDMAP_DB_CACHE_SIZE (16 * 1024 * 1024)
+
+/* MindMap DB bulk transfers: a multiple of 1024 */
+#define MINDMAP_BULK_BUF_SIZE (1024 * 1024)
+
+/* interned names */
+#define STRPOOL_INIT_BUCKETS 4096
+#define STRPOOL_CHUNK_SIZE 64 * 1024
+
+/* region of knowledge base objects */
+#define REGION_CHUNK_SIZE 256 * 1024
+#define REGION_ALIGN 16
+#define REGION_INIT_BLOCKS 1024
+
 #define INDEX_REALLOC_FACTOR 2
 #define DEFAULT_INDEX_SIZE 1024
 
@@ -180,12 +218,49 @@ enum { oo_OK, oo_FAIL, FAIL, oo_NOMEM, oo_NO_RESULTS } oo_err_codes;
 
 #define MAX_CONTACT_DISTANCE 4
 
+/* max length of the superclass chain 
+ * flattened into the linking tables */
+#define MAX_INHERIT_DEPTH 32
+
+/* max number of nested levels in a shared code template */
+#define MAX_SHARED_CODE_DEPTH 16
+
 #define ATOM_BYTE 1
 
 #define MAX_CONC_ID_SIZE 256
 
+/* upper limit of the threads parsing XML include files at startup,
+ * 0 parses every file in the loading thread */
+#define MAX_XML_PARSE_THREADS 8
+
+/* parsed documents per parsing thread waiting to be taken
+ * by the loading thread, the workers stop ahead of it */
+#define XML_POOL_DOCS_PER_WORKER 2
+
+/* socket server: the read buffer grows up to the largest request,
+ * a connection is not read while its pipeline is full */
+#define SERVER_READ_BUF_SIZE 64 * 1024
+#define SERVER_MAX_REQUEST_SIZE 1024 * 1024
+#define SERVER_MAX_PIPELINE 64
+#define SERVER_MAX_CONNECTIONS 1024
+#define SERVER_MAX_WORKERS 64
+#define SERVER_MAX_EVENTS 64
+#define SERVER_MAX_IOV 16
+#define SERVER_LISTEN_BACKLOG 128
+
+/* batch mode: records are decoded a window at a time,
+ * the read buffer of a stream grows up to the longest record */
+#define BATCH_WINDOW_SIZE 4096
+#define BATCH_READ_BUF_SIZE 1024 * 1024
+#define BATCH_WRITE_BUF_SIZE 1024 * 1024
+#define BATCH_MAX_THREADS 64
+
 /* caching in bytes */
 #define MAX_MEMCACHE_SIZE 160 * 1024 * 1024
+
+/* spare provider codes of a cache matrix, in percent:
+ * codes added within it need no rebuild */
+#define DEFAULT_CACHE_HEADROOM 0
 #define DEFAULT_MATRIX_DEPTH 3
 #define DEFAULT_MAX_UNREC_CHARS 10
 
@@ -27,36 +27,13 @@
 #include "ooconfig.h"
 #include "ooconcunit.h"
 #include "oocode.h"
+#include "ooregion.h"
 
-/*  destructor */
+/*  destructor: the groups with their constraints
+ *  are released together with the region of the MindMap */
 static
 int ooConstraintGroup_del(struct ooConstraintGroup *self)
 {
-    struct ooConstraintGroup *cg, *next_cg;
-    struct ooConstraint *c, *next_c;
-
-    c = self->atomic_constraints;
-    while (c) {
-	next_c = c->next;
-	free(c);
-	c = next_c;
-    }
-
-    cg = self->children;
-    while (cg) {
-	next_cg = cg;
-	cg->del(cg);
-	cg = next_cg->next;
-    }
-
-    cg = self->next;
-    while (cg) {
-	next_cg = cg;
-	cg->del(cg);
-	cg = next_cg->next;
-    }
-
-    free(self);
     return oo_OK;
 }
 
@@ -174,13 +151,14 @@ ooConstraintGroup_read_children(struct ooConstraintGroup *self,
     xmlNode *cur_node;
     struct ooConstraintGroup *cg = NULL;
     struct ooConstraint *c = NULL;
+    struct ooRegion *region = code->cs->region;
     char *value = NULL;
     int ret;
 
     for (cur_node = input_node; cur_node; cur_node = cur_node->next) {
 	if (cur_node->type != XML_ELEMENT_NODE) continue;
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"cgroup"))) {
-	    ret = ooConstraintGroup_new(&cg);
+	    ret = ooConstraintGroup_new(&cg, region);
 	    if (ret != oo_OK) return ret;
 
 	    value = (char*)xmlGetProp(cur_node,  (const xmlChar *)"oper");
@@ -194,7 +172,7 @@ ooConstraintGroup_read_children(struct ooConstraintGroup *self,
 	}
 
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"constraint"))) {
-	    c = malloc(sizeof(struct ooConstraint));
+	    c = region->alloc(region, sizeof(struct ooConstraint));
 	    if (!c) return oo_NOMEM;
 
 	    ret = ooConstraint_read_atomic_constraint(c, code, cur_node);
@@ -237,9 +215,12 @@ ooConstraintGroup_read_XML(struct ooConstraintGroup *self,
 
 /*  ooConstraintGroup Initializer */
 extern int 
-ooConstraintGroup_new(struct ooConstraintGroup **cg)
+ooConstraintGroup_new(struct ooConstraintGroup **cg,
+		      struct ooRegion *region)
 {   
-    struct ooConstraintGroup *self = malloc(sizeof(struct ooConstraintGroup));
+    struct ooConstraintGroup *self;
+
+    self = region->alloc(region, sizeof(struct ooConstraintGroup));
     if (!self) return oo_NOMEM;
 
     self->is_affirmed = true;
@@ -64,5 +64,6 @@ typedef struct ooConstraintGroup
 
 } ooConstraintGroup;
 
-extern int ooConstraintGroup_new(struct ooConstraintGroup **self); 
+extern int ooConstraintGroup_new(struct ooConstraintGroup **self,
+				 struct ooRegion *region);
 #endif
@@ -29,6 +29,7 @@
 #include "oocache.h"
 #include "oosegmentizer.h"
 #include "ooaccumulator.h"
+#include "ootrace.h"
 
 /*  destructor */
 static int
@@ -158,6 +159,8 @@ ooDecoder_add_providers(struct ooDecoder *self,
 	}
 
 	dec->oomnik = self->oomnik;
+	dec->beam = self->beam;
+	dec->budget = self->budget;
 	ret = dec->set_codesystem(dec, provider);
 
 	if (ret != oo_OK) {
@@ -187,6 +190,19 @@ ooDecoder_set_codesystem(struct ooDecoder *self,
 	       cs->name);
 
     self->codesystem = cs;
+
+    /* beam search settings of the controller */
+    if (!self->beam && self->oomnik)
+	self->beam = &self->oomnik->beam;
+
+    if (self->beam) {
+	self->agenda->beam = self->beam;
+	self->segm->agenda->beam = self->beam;
+    }
+
+    self->agenda->budget = self->budget;
+    self->segm->agenda->budget = self->budget;
+
     if (cs->is_atomic) {
 	self->segm->is_atomic = true;
 	self->is_atomic = true;
@@ -228,9 +244,9 @@ ooDecoder_save_result(struct ooDecoder *self)
     size_t i, chunk_size = 0;
     struct ooComplex *c, *best_complex;
 
-    /*if (DEBUG_LEVEL_1)*/
-	printf("\n   ... Saving the decoded results of \"%s\"...\n",
-	   self->input);
+    if (OO_TRACE_ON(OO_TRACE_DECODER))
+	oo_trace_msg(OO_TRACE_DECODER, "saving the decoded results of \"%s\"",
+		     self->input);
 
 
 
@@ -239,6 +255,39 @@ ooDecoder_save_result(struct ooDecoder *self)
     return oo_OK;
 }
 
+/**
+ * a decoder hierarchy serves any number of requests
+ * as long as its CodeSystems stay the same:
+ * everything a request leaves behind is cleared here
+ */
+static int
+ooDecoder_reset(struct ooDecoder *self)
+{
+    struct ooDecoder *dec;
+    size_t i;
+
+    self->input = NULL;
+    self->input_len = 0;
+    self->task_id = 0;
+    self->term_count = 0;
+    self->num_parsed_atoms = 0;
+    self->num_terminals = 0;
+    self->solution = NULL;
+
+    ooStats_reset(&self->stats);
+
+    self->agenda->clear(self->agenda);
+    self->segm->agenda->clear(self->segm->agenda);
+    self->accu->reset(self->accu);
+
+    for (i = 0; i < self->segm->num_decoders; i++) {
+	dec = self->segm->decoders[i];
+	if (!dec) continue;
+	dec->reset(dec);
+    }
+
+    return oo_OK;
+}
 
 /***************************   ANALYSIS ***************************/
 
@@ -252,6 +301,7 @@ ooDecoder_analyze_units(struct ooDecoder *self)
 {
     struct ooAgenda *agenda;
     int num_remaining_solutions;
+    oo_ticks begin;
     int ret;
 
     if (DEBUG_LEVEL_3)
@@ -269,8 +319,10 @@ ooDecoder_analyze_units(struct ooDecoder *self)
 	/*printf("\n\n\nFINAL STATE OF AGENDA (last idx: %d):\n",
 	  agenda->last_idx_pos + 1);*/
 
+	begin = oo_read_ticks();
 	ret = agenda->present_solution(agenda, NULL,
 				       0, agenda->last_idx_pos + 1);
+	ooStats_add_stage(&self->stats, OO_STAGE_SOLUTION, begin);
 	if (ret != oo_OK) return ret;
 
 	num_remaining_solutions = self->segm->num_solutions -\
@@ -302,6 +354,7 @@ ooDecoder_decode(struct ooDecoder *self)
 {
     struct ooLinearCache *cache = self->codesystem->cache;
     struct ooConcUnit *cu;
+    oo_ticks begin, trace_begin, decode_begin;
     int ret;
 
     if (DEBUG_LEVEL_1)
@@ -314,17 +367,27 @@ ooDecoder_decode(struct ooDecoder *self)
     self->agenda->reset(self->agenda);
     self->segm->reset(self->segm);
 
+    self->stats.num_runs++;
+    decode_begin = OO_TRACE_BEGIN(OO_TRACE_DECODER);
+
     /* linear cache is available */
     if (cache) {
+	trace_begin = OO_TRACE_BEGIN(OO_TRACE_CACHE);
+	begin = oo_read_ticks();
 	ret = cache->lookup(cache,
 			    self->segm,
 			    self->input, 
 			    self->input_len,
 			    self->task_id,
 			    self->agenda);
+	ooStats_add_stage(&self->stats, OO_STAGE_CACHE_LOOKUP, begin);
+	OO_TRACE_END(OO_TRACE_CACHE, "cache_lookup", self->codesystem->name, 
+		     trace_begin);
 
 	self->num_parsed_atoms = self->segm->num_parsed_atoms;
 	self->num_terminals = self->segm->num_terminals;
+	OO_TRACE_END(OO_TRACE_DECODER, "decode", self->codesystem->name, 
+		     decode_begin);
 	return oo_OK;
     }
 
@@ -336,10 +399,17 @@ ooDecoder_decode(struct ooDecoder *self)
 	printf("  -- No cache available... Segmentizing input: %zu\n", 
 	   self->input_len);
 
+    trace_begin = OO_TRACE_BEGIN(OO_TRACE_SEGM);
+    begin = oo_read_ticks();
     ret = self->segm->segmentize(self->segm);
+    ooStats_add_stage(&self->stats, OO_STAGE_SEGMENTIZE, begin);
+    OO_TRACE_END(OO_TRACE_SEGM, "segmentize", self->codesystem->name, 
+		 trace_begin);
     if (ret != oo_OK) return ret;
 
     ret = ooDecoder_analyze_units(self);
+    OO_TRACE_END(OO_TRACE_DECODER, "decode", self->codesystem->name, 
+		 decode_begin);
     if (ret != oo_OK) return ret;
 
     /*if (self->is_root)
@@ -379,6 +449,10 @@ ooDecoder_process_string(struct ooDecoder *self,
 	/* buffer is full */
 	buf[INPUT_BUF_SIZE] = '\0';
 
+	/* out of budget: the rest of the input is left out */
+	if (task_id && self->agenda->budget_admit(self->agenda, true) != oo_OK)
+	    return oo_OK;
+
 	self->input = buf;
 	self->input_len = INPUT_BUF_SIZE;
 
@@ -412,7 +486,8 @@ ooDecoder_process_string(struct ooDecoder *self,
     buf[i] = '\0';
 
     /* scan the remainder if any */
-    if (i) {
+    if (i && (!task_id || 
+	      self->agenda->budget_admit(self->agenda, true) == oo_OK)) {
 	self->input = buf;
 	self->input_len = i;
 
@@ -447,6 +522,9 @@ ooDecoder_new(struct ooDecoder **dec)
 
     self->cache_segm = NULL;
     self->oomnik = NULL;
+    self->beam = NULL;
+    self->budget = NULL;
+    memset(&self->root_budget, 0, sizeof(struct ooBudget));
     self->codesystem = NULL;
     self->loops = NULL;
     self->is_root = false;
@@ -474,6 +552,10 @@ ooDecoder_new(struct ooDecoder **dec)
 
     self->format = FORMAT_XML;
 
+    ooStats_reset(&self->stats);
+    self->agenda->stats = &self->stats;
+    self->segm->agenda->stats = &self->stats;
+
     /* bind your methods */
     self->del = ooDecoder_del;
     self->str = ooDecoder_str;
@@ -481,6 +563,7 @@ ooDecoder_new(struct ooDecoder **dec)
     self->decode = ooDecoder_decode;
     self->process = ooDecoder_process_string;
     self->set_codesystem = ooDecoder_set_codesystem;
+    self->reset = ooDecoder_reset;
     *dec = self;
     return oo_OK;
 }
@@ -37,6 +37,15 @@ typedef struct ooDecoder {
     /* main controller */
     struct OOmnik *oomnik;
 
+    /* beam search settings of the knowledge base generation
+     * the request is pinned to, NULL means those of the controller */
+    struct ooBeam *beam;
+
+    /* work budget of the request shared by the whole hierarchy,
+     * the root decoder keeps it in root_budget */
+    struct ooBudget *budget;
+    struct ooBudget root_budget;
+
     /* coding system */
     struct ooCodeSystem *codesystem;
 
@@ -89,12 +98,18 @@ typedef struct ooDecoder {
 
     output_type format;
 
+    /* stage timings and counters */
+    struct ooStats stats;
+
     /***********  public methods ***********/
     int (*del)(struct ooDecoder *self);
     const char* (*str)(struct ooDecoder *self);
 
     int (*set_codesystem)(struct ooDecoder *self, struct ooCodeSystem *cs);
 
+    /* ready the whole hierarchy for the next request */
+    int (*reset)(struct ooDecoder *self);
+
     /* main job */
     int (*process)(struct ooDecoder *self, const char *input);
     int (*decode)(struct ooDecoder *self);
@@ -28,6 +28,7 @@
 
 #include "oodict.h"
 #include "oolist.h"
+#include "oostrpool.h"
 
 static size_t 
 oo_hash(const char *key)
@@ -51,6 +52,49 @@ ooDict_set_hash(struct ooDict *self,
     return oo_OK;
 }
 
+static int
+ooDict_set_pool(struct ooDict *self,
+		struct ooStrPool *pool)
+{
+    self->pool = pool;
+
+    return oo_OK;
+}
+
+/*  interned keys are unique: comparing the pointers is enough */
+static ooDictItem* 
+ooDict_find_interned(struct ooDict *self,
+		     const char *handle)
+{
+    struct ooList *l;
+    struct ooListItem *cur;
+    unsigned int h;
+
+    h = OO_STR_HASH(handle) % self->hash->size;
+
+    l = (struct ooList*)self->hash->data[h];
+
+    for (cur = l->head; cur; cur = cur->next) {
+        if (((struct ooDictItem*)cur->data)->key == handle)
+            return (struct ooDictItem*)cur->data;
+    }
+
+    return NULL;
+}
+
+static void*
+ooDict_get_interned(struct ooDict *self,
+		    const char *handle)
+{
+    struct ooDictItem *item;
+
+    if (!self->pool) return self->get(self, handle);
+
+    item = ooDict_find_interned(self, handle);
+    if (!item) return NULL;
+    return item->data;
+}
+
 static ooDictItem* 
 ooDict_find_item(struct ooDict *self,
 		 const char *key)
@@ -60,6 +104,12 @@ ooDict_find_item(struct ooDict *self,
     const char *cur_key;
     unsigned int h;
 
+    if (self->pool) {
+	key = self->pool->find(self->pool, key);
+	if (!key) return NULL;
+	return ooDict_find_interned(self, key);
+    }
+
     h = oo_hash(key) % self->hash->size;
 
     l = (struct ooList*)self->hash->data[h];
@@ -95,6 +145,20 @@ ooDict_set(struct ooDict *self,
     const char *cur_key;
     unsigned int h;
 
+    if (self->pool) {
+	key = self->pool->intern(self->pool, key);
+	if (!key) return oo_NOMEM;
+
+	item = ooDict_find_interned(self, key);
+	if (item) {
+	    item->data = data;
+	    return oo_OK;
+	}
+	h = OO_STR_HASH(key) % self->hash->size;
+	l = (struct ooList*)self->hash->data[h];
+	goto add;
+    }
+
     h = oo_hash(key) % self->hash->size;
     l = (struct ooList*)self->hash->data[h];
 
@@ -114,11 +178,12 @@ ooDict_set(struct ooDict *self,
         return oo_OK;
     }
 
+add:
     item = (struct ooDictItem*)malloc(sizeof(struct ooDictItem));
     if (!item) return oo_NOMEM;
 
     item->data = data;
-    item->key = strdup(key);
+    item->key = self->pool ? (char*)key : strdup(key);
 
     l->add(l, (void*)item, NULL);
 
@@ -143,16 +208,23 @@ ooDict_remove(struct ooDict *self,
     struct ooListItem *cur;
     unsigned int h;
     
-    h = self->hash_func(key) % self->hash->size;
+    if (self->pool) {
+	key = self->pool->find(self->pool, key);
+	if (!key) return oo_FAIL;
+	h = OO_STR_HASH(key) % self->hash->size;
+    }
+    else
+	h = self->hash_func(key) % self->hash->size;
     l = (ooList*)self->hash->data[h];
 
     cur = l->head;
     while (cur) {
         cur_key = ((struct ooDictItem*)cur->data)->key;
 
-        if (!strcmp(key, cur_key)) {
+        if (self->pool ? cur_key == key : !strcmp(key, cur_key)) {
             data = ((struct ooDictItem*)cur->data)->data;
-            free(cur_key);
+            if (!self->pool)
+		free(cur_key);
             free(cur->data);
             l->remove(l, cur);
             return oo_OK;
@@ -175,7 +247,8 @@ static int ooDict_del(struct ooDict *self)
             cur = l->head;
             while (cur) {
                 item = (struct ooDictItem*)cur->data;
-                free(item->key);
+                if (!self->pool)
+                    free(item->key);
                 free(item);
                 cur = cur->next;
             }
@@ -221,7 +294,10 @@ ooDict_resize(struct ooDict *self,
 	cur = l->head;
 	while (cur) {
 	    item = (struct ooDictItem*)cur->data;
-	    h = self->hash_func(item->key) % self->hash->size;
+	    if (self->pool)
+		h = OO_STR_HASH(item->key) % self->hash->size;
+	    else
+		h = self->hash_func(item->key) % self->hash->size;
 	    new_list = (struct ooList*)self->hash->data[h];
 	    new_list->add(new_list, (void*)item, NULL);
 	    cur = cur->next;
@@ -243,6 +319,9 @@ ooDict_init(struct ooDict *self)
     self->resize        = ooDict_resize;
     self->set_hash      = ooDict_set_hash;
     self->hash_func     = oo_hash;
+    self->set_pool      = ooDict_set_pool;
+    self->get_interned  = ooDict_get_interned;
+    self->pool          = NULL;
 
     return oo_OK;
 }
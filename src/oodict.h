@@ -27,6 +27,8 @@
 #include "ooconfig.h"
 #include "ooarray.h"
 
+struct ooStrPool;
+
 typedef size_t (*oo_hash_func)(const char *key);
 
 typedef struct ooDictItem
@@ -71,8 +73,21 @@ typedef struct ooDict
     oo_compar_func (*set_compare)(struct ooDict *self,
                                   oo_compar_func new_compar_func);
 
+    /*
+     * keep the keys as handles of a string pool
+     * instead of private copies, only for an empty dict
+     */
+    int (*set_pool)(struct ooDict *self,
+                    struct ooStrPool *pool);
+
+    /* get data by a handle of the pool: no string comparisons */
+    void* (*get_interned)(struct ooDict *self,
+                          const char *handle);
+
     /******** private attributes ********/
 
+    struct ooStrPool *pool;
+
     struct ooArray *hash;
 
     oo_hash_func hash_func;
@@ -0,0 +1,434 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oomemory.c
+ *   OOmnik memory accounting implementation
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <libxml/parser.h>
+
+#include "ooconfig.h"
+#include "oomemory.h"
+#include "oomindmap.h"
+#include "oodomain.h"
+#include "ootopic.h"
+#include "oocode.h"
+#include "oocodesystem.h"
+#include "oocache.h"
+#include "oodict.h"
+#include "oostrpool.h"
+#include "oolist.h"
+#include "ooarray.h"
+#include "oodecoder.h"
+#include "ooagenda.h"
+#include "ooaccumulator.h"
+#include "oosegmentizer.h"
+
+static size_t
+oo_memory_str(const char *str)
+{
+    if (!str) return 0;
+    return strlen(str) + 1;
+}
+
+/* the hash table, its lists and the keys:
+ * the values belong to their owners,
+ * interned keys to the string pool */
+static size_t
+oo_memory_dict(struct ooDict *dict)
+{
+    struct ooList *l;
+    struct ooListItem *cur;
+    struct ooDictItem *item;
+    size_t i, size;
+
+    if (!dict) return 0;
+
+    size = sizeof(struct ooDict);
+    if (!dict->hash) return size;
+
+    size += sizeof(struct ooArray) + dict->hash->size * sizeof(void*);
+
+    for (i = 0; i < dict->hash->size; i++) {
+	l = (struct ooList*)dict->hash->data[i];
+	if (!l) continue;
+	size += sizeof(struct ooList);
+
+	for (cur = l->head; cur; cur = cur->next) {
+	    item = (struct ooDictItem*)cur->data;
+	    size += sizeof(struct ooListItem) + sizeof(struct ooDictItem);
+	    if (item && !dict->pool) size += oo_memory_str(item->key);
+	}
+    }
+
+    return size;
+}
+
+static size_t
+oo_memory_spec_list(struct ooCodeSpec *spec)
+{
+    size_t size = 0;
+
+    for (; spec; spec = spec->next)
+	size += sizeof(struct ooCodeSpec);
+
+    return size;
+}
+
+static size_t
+oo_memory_code_unit(struct ooCodeUnit *unit)
+{
+    size_t i, size;
+
+    size = sizeof(struct ooCodeUnit) + unit->num_specs * sizeof(void*);
+
+    for (i = 0; i < unit->num_specs; i++) {
+	if (!unit->specs[i]) continue;
+	size += sizeof(struct ooCodeUnitSpec);
+	if (unit->specs[i]->unit)
+	    size += oo_memory_code_unit(unit->specs[i]->unit);
+    }
+
+    return size;
+}
+
+static int
+oo_memory_usage(struct ooCodeSystemMemory *self,
+		struct ooCodeUsage *usage)
+{
+    size_t i;
+
+    self->usages += sizeof(struct ooCodeUsage) +\
+	usage->num_usages * sizeof(void*);
+
+    for (i = 0; i < usage->num_usages; i++)
+	oo_memory_usage(self, usage->usages[i]);
+
+    /* derivations are owned by their usages */
+    self->derivs += usage->num_derivs * sizeof(void*);
+
+    self->derivs += usage->num_derivs * sizeof(struct ooCodeDeriv);
+
+    return oo_OK;
+}
+
+static int
+oo_memory_code(struct ooCodeSystemMemory *self,
+	       struct ooCode *code)
+{
+    size_t i, size;
+
+    /* the names are counted with the string pool */
+    size = sizeof(struct ooCode);
+
+    /* denotations */
+    size += code->num_denots * 2 * sizeof(void*);
+
+    /* implications */
+    size += code->num_implied_codes * 2 * sizeof(void*);
+
+    /* cached sequences with their contexts */
+    if (code->cache) {
+	size += sizeof(struct ooCodeCache) +\
+	    code->cache->num_seqs * 2 * sizeof(void*);
+
+	for (i = 0; i < code->cache->num_seqs; i++) {
+	    size += oo_memory_str(code->cache->seqs[i]);
+	    if (code->cache->contexts[i])
+		size += sizeof(struct ooAdaptContext);
+	}
+    }
+
+    if (code->shared)
+	size += oo_memory_code_unit(code->shared);
+    if (code->shared_template)
+	size += sizeof(struct ooCodeTemplate);
+
+    self->codes += size;
+
+    /* syntax */
+    for (i = 0; i < OO_NUM_OPERS; i++) {
+	self->specs += oo_memory_spec_list(code->children[i]);
+	self->specs += oo_memory_spec_list(code->parents[i]);
+	self->derivs += code->num_deriv_refs[i] * sizeof(struct ooCodeDerivRef);
+    }
+
+    self->specs += (code->num_parent_links + code->num_child_links) *\
+	sizeof(struct ooCodeLink);
+
+    /* semantics */
+    self->usages += code->num_usages * sizeof(void*);
+    for (i = 0; i < code->num_usages; i++)
+	oo_memory_usage(self, code->usages[i]);
+
+    return oo_OK;
+}
+
+static int
+oo_memory_cache(struct ooCodeSystemMemory *self,
+		struct ooLinearCache *cache)
+{
+    struct ooLinearCacheCell *cell;
+    struct ooLinearCacheTail *tail;
+    struct ooCodeMatch *match;
+    size_t i, j, *num_codes;
+
+    self->cache_matrix += sizeof(struct ooLinearCache) +\
+	oo_memory_str(cache->provider_name);
+
+    if (cache->matrix) {
+	self->cache_matrix += cache->matrix_size;
+
+	for (i = 0; i < cache->num_cells; i++) {
+	    cell = cache->matrix[i];
+	    if (!cell) continue;
+
+	    self->cache_cells += sizeof(struct ooLinearCacheCell) +\
+		cell->num_tails * sizeof(void*);
+
+	    for (j = 0; j < cell->num_tails; j++) {
+		tail = cell->tails[j];
+		self->cache_tails += sizeof(struct ooLinearCacheTail) +\
+		    tail->num_units * sizeof(size_t);
+
+		for (match = tail->code_match; match; match = match->next)
+		    self->cache_tails += sizeof(struct ooCodeMatch);
+	    }
+	}
+    }
+
+    if (cache->row_sizes)
+	self->cache_matrix += cache->matrix_depth * sizeof(size_t);
+
+    /* sequence dictionaries: the code lists and their sizes
+     * are owned by the cache, the keys belong to the codes */
+    self->cache_dicts += oo_memory_dict(cache->codes) +\
+	oo_memory_dict(cache->code_list_sizes) +\
+	cache->num_codes * sizeof(void*) +\
+	cache->num_pending_seqs * sizeof(void*);
+
+    for (i = 0; i < cache->num_codes; i++) {
+	num_codes = cache->code_list_sizes->get(cache->code_list_sizes,
+					  (const char*)cache->codeseqs[i]);
+	if (!num_codes) continue;
+	self->cache_dicts += sizeof(size_t) + *num_codes * sizeof(void*);
+    }
+
+    return oo_OK;
+}
+
+extern int
+ooCodeSystemMemory_measure(struct ooCodeSystemMemory *self,
+			   struct ooCodeSystem *cs)
+{
+    size_t i;
+
+    memset(self, 0, sizeof(struct ooCodeSystemMemory));
+
+    self->codes = sizeof(struct ooCodeSystem) + oo_memory_str(cs->name) +\
+	cs->num_codes * sizeof(void*);
+
+    if (cs->code_index)
+	self->codes += (cs->code_index_capacity + 1) * sizeof(void*);
+
+    /* slot 0 stands for an unrecognized code */
+    for (i = 1; cs->code_index && i < cs->num_codes; i++) {
+	if (!cs->code_index[i]) continue;
+	oo_memory_code(self, cs->code_index[i]);
+    }
+
+    self->dicts = oo_memory_dict(cs->codes) +\
+	oo_memory_dict(cs->name_refs);
+
+    if (cs->cache)
+	oo_memory_cache(self, cs->cache);
+
+    if (cs->numeric_denotmap)
+	self->numeric_denotmap = sizeof(NUMERIC_CODE_TYPE) * (UCS2_MAX + 1);
+
+    self->total = self->codes + self->specs + self->usages + self->derivs +\
+	self->dicts + self->cache_matrix + self->cache_cells +\
+	self->cache_tails + self->cache_dicts + self->numeric_denotmap;
+
+    return oo_OK;
+}
+
+extern int
+ooMindMapMemory_measure(struct ooMindMapMemory *self,
+			struct ooMindMap *mm)
+{
+    struct ooConcept *conc;
+    struct ooDomain *domain;
+    struct ooTopic *topic;
+    size_t i;
+
+    memset(self, 0, sizeof(struct ooMindMapMemory));
+
+    for (i = 0; i < mm->num_concepts; i++) {
+	conc = mm->concept_index[i];
+	if (!conc) continue;
+
+	self->concepts += sizeof(struct ooConcept) +\
+	    oo_memory_str(conc->id) + oo_memory_str(conc->name) +\
+	    oo_memory_str(conc->annot) + conc->bytecode_size +\
+	    conc->_num_attrs * (sizeof(void*) + sizeof(struct ooAttr));
+    }
+
+    self->concept_index = mm->concept_index_size * sizeof(void*);
+    self->name_index = oo_memory_dict(mm->_name_index);
+
+    self->domains = mm->num_domains * sizeof(void*);
+    for (i = 0; i < mm->num_domains; i++) {
+	domain = mm->domains[i];
+	self->domains += sizeof(struct ooDomain) +\
+	    oo_memory_str(domain->id) + oo_memory_str(domain->name) +\
+	    oo_memory_str(domain->title) +\
+	    (domain->num_subdomains + domain->num_concepts) * sizeof(void*);
+    }
+
+    /* topic 0 is a placeholder */
+    self->topics = mm->num_topics * sizeof(void*);
+    for (i = 0; i < mm->num_topics; i++) {
+	topic = mm->topics[i];
+	if (!topic) continue;
+
+	self->topics += sizeof(struct ooTopic) + oo_memory_str(topic->name) +\
+	    (topic->num_ingredients + topic->num_topics) * sizeof(void*);
+
+	self->topics += topic->num_ingredients * sizeof(struct ooTopicIngredient);
+    }
+
+    if (mm->topic_index)
+	self->topic_index = mm->num_concepts * sizeof(void*);
+
+    if (mm->names)
+	self->names = mm->names->total_size;
+
+    self->total = self->concepts + self->concept_index + self->name_index +\
+	self->domains + self->topics + self->topic_index + self->names;
+
+    return oo_OK;
+}
+
+extern int
+ooRequestMemory_measure(struct ooRequestMemory *self,
+			struct ooDecoder *dec)
+{
+    struct ooSegmentizer *segm = dec->segm;
+    struct ooAccu *accu = dec->accu;
+    int i;
+
+    self->num_decoders++;
+
+    self->decoders += sizeof(struct ooDecoder) + sizeof(struct ooSegmentizer) +\
+	dec->num_parents * sizeof(void*);
+    self->agendas += sizeof(struct ooAgenda) * 2;
+
+    self->accus += sizeof(struct ooAccu);
+    if (accu->topic_index && dec->codesystem)
+	self->accus += dec->codesystem->mindmap->num_topics * sizeof(void*);
+    if (accu->concept_index)
+	self->accus += accu->num_concepts * sizeof(void*);
+    if (accu->output_buf)
+	self->output_buffers += accu->output_total_space;
+
+    if (!segm->decoders) goto total;
+
+    self->decoders += segm->num_decoders * sizeof(void*);
+
+    for (i = 0; i < segm->num_decoders; i++) {
+	if (!segm->decoders[i]) continue;
+	ooRequestMemory_measure(self, segm->decoders[i]);
+    }
+
+ total:
+    self->total = self->decoders + self->agendas + self->accus +\
+	self->output_buffers;
+
+    return oo_OK;
+}
+
+extern int
+ooCodeSystemMemory_present(struct ooCodeSystemMemory *self,
+			   const char *name,
+			   char *buf,
+			   size_t buf_size)
+{
+    int chunk_size;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"name\":\"%s\",\"total\":%zu,"
+			  "\"codes\":%zu,\"specs\":%zu,\"usages\":%zu,"
+			  "\"derivs\":%zu,\"dicts\":%zu,"
+			  "\"cache\":{\"matrix\":%zu,\"cells\":%zu,"
+			  "\"tails\":%zu,\"dicts\":%zu},"
+			  "\"numeric_denotmap\":%zu}",
+			  name, self->total,
+			  self->codes, self->specs, self->usages,
+			  self->derivs, self->dicts,
+			  self->cache_matrix, self->cache_cells,
+			  self->cache_tails, self->cache_dicts,
+			  self->numeric_denotmap);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+
+    return oo_OK;
+}
+
+extern int
+ooMindMapMemory_present(struct ooMindMapMemory *self,
+			char *buf,
+			size_t buf_size)
+{
+    int chunk_size;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"total\":%zu,\"concepts\":%zu,"
+			  "\"concept_index\":%zu,\"name_index\":%zu,"
+			  "\"domains\":%zu,\"topics\":%zu,\"topic_index\":%zu,"
+			  "\"names\":%zu}",
+			  self->total, self->concepts,
+			  self->concept_index, self->name_index,
+			  self->domains, self->topics, self->topic_index,
+			  self->names);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+
+    return oo_OK;
+}
+
+extern int
+ooRequestMemory_present(struct ooRequestMemory *self,
+			const char *name,
+			char *buf,
+			size_t buf_size)
+{
+    int chunk_size;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"codesystem\":\"%s\",\"total\":%zu,"
+			  "\"num_decoders\":%zu,\"decoders\":%zu,"
+			  "\"agendas\":%zu,\"accus\":%zu,"
+			  "\"output_buffers\":%zu}",
+			  name, self->total,
+			  self->num_decoders, self->decoders,
+			  self->agendas, self->accus,
+			  self->output_buffers);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+
+    return oo_OK;
+}
@@ -0,0 +1,129 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oomemory.h
+ *   OOmnik memory accounting
+ */
+
+#ifndef OO_MEMORY_H
+#define OO_MEMORY_H
+
+#include <stddef.h>
+
+#include "ooconfig.h"
+
+struct ooCodeSystem;
+struct ooMindMap;
+struct ooDecoder;
+
+/**
+ *  Memory held by a loaded CodeSystem,
+ *  all figures are requested bytes
+ *  without the allocator overhead
+ */
+typedef struct ooCodeSystemMemory {
+    /* code objects with their names, denotations,
+     * cached sequences and shared units */
+    size_t codes;
+
+    /* syntactic specs and the linking tables */
+    size_t specs;
+
+    /* semantic usages */
+    size_t usages;
+
+    /* derivations and the derivation index */
+    size_t derivs;
+
+    /* name dictionary of the codes */
+    size_t dicts;
+
+    /* Linear Cache */
+    size_t cache_matrix;
+    size_t cache_cells;
+    size_t cache_tails;
+    size_t cache_dicts;
+
+    /* direct Unicode/ASCII lookup table */
+    size_t numeric_denotmap;
+
+    size_t total;
+} ooCodeSystemMemory;
+
+/**
+ *  Memory held by the MindMap itself
+ */
+typedef struct ooMindMapMemory {
+    size_t concepts;
+    size_t concept_index;
+    size_t name_index;
+    size_t domains;
+    size_t topics;
+    size_t topic_index;
+
+    /* interned names of codes, concepts and topics */
+    size_t names;
+
+    size_t total;
+} ooMindMapMemory;
+
+/**
+ *  Working memory of a single request:
+ *  the whole hierarchy of Decoders
+ */
+typedef struct ooRequestMemory {
+    size_t num_decoders;
+
+    /* Decoder and Segmentizer objects */
+    size_t decoders;
+    size_t agendas;
+
+    /* Accumulators without their output buffers */
+    size_t accus;
+    size_t output_buffers;
+
+    size_t total;
+} ooRequestMemory;
+
+
+/* walk the codes and the cache of a CodeSystem */
+extern int ooCodeSystemMemory_measure(struct ooCodeSystemMemory *self,
+				      struct ooCodeSystem *cs);
+
+/* concepts, domains, topics and the indices */
+extern int ooMindMapMemory_measure(struct ooMindMapMemory *self,
+				   struct ooMindMap *mm);
+
+/* add up a Decoder and all its subordinate Decoders */
+extern int ooRequestMemory_measure(struct ooRequestMemory *self,
+				   struct ooDecoder *dec);
+
+/* JSON representations */
+extern int ooCodeSystemMemory_present(struct ooCodeSystemMemory *self,
+				      const char *name,
+				      char *buf,
+				      size_t buf_size);
+
+extern int ooMindMapMemory_present(struct ooMindMapMemory *self,
+				   char *buf,
+				   size_t buf_size);
+
+extern int ooRequestMemory_present(struct ooRequestMemory *self,
+				   const char *name,
+				   char *buf,
+				   size_t buf_size);
+
+#endif /* OO_MEMORY_H */
@@ -22,9 +22,11 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <db.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "oocodesystem.h"
 #include "oomindmap.h"
@@ -33,6 +35,10 @@
 #include "oodomain.h"
 #include "ooutils.h"
 #include "oodict.h"
+#include "ooconcstore.h"
+#include "ooxmlpool.h"
+#include "oostrpool.h"
+#include "ooregion.h"
 
 #include "ooconfig.h"
 
@@ -61,6 +67,9 @@ ooMindMap_del(struct ooMindMap *self)
     if (self->_storage)
 	ret = self->_storage->close(self->_storage, 0);
 
+    if (self->_concept_store)
+	self->_concept_store->del(self->_concept_store);
+
     /* remove codesystems */
     for (i = 0; i < self->num_codesystems; i++)
 	if (self->codesystems[i]) 
@@ -97,6 +106,13 @@ ooMindMap_del(struct ooMindMap *self)
 	free(self->topics);
     }
 
+    if (self->region)
+	self->region->del(self->region);
+
+    /* the names go last: everything above may refer to them */
+    if (self->names)
+	self->names->del(self->names);
+
     free(self);
 
     return oo_OK;
@@ -210,12 +226,39 @@ ooMindMap_drop(struct ooMindMap *self, mindmap_size_t concid)
 }
 
 
+/*  a concept read in place from the mapped Concept Store */
+static struct ooConcept* 
+ooMindMap_get_mapped(struct ooMindMap *self, mindmap_size_t id)
+{
+    const struct ooPackedConcept *pc;
+    struct ooConcept *conc = NULL;
+    int ret;
+
+    pc = self->get_packed(self, id);
+    if (!pc) return NULL;
+
+    ret = ooConcept_new(&conc);
+    if (ret != oo_OK) return NULL;
+
+    conc->numid = id;
+
+    ret = conc->unpack_store(conc, pc);
+    if (ret != oo_OK) {
+	conc->del(conc);
+	return NULL;
+    }
+
+    self->concept_index[id] = conc;
+
+    return conc;
+}
+
 /**
  *  Retrieving a concept:
  *  if it's already cached in memory,
  *  return a reference to it,
- *  otherwise check the MindMap DB
- *  and initialize a new concept.
+ *  otherwise check the Concept Store if mapped
+ *  or the MindMap DB and initialize a new concept.
  */
 static struct ooConcept* 
 ooMindMap_get(struct ooMindMap *self, mindmap_size_t id)
@@ -225,7 +268,6 @@ ooMindMap_get(struct ooMindMap *self, mindmap_size_t id)
     int ret;
 
     struct ooConcept *conc = NULL;
-    char *key_buffer;
     static mindmap_size_t idsize = sizeof(mindmap_size_t);
 
     if (id > self->num_concepts) return NULL;
@@ -234,19 +276,17 @@ ooMindMap_get(struct ooMindMap *self, mindmap_size_t id)
     conc = (struct ooConcept*)self->concept_index[id];
     if (conc) return conc;
 
+    if (self->_concept_store)
+	return ooMindMap_get_mapped(self, id);
+
     dbp = self->_storage;
 
     /* initialize the DBTs */
     memset(&key, 0, sizeof(DBT));
     memset(&data, 0, sizeof(DBT));
 
-    key_buffer = malloc(idsize);
-    if (!key_buffer) return NULL;
-
-    memcpy(key_buffer, &id, idsize);
-
     /* set the search key with the Concept id */
-    key.data = key_buffer;
+    key.data = &id;
     key.size = idsize;
 
     /* get the record */
@@ -261,64 +301,446 @@ ooMindMap_get(struct ooMindMap *self, mindmap_size_t id)
     ret = ooConcept_new(&conc);
     if (ret != oo_OK) return NULL;
 
+    /* the record buffer belongs to the DB:
+     * the attributes are read from our own copy */
     conc->numid = id;
-    conc->bytecode = (char*)data.data;
+    conc->bytecode = malloc(data.size);
+    if (!conc->bytecode) {
+	conc->del(conc);
+	return NULL;
+    }
+    memcpy(conc->bytecode, data.data, data.size);
     conc->bytecode_size = (size_t)data.size;
-    conc->unpack(conc);
+
+    ret = conc->unpack(conc);
+    if (ret != oo_OK) {
+	conc->del(conc);
+	return NULL;
+    }
 
     /* update the cache */
     self->concept_index[id] = conc;
 
-    free(key_buffer);
-
     return conc;
 }
 
+/*  mapping the Concept Store */
 static int
-ooMindMap_keys(struct ooMindMap *self,
-	       mindmap_size_t  **ids,
-	       mindmap_size_t    batch_size,
-	       mindmap_size_t    batch_start)
-{   DBT key, data;
+ooMindMap_open_store(struct ooMindMap *self,
+		     const char *filename)
+{
+    int ret;
+
+    if (!self->_concept_store) {
+	ret = ooConceptStore_new(&self->_concept_store);
+	if (ret != oo_OK) return ret;
+    }
+
+    return self->_concept_store->open(self->_concept_store, filename);
+}
+
+/**
+ *  the record stays in the mapped file:
+ *  no allocations and no locking
+ */
+static const struct ooPackedConcept*
+ooMindMap_get_packed(struct ooMindMap *self,
+		     mindmap_size_t id)
+{
+    if (!self->_concept_store) return NULL;
+
+    return self->_concept_store->get(self->_concept_store, id);
+}
+
+/*  converting the MindMap DB into a Concept Store */
+static int
+ooMindMap_build_store(struct ooMindMap *self,
+		      const char *filename)
+{
+    return ooConceptStore_import(self->_storage, filename);
+}
+
+/*  opening a bulk cursor over the MindMap DB */
+static int
+ooMindMap_cursor_open(struct ooMindMap *self,
+		      struct ooMindMapCursor *cursor,
+		      void *buf,
+		      size_t buf_size)
+{
     DB *dbp;
-    DBC *dbcp;
     int ret;
 
     dbp = self->_storage;
 
-    /* initialize the key/data pair */
-    memset(&key, 0, sizeof(DBT));
-    memset(&data, 0, sizeof(DBT));
+    memset(cursor, 0, sizeof(struct ooMindMapCursor));
 
-    /* acquire a cursor for the database */
-    if ((ret = dbp->cursor(dbp, NULL, &dbcp, 0)) != 0) {
+    /* the DB fills the caller's buffer with whole batches */
+    cursor->bulk.data = buf;
+    cursor->bulk.ulen = (u_int32_t)buf_size;
+    cursor->bulk.flags = DB_DBT_USERMEM;
+
+    ret = dbp->cursor(dbp, NULL, &cursor->dbc, 0);
+    if (ret != 0) {
 	dbp->err(dbp, ret, "DB->cursor");
-	goto error;
+	cursor->dbc = NULL;
+	return oo_FAIL;
     }
 
-    /* TODO: batching */
+    return oo_OK;
+}
 
-    /* walk through the database and print out the key/data pairs. */
-    while ((ret = dbcp->c_get(dbcp, &key, &data, DB_NEXT)) == 0)
-	printf("%.*s : %.*s\n",
-	       (int)key.size, (char *)key.data,
-	       (int)data.size, (char *)data.data);
-    if (ret != DB_NOTFOUND)
-    {	dbp->err(dbp, ret, "DBcursor->get");
-	goto error;
+/*  next record of the current batch,
+ *  fetching a new batch when it's over */
+static int
+ooMindMap_cursor_next(struct ooMindMap *self,
+		      struct ooMindMapCursor *cursor,
+		      const void **key,
+		      size_t *key_size,
+		      const void **data,
+		      size_t *data_size)
+{
+    DB *dbp;
+    DBT key_unused;
+    void *retkey, *retdata;
+    u_int32_t retklen, retdlen;
+    int ret;
+
+    dbp = self->_storage;
+
+    if (!cursor->dbc) return oo_FAIL;
+
+    while (1) {
+	if (cursor->pos) {
+	    DB_MULTIPLE_KEY_NEXT(cursor->pos, &cursor->bulk,
+				 retkey, retklen, retdata, retdlen);
+	    if (cursor->pos) {
+		*key = retkey;
+		*key_size = (size_t)retklen;
+		*data = retdata;
+		*data_size = (size_t)retdlen;
+		return oo_OK;
+	    }
+	}
+
+	memset(&key_unused, 0, sizeof(DBT));
+
+	ret = cursor->dbc->c_get(cursor->dbc, &key_unused, &cursor->bulk,
+				 DB_MULTIPLE_KEY | DB_NEXT);
+	if (ret == DB_NOTFOUND)
+	    return oo_NO_RESULTS;
+
+	if (ret == DB_BUFFER_SMALL) {
+	    fprintf(stderr, "  -- MindMap record of %lu bytes "
+		    "exceeds the bulk buffer of %lu bytes\n",
+		    (unsigned long)cursor->bulk.size,
+		    (unsigned long)cursor->bulk.ulen);
+	    return oo_NOMEM;
+	}
+
+	if (ret != 0) {
+	    dbp->err(dbp, ret, "DBcursor->get");
+	    return oo_FAIL;
+	}
+
+	DB_MULTIPLE_INIT(cursor->pos, &cursor->bulk);
+    }
+
+    return oo_OK;
+}
+
+/*  fetch the batch starting at the given key or the next one after it */
+static int
+ooMindMap_cursor_seek(struct ooMindMap *self,
+		      struct ooMindMapCursor *cursor,
+		      const void *key,
+		      size_t key_size)
+{
+    DB *dbp;
+    DBT seek_key;
+    mindmap_size_t id;
+    int ret;
+
+    dbp = self->_storage;
+
+    if (!cursor->dbc) return oo_FAIL;
+    if (key_size != sizeof(mindmap_size_t)) return oo_FAIL;
+
+    /* the DB may write the found key over ours */
+    memcpy(&id, key, key_size);
+
+    memset(&seek_key, 0, sizeof(DBT));
+    seek_key.data = &id;
+    seek_key.size = (u_int32_t)key_size;
+
+    ret = cursor->dbc->c_get(cursor->dbc, &seek_key, &cursor->bulk,
+			     DB_MULTIPLE_KEY | DB_SET_RANGE);
+    if (ret == DB_NOTFOUND)
+	return oo_NO_RESULTS;
+
+    if (ret != 0) {
+	dbp->err(dbp, ret, "DBcursor->get");
+	return oo_FAIL;
     }
 
-    /* close everything down */
-    if ((ret = dbcp->c_close(dbcp)) != 0) {
+    DB_MULTIPLE_INIT(cursor->pos, &cursor->bulk);
+
+    return oo_OK;
+}
+
+static int
+ooMindMap_cursor_close(struct ooMindMap *self,
+		       struct ooMindMapCursor *cursor)
+{
+    DB *dbp;
+    int ret;
+
+    dbp = self->_storage;
+
+    if (!cursor->dbc) return oo_OK;
+
+    ret = cursor->dbc->c_close(cursor->dbc);
+    cursor->dbc = NULL;
+    cursor->pos = NULL;
+
+    if (ret != 0) {
 	dbp->err(dbp, ret, "DBcursor->close");
-	goto error;
+	return oo_FAIL;
     }
 
     return oo_OK;
+}
+
+/**
+ *  the ids come in the DB order:
+ *  a caller walks the whole DB by passing the last id
+ *  of every batch until num_ids falls short of batch_size,
+ *  each batch is found by a range lookup
+ */
+static int
+ooMindMap_keys(struct ooMindMap *self,
+	       mindmap_size_t   *ids,
+	       size_t            batch_size,
+	       const mindmap_size_t *last_id,
+	       size_t           *num_ids)
+{
+    struct ooMindMapCursor cursor;
+    const void *key, *data;
+    size_t key_size, data_size;
+    void *buf;
+    int ret;
+
+    *num_ids = 0;
 
-error:	
-    (void)dbp->close(dbp, 0);
-    return oo_FAIL;
+    buf = malloc(MINDMAP_BULK_BUF_SIZE);
+    if (!buf) return oo_NOMEM;
+
+    ret = ooMindMap_cursor_open(self, &cursor, buf, MINDMAP_BULK_BUF_SIZE);
+    if (ret != oo_OK) goto final;
+
+    if (last_id) {
+	ret = ooMindMap_cursor_seek(self, &cursor,
+				    last_id, sizeof(mindmap_size_t));
+	if (ret != oo_OK) goto close;
+    }
+
+    while (*num_ids < batch_size) {
+	ret = ooMindMap_cursor_next(self, &cursor,
+				    &key, &key_size, &data, &data_size);
+	if (ret != oo_OK) break;
+
+	if (key_size != sizeof(mindmap_size_t)) continue;
+
+	/* the range starts with the last id itself */
+	if (last_id && !memcmp(key, last_id, sizeof(mindmap_size_t)))
+	    continue;
+
+	memcpy(&ids[*num_ids], key, sizeof(mindmap_size_t));
+	(*num_ids)++;
+    }
+
+close:
+    if (ret == oo_NO_RESULTS) ret = oo_OK;
+
+    ooMindMap_cursor_close(self, &cursor);
+
+final:
+    free(buf);
+    return ret;
+}
+
+/*  writing out a full bulk buffer */
+static int
+ooMindMap_bulk_flush(struct ooMindMap *self,
+		     DBT *bulk,
+		     void **pos,
+		     size_t *num_records)
+{
+    DB *dbp;
+    DBT data_unused;
+    int ret;
+
+    dbp = self->_storage;
+
+    if (*num_records) {
+	memset(&data_unused, 0, sizeof(DBT));
+
+	ret = dbp->put(dbp, NULL, bulk, &data_unused, DB_MULTIPLE_KEY);
+	if (ret != 0) {
+	    dbp->err(dbp, ret, "DB->put");
+	    return oo_FAIL;
+	}
+    }
+
+    *num_records = 0;
+    DB_MULTIPLE_WRITE_INIT(*pos, bulk);
+
+    return oo_OK;
+}
+
+/*  appending a record to the bulk buffer */
+static int
+ooMindMap_bulk_add(struct ooMindMap *self,
+		   DBT *bulk,
+		   void **pos,
+		   size_t *num_records,
+		   void *key,
+		   size_t key_size,
+		   void *data,
+		   size_t data_size)
+{
+    DB *dbp;
+    DBT single_key, single_data;
+    int ret;
+
+    dbp = self->_storage;
+
+    DB_MULTIPLE_KEY_WRITE_NEXT(*pos, bulk,
+			       key, key_size, data, data_size);
+    if (*pos) {
+	(*num_records)++;
+	return oo_OK;
+    }
+
+    ret = ooMindMap_bulk_flush(self, bulk, pos, num_records);
+    if (ret != oo_OK) return ret;
+
+    DB_MULTIPLE_KEY_WRITE_NEXT(*pos, bulk,
+			       key, key_size, data, data_size);
+    if (*pos) {
+	(*num_records)++;
+	return oo_OK;
+    }
+
+    /* a record larger than the whole buffer goes on its own */
+    DB_MULTIPLE_WRITE_INIT(*pos, bulk);
+
+    memset(&single_key, 0, sizeof(DBT));
+    memset(&single_data, 0, sizeof(DBT));
+    single_key.data = key;
+    single_key.size = (u_int32_t)key_size;
+    single_data.data = data;
+    single_data.size = (u_int32_t)data_size;
+
+    ret = dbp->put(dbp, NULL, &single_key, &single_data, 0);
+    if (ret != 0) {
+	dbp->err(dbp, ret, "DB->put");
+	return oo_FAIL;
+    }
+
+    return oo_OK;
+}
+
+/*  the DB compares the keys bytewise */
+static int
+ooMindMap_compare_keys(const void *a,
+		       const void *b)
+{
+    const struct ooConcept *conc_a = *(const struct ooConcept**)a;
+    const struct ooConcept *conc_b = *(const struct ooConcept**)b;
+
+    return memcmp(&conc_a->numid, &conc_b->numid, sizeof(mindmap_size_t));
+}
+
+/**
+ *  the concepts are packed and inserted in the key order
+ *  so that the btree pages fill up sequentially,
+ *  the DB is synced only once at the end
+ */
+static int
+ooMindMap_save_concepts(struct ooMindMap *self)
+{
+    DB *dbp;
+    DBT bulk;
+    struct ooConcept **concepts = NULL;
+    struct ooConcept *conc;
+    size_t num_concepts = 0;
+    size_t num_records = 0;
+    void *pos;
+    size_t i;
+    int ret = oo_OK;
+
+    dbp = self->_storage;
+
+    memset(&bulk, 0, sizeof(DBT));
+    bulk.ulen = MINDMAP_BULK_BUF_SIZE;
+    bulk.flags = DB_DBT_USERMEM | DB_DBT_BULK;
+    bulk.data = malloc(MINDMAP_BULK_BUF_SIZE);
+    if (!bulk.data) return oo_NOMEM;
+
+    concepts = malloc(sizeof(struct ooConcept*) * (self->num_concepts + 1));
+    if (!concepts) {
+	ret = oo_NOMEM;
+	goto final;
+    }
+
+    for (i = 1; i <= self->num_concepts; i++) {
+	conc = self->concept_index[i];
+	if (!conc) continue;
+	concepts[num_concepts++] = conc;
+    }
+
+    qsort(concepts, num_concepts,
+	  sizeof(struct ooConcept*), ooMindMap_compare_keys);
+
+    DB_MULTIPLE_WRITE_INIT(pos, &bulk);
+
+    for (i = 0; i < num_concepts; i++) {
+	conc = concepts[i];
+
+	ret = conc->pack(conc, PACK_COMPACT);
+	if (ret != oo_OK) goto final;
+
+	ret = ooMindMap_bulk_add(self, &bulk, &pos, &num_records,
+				 &conc->numid, sizeof(mindmap_size_t),
+				 conc->bytecode, conc->bytecode_size);
+
+	/* the bulk buffer keeps its own copy */
+	free(conc->bytecode);
+	conc->bytecode = NULL;
+	conc->bytecode_size = 0;
+
+	if (ret != oo_OK) goto final;
+
+	conc->_is_modified = false;
+    }
+
+    ret = ooMindMap_bulk_flush(self, &bulk, &pos, &num_records);
+    if (ret != oo_OK) goto final;
+
+    if ((ret = dbp->sync(dbp, 0)) != 0) {
+	dbp->err(dbp, ret, "DB->sync");
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    if (DEBUG_LEVEL_2)
+	printf("  ++ %lu concepts saved to the MindMap DB\n",
+	       (unsigned long)num_concepts);
+
+final:
+    if (concepts) free(concepts);
+    free(bulk.data);
+    return ret;
 }
 
 /*  looking up a concept by its atomic name */
@@ -331,6 +753,15 @@ ooMindMap_lookup(struct ooMindMap *self,
     return (struct ooConcept *)self->_name_index->get(self->_name_index, name);
 }
 
+/*  the name is a handle of self->names */
+static struct ooConcept* 
+ooMindMap_lookup_interned(struct ooMindMap *self, 
+			  const char *name)
+{
+    return (struct ooConcept *)self->_name_index->get_interned(self->_name_index,
+								name);
+}
+
 static struct ooCodeSystem* 
 ooMindMap_get_codesystem(struct ooMindMap *self, 
 			 const char *cs_uri)
@@ -431,7 +862,7 @@ ooMindMap_add_concept(struct ooMindMap *self,
 
 static int
 ooMindMap_read_codesystem(struct ooMindMap *self, 
-			 xmlNode *xmlcur,
+			  xmlTextReaderPtr reader,
 			  const char *path,
 			  size_t path_size)
 {
@@ -446,7 +877,12 @@ ooMindMap_read_codesystem(struct ooMindMap *self,
     cs->mindmap = self;
     cs->filename = path;
 
-    ret = cs->read(cs, xmlcur);
+    /* code names are interned in the MindMap pool,
+     * the codes themselves live in its region */
+    cs->codes->set_pool(cs->codes, self->names);
+    cs->region = self->region;
+
+    ret = cs->read_stream(cs, reader);
     if (ret != oo_OK) {
 	fprintf(stderr,
 		"Failed to initialize the CodeSystem :(\n");
@@ -486,6 +922,8 @@ ooMindMap_add_topic(struct ooMindMap *self,
     ret = ooTopic_new(&topic);
     if (ret != oo_OK) return oo_FAIL;
 
+    topic->names = self->names;
+
     if (topic->read(topic, xmlcur) != oo_OK) {
 	fprintf(stderr,
 		"Failed to read the topic in %s :(\n", path);
@@ -682,6 +1120,69 @@ ooMindMap_read_include(struct ooMindMap *self,
 
 
 
+/**
+ * stream the codesystems of a <conceptlist> file,
+ * oo_NO_RESULTS for any other kind of file
+ */
+static int
+ooMindMap_stream_import(struct ooMindMap *self, 
+			const char *filename)
+{
+    xmlTextReaderPtr reader;
+    char *path = NULL;
+    size_t path_size;
+    int ret;
+
+    reader = xmlReaderForFile(filename, NULL, 0);
+    if (!reader) return oo_NO_RESULTS;
+
+    /* find the root element */
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+	if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) break;
+    }
+
+    if (ret != 1 ||
+	xmlStrcmp(xmlTextReaderConstName(reader), (const xmlChar *)"conceptlist")) {
+	xmlFreeTextReader(reader);
+	return oo_NO_RESULTS;
+    }
+
+    ret = oo_extract_dirpath(filename, &path, &path_size);
+    if (ret != oo_OK) goto final;
+
+    if (DEBUG_LEVEL_1)
+	printf(" -- MindMap: streaming XML file in \"%s\"\n", path);
+
+    /* codesystems are the only children to follow */
+    ret = xmlTextReaderRead(reader);
+    while (ret == 1) {
+	if (xmlTextReaderDepth(reader) == 1 &&
+	    xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT &&
+	    !xmlStrcmp(xmlTextReaderConstName(reader), (const xmlChar *)"codesystem")) {
+	    ooMindMap_read_codesystem(self, reader, path, path_size);
+	    ret = xmlTextReaderNext(reader);
+	    continue;
+	}
+	ret = xmlTextReaderRead(reader);
+    }
+
+    if (ret < 0) {
+	fprintf(stderr,"Document not parsed successfully :( \n");
+	ret = -1;
+	goto final;
+    }
+
+    ret = oo_OK;
+
+final:
+    if (path)
+	free(path);
+
+    xmlFreeTextReader(reader);
+
+    return ret;
+}
+
 /**
  * import Concepts from XML file 
  */
@@ -700,7 +1201,15 @@ ooMindMap_import(struct ooMindMap *self,
     if (DEBUG_LEVEL_1)
 	printf(" -- MindMap: reading XML file \"%s\"...\n", filename);
 
-    doc = xmlParseFile(filename);
+    /* codesets may be too large to hold as a whole tree */
+    ret = ooMindMap_stream_import(self, filename);
+    if (ret != oo_NO_RESULTS) return ret;
+    ret = oo_OK;
+
+    if (self->xml_pool)
+	doc = self->xml_pool->get(self->xml_pool, filename);
+    else
+	doc = xmlParseFile(filename);
     if (!doc) {
 	fprintf(stderr,"Document not parsed successfully :( \n");
 	ret = -1;
@@ -720,22 +1229,6 @@ ooMindMap_import(struct ooMindMap *self,
     if (DEBUG_LEVEL_1)
 	printf(" -- MindMap: successfully parsed XML file in \"%s\"\n", path);
 
-   /* concepts and codes */
-    if (!xmlStrcmp(root_node->name, (const xmlChar *) "conceptlist")) {
-	for (cur_node = root_node->children; cur_node; cur_node = cur_node->next) {
-	    if (cur_node->type != XML_ELEMENT_NODE) continue;
-
-	    /* nested includes */
-	    /*if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"include"))) 
-	      ooMindMap_read_include(self, cur_node, path, path_size);*/
-
-	    /* read the codesystem */
-	    if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codesystem"))) 
-		ooMindMap_read_codesystem(self, cur_node, path, path_size);
-	}
-	goto final;
-    } 
-
     /* read conceptual domains */
     if (!xmlStrcmp(root_node->name, (const xmlChar *)"domain")) {
 	ooMindMap_read_domain(self, root_node, path, path_size, parent_domain);
@@ -763,8 +1256,12 @@ final:
     if (path)
 	free(path);
 
-    if (doc)
-	xmlFreeDoc(doc);
+    if (doc) {
+	if (self->xml_pool)
+	    self->xml_pool->release(self->xml_pool, doc);
+	else
+	    xmlFreeDoc(doc);
+    }
 
     return ret;
 }
@@ -855,20 +1352,198 @@ ooMindMap_build_cache(struct ooMindMap *self)
 
 
 
-/* export concepts to file */
+/**
+ *  Dump file layout:
+ *
+ *   1. header:   OO_MINDMAP_DUMP_MAGIC, uint32_t version,
+ *                uint32_t reserved
+ *   2. records:  uint32_t key size, uint32_t data size,
+ *                the key and the data bytes
+ *
+ *  The records follow the DB order,
+ *  so restoring them needs no sorting.
+ */
+#define OO_MINDMAP_DUMP_MAGIC "OOMNIKMM"
+#define OO_MINDMAP_DUMP_VERSION 1
+
+/*  export the MindMap DB records to a file */
 static int
 ooMindMap_export(struct ooMindMap *self, 
 		 const char *filename)
 {
-    printf("Exporting concepts to file %s...\n", filename);
+    struct ooMindMapCursor cursor;
+    const void *key, *data;
+    size_t key_size, data_size;
+    size_t num_records = 0;
+    uint32_t header[2];
+    uint32_t sizes[2];
+    void *buf;
+    FILE *f;
+    int ret;
+
+    if (DEBUG_LEVEL_2)
+	printf("  ** Exporting concepts to file %s...\n", filename);
+
+    buf = malloc(MINDMAP_BULK_BUF_SIZE);
+    if (!buf) return oo_NOMEM;
+
+    f = fopen(filename, "wb");
+    if (!f) {
+	fprintf(stderr, "  -- Couldn't open file \"%s\" for writing\n",
+		filename);
+	free(buf);
+	return oo_FAIL;
+    }
+
+    ret = ooMindMap_cursor_open(self, &cursor, buf, MINDMAP_BULK_BUF_SIZE);
+    if (ret != oo_OK) goto final;
+
+    header[0] = OO_MINDMAP_DUMP_VERSION;
+    header[1] = 0;
+
+    if (fwrite(OO_MINDMAP_DUMP_MAGIC, 1, 8, f) != 8 ||
+	fwrite(header, sizeof(header), 1, f) != 1) {
+	ret = oo_FAIL;
+	goto close_cursor;
+    }
+
+    while (1) {
+	ret = ooMindMap_cursor_next(self, &cursor,
+				    &key, &key_size, &data, &data_size);
+	if (ret == oo_NO_RESULTS) {
+	    ret = oo_OK;
+	    break;
+	}
+	if (ret != oo_OK) break;
+
+	sizes[0] = (uint32_t)key_size;
+	sizes[1] = (uint32_t)data_size;
+
+	if (fwrite(sizes, sizeof(sizes), 1, f) != 1 ||
+	    fwrite(key, 1, key_size, f) != key_size ||
+	    fwrite(data, 1, data_size, f) != data_size) {
+	    ret = oo_FAIL;
+	    break;
+	}
+	num_records++;
+    }
+
+close_cursor:
+    ooMindMap_cursor_close(self, &cursor);
+
+final:
+    if (fclose(f) != 0 && ret == oo_OK)
+	ret = oo_FAIL;
+    free(buf);
+
+    if (ret != oo_OK) {
+	fprintf(stderr, "  -- Export to \"%s\" failed\n", filename);
+	return ret;
+    }
+
+    if (DEBUG_LEVEL_2)
+	printf("  ++ %lu records exported\n", (unsigned long)num_records);
+
     return oo_OK;
 }
 
+/*  bulk loading of a MindMap dump */
+static int
+ooMindMap_restore(struct ooMindMap *self, 
+		  const char *filename)
+{
+    DB *dbp;
+    DBT bulk;
+    char magic[8];
+    uint32_t header[2];
+    uint32_t sizes[2];
+    char *rec = NULL;
+    size_t rec_size = 0;
+    size_t num_records = 0;
+    size_t total = 0;
+    void *pos;
+    FILE *f;
+    int ret = oo_OK;
+
+    dbp = self->_storage;
+
+    f = fopen(filename, "rb");
+    if (!f) {
+	fprintf(stderr, "  -- Couldn't open file \"%s\"\n", filename);
+	return oo_FAIL;
+    }
+
+    if (fread(magic, 1, 8, f) != 8 ||
+	memcmp(magic, OO_MINDMAP_DUMP_MAGIC, 8) ||
+	fread(header, sizeof(header), 1, f) != 1 ||
+	header[0] != OO_MINDMAP_DUMP_VERSION) {
+	fprintf(stderr, "  -- \"%s\" is not a MindMap dump\n", filename);
+	fclose(f);
+	return oo_FAIL;
+    }
+
+    memset(&bulk, 0, sizeof(DBT));
+    bulk.ulen = MINDMAP_BULK_BUF_SIZE;
+    bulk.flags = DB_DBT_USERMEM | DB_DBT_BULK;
+    bulk.data = malloc(MINDMAP_BULK_BUF_SIZE);
+    if (!bulk.data) {
+	fclose(f);
+	return oo_NOMEM;
+    }
+
+    DB_MULTIPLE_WRITE_INIT(pos, &bulk);
+
+    while (fread(sizes, sizeof(sizes), 1, f) == 1) {
+	if ((size_t)sizes[0] + sizes[1] > rec_size) {
+	    free(rec);
+	    rec_size = (size_t)sizes[0] + sizes[1];
+	    rec = malloc(rec_size);
+	    if (!rec) {
+		ret = oo_NOMEM;
+		goto final;
+	    }
+	}
+
+	if (fread(rec, 1, (size_t)sizes[0] + sizes[1], f) !=
+	    (size_t)sizes[0] + sizes[1]) {
+	    fprintf(stderr, "  -- Truncated MindMap dump \"%s\"\n",
+		    filename);
+	    ret = oo_FAIL;
+	    goto final;
+	}
+
+	ret = ooMindMap_bulk_add(self, &bulk, &pos, &num_records,
+				 rec, sizes[0], rec + sizes[0], sizes[1]);
+	if (ret != oo_OK) goto final;
+	total++;
+    }
+
+    ret = ooMindMap_bulk_flush(self, &bulk, &pos, &num_records);
+    if (ret != oo_OK) goto final;
+
+    if ((ret = dbp->sync(dbp, 0)) != 0) {
+	dbp->err(dbp, ret, "DB->sync");
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    if (DEBUG_LEVEL_2)
+	printf("  ++ %lu records restored from %s\n",
+	       (unsigned long)total, filename);
+
+final:
+    if (rec) free(rec);
+    free(bulk.data);
+    fclose(f);
+    return ret;
+}
+
 
 
 /*  MindMap Initializer */
 extern int
-ooMindMap_new(struct ooMindMap **mm)
+ooMindMap_new(struct ooMindMap **mm,
+	      DB_ENV *env)
 {
     DB *dbp;
     int ret = oo_FAIL;
@@ -881,11 +1556,14 @@ ooMindMap_new(struct ooMindMap **mm)
     self->num_codesystems = 0;
     self->codesystems = NULL;
     self->_storage = NULL;
-
-
+    self->_concept_store = NULL;
+    self->xml_pool = NULL;
+    self->names = NULL;
+    self->region = NULL;
+    self->topic_index = NULL;
 
     /* Create and initialize database object */
-    if ((ret = db_create(&dbp, NULL, 0)) != 0) {
+    if ((ret = db_create(&dbp, env, 0)) != 0) {
 	fprintf(stderr,
 		"db_create: %s\n", db_strerror(ret));
 	goto error;
@@ -900,7 +1578,9 @@ ooMindMap_new(struct ooMindMap **mm)
 	dbp->err(dbp, ret, "set_pagesize");
 	goto error;
     }
-    if ((ret = dbp->set_cachesize(dbp, 0, 32 * 1024, 0)) != 0) {
+    /* the cache of an environment is set up by its owner */
+    if (!env &&
+	(ret = dbp->set_cachesize(dbp, 0, MINDMAP_DB_CACHE_SIZE, 0)) != 0) {
 	dbp->err(dbp, ret, "set_cachesize");
 	goto error;
     }
@@ -921,8 +1601,15 @@ ooMindMap_new(struct ooMindMap **mm)
     self->num_concepts = 1;
     self->concept_index_size = DEFAULT_INDEX_SIZE; 
 
+    ret = ooStrPool_new(&self->names);
+    if (ret != oo_OK) goto error;
+
+    ret = ooRegion_new(&self->region);
+    if (ret != oo_OK) goto error;
+
     ret = ooDict_new(&self->_name_index);
     if (ret != oo_OK) goto error;
+    self->_name_index->set_pool(self->_name_index, self->names);
 
 
     self->root_domain = NULL;
@@ -943,6 +1630,7 @@ ooMindMap_new(struct ooMindMap **mm)
 
     self->import_file = ooMindMap_import;
     self->export_file = ooMindMap_export;
+    self->restore_file = ooMindMap_restore;
 
     self->newid = ooMindMap_newid;
 
@@ -950,11 +1638,19 @@ ooMindMap_new(struct ooMindMap **mm)
     self->drop = ooMindMap_drop;
 
     self->get = ooMindMap_get;
+    self->open_store = ooMindMap_open_store;
+    self->get_packed = ooMindMap_get_packed;
+    self->build_store = ooMindMap_build_store;
     self->get_codesystem = ooMindMap_get_codesystem;
     self->resolve_refs = ooMindMap_resolve_refs;
     self->build_cache = ooMindMap_build_cache;
     self->lookup = ooMindMap_lookup;
+    self->lookup_interned = ooMindMap_lookup_interned;
     self->keys = ooMindMap_keys;
+    self->cursor_open = ooMindMap_cursor_open;
+    self->cursor_next = ooMindMap_cursor_next;
+    self->cursor_close = ooMindMap_cursor_close;
+    self->save_concepts = ooMindMap_save_concepts;
 
     self->add_concept = ooMindMap_add_concept;
 
@@ -32,6 +32,18 @@ struct ooCodeSystem;
 struct ooConcept;
 struct ooDomain;
 struct ooDict;
+struct ooConceptStore;
+struct ooPackedConcept;
+struct ooRegion;
+
+/* bulk walk over the records of the MindMap DB */
+typedef struct ooMindMapCursor {
+    DBC *dbc;
+
+    /* caller's buffer of the current batch */
+    DBT bulk;
+    void *pos;
+} ooMindMapCursor;
 
 /*  the Mind Map Controller */
 typedef struct ooMindMap 
@@ -61,6 +73,18 @@ typedef struct ooMindMap
     struct ooTopic **topics;
     size_t num_topics;
     struct ooTopicIngredient **topic_index;
+
+    /* interned names of codes, concepts and topics:
+     * the handles live as long as the MindMap */
+    struct ooStrPool *names;
+
+    /* codes, specs, usages and cache tails of all the CodeSystems:
+     * released at once together with the MindMap */
+    struct ooRegion *region;
+
+    /* include files parsed ahead by worker threads during loading,
+     * NULL when every file is parsed in place */
+    struct ooXMLPool *xml_pool;
     
     /***********  public methods ***********/
     int (*del)(struct ooMindMap *self);
@@ -75,9 +99,24 @@ typedef struct ooMindMap
     /* lookup a concept by name */
     struct ooConcept* (*lookup)(struct ooMindMap *self, const char *conc_name);
 
+    /* lookup a concept by a name interned in self->names */
+    struct ooConcept* (*lookup_interned)(struct ooMindMap *self,
+					 const char *conc_name);
+
     /* retrieve a concept by its numeric id */
     struct ooConcept* (*get)(struct ooMindMap *self, mindmap_size_t id);
 
+    /* map a read-only Concept Store file */
+    int (*open_store)(struct ooMindMap *self, const char *filename);
+
+    /* zero-copy access to a concept of the Concept Store,
+     * safe to call from any thread */
+    const struct ooPackedConcept* (*get_packed)(struct ooMindMap *self,
+						mindmap_size_t id);
+
+    /* write the concepts of the MindMap DB into a Concept Store file */
+    int (*build_store)(struct ooMindMap *self, const char *filename);
+
 
     /* retrieve a CodeSystem by its URI */
     struct ooCodeSystem* (*get_codesystem)(struct ooMindMap*, 
@@ -102,11 +141,37 @@ typedef struct ooMindMap
     /* remove a concept by id */
     int (*drop)(struct ooMindMap *self, mindmap_size_t);
 
-    /* list existing concept ids in batches */
+    /* list existing concept ids in batches:
+       up to batch_size ids in the DB order
+       following the id last returned, NULL starts from the first one */
     int (*keys)(struct ooMindMap  *self,
-		  mindmap_size_t **ids,
-		  mindmap_size_t   batch_size,
-		  mindmap_size_t   batch_start);
+		mindmap_size_t   *ids,
+		size_t            batch_size,
+		const mindmap_size_t *last_id,
+		size_t           *num_ids);
+
+    /* walk the DB records fetched in bulk into the caller's buffer,
+       its size must be a multiple of 1024 */
+    int (*cursor_open)(struct ooMindMap *self,
+		       struct ooMindMapCursor *cursor,
+		       void *buf,
+		       size_t buf_size);
+
+    /* next record or oo_NO_RESULTS at the end,
+       the record stays valid until the next call */
+    int (*cursor_next)(struct ooMindMap *self,
+		       struct ooMindMapCursor *cursor,
+		       const void **key,
+		       size_t *key_size,
+		       const void **data,
+		       size_t *data_size);
+
+    int (*cursor_close)(struct ooMindMap *self,
+			struct ooMindMapCursor *cursor);
+
+    /* save all the concepts in memory to the MindMap DB
+       with bulk writes sorted by key */
+    int (*save_concepts)(struct ooMindMap *self);
 
     /* load concepts from file */
     int (*import_file)(struct ooMindMap *self, 
@@ -116,6 +181,9 @@ typedef struct ooMindMap
     /* save the complete MindMap DB into a file */
     int (*export_file)(struct ooMindMap *self, const char *filename);
 
+    /* load a file written by export_file into the MindMap DB */
+    int (*restore_file)(struct ooMindMap *self, const char *filename);
+
 
     /***********  private attributes ***********/
 
@@ -124,6 +192,9 @@ typedef struct ooMindMap
        Berkeley DB backend */
     DB *_storage;
 
+    /* read-only memory-mapped alternative to the MindMap DB */
+    struct ooConceptStore *_concept_store;
+
     /* last concept identifier */
     mindmap_size_t _currid;
 
@@ -133,7 +204,8 @@ typedef struct ooMindMap
 
 } ooMindMap;
 
-extern int ooMindMap_new(struct ooMindMap**); 
+/* the DB handle is created within env unless it is NULL */
+extern int ooMindMap_new(struct ooMindMap**, DB_ENV*); 
 
 
 #endif /* OOMINDMAP_H */
@@ -38,6 +38,12 @@
 #include "oosegmentizer.h"
 #include "ooagenda.h"
 #include "ooaccumulator.h"
+#include "oocodesystem.h"
+#include "oocache.h"
+#include "oostats.h"
+#include "ootrace.h"
+#include "oomemory.h"
+#include "ooxmlpool.h"
 
 /*
  * prototypes 
@@ -46,19 +52,18 @@ static int
 OOmnik_read_data(struct OOmnik *self, const char *config);
 
 
-/*  destructor */
-static int
-OOmnik_del(OOmnik *self)
+/*  free up the configuration strings */
+static void
+OOmnik_free_config(struct OOmnik *self)
 {
     int i;
 
-    /* free up the subordinate resources */
-    if (self->mindmap) 
-	self->mindmap->del(self->mindmap);
-
     if (self->db_filename)
 	free(self->db_filename);
 
+    if (self->store_filename)
+	free(self->store_filename);
+
     if (self->default_codesystem_name)
 	free(self->default_codesystem_name);
 
@@ -72,8 +77,117 @@ OOmnik_del(OOmnik *self)
     if (self->includes_path)
 	free(self->includes_path);
 
-    /* free up yourself */
-    free(self);
+    if (self->trace_filename)
+	free(self->trace_filename);
+
+    if (self->trace_subsystems)
+	free(self->trace_subsystems);
+
+    self->db_filename = NULL;
+    self->store_filename = NULL;
+    self->default_codesystem_name = NULL;
+    self->includes = NULL;
+    self->num_includes = 0;
+    self->includes_path = NULL;
+    self->trace_filename = NULL;
+    self->trace_subsystems = NULL;
+}
+
+/*  pin the current generation for the duration of a request */
+static struct ooGeneration*
+OOmnik_acquire_generation(struct OOmnik *self)
+{
+    struct ooGeneration *gen;
+
+    pthread_mutex_lock(&self->generation_lock);
+    gen = self->generation;
+    if (gen) gen->num_refs++;
+    pthread_mutex_unlock(&self->generation_lock);
+
+    return gen;
+}
+
+/*  the generation is freed by whoever lets it go last */
+static void
+OOmnik_release_generation(struct OOmnik *self,
+			  struct ooGeneration *gen)
+{
+    size_t num_refs;
+
+    pthread_mutex_lock(&self->generation_lock);
+    num_refs = --gen->num_refs;
+    pthread_mutex_unlock(&self->generation_lock);
+
+    if (num_refs) return;
+
+    if (DEBUG_LEVEL_1)
+	fprintf(stderr, "  -- OOmnik: generation %zu is drained\n", gen->id);
+
+    gen->mindmap->del(gen->mindmap);
+
+    pthread_rwlock_destroy(&gen->update_lock);
+
+    if (gen->default_codesystem_name)
+	free(gen->default_codesystem_name);
+
+    free(gen);
+}
+
+/*  pin the current generation and keep the code updates away */
+static struct ooGeneration*
+OOmnik_enter_generation(struct OOmnik *self)
+{
+    struct ooGeneration *gen;
+
+    gen = OOmnik_acquire_generation(self);
+    if (gen) pthread_rwlock_rdlock(&gen->update_lock);
+
+    return gen;
+}
+
+static void
+OOmnik_leave_generation(struct OOmnik *self,
+			struct ooGeneration *gen)
+{
+    pthread_rwlock_unlock(&gen->update_lock);
+    OOmnik_release_generation(self, gen);
+}
+
+/*  a loader that has not become a generation */
+static void
+OOmnik_free_loader(struct OOmnik *loader)
+{
+    if (loader->mindmap)
+	loader->mindmap->del(loader->mindmap);
+
+    if (loader->db_env)
+	loader->db_env->close(loader->db_env, 0);
+
+    OOmnik_free_config(loader);
+
+    pthread_mutex_destroy(&loader->generation_lock);
+    pthread_mutex_destroy(&loader->stats_lock);
+
+    free(loader);
+}
+
+/*  destructor */
+static int
+OOmnik_del(OOmnik *self)
+{
+    /* let the background reload finish */
+    if (self->has_reload_thread)
+	pthread_join(self->reload_thread, NULL);
+
+    /* free up the subordinate resources */
+    if (self->generation) {
+	OOmnik_release_generation(self, self->generation);
+	self->mindmap = NULL;
+    }
+
+    OOmnik_free_loader(self);
+
+    oo_trace_close();
 
     xmlCleanupParser();
 
@@ -144,7 +258,7 @@ OOmnik_read_config(struct OOmnik *self,
     int errcode, path_size = 0, chunk_size = 0, db_filename_size = 0, ret;
     xmlDocPtr doc;
     xmlNodePtr root, cur_node;
-    char *value;
+    char *value, *subsystems;
     const char *path;
 
     if (DEBUG_LEVEL_1)
@@ -223,6 +337,19 @@ OOmnik_read_config(struct OOmnik *self,
 		strcpy(self->db_filename, value);
 		xmlFree(value);
 	    }
+
+	    /* read-only Concept Store */
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"store");
+	    if (value) {
+		if (self->store_filename)
+		    free(self->store_filename);
+		self->store_filename = strdup(value);
+		xmlFree(value);
+		if (!self->store_filename) {
+		    errcode = oo_NOMEM;
+		    goto error;
+		}
+	    }
 	}
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"output"))) {
 	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"format");
@@ -235,6 +362,86 @@ OOmnik_read_config(struct OOmnik *self,
 	    }
 	}
 
+	/* beam search settings */
+	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"beam"))) {
+	    self->beam.enabled = true;
+
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"span_width");
+	    if (value) {
+		self->beam.span_width = (size_t)atoi(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"code_width");
+	    if (value) {
+		self->beam.code_width = (size_t)atoi(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"threshold");
+	    if (value) {
+		self->beam.threshold = atof(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"enabled");
+	    if (value) {
+		if (!strcmp(value, "0")) self->beam.enabled = false;
+		xmlFree(value);
+	    }
+	}
+
+	/* work budget of a request */
+	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"budget"))) {
+	    self->budget.enabled = true;
+
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"deadline_usec");
+	    if (value) {
+		self->budget.deadline_usec = (size_t)atol(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"max_units");
+	    if (value) {
+		self->budget.max_units = (size_t)atol(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"max_complexes");
+	    if (value) {
+		self->budget.max_complexes = (size_t)atol(value);
+		xmlFree(value);
+	    }
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"enabled");
+	    if (value) {
+		if (!strcmp(value, "0")) self->budget.enabled = false;
+		xmlFree(value);
+	    }
+	}
+
+	/* runtime tracing: only recorded here,
+	   a loader that may be thrown away never touches the trace */
+	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"trace"))) {
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"filename");
+	    if (value) {
+		if (self->trace_filename)
+		    free(self->trace_filename);
+		self->trace_filename = strdup(value);
+		xmlFree(value);
+		if (!self->trace_filename) {
+		    errcode = oo_NOMEM;
+		    goto error;
+		}
+	    }
+	    subsystems = (char *)xmlGetProp(cur_node,  
+					    (const xmlChar *)"subsystems");
+	    if (subsystems) {
+		if (self->trace_subsystems)
+		    free(self->trace_subsystems);
+		self->trace_subsystems = strdup(subsystems);
+		xmlFree(subsystems);
+		if (!self->trace_subsystems) {
+		    errcode = oo_NOMEM;
+		    goto error;
+		}
+	    }
+	}
+
 	if ((!xmlStrcmp(cur_node->name, (const xmlChar *)"codesystem"))) {
 	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"name");
 	    if (value) {
@@ -273,6 +480,15 @@ OOmnik_read_config(struct OOmnik *self,
     fprintf(stderr, "\n Initializing OOmnik...\n"
 	    "    * working directory: %s\n", self->includes_path);
     fprintf(stderr, "    * MindMap DB file name: %s\n", self->db_filename);
+    if (self->store_filename)
+	fprintf(stderr, "    * Concept Store file name: %s\n", self->store_filename);
+    if (self->beam.enabled)
+	fprintf(stderr, "    * beam: span width %zu, code width %zu, threshold %.2f\n", 
+		self->beam.span_width, self->beam.code_width, self->beam.threshold);
+    if (self->budget.enabled)
+	fprintf(stderr, "    * budget: deadline %zu usec, %zu units, %zu complexes\n", 
+		self->budget.deadline_usec, self->budget.max_units,
+		self->budget.max_complexes);
 
     errcode = oo_OK;
 
@@ -280,8 +496,9 @@ error:
     if (errcode != oo_OK)
 	fprintf(stderr, "\n Error reading configuration file \"%s\"\n", filename);
 
+    /* the parser is cleaned up once by the destructor:
+     * a reload reads the config in its own thread */
     xmlFreeDoc(doc);
-    xmlCleanupParser();
 
     return errcode;
 }
@@ -289,6 +506,49 @@ error:
 
 
 
+/**
+ * the environment lets the loader open the MindMap DB
+ * while the handle of the live generation is still in use:
+ * a private region of this process, its own cache and page locks
+ */
+static int
+OOmnik_open_db_env(struct OOmnik *self)
+{
+    DB_ENV *env;
+    int ret;
+
+    if ((ret = db_env_create(&env, 0)) != 0) {
+	fprintf(stderr, "db_env_create: %s\n", db_strerror(ret));
+	return oo_FAIL;
+    }
+
+    env->set_errfile(env, stderr);
+    env->set_errpfx(env, "OOmnik");
+
+    if ((ret = env->set_cachesize(env, 0, MINDMAP_DB_CACHE_SIZE, 0)) != 0) {
+	env->err(env, ret, "set_cachesize");
+	goto error;
+    }
+    if ((ret = env->set_lk_detect(env, DB_LOCK_DEFAULT)) != 0) {
+	env->err(env, ret, "set_lk_detect");
+	goto error;
+    }
+
+    if ((ret = env->open(env, NULL,
+			 DB_CREATE | DB_INIT_LOCK | DB_INIT_MPOOL |
+			 DB_PRIVATE | DB_THREAD, 0)) != 0) {
+	env->err(env, ret, "DB_ENV->open");
+	goto error;
+    }
+
+    self->db_env = env;
+    return oo_OK;
+
+ error:
+    (void)env->close(env, 0);
+    return oo_FAIL;
+}
+
 /*  open the MindMap DB */
 static int 
 OOmnik_open_mindmap(OOmnik *self, const char *dbname)
@@ -302,49 +562,190 @@ OOmnik_open_mindmap(OOmnik *self, const char *dbname)
     return oo_OK;
 }
 
-/*  hot restart */
+/**
+ * the knowledge base of a loader becomes the current generation
+ * and its configuration replaces that of the controller;
+ * the previous generation is let go and freed
+ * as soon as its last request is over
+ */
+static int
+OOmnik_publish(struct OOmnik *self,
+	       struct OOmnik *loader)
+{
+    struct ooGeneration *gen, *prev;
+
+    gen = malloc(sizeof(struct ooGeneration));
+    if (!gen) return oo_NOMEM;
+
+    gen->default_codesystem_name = NULL;
+    if (loader->default_codesystem_name) {
+	gen->default_codesystem_name = strdup(loader->default_codesystem_name);
+	if (!gen->default_codesystem_name) {
+	    free(gen);
+	    return oo_NOMEM;
+	}
+    }
+
+    gen->mindmap = loader->mindmap;
+    gen->default_codesystem = loader->default_codesystem;
+    gen->beam = loader->beam;
+    gen->budget = loader->budget;
+    gen->num_refs = 1;
+    gen->num_updates = 0;
+    pthread_rwlock_init(&gen->update_lock, NULL);
+
+    pthread_mutex_lock(&self->generation_lock);
+
+    if (loader != self) {
+	OOmnik_free_config(self);
+
+	self->db_filename = loader->db_filename;
+	self->store_filename = loader->store_filename;
+	self->default_codesystem_name = loader->default_codesystem_name;
+	self->includes = loader->includes;
+	self->num_includes = loader->num_includes;
+	self->includes_path = loader->includes_path;
+	self->default_format = loader->default_format;
+	self->beam = loader->beam;
+	self->budget = loader->budget;
+
+	/* nothing is left to the loader */
+	loader->mindmap = NULL;
+	loader->db_filename = NULL;
+	loader->store_filename = NULL;
+	loader->default_codesystem_name = NULL;
+	loader->includes = NULL;
+	loader->num_includes = 0;
+	loader->includes_path = NULL;
+    }
+
+    gen->id = ++self->num_generations;
+
+    prev = self->generation;
+    self->generation = gen;
+    self->mindmap = gen->mindmap;
+    self->default_codesystem = gen->default_codesystem;
+
+    pthread_mutex_unlock(&self->generation_lock);
+
+    if (prev)
+	OOmnik_release_generation(self, prev);
+
+    return oo_OK;
+}
+
+/*  hot restart: the next generation is built aside */
 static int 
 OOmnik_reload(struct OOmnik *self)
 {
-    int i, ret;
+    struct OOmnik *loader;
+    int ret;
 
     fprintf(stderr, " Reloading OOmnik...\n");
 
-    /* free up the subordinate resources */
-    if (self->mindmap) 
-	self->mindmap->del(self->mindmap);
+    ret = OOmnik_new(&loader);
+    if (ret != oo_OK) return ret;
 
-    if (self->db_filename)
-	free(self->db_filename);
+    /* the DB file stays open in the live generation */
+    loader->db_env = self->db_env;
 
-    if (self->default_codesystem_name)
-	free(self->default_codesystem_name);
+    ret = OOmnik_read_data(loader, self->conf_name);
+    if (ret == oo_OK)
+	ret = OOmnik_publish(self, loader);
 
-    /* delete include path strings */
-    for (i = 0; i < self->num_includes; i++)
-	if (self->includes[i])
-	    free(self->includes[i]);
-    if (self->includes)
-	free(self->includes);
+    /* the environment is the controller's */
+    loader->db_env = NULL;
+    OOmnik_free_loader(loader);
 
-    if (self->includes_path)
-	free(self->includes_path);
+    if (ret != oo_OK) {
+	fprintf(stderr, " -- Reload failed, the current knowledge base "
+		"stays active :(\n");
+	return ret;
+    }
 
-    /* recreate the Mind Map */
-    ret = ooMindMap_new(&self->mindmap);
-    if (ret != oo_OK) return ret;
+    /* the CodeSystems of the new generation start from scratch */
+    OOmnik_reset_stats(self);
 
-    self->db_filename = NULL;
-    self->default_codesystem_name = NULL;
-    self->default_codesystem = NULL;
-    self->default_format = FORMAT_XML;
+    fprintf(stderr, "\n  OOmnik reloaded! :)\n");
 
-    self->includes_path = NULL;
-    self->includes = NULL;
-    self->num_includes = 0;
+    return oo_OK;
+}
+
+static void*
+OOmnik_reload_work(void *arg)
+{
+    struct OOmnik *self = (struct OOmnik*)arg;
+
+    OOmnik_reload(self);
+
+    pthread_mutex_lock(&self->generation_lock);
+    self->is_reloading = false;
+    pthread_mutex_unlock(&self->generation_lock);
+
+    return NULL;
+}
+
+/*  hot restart in a background thread, one at a time */
+static int 
+OOmnik_reload_async(struct OOmnik *self)
+{
+    bool has_reload_thread;
+
+    pthread_mutex_lock(&self->generation_lock);
+
+    if (self->is_reloading) {
+	pthread_mutex_unlock(&self->generation_lock);
+	return oo_FAIL;
+    }
+
+    self->is_reloading = true;
+    has_reload_thread = self->has_reload_thread;
+    self->has_reload_thread = true;
+
+    pthread_mutex_unlock(&self->generation_lock);
+
+    /* the previous reload is over by now */
+    if (has_reload_thread)
+	pthread_join(self->reload_thread, NULL);
 
-    OOmnik_read_data(self, self->conf_name);
+    if (pthread_create(&self->reload_thread, NULL,
+		       OOmnik_reload_work, (void*)self) != 0) {
+	pthread_mutex_lock(&self->generation_lock);
+	self->is_reloading = false;
+	self->has_reload_thread = false;
+	pthread_mutex_unlock(&self->generation_lock);
+	return oo_FAIL;
+    }
+
+    return oo_OK;
+}
+
+static int
+OOmnik_interact_trace(struct OOmnik *self,
+		      char *args)
+{
+    char *filename, *subsystems;
+    int ret;
+
+    filename = strtok(args, " \t\n");
+    if (!filename) return oo_FAIL;
+
+    if (!strcmp(filename, "off")) {
+	OOmnik_set_trace(self, NULL, NULL);
+	fprintf(stderr, "  OOmnik: tracing stopped\n");
+	return oo_OK;
+    }
+
+    subsystems = strtok(NULL, " \t\n");
+
+    ret = OOmnik_set_trace(self, filename, subsystems);
+    if (ret != oo_OK) {
+	fprintf(stderr, "  -- OOmnik: failed to start tracing :(\n");
+	return ret;
+    }
 
+    fprintf(stderr, "  OOmnik: tracing %s to %s\n", 
+	    subsystems ? subsystems : "all", filename);
     return oo_OK;
 }
 
@@ -362,13 +763,47 @@ OOmnik_interact(struct OOmnik *self)
 
     while (fgets(buf, sizeof(buf), stdin)) {
 
+	/* the current knowledge base keeps serving meanwhile */
 	if (!strcmp(buf, "r\n")) {
-	    ret = OOmnik_reload(self);
-	    if (ret != oo_OK) {
-		fprintf(stderr, " -- Reload failed... :(( Exiting now...\n");
-		return oo_FAIL;
+	    ret = self->start_reload(self);
+	    if (ret != oo_OK)
+		fprintf(stderr, "  -- OOmnik: a reload is already running\n");
+	    else
+		fprintf(stderr, "  OOmnik: reloading in the background...\n");
+	    fprintf(stderr, ">>> ");
+	    continue;
+	}
+
+	/* trace <filename> [subsystems] */
+	if (!strncmp(buf, "trace ", strlen("trace "))) {
+	    ret = OOmnik_interact_trace(self, buf + strlen("trace "));
+	    fprintf(stderr, ">>> ");
+	    continue;
+	}
+
+	if (!strcmp(buf, "stats\n")) {
+	    result = OOmnik_get_stats(self);
+	    if (result) {
+		printf("%s\n", result);
+		OOmnik_free_result(result);
 	    }
-	    fprintf(stderr, "\n  OOmnik reloaded! :)\n");
+	    fprintf(stderr, ">>> ");
+	    continue;
+	}
+
+	if (!strcmp(buf, "memory\n")) {
+	    result = OOmnik_memory_stats(self);
+	    if (result) {
+		printf("%s\n", result);
+		OOmnik_free_result(result);
+	    }
+	    fprintf(stderr, ">>> ");
+	    continue;
+	}
+
+	if (!strcmp(buf, "stats reset\n")) {
+	    OOmnik_reset_stats(self);
+	    fprintf(stderr, "  OOmnik: statistics cleared\n");
 	    fprintf(stderr, ">>> ");
 	    continue;
 	}
@@ -403,7 +838,9 @@ OOmnik_read_data(struct OOmnik *self,
 {
     struct ooMindMap *mm;
     struct ooCodeSystem *cs = NULL;
+    struct ooXMLPool *pool;
     char *include_filename;
+    long num_cpus;
     int i, ret;
  
     ret = OOmnik_read_config(self, conf_name);
@@ -414,6 +851,15 @@ OOmnik_read_data(struct OOmnik *self,
     fprintf(stderr, "    * default CS: %s\n",
 	   self->default_codesystem_name);
 
+    /* a loader is given the environment of its controller */
+    if (!self->db_env) {
+	ret = OOmnik_open_db_env(self);
+	if (ret != oo_OK) goto error;
+    }
+
+    ret = ooMindMap_new(&self->mindmap, self->db_env);
+    if (ret != oo_OK) goto error;
+
     if (self->open_mindmap(self, self->db_filename) != oo_OK) {
 	fprintf(stderr, "  -- Failed to activate the MindMap database: \"%s\" :(\n",
 		self->db_filename);
@@ -422,8 +868,28 @@ OOmnik_read_data(struct OOmnik *self,
 
     mm = self->mindmap;
 
+    if (self->store_filename) {
+	/* the concepts would silently come from the DB instead */
+	ret = mm->open_store(mm, self->store_filename);
+	if (ret != oo_OK) {
+	    fprintf(stderr, "  -- Failed to map the Concept Store: \"%s\" :(\n",
+		    self->store_filename);
+	    goto error;
+	}
+    }
+
     fprintf(stderr, "  OOmnik: importing the Concepts...\n");
 
+    /* the XML datasets are parsed ahead on all the other CPUs,
+     * while the import itself keeps the order of the includes
+     * so that all the ids come out as in a sequential load */
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ooXMLPool_new(&pool, num_cpus > 1 ? (size_t)num_cpus - 1 : 0) == oo_OK) {
+	for (i = 0; i < self->num_includes; i++)
+	    pool->add(pool, self->includes[i]);
+	mm->xml_pool = pool;
+    }
+
     /* read the XML datasets */
     for (i = 0; i < self->num_includes; i++) {
 	include_filename = self->includes[i];
@@ -431,6 +897,11 @@ OOmnik_read_data(struct OOmnik *self,
 	ret = mm->import_file(mm, include_filename, NULL);
     }
 
+    if (mm->xml_pool) {
+	mm->xml_pool->del(mm->xml_pool);
+	mm->xml_pool = NULL;
+    }
+
     fprintf(stderr, "  OOmnik: resolving name references...\n");
     ret = mm->resolve_refs(mm);
 
@@ -467,66 +938,1068 @@ OOmnik_read_data(struct OOmnik *self,
 }
 
 
-EXPORT extern int
-OOmnik_free_result(const char *outbuf)
+/**
+ * add up the counters of the decoder hierarchy:
+ * pruning totals go to the controller,
+ * stage statistics go to the CodeSystems
+ */
+static int
+OOmnik_collect_stats(struct OOmnik *self,
+		     struct ooDecoder *dec)
 {
-    char *buf = (char*)outbuf;
-    if (buf)
-	free(buf);
+    struct ooAgenda *agendas[2];
+    struct ooAgenda *agenda;
+    struct ooStats *stats = &dec->stats;
+    size_t i;
+
+    agendas[0] = dec->agenda;
+    agendas[1] = dec->segm->agenda;
+
+    for (i = 0; i < 2; i++) {
+	agenda = agendas[i];
+	self->num_beam_pruned += agenda->num_beam_pruned;
+	self->num_pruned_predictions += agenda->num_pruned_predictions;
+	self->num_reused_predictions += agenda->num_reused_predictions;
+
+	stats->num_units += agenda->num_allocated_units;
+	stats->num_complexes += agenda->num_created_complexes;
+	stats->num_pruned += agenda->num_beam_pruned +\
+	    agenda->num_pruned_predictions;
+	stats->num_reused += agenda->num_reused_predictions;
+
+	/* the pools of the last window are not reset yet */
+	if (agenda->max_units > stats->max_units)
+	    stats->max_units = agenda->max_units;
+	if (agenda->storage_space_used > stats->max_units)
+	    stats->max_units = agenda->storage_space_used;
+	if (agenda->max_predictions > stats->max_predictions)
+	    stats->max_predictions = agenda->max_predictions;
+	if (agenda->num_predictions > stats->max_predictions)
+	    stats->max_predictions = agenda->num_predictions;
+	if (agenda->max_beam_slots > stats->max_beam_slots)
+	    stats->max_beam_slots = agenda->max_beam_slots;
+	if (agenda->num_beam_slots > stats->max_beam_slots)
+	    stats->max_beam_slots = agenda->num_beam_slots;
+    }
+
+    if (dec->codesystem)
+	ooStats_merge(&dec->codesystem->stats, stats);
+
+    for (i = 0; i < dec->segm->num_decoders; i++) {
+	if (!dec->segm->decoders[i]) continue;
+	OOmnik_collect_stats(self, dec->segm->decoders[i]);
+    }
 
     return oo_OK;
 }
 
-
-/* for external systems */
-EXPORT extern const char*
-OOmnik_process(void *oomnik, 
-	       const char *input,
-	       int format)
+EXPORT extern int
+OOmnik_get_pruning_stats(void *oomnik,
+			 size_t *num_beam_pruned,
+			 size_t *num_pruned_predictions,
+			 size_t *num_reused_predictions)
 {
     struct OOmnik *self = (struct OOmnik*)oomnik;
-    struct ooDecoder *dec;
-    char *output_buf = NULL;
+    if (!self) return oo_FAIL;
+
+    /* the totals are updated by the decoding threads */
+    pthread_mutex_lock(&self->stats_lock);
+    *num_beam_pruned = self->num_beam_pruned;
+    *num_pruned_predictions = self->num_pruned_predictions;
+    *num_reused_predictions = self->num_reused_predictions;
+    pthread_mutex_unlock(&self->stats_lock);
+
+    return oo_OK;
+}
+
+/**
+ * JSON report of the decoding statistics,
+ * to be released by OOmnik_free_result
+ */
+EXPORT extern const char*
+OOmnik_get_stats(void *oomnik)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    struct ooMindMap *mm;
+    struct ooCodeSystem *cs;
+    char *buf;
+    size_t buf_size, buf_used = 0, mark, reserve;
+    oo_ticks now_ticks, now_nsec;
+    double ticks_per_usec = 0.0, elapsed;
+    int i, chunk_size, num_reported = 0, ret;
+
+    if (!self) return NULL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return NULL;
+    mm = gen->mindmap;
+
+    /* runtime stats and cache occupancy of every CodeSystem */
+    buf_size = STATS_ENTRY_BUF_SIZE * (2 * mm->num_codesystems + 1);
+    buf = malloc(buf_size);
+    if (!buf) {
+	OOmnik_leave_generation(self, gen);
+	return NULL;
+    }
+
+    now_ticks = oo_read_ticks();
+    now_nsec = oo_read_nsec();
+
+    if (now_nsec > self->calib_nsec)
+	ticks_per_usec = (double)(now_ticks - self->calib_ticks) * 1000.0 /\
+	    (double)(now_nsec - self->calib_nsec);
+
+    pthread_mutex_lock(&self->stats_lock);
+
+    elapsed = (double)(now_nsec - self->stats_reset_nsec) / 1000000000.0;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"requests\":%zu,\"partial_requests\":%zu,"
+			  "\"elapsed_s\":%.3f,"
+			  "\"beam_pruned\":%zu,\"pruned_predictions\":%zu,"
+			  "\"reused_predictions\":%zu,\"codesystems\":[",
+			  self->num_requests, self->num_partial_requests, elapsed,
+			  self->num_beam_pruned, self->num_pruned_predictions,
+			  self->num_reused_predictions);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) {
+	pthread_mutex_unlock(&self->stats_lock);
+	OOmnik_leave_generation(self, gen);
+	free(buf);
+	return NULL;
+    }
+    buf_used += chunk_size;
+
+    /* room for closing both lists */
+    reserve = sizeof("],\"caches\":[") + sizeof("]}");
+
+    for (i = 0; i < mm->num_codesystems; i++) {
+	cs = mm->codesystems[i];
+	if (!cs || !cs->stats.num_runs) continue;
+	if (buf_used + reserve + 1 >= buf_size) break;
+
+	/* a report that does not fit is dropped */
+	mark = buf_used;
+	if (num_reported) buf[buf_used++] = ',';
+
+	ret = ooStats_present(&cs->stats, cs->name, ticks_per_usec,
+			      buf + buf_used, buf_size - buf_used - reserve);
+	if (ret != oo_OK) {
+	    buf_used = mark;
+	    break;
+	}
+
+	buf_used += strlen(buf + buf_used);
+	num_reported++;
+    }
+
+    pthread_mutex_unlock(&self->stats_lock);
+
+    chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			  "],\"caches\":[");
+    buf_used += chunk_size;
+
+    /* load-time figures need no locking */
+    reserve = sizeof("]}");
+    num_reported = 0;
+    for (i = 0; i < mm->num_codesystems; i++) {
+	cs = mm->codesystems[i];
+	if (!cs || !cs->cache || !cs->cache->matrix) continue;
+	if (buf_used + reserve + 1 >= buf_size) break;
+
+	mark = buf_used;
+	if (num_reported) buf[buf_used++] = ',';
+
+	ret = cs->cache->present_occupancy(cs->cache, buf + buf_used, 
+					   buf_size - buf_used - reserve);
+	if (ret != oo_OK) {
+	    buf_used = mark;
+	    break;
+	}
+
+	buf_used += strlen(buf + buf_used);
+	num_reported++;
+    }
+
+    snprintf(buf + buf_used, buf_size - buf_used, "]}");
+
+    OOmnik_leave_generation(self, gen);
+
+    return buf;
+}
+
+EXPORT extern int
+OOmnik_reset_stats(void *oomnik)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    struct ooMindMap *mm;
+    int i;
+
+    if (!self) return oo_FAIL;
+
+    gen = OOmnik_enter_generation(self);
+
+    pthread_mutex_lock(&self->stats_lock);
+
+    mm = gen ? gen->mindmap : NULL;
+    for (i = 0; mm && i < mm->num_codesystems; i++) {
+	if (!mm->codesystems[i]) continue;
+	ooStats_reset(&mm->codesystems[i]->stats);
+    }
+
+    self->num_requests = 0;
+    self->num_partial_requests = 0;
+    self->num_beam_pruned = 0;
+    self->num_pruned_predictions = 0;
+    self->num_reused_predictions = 0;
+    self->stats_reset_nsec = oo_read_nsec();
+
+    pthread_mutex_unlock(&self->stats_lock);
+
+    if (gen)
+	OOmnik_leave_generation(self, gen);
+
+    return oo_OK;
+}
+
+/**
+ * working memory of a request: a Decoder hierarchy
+ * is set up the same way as in OOmnik_process
+ */
+static int
+OOmnik_measure_request(struct OOmnik *self,
+		       struct ooGeneration *gen,
+		       struct ooRequestMemory *mem)
+{
+    struct ooDecoder *dec;
     int ret;
 
-    output_buf = malloc(OUTPUT_BUF_SIZE);
-    if (!output_buf) return NULL;
-   
-    /* init new Decoder */
+    memset(mem, 0, sizeof(struct ooRequestMemory));
+
+    if (!gen->default_codesystem) return oo_FAIL;
+
     ret = ooDecoder_new(&dec);
-    if (ret != oo_OK) return NULL;
+    if (ret != oo_OK) return ret;
 
     dec->is_root = true;
     dec->oomnik = self;
-    dec->format = (output_type)format;
+    dec->beam = &gen->beam;
 
-    ret = dec->set_codesystem(dec, self->default_codesystem);
+    ret = dec->set_codesystem(dec, gen->default_codesystem);
+    if (ret == oo_OK)
+	ret = ooRequestMemory_measure(mem, dec);
 
-    if (ret != oo_OK) {
-	printf("  Sorry, the default codesystem \"%s\" is not available :(\n",
-	     self->default_codesystem_name);
+    dec->del(dec);
+
+    /* the output buffer of OOmnik_process */
+    mem->output_buffers += OUTPUT_BUF_SIZE;
+    mem->total += OUTPUT_BUF_SIZE;
+
+    return ret;
+}
+
+/**
+ * JSON report of the memory held by the knowledge base
+ * and by a single request, to be released by OOmnik_free_result
+ */
+EXPORT extern const char*
+OOmnik_memory_stats(void *oomnik)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    struct ooMindMap *mm;
+    struct ooCodeSystem *cs;
+    struct ooCodeSystemMemory cs_mem;
+    struct ooMindMapMemory mm_mem;
+    struct ooRequestMemory req_mem;
+    size_t buf_size, buf_used = 0, mark, kb_total;
+    char *buf;
+    int i, chunk_size, num_reported = 0, ret;
+
+    if (!self) return NULL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return NULL;
+    mm = gen->mindmap;
+
+    buf_size = MEMORY_ENTRY_BUF_SIZE * (mm->num_codesystems + 3);
+    buf = malloc(buf_size);
+    if (!buf) {
+	OOmnik_leave_generation(self, gen);
 	return NULL;
     }
 
+    ooMindMapMemory_measure(&mm_mem, mm);
+    kb_total = mm_mem.total;
+
+    strcpy(buf, "{\"codesystems\":[");
+    buf_used = strlen(buf);
+
+    for (i = 0; i < mm->num_codesystems; i++) {
+	cs = mm->codesystems[i];
+	if (!cs) continue;
+
+	ooCodeSystemMemory_measure(&cs_mem, cs);
+	kb_total += cs_mem.total;
+
+	/* the totals are kept even if a report does not fit */
+	mark = buf_used;
+	if (num_reported) buf[buf_used++] = ',';
+
+	ret = ooCodeSystemMemory_present(&cs_mem, cs->name, buf + buf_used,
+					 buf_size - buf_used);
+	if (ret != oo_OK) {
+	    buf_used = mark;
+	    continue;
+	}
+
+	buf_used += strlen(buf + buf_used);
+	num_reported++;
+    }
+
+    strcpy(buf + buf_used, "],\"mindmap\":");
+    buf_used += strlen(buf + buf_used);
+
+    ret = ooMindMapMemory_present(&mm_mem, buf + buf_used, buf_size - buf_used);
+    if (ret != oo_OK) goto error;
+    buf_used += strlen(buf + buf_used);
+
+    ret = OOmnik_measure_request(self, gen, &req_mem);
+    if (ret == oo_OK) {
+	strcpy(buf + buf_used, ",\"request\":");
+	buf_used += strlen(buf + buf_used);
+
+	ret = ooRequestMemory_present(&req_mem, gen->default_codesystem_name,
+				      buf + buf_used, buf_size - buf_used);
+	if (ret != oo_OK) goto error;
+	buf_used += strlen(buf + buf_used);
+    }
+
+    chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			  ",\"knowledge_base_total\":%zu,"
+			  "\"request_total\":%zu}",
+			  kb_total, req_mem.total);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	goto error;
+
+    OOmnik_leave_generation(self, gen);
+
+    return buf;
+
+ error:
+    OOmnik_leave_generation(self, gen);
+    free(buf);
+    return NULL;
+}
+
+/**
+ * convert the MindMap DB into a read-only Concept Store
+ * that can be set up by <db store="..."/>
+ */
+EXPORT extern int
+OOmnik_build_store(void *oomnik,
+		   const char *filename)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    int ret;
+
+    if (!self || !filename) return oo_FAIL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    ret = gen->mindmap->build_store(gen->mindmap, filename);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * write all the loaded concepts into the MindMap DB
+ */
+EXPORT extern int
+OOmnik_save_concepts(void *oomnik)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    int ret;
+
+    if (!self) return oo_FAIL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    ret = gen->mindmap->save_concepts(gen->mindmap);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * dump the MindMap DB into a file
+ */
+EXPORT extern int
+OOmnik_export_db(void *oomnik,
+		 const char *filename)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    int ret;
+
+    if (!self || !filename) return oo_FAIL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    ret = gen->mindmap->export_file(gen->mindmap, filename);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * bulk load a dump made by OOmnik_export_db
+ */
+EXPORT extern int
+OOmnik_import_db(void *oomnik,
+		 const char *filename)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    int ret;
+
+    if (!self || !filename) return oo_FAIL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    ret = gen->mindmap->restore_file(gen->mindmap, filename);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * start writing a trace of the given subsystems,
+ * a NULL filename stops tracing 
+ */
+EXPORT extern int
+OOmnik_set_trace(void *oomnik,
+		 const char *filename,
+		 const char *subsystems)
+{
+    if (!filename) return oo_trace_close();
+
+    return oo_trace_open(filename, subsystems);
+}
+
+EXPORT extern int
+OOmnik_free_result(const char *outbuf)
+{
+    char *buf = (char*)outbuf;
+    if (buf)
+	free(buf);
+
+    return oo_OK;
+}
+
+/**
+ * build the next knowledge base generation in the background,
+ * fails if a reload is already running
+ */
+EXPORT extern int
+OOmnik_start_reload(void *oomnik)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+
+    if (!self) return oo_FAIL;
+
+    return self->start_reload(self);
+}
+
+
+typedef enum code_update_t { CODE_ADD, 
+			      CODE_REPLACE, 
+			      CODE_REMOVE } code_update_t;
+
+/**
+ * change a single code of a CodeSystem in the current generation,
+ * the requests under way are finished first
+ */
+static int
+OOmnik_update_code(struct OOmnik *self,
+		   code_update_t update,
+		   const char *cs_name,
+		   const char *code_xml,
+		   const char *code_name)
+{
+    struct ooGeneration *gen;
+    struct ooCodeSystem *cs;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root = NULL;
+    int ret;
+
+    if (!self || !cs_name) return oo_FAIL;
+
+    if (update != CODE_REMOVE) {
+	doc = xmlReadMemory(code_xml, strlen(code_xml), NULL, NULL, 0);
+	if (!doc) {
+	    fprintf(stderr, "  -- OOmnik: the code description is not valid XML :(\n");
+	    return oo_FAIL;
+	}
+
+	root = xmlDocGetRootElement(doc);
+	if (!root || xmlStrcmp(root->name, (const xmlChar *)"code")) {
+	    fprintf(stderr, "  -- OOmnik: a <code> element is expected :(\n");
+	    xmlFreeDoc(doc);
+	    return oo_FAIL;
+	}
+    }
+
+    gen = OOmnik_acquire_generation(self);
+    if (!gen) {
+	if (doc) xmlFreeDoc(doc);
+	return oo_FAIL;
+    }
+
+    cs = gen->mindmap->get_codesystem(gen->mindmap, cs_name);
+    if (!cs) {
+	fprintf(stderr, "  -- OOmnik: no such CodeSystem: \"%s\" :(\n", cs_name);
+	ret = oo_FAIL;
+	goto final;
+    }
+
+    pthread_rwlock_wrlock(&gen->update_lock);
+
+    switch (update) {
+    case CODE_ADD:
+	ret = cs->add_code(cs, root);
+	break;
+    case CODE_REPLACE:
+	ret = cs->replace_code(cs, root);
+	break;
+    default:
+	ret = cs->remove_code(cs, code_name);
+	break;
+    }
+
+    /* the sessions rebuild their decoders */
+    gen->num_updates++;
+
+    pthread_rwlock_unlock(&gen->update_lock);
+
+ final:
+    OOmnik_release_generation(self, gen);
+
+    if (doc) xmlFreeDoc(doc);
+
+    return ret;
+}
+
+/**
+ * add a code given as a <code> element to a CodeSystem in use,
+ * the code stays until the next reload
+ */
+EXPORT extern int
+OOmnik_add_code(void *oomnik,
+		const char *cs_name,
+		const char *code_xml)
+{
+    if (!code_xml) return oo_FAIL;
+
+    return OOmnik_update_code((struct OOmnik*)oomnik, CODE_ADD, 
+			      cs_name, code_xml, NULL);
+}
+
+/* a code of the same name is replaced or added */
+EXPORT extern int
+OOmnik_replace_code(void *oomnik,
+		    const char *cs_name,
+		    const char *code_xml)
+{
+    if (!code_xml) return oo_FAIL;
+
+    return OOmnik_update_code((struct OOmnik*)oomnik, CODE_REPLACE, 
+			      cs_name, code_xml, NULL);
+}
+
+EXPORT extern int
+OOmnik_remove_code(void *oomnik,
+		   const char *cs_name,
+		   const char *code_name)
+{
+    if (!code_name) return oo_FAIL;
+
+    return OOmnik_update_code((struct OOmnik*)oomnik, CODE_REMOVE, 
+			      cs_name, NULL, code_name);
+}
+
+
+/**
+ * build the decoder hierarchy of a CodeSystem
+ * of a pinned generation
+ */
+static int
+OOmnik_new_decoder(struct OOmnik *self,
+		   struct ooGeneration *gen,
+		   struct ooCodeSystem *cs,
+		   struct ooDecoder **result)
+{
+    struct ooDecoder *dec;
+    int ret;
+
+    ret = ooDecoder_new(&dec);
+    if (ret != oo_OK) return ret;
+
+    dec->is_root = true;
+    dec->oomnik = self;
+    dec->beam = &gen->beam;
+    dec->budget = &dec->root_budget;
+
+    ret = dec->set_codesystem(dec, cs);
+    if (ret != oo_OK) {
+	printf("  Sorry, the codesystem \"%s\" is not available :(\n",
+	       cs->name);
+	dec->del(dec);
+	return ret;
+    }
+
+    *result = dec;
+
+    return oo_OK;
+}
+
+/**
+ * the budget of a request starts with the limits given
+ * and its deadline counts from now
+ */
+static void
+OOmnik_start_budget(struct ooDecoder *dec,
+		    const struct ooBudget *limits)
+{
+    struct ooBudget *budget = &dec->root_budget;
+
+    memset(budget, 0, sizeof(struct ooBudget));
+    if (!limits || !limits->enabled) return;
+
+    budget->enabled = true;
+    budget->deadline_usec = limits->deadline_usec;
+    budget->max_units = limits->max_units;
+    budget->max_complexes = limits->max_complexes;
+
+    if (budget->deadline_usec)
+	budget->deadline = oo_read_nsec() + 
+	    (oo_ticks)budget->deadline_usec * 1000;
+}
+
+/**
+ * decode a request with a root decoder
+ * into the caller's buffer;
+ * a request out of its budget presents
+ * the best solution found so far
+ */
+static int
+OOmnik_decode(struct OOmnik *self,
+	      struct ooDecoder *dec,
+	      const struct ooBudget *budget,
+	      const char *input,
+	      int format,
+	      char *output_buf,
+	      size_t output_buf_size)
+{
+    struct ooCodeSystem *cs = dec->codesystem;
+    oo_ticks begin, trace_begin, request_begin;
+    bool is_partial;
+    int ret;
+
+    request_begin = OO_TRACE_BEGIN(OO_TRACE_DECODER);
+
+    dec->format = (output_type)format;
+    OOmnik_start_budget(dec, budget);
+
     ret = dec->process(dec, input);
+    is_partial = dec->root_budget.is_exhausted;
 
     /* TODO: add error explanation text to Decoder
      * and return it to the caller */
-    if (ret != oo_OK) return NULL;
+    if (ret != oo_OK && !is_partial) return ret;
 
-    /*if (!dec->agenda->accu->output_buf) {
-	free(output_buf);
-	ret = dec->del(dec);
-	return NULL;
-	}*/
+    dec->agenda->accu->is_partial = is_partial;
 
+    trace_begin = OO_TRACE_BEGIN(OO_TRACE_PRESENT);
+    begin = oo_read_ticks();
     dec->agenda->accu->present_solution(dec->agenda->accu,
-					output_buf, OUTPUT_BUF_SIZE);
+					output_buf, output_buf_size);
+    ooStats_add_stage(&dec->stats, OO_STAGE_PRESENTATION, begin);
+    OO_TRACE_END(OO_TRACE_PRESENT, "present", cs->name, trace_begin);
+
+    pthread_mutex_lock(&self->stats_lock);
+    self->num_requests++;
+    if (is_partial)
+	self->num_partial_requests++;
+    OOmnik_collect_stats(self, dec);
+    pthread_mutex_unlock(&self->stats_lock);
+
+    OO_TRACE_END(OO_TRACE_DECODER, "request", cs->name, request_begin);
+
+    return oo_OK;
+}
 
-    /*sprintf(output_buf, "%s", dec->agenda->accu->solution);*/
-    ret = dec->del(dec);
+/* for external systems */
+EXPORT extern const char*
+OOmnik_process(void *oomnik, 
+	       const char *input,
+	       int format)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    struct ooDecoder *dec = NULL;
+    char *output_buf = NULL;
+    int ret;
+
+    /* the whole request is served by the same generation
+     * even if a reload swaps it meanwhile */
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return NULL;
+
+    if (!gen->default_codesystem) {
+	printf("  Sorry, the default codesystem \"%s\" is not available :(\n",
+	       gen->default_codesystem_name);
+	goto error;
+    }
+
+    output_buf = malloc(OUTPUT_BUF_SIZE);
+    if (!output_buf) goto error;
+
+    ret = OOmnik_new_decoder(self, gen, gen->default_codesystem, &dec);
+    if (ret != oo_OK) goto error;
+
+    ret = OOmnik_decode(self, dec, &gen->budget, input, format,
+			output_buf, OUTPUT_BUF_SIZE);
+    if (ret != oo_OK) goto error;
+
+    dec->del(dec);
+
+    OOmnik_leave_generation(self, gen);
 
     return output_buf;
+
+ error:
+    if (dec) dec->del(dec);
+    OOmnik_leave_generation(self, gen);
+    if (output_buf) free(output_buf);
+    return NULL;
+}
+
+/**
+ * forget the decoders of the session,
+ * the session moves over to the given generation;
+ * deleting a decoder never reads its generation,
+ * so the one they were built for may be gone already
+ */
+static void
+OOmnik_session_reset(struct ooSession *session,
+		     struct ooGeneration *gen)
+{
+    size_t i;
+
+    for (i = 0; i < session->num_decoders; i++)
+	session->decoders[i]->del(session->decoders[i]);
+    session->num_decoders = 0;
+
+    session->generation_id = gen ? gen->id : 0;
+    session->num_updates = gen ? gen->num_updates : 0;
+}
+
+/**
+ * the decoder hierarchy of the CodeSystem
+ * kept by the session, built on the first request
+ */
+static struct ooDecoder*
+OOmnik_session_get_decoder(struct ooSession *session,
+			   struct ooGeneration *gen,
+			   struct ooCodeSystem *cs)
+{
+    struct ooDecoder **decoders;
+    struct ooDecoder *dec;
+    size_t i;
+    int ret;
+
+    if (session->generation_id != gen->id ||
+	session->num_updates != gen->num_updates)
+	OOmnik_session_reset(session, gen);
+
+    for (i = 0; i < session->num_decoders; i++) {
+	if (session->decoders[i]->codesystem == cs)
+	    return session->decoders[i];
+    }
+
+    decoders = realloc(session->decoders, sizeof(struct ooDecoder*) *
+		       (session->num_decoders + 1));
+    if (!decoders) return NULL;
+    session->decoders = decoders;
+
+    ret = OOmnik_new_decoder(session->oomnik, gen, cs, &dec);
+    if (ret != oo_OK) return NULL;
+
+    decoders[session->num_decoders++] = dec;
+    session->num_decoders_built++;
+
+    return dec;
+}
+
+/*  a failed request leaves a hierarchy of unknown state */
+static void
+OOmnik_session_drop_decoder(struct ooSession *session,
+			    struct ooDecoder *dec)
+{
+    size_t i;
+
+    for (i = 0; i < session->num_decoders; i++) {
+	if (session->decoders[i] != dec) continue;
+	session->decoders[i] = session->decoders[--session->num_decoders];
+	break;
+    }
+
+    dec->del(dec);
+}
+
+/*  a request of a session within a pinned generation */
+static int
+OOmnik_session_decode(struct ooSession *session,
+		      struct ooGeneration *gen,
+		      struct ooCodeSystem *cs,
+		      const char *input,
+		      int format,
+		      const char **result)
+{
+    struct ooDecoder *dec;
+    struct ooBudget *budget;
+    int ret;
+
+    session->is_partial = false;
+
+    dec = OOmnik_session_get_decoder(session, gen, cs);
+    if (!dec) return oo_FAIL;
+
+    budget = session->has_budget ? &session->budget : &gen->budget;
+
+    session->output_buf[0] = '\0';
+    ret = OOmnik_decode(session->oomnik, dec, budget, input, format,
+			session->output_buf, session->output_buf_size);
+    if (ret != oo_OK) {
+	OOmnik_session_drop_decoder(session, dec);
+	return ret;
+    }
+
+    session->is_partial = dec->root_budget.is_exhausted;
+
+    dec->reset(dec);
+
+    session->num_requests++;
+    *result = session->output_buf;
+
+    return oo_OK;
+}
+
+/**
+ * working context of a client thread,
+ * to be released by OOmnik_close_session
+ */
+EXPORT extern void*
+OOmnik_open_session(void *oomnik)
+{
+    struct ooSession *session;
+
+    if (!oomnik) return NULL;
+
+    session = malloc(sizeof(struct ooSession));
+    if (!session) return NULL;
+
+    memset(session, 0, sizeof(struct ooSession));
+    session->oomnik = (struct OOmnik*)oomnik;
+
+    session->output_buf = malloc(OUTPUT_BUF_SIZE);
+    if (!session->output_buf) {
+	free(session);
+	return NULL;
+    }
+    session->output_buf_size = OUTPUT_BUF_SIZE;
+
+    return session;
+}
+
+/**
+ * decode a request with the named CodeSystem,
+ * NULL takes the default one; the result belongs
+ * to the session and is overwritten by its next request
+ */
+EXPORT extern int
+OOmnik_session_process(void *ctx,
+		       const char *input,
+		       int format,
+		       const char *cs_name,
+		       const char **result)
+{
+    struct ooSession *session = (struct ooSession*)ctx;
+    struct OOmnik *self;
+    struct ooGeneration *gen;
+    struct ooCodeSystem *cs;
+    int ret;
+
+    if (!session || !input || !result) return oo_FAIL;
+    self = session->oomnik;
+    *result = NULL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    cs = gen->default_codesystem;
+    if (cs_name && *cs_name)
+	cs = gen->mindmap->get_codesystem(gen->mindmap, cs_name);
+
+    if (!cs) {
+	OOmnik_leave_generation(self, gen);
+	return oo_NO_RESULTS;
+    }
+
+    ret = OOmnik_session_decode(session, gen, cs, input, format, result);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * CodeSystem handle for OOmnik_session_process_cs:
+ * it saves the name lookup and stays valid until the next reload
+ */
+EXPORT extern void*
+OOmnik_get_codesystem(void *oomnik,
+		      const char *cs_name)
+{
+    struct OOmnik *self = (struct OOmnik*)oomnik;
+    struct ooGeneration *gen;
+    struct ooCodeSystem *cs;
+
+    if (!self || !cs_name) return NULL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return NULL;
+
+    cs = gen->mindmap->get_codesystem(gen->mindmap, cs_name);
+
+    OOmnik_leave_generation(self, gen);
+
+    return (void*)cs;
+}
+
+/**
+ * decode a request with a CodeSystem handle,
+ * NULL takes the default one; a handle of a previous
+ * generation is refused with oo_NO_RESULTS
+ */
+EXPORT extern int
+OOmnik_session_process_cs(void *ctx,
+			  const char *input,
+			  int format,
+			  void *codesystem,
+			  const char **result)
+{
+    struct ooSession *session = (struct ooSession*)ctx;
+    struct OOmnik *self;
+    struct ooGeneration *gen;
+    struct ooMindMap *mindmap;
+    struct ooCodeSystem *cs = NULL;
+    int i, ret;
+
+    if (!session || !input || !result) return oo_FAIL;
+    self = session->oomnik;
+    *result = NULL;
+
+    gen = OOmnik_enter_generation(self);
+    if (!gen) return oo_FAIL;
+
+    /* the handle is only compared, never followed,
+     * until it is known to belong to this generation */
+    mindmap = gen->mindmap;
+    if (!codesystem)
+	cs = gen->default_codesystem;
+    else {
+	for (i = 0; i < mindmap->num_codesystems; i++) {
+	    if ((void*)mindmap->codesystems[i] != codesystem) continue;
+	    cs = mindmap->codesystems[i];
+	    break;
+	}
+    }
+
+    if (!cs) {
+	OOmnik_leave_generation(self, gen);
+	return oo_NO_RESULTS;
+    }
+
+    ret = OOmnik_session_decode(session, gen, cs, input, format, result);
+
+    OOmnik_leave_generation(self, gen);
+
+    return ret;
+}
+
+/**
+ * limit the following requests of the session
+ * in place of the configured budget, 0 means unlimited
+ */
+EXPORT extern int
+OOmnik_session_set_budget(void *ctx,
+			  size_t deadline_usec,
+			  size_t max_units,
+			  size_t max_complexes)
+{
+    struct ooSession *session = (struct ooSession*)ctx;
+
+    if (!session) return oo_FAIL;
+
+    memset(&session->budget, 0, sizeof(struct ooBudget));
+    session->budget.enabled = (deadline_usec || max_units || max_complexes);
+    session->budget.deadline_usec = deadline_usec;
+    session->budget.max_units = max_units;
+    session->budget.max_complexes = max_complexes;
+    session->has_budget = true;
+
+    return oo_OK;
+}
+
+/*  1 if the last request of the session ran out of its budget */
+EXPORT extern int
+OOmnik_session_is_partial(void *ctx)
+{
+    struct ooSession *session = (struct ooSession*)ctx;
+
+    if (!session) return 0;
+
+    return session->is_partial ? 1 : 0;
+}
+
+EXPORT extern int
+OOmnik_close_session(void *ctx)
+{
+    struct ooSession *session = (struct ooSession*)ctx;
+
+    if (!session) return oo_FAIL;
+
+    OOmnik_session_reset(session, NULL);
+
+    if (session->decoders) free(session->decoders);
+    free(session->output_buf);
+    free(session);
+
+    return oo_OK;
 }
 
 
@@ -545,6 +2018,17 @@ OOmnik_create(const char *conf_name)
     ret = OOmnik_read_data(oomnik, conf_name);
     if (ret != oo_OK) goto error;
 
+    /* a reload keeps the trace as it is */
+    if (oomnik->trace_filename) {
+	ret = oo_trace_open(oomnik->trace_filename, oomnik->trace_subsystems);
+	if (ret == oo_OK)
+	    fprintf(stderr, "    * trace file: %s (%s)\n", oomnik->trace_filename, 
+		    oomnik->trace_subsystems ? oomnik->trace_subsystems : "all");
+    }
+
+    ret = OOmnik_publish(oomnik, oomnik);
+    if (ret != oo_OK) goto error;
+
     fprintf(stderr,"\n   OOmnik is up and running!\n");
 
     return (void*)oomnik;
@@ -560,18 +2044,14 @@ error:
 extern int 
 OOmnik_init(struct OOmnik *self)
 {
-    int ret;
-
     self->conf_name = NULL;
-    self->mindmap = NULL;
 
-    ret = ooMindMap_new(&self->mindmap);
-    if (ret != oo_OK) {
-	free(self);
-	return ret;
-    }
+    /* both are set up by OOmnik_read_data */
+    self->mindmap = NULL;
+    self->db_env = NULL;
 
     self->db_filename = NULL;
+    self->store_filename = NULL;
     self->default_codesystem_name = NULL;
     self->default_codesystem = NULL;
 
@@ -580,6 +2060,36 @@ OOmnik_init(struct OOmnik *self)
     self->includes_path = NULL;
     self->includes = NULL;
     self->num_includes = 0;
+    self->trace_filename = NULL;
+    self->trace_subsystems = NULL;
+
+    /* beam search is off by default */
+    self->beam.enabled = false;
+    self->beam.span_width = 0;
+    self->beam.code_width = 0;
+    self->beam.threshold = 0.0;
+
+    self->num_beam_pruned = 0;
+    self->num_pruned_predictions = 0;
+    self->num_reused_predictions = 0;
+
+    /* requests are not limited by default */
+    memset(&self->budget, 0, sizeof(struct ooBudget));
+
+    self->num_requests = 0;
+    self->num_partial_requests = 0;
+    self->calib_ticks = oo_read_ticks();
+    self->calib_nsec = oo_read_nsec();
+    self->stats_reset_nsec = self->calib_nsec;
+    pthread_mutex_init(&self->stats_lock, NULL);
+
+    /* the first generation is published by OOmnik_create */
+    self->generation = NULL;
+    self->num_generations = 0;
+    pthread_mutex_init(&self->generation_lock, NULL);
+
+    self->has_reload_thread = false;
+    self->is_reloading = false;
     
     /* bind your methods */
     self->str = OOmnik_str;
@@ -587,6 +2097,7 @@ OOmnik_init(struct OOmnik *self)
 
     self->open_mindmap = OOmnik_open_mindmap;
     self->reload = OOmnik_reload;
+    self->start_reload = OOmnik_reload_async;
     self->interact = OOmnik_interact;
     self->process = OOmnik_process;
 
@@ -601,7 +2112,9 @@ OOmnik_new(struct OOmnik **oom)
     struct OOmnik *self = malloc(sizeof(struct OOmnik));
     if (!self) return oo_NOMEM;
 
-    OOmnik_init(self);
+    /* a failed init has already released self */
+    ret = OOmnik_init(self);
+    if (ret != oo_OK) return ret;
 
     *oom = self;
     return oo_OK;
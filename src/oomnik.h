@@ -13,15 +13,52 @@
 #ifndef OOMNIK_H
 #define OOMNIK_H
 
+#include <pthread.h>
+
 #include "ooconfig.h"
 #include "oomindmap.h"
 #include "ooconcept.h"
+#include "ooagenda.h"
 
 
 /* forward declarations */
 struct ooDecoder;
 
 
+/**
+ * Knowledge base generation:
+ * the MindMap built by one reading of the configuration.
+ * Every request pins the generation it has started with,
+ * a reload builds the next one while the current one
+ * keeps serving, and the old generation is freed
+ * as soon as its last request lets it go.
+ */
+typedef struct ooGeneration {
+    size_t id;
+
+    struct ooMindMap *mindmap;
+    struct ooCodeSystem *default_codesystem;
+    char *default_codesystem_name;
+
+    /* beam search settings the generation was built with */
+    struct ooBeam beam;
+
+    /* work budget of every request */
+    struct ooBudget budget;
+
+    /* pinning requests plus the controller while it is current */
+    size_t num_refs;
+
+    /* requests read the MindMap,
+     * code updates change it in place */
+    pthread_rwlock_t update_lock;
+
+    /* code updates applied so far:
+     * the decoders built before are stale */
+    size_t num_updates;
+} ooGeneration;
+
+
 /**
  * OOmnik Controller:
  * main controller of decoding process
@@ -31,6 +68,8 @@ struct ooDecoder;
 typedef struct OOmnik {
 
     /***********  public attributes **********/
+
+    /* MindMap of the current generation */
     struct ooMindMap *mindmap;
 
     const char *conf_name;
@@ -39,13 +78,59 @@ typedef struct OOmnik {
 
     char *db_filename;
 
+    /* the MindMap DB handles of all the generations
+     * share the locks and the cache of the controller */
+    DB_ENV *db_env;
+
+    /* read-only memory-mapped Concept Store */
+    char *store_filename;
+
     char *default_codesystem_name;
     struct ooCodeSystem *default_codesystem;
 
     char *includes_path;
 
+    /* <trace> settings, applied on the first load only */
+    char *trace_filename;
+    char *trace_subsystems;
+
     output_type default_format;
 
+    /* beam search settings for all agendas */
+    struct ooBeam beam;
+
+    /* work budget of every request */
+    struct ooBudget budget;
+
+    /* pruning totals over all processed requests */
+    size_t num_beam_pruned;
+    size_t num_pruned_predictions;
+    size_t num_reused_predictions;
+
+    /* decoding statistics: the per-stage figures
+     * are kept by every CodeSystem */
+    size_t num_requests;
+    size_t num_partial_requests;
+    oo_ticks stats_reset_nsec;
+
+    /* cycle counter calibration */
+    oo_ticks calib_ticks;
+    oo_ticks calib_nsec;
+
+    /* guards the totals against concurrent requests */
+    pthread_mutex_t stats_lock;
+
+    /* the generation new requests are served from,
+     * mindmap and default_codesystem follow it */
+    struct ooGeneration *generation;
+    size_t num_generations;
+    pthread_mutex_t generation_lock;
+
+    /* background reload */
+    pthread_t reload_thread;
+    bool has_reload_thread;
+    bool is_reloading;
+
     /* public methods */
     int   (*del)(struct OOmnik *self);
     int   (*str)(struct OOmnik *self);
@@ -57,9 +142,14 @@ typedef struct OOmnik {
     /*  start the interactive shell */
     int (*interact)(struct OOmnik *self);
 
-    /*  re-read all knowledge sources */
+    /*  re-read all knowledge sources:
+     *  the current generation keeps serving
+     *  until the new one is ready, a failed build leaves it active */
     int (*reload)(struct OOmnik *self);
 
+    /*  the same in a background thread */
+    int (*start_reload)(struct OOmnik *self);
+
     /*  process string from memory */
     int (*process)(void *self, 
 		   const char *input,
@@ -73,6 +163,45 @@ typedef struct OOmnik {
 } OOmnik;
 
 
+/**
+ * Session:
+ * the working context of a single client thread,
+ * its output buffer is reused by every request
+ * and stays valid until the next one.
+ * The decoder hierarchy of every CodeSystem asked for
+ * is built once and kept for the following requests
+ * until a reload or a code update makes it stale.
+ */
+typedef struct ooSession {
+    struct OOmnik *oomnik;
+
+    char *output_buf;
+    size_t output_buf_size;
+
+    /* the generation the decoders are built for:
+     * only its id is kept, so an idle session
+     * does not hold a drained generation in memory,
+     * the decoders of a freed one are dropped on the next request */
+    size_t generation_id;
+    size_t num_updates;
+
+    /* root decoders, one per CodeSystem */
+    struct ooDecoder **decoders;
+    size_t num_decoders;
+
+    /* the budget of the session's requests
+     * in place of the configured one */
+    struct ooBudget budget;
+    bool has_budget;
+
+    /* the last request ran out of its budget */
+    bool is_partial;
+
+    size_t num_requests;
+    size_t num_decoders_built;
+} ooSession;
+
+
 /* for external systems like .NET */
 #ifdef __cplusplus
 extern "C" {
@@ -83,6 +212,52 @@ EXPORT extern const char* OOmnik_process(void *oomnik,
 					 const char *buf,
 					 int format);
 EXPORT extern int OOmnik_free_result(const char *buf);
+EXPORT extern void* OOmnik_open_session(void *oomnik);
+EXPORT extern int OOmnik_session_process(void *session,
+					 const char *input,
+					 int format,
+					 const char *cs_name,
+					 const char **result);
+EXPORT extern void* OOmnik_get_codesystem(void *oomnik,
+					  const char *cs_name);
+EXPORT extern int OOmnik_session_process_cs(void *session,
+					    const char *input,
+					    int format,
+					    void *codesystem,
+					    const char **result);
+EXPORT extern int OOmnik_session_set_budget(void *session,
+					    size_t deadline_usec,
+					    size_t max_units,
+					    size_t max_complexes);
+EXPORT extern int OOmnik_session_is_partial(void *session);
+EXPORT extern int OOmnik_close_session(void *session);
+EXPORT extern int OOmnik_start_reload(void *oomnik);
+EXPORT extern int OOmnik_add_code(void *oomnik,
+				  const char *cs_name,
+				  const char *code_xml);
+EXPORT extern int OOmnik_replace_code(void *oomnik,
+				      const char *cs_name,
+				      const char *code_xml);
+EXPORT extern int OOmnik_remove_code(void *oomnik,
+				     const char *cs_name,
+				     const char *code_name);
+EXPORT extern int OOmnik_get_pruning_stats(void *oomnik,
+					   size_t *num_beam_pruned,
+					   size_t *num_pruned_predictions,
+					   size_t *num_reused_predictions);
+EXPORT extern const char* OOmnik_get_stats(void *oomnik);
+EXPORT extern int OOmnik_reset_stats(void *oomnik);
+EXPORT extern const char* OOmnik_memory_stats(void *oomnik);
+EXPORT extern int OOmnik_build_store(void *oomnik,
+				     const char *filename);
+EXPORT extern int OOmnik_save_concepts(void *oomnik);
+EXPORT extern int OOmnik_export_db(void *oomnik,
+				   const char *filename);
+EXPORT extern int OOmnik_import_db(void *oomnik,
+				   const char *filename);
+EXPORT extern int OOmnik_set_trace(void *oomnik,
+				   const char *filename,
+				   const char *subsystems);
 
 extern int OOmnik_new(struct OOmnik **self);
 
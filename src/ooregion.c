@@ -0,0 +1,151 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooregion.c
+ *   OOmnik region allocator of knowledge base objects
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ooconfig.h"
+#include "ooregion.h"
+
+/* header of a growable array */
+typedef struct ooRegionBlock {
+    size_t slot;
+    size_t size;
+} ooRegionBlock;
+
+static int
+ooRegion_del(struct ooRegion *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->num_chunks; i++)
+	free(self->chunks[i]);
+
+    for (i = 0; i < self->num_blocks; i++)
+	free(self->blocks[i]);
+
+    if (self->chunks) free(self->chunks);
+    if (self->blocks) free(self->blocks);
+
+    free(self);
+
+    return oo_OK;
+}
+
+static void*
+ooRegion_alloc(struct ooRegion *self,
+	       size_t size)
+{
+    char **chunks;
+    char *chunk;
+    size_t chunk_size = REGION_CHUNK_SIZE;
+
+    size = (size + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1);
+
+    if (self->num_chunks &&
+	self->chunk_used + size <= REGION_CHUNK_SIZE) {
+	chunk = self->chunks[self->num_chunks - 1] + self->chunk_used;
+	self->chunk_used += size;
+	memset(chunk, 0, size);
+	return chunk;
+    }
+
+    /* oversized objects get a chunk of their own */
+    if (size > chunk_size)
+	chunk_size = size;
+
+    chunks = realloc(self->chunks, sizeof(char*) * (self->num_chunks + 1));
+    if (!chunks) return NULL;
+    self->chunks = chunks;
+
+    chunk = calloc(1, chunk_size);
+    if (!chunk) return NULL;
+
+    /* an oversized chunk is full right away
+     * and goes below the current one */
+    if (chunk_size > REGION_CHUNK_SIZE && self->num_chunks) {
+	chunks[self->num_chunks] = chunks[self->num_chunks - 1];
+	chunks[self->num_chunks - 1] = chunk;
+    }
+    else {
+	chunks[self->num_chunks] = chunk;
+	self->chunk_used = size;
+    }
+
+    self->num_chunks++;
+    self->total_size += chunk_size;
+
+    return chunk;
+}
+
+static void*
+ooRegion_realloc(struct ooRegion *self,
+		 void *ptr,
+		 size_t size)
+{
+    struct ooRegionBlock *block = NULL;
+    void **blocks;
+    size_t blocks_size, old_size = 0;
+
+    if (ptr) {
+	block = (struct ooRegionBlock*)ptr - 1;
+	old_size = block->size;
+    }
+    else if (self->num_blocks == self->blocks_size) {
+	blocks_size = self->blocks_size ?
+	    self->blocks_size * INDEX_REALLOC_FACTOR : REGION_INIT_BLOCKS;
+	blocks = realloc(self->blocks, sizeof(void*) * blocks_size);
+	if (!blocks) return NULL;
+	self->blocks = blocks;
+	self->blocks_size = blocks_size;
+    }
+
+    block = realloc(block, sizeof(struct ooRegionBlock) + size);
+    if (!block) return NULL;
+
+    if (!ptr)
+	block->slot = self->num_blocks++;
+
+    block->size = size;
+    self->blocks[block->slot] = block;
+    self->total_size += size - old_size;
+
+    return block + 1;
+}
+
+extern int
+ooRegion_new(struct ooRegion **region)
+{
+    struct ooRegion *self;
+
+    self = malloc(sizeof(struct ooRegion));
+    if (!self) return oo_NOMEM;
+
+    memset(self, 0, sizeof(struct ooRegion));
+
+    self->del = ooRegion_del;
+    self->alloc = ooRegion_alloc;
+    self->realloc = ooRegion_realloc;
+
+    *region = self;
+
+    return oo_OK;
+}
@@ -0,0 +1,64 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooregion.h
+ *   OOmnik region allocator of knowledge base objects
+ */
+
+#ifndef OO_REGION_H
+#define OO_REGION_H
+
+#include <stddef.h>
+
+#include "ooconfig.h"
+
+/**
+ *  Region:
+ *  owns the objects of one loaded knowledge base.
+ *
+ *  Fixed size objects are carved out of large chunks,
+ *  growable arrays are kept on the heap as tracked blocks.
+ *  Nothing is released one by one: a single del()
+ *  gives back the whole generation.
+ */
+typedef struct ooRegion {
+    char **chunks;
+    size_t num_chunks;
+    size_t chunk_used;
+
+    /* growable arrays */
+    void **blocks;
+    size_t num_blocks;
+    size_t blocks_size;
+
+    /* bytes taken from the system */
+    size_t total_size;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooRegion *self);
+
+    /* zeroed memory that lives as long as the region */
+    void* (*alloc)(struct ooRegion *self, size_t size);
+
+    /* resize an array of the region,
+     * NULL starts a new one; the contents are kept */
+    void* (*realloc)(struct ooRegion *self, void *ptr, size_t size);
+
+} ooRegion;
+
+extern int ooRegion_new(struct ooRegion **self);
+
+#endif /* OO_REGION_H */
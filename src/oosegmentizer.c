@@ -428,6 +428,7 @@ static int
 ooSegmentizer_segmentize(struct ooSegmentizer *self)
 {
     atomic_codesystem_t atomic_cs_type;
+    oo_ticks begin;
     int ret;
     size_t i;
     struct ooDecoder *dec;
@@ -442,7 +443,12 @@ ooSegmentizer_segmentize(struct ooSegmentizer *self)
     /* atomic segmentation: byte(s) -> integer */
     if (self->is_atomic) {
 	atomic_cs_type = self->parent_decoder->codesystem->atomic_codesystem_type;
-	return ooSegmentizer_choose_atomic_decoder(self, atomic_cs_type);
+
+	begin = oo_read_ticks();
+	ret = ooSegmentizer_choose_atomic_decoder(self, atomic_cs_type);
+	ooStats_add_stage(&self->parent_decoder->stats, 
+			  OO_STAGE_ATOMIC_PARSE, begin);
+	return ret;
     }
 
     if (!self->num_decoders) {
@@ -474,6 +480,10 @@ ooSegmentizer_segmentize(struct ooSegmentizer *self)
 
     /* cooperative decoders */
     for (i = 0; i < self->num_decoders; i++) {
+	/* out of budget: the interpretations merged so far will do */
+	if (i && self->agenda->budget_admit(self->agenda, true) != oo_OK)
+	    break;
+
 	dec = self->decoders[i];
 	ret = ooSegmentizer_call_subordinate_decoder(self, dec);
 	if (ret != oo_OK) continue;
@@ -0,0 +1,995 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooserver.c
+ *   OOmnik socket server
+ */
+
+/* accept4 */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ooconfig.h"
+#include "oomnik.h"
+#include "ooserver.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static size_t
+ooServer_get_size(const char *buf)
+{
+    const unsigned char *c = (const unsigned char*)buf;
+
+    return ((size_t)c[0] << 24) | ((size_t)c[1] << 16) |
+	((size_t)c[2] << 8) | (size_t)c[3];
+}
+
+static void
+ooServer_put_size(char *buf,
+		  size_t size)
+{
+    buf[0] = (char)((size >> 24) & 0xff);
+    buf[1] = (char)((size >> 16) & 0xff);
+    buf[2] = (char)((size >> 8) & 0xff);
+    buf[3] = (char)(size & 0xff);
+}
+
+/*  the complete response frame of a job */
+static int
+ooServer_set_frame(struct ooServerJob *job,
+		   oo_server_status status,
+		   const char *payload,
+		   size_t payload_size)
+{
+    size_t body_size = OO_SERVER_RESPONSE_HEADER_SIZE + payload_size;
+
+    job->frame = malloc(OO_SERVER_FRAME_HEADER_SIZE + body_size);
+    if (!job->frame) return oo_NOMEM;
+
+    ooServer_put_size(job->frame, body_size);
+    job->frame[OO_SERVER_FRAME_HEADER_SIZE] = (char)status;
+    if (payload_size)
+	memcpy(job->frame + OO_SERVER_FRAME_HEADER_SIZE +
+	       OO_SERVER_RESPONSE_HEADER_SIZE, payload, payload_size);
+
+    job->frame_size = OO_SERVER_FRAME_HEADER_SIZE + body_size;
+    job->frame_sent = 0;
+
+    return oo_OK;
+}
+
+static void
+ooServer_append_job(struct ooServerConn *conn,
+		    struct ooServerJob *job)
+{
+    job->next = NULL;
+
+    if (conn->tail)
+	conn->tail->next = job;
+    else
+	conn->head = job;
+
+    conn->tail = job;
+    conn->num_jobs++;
+}
+
+/*  a response that needs no worker */
+static int
+ooServer_reply(struct ooServerConn *conn,
+	       oo_server_status status,
+	       const char *payload,
+	       size_t payload_size)
+{
+    struct ooServerJob *job;
+    int ret;
+
+    job = malloc(sizeof(struct ooServerJob));
+    if (!job) return oo_NOMEM;
+
+    memset(job, 0, sizeof(struct ooServerJob));
+    job->conn = conn;
+
+    ret = ooServer_set_frame(job, status, payload, payload_size);
+    if (ret != oo_OK) {
+	free(job);
+	return ret;
+    }
+
+    job->is_done = true;
+    ooServer_append_job(conn, job);
+
+    return oo_OK;
+}
+
+/*  the counters of the event loop and those of the controller */
+static int
+ooServer_reply_stats(struct ooServer *self,
+		     struct ooServerConn *conn)
+{
+    const char *stats;
+    char *buf;
+    size_t buf_size;
+    int size, ret;
+
+    stats = OOmnik_get_stats(self->oomnik);
+
+    buf_size = STATS_ENTRY_BUF_SIZE + strlen(self->address) +
+	(stats ? strlen(stats) : 0);
+    buf = malloc(buf_size);
+    if (!buf) {
+	if (stats) OOmnik_free_result(stats);
+	return oo_NOMEM;
+    }
+
+    size = snprintf(buf, buf_size,
+		    "{\"server\":{\"address\":\"%s\",\"workers\":%zu,"
+		    "\"connections\":%zu,\"total_connections\":%zu,"
+		    "\"requests\":%zu,\"bad_requests\":%zu,"
+		    "\"active_jobs\":%zu,\"bytes_in\":%zu,\"bytes_out\":%zu},"
+		    "\"oomnik\":%s}",
+		    self->address, self->num_workers,
+		    self->num_conns, self->total_conns,
+		    self->num_requests, self->num_bad_requests,
+		    self->num_active_jobs, self->bytes_in, self->bytes_out,
+		    stats ? stats : "null");
+
+    if (stats) OOmnik_free_result(stats);
+
+    if (size < 0 || (size_t)size >= buf_size)
+	ret = ooServer_reply(conn, OO_SERVER_FAILED, NULL, 0);
+    else
+	ret = ooServer_reply(conn, OO_SERVER_OK, buf, (size_t)size);
+
+    free(buf);
+
+    return ret;
+}
+
+/*  hand a job over to the workers */
+static void
+ooServer_dispatch(struct ooServer *self,
+		  struct ooServerJob *job)
+{
+    job->next_queued = NULL;
+
+    pthread_mutex_lock(&self->lock);
+
+    if (self->queue_tail)
+	self->queue_tail->next_queued = job;
+    else
+	self->queue_head = job;
+    self->queue_tail = job;
+
+    pthread_cond_signal(&self->work_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    self->num_active_jobs++;
+}
+
+/**
+ *  turn the complete frames of the read buffer into jobs
+ *  while the pipeline of the connection has room
+ */
+static int
+ooServer_parse(struct ooServer *self,
+	       struct ooServerConn *conn)
+{
+    struct ooServerJob *job;
+    const unsigned char *body;
+    size_t offset = 0, body_size, frame_size;
+    size_t cs_name_size, input_size;
+    char *data, *buf;
+    int ret = oo_OK;
+
+    while (!conn->is_broken && conn->num_jobs < SERVER_MAX_PIPELINE) {
+	if (conn->buf_used - offset < OO_SERVER_FRAME_HEADER_SIZE) break;
+
+	body_size = ooServer_get_size(conn->buf + offset);
+	if (body_size < OO_SERVER_REQUEST_HEADER_SIZE ||
+	    body_size > SERVER_MAX_REQUEST_SIZE) {
+	    self->num_bad_requests++;
+	    conn->is_broken = true;
+	    ret = ooServer_reply(conn, OO_SERVER_BAD_REQUEST, NULL, 0);
+	    break;
+	}
+
+	frame_size = OO_SERVER_FRAME_HEADER_SIZE + body_size;
+	if (conn->buf_used - offset < frame_size) break;
+
+	body = (const unsigned char*)conn->buf + offset +
+	    OO_SERVER_FRAME_HEADER_SIZE;
+	offset += frame_size;
+	self->num_requests++;
+
+	cs_name_size = ((size_t)body[2] << 8) | (size_t)body[3];
+
+	if (cs_name_size > body_size - OO_SERVER_REQUEST_HEADER_SIZE ||
+	    body[1] > FORMAT_XML ||
+	    (body[0] != OO_SERVER_PROCESS && body[0] != OO_SERVER_STATS)) {
+	    self->num_bad_requests++;
+	    ret = ooServer_reply(conn, OO_SERVER_BAD_REQUEST, NULL, 0);
+	    if (ret != oo_OK) break;
+	    continue;
+	}
+
+	if (body[0] == OO_SERVER_STATS) {
+	    ret = ooServer_reply_stats(self, conn);
+	    if (ret != oo_OK) break;
+	    continue;
+	}
+
+	input_size = body_size - OO_SERVER_REQUEST_HEADER_SIZE - cs_name_size;
+
+	/* the job keeps its own copy of the names:
+	 * the read buffer moves on */
+	job = malloc(sizeof(struct ooServerJob) + cs_name_size + input_size + 2);
+	if (!job) {
+	    ret = oo_NOMEM;
+	    break;
+	}
+	memset(job, 0, sizeof(struct ooServerJob));
+
+	job->conn = conn;
+	job->type = body[0];
+	job->format = body[1];
+
+	data = (char*)(job + 1);
+	memcpy(data, body + OO_SERVER_REQUEST_HEADER_SIZE, cs_name_size);
+	data[cs_name_size] = '\0';
+	job->cs_name = data;
+
+	data += cs_name_size + 1;
+	memcpy(data, body + OO_SERVER_REQUEST_HEADER_SIZE + cs_name_size,
+	       input_size);
+	data[input_size] = '\0';
+	job->input = data;
+
+	ooServer_append_job(conn, job);
+	ooServer_dispatch(self, job);
+    }
+
+    if (offset) {
+	conn->buf_used -= offset;
+	memmove(conn->buf, conn->buf + offset, conn->buf_used);
+    }
+
+    if (ret != oo_OK || conn->is_broken) return ret;
+
+    /* room for the whole next frame */
+    if (conn->buf_used < OO_SERVER_FRAME_HEADER_SIZE) return oo_OK;
+
+    frame_size = OO_SERVER_FRAME_HEADER_SIZE + ooServer_get_size(conn->buf);
+    if (frame_size <= conn->buf_size ||
+	frame_size > OO_SERVER_FRAME_HEADER_SIZE + SERVER_MAX_REQUEST_SIZE)
+	return oo_OK;
+
+    buf = realloc(conn->buf, frame_size);
+    if (!buf) return oo_NOMEM;
+
+    conn->buf = buf;
+    conn->buf_size = frame_size;
+
+    return oo_OK;
+}
+
+static int
+ooServer_read(struct ooServer *self,
+	      struct ooServerConn *conn)
+{
+    ssize_t num_bytes;
+
+    if (conn->is_eof || conn->is_broken) return oo_OK;
+    if (conn->buf_used == conn->buf_size) return oo_OK;
+
+    num_bytes = recv(conn->fd, conn->buf + conn->buf_used,
+		     conn->buf_size - conn->buf_used, 0);
+    if (num_bytes < 0) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+	    return oo_OK;
+	return oo_FAIL;
+    }
+
+    if (!num_bytes) {
+	conn->is_eof = true;
+	return oo_OK;
+    }
+
+    conn->buf_used += (size_t)num_bytes;
+    self->bytes_in += (size_t)num_bytes;
+
+    return oo_OK;
+}
+
+/*  remove the sent response at the head */
+static void
+ooServer_pop_job(struct ooServerConn *conn)
+{
+    struct ooServerJob *job = conn->head;
+
+    conn->head = job->next;
+    if (!conn->head) conn->tail = NULL;
+    conn->num_jobs--;
+
+    if (job->frame) free(job->frame);
+    free(job);
+}
+
+/**
+ *  send the finished responses at the head of the pipeline,
+ *  several of them in a single call
+ */
+static int
+ooServer_flush(struct ooServer *self,
+	       struct ooServerConn *conn)
+{
+    struct iovec iov[SERVER_MAX_IOV];
+    struct msghdr msg;
+    struct ooServerJob *job;
+    size_t num_iov, num_sent, size;
+    ssize_t num_bytes;
+
+    conn->is_blocked = false;
+
+    while (conn->head && conn->head->is_done) {
+	num_iov = 0;
+	for (job = conn->head;
+	     job && job->is_done && num_iov < SERVER_MAX_IOV;
+	     job = job->next) {
+	    /* out of memory in a worker */
+	    if (!job->frame) return oo_NOMEM;
+
+	    iov[num_iov].iov_base = job->frame + job->frame_sent;
+	    iov[num_iov].iov_len = job->frame_size - job->frame_sent;
+	    num_iov++;
+	}
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = num_iov;
+
+	num_bytes = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+	if (num_bytes < 0) {
+	    if (errno == EINTR) continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		conn->is_blocked = true;
+		return oo_OK;
+	    }
+	    return oo_FAIL;
+	}
+
+	self->bytes_out += (size_t)num_bytes;
+
+	num_sent = (size_t)num_bytes;
+	while (num_sent) {
+	    job = conn->head;
+	    size = job->frame_size - job->frame_sent;
+	    if (num_sent < size) {
+		job->frame_sent += num_sent;
+		break;
+	    }
+	    num_sent -= size;
+	    ooServer_pop_job(conn);
+	}
+    }
+
+    return oo_OK;
+}
+
+/*  register the events the connection is waiting for */
+static int
+ooServer_watch(struct ooServer *self,
+	       struct ooServerConn *conn)
+{
+    struct epoll_event ev;
+    unsigned int events = 0;
+
+    /* backpressure: a full pipeline is not read */
+    if (!conn->is_eof && !conn->is_broken &&
+	conn->num_jobs < SERVER_MAX_PIPELINE &&
+	conn->buf_used < conn->buf_size)
+	events |= EPOLLIN;
+
+    if (conn->is_blocked)
+	events |= EPOLLOUT;
+
+    if (events == conn->events) return oo_OK;
+
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events = events;
+    ev.data.ptr = conn;
+
+    if (epoll_ctl(self->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+	return oo_FAIL;
+
+    conn->events = events;
+
+    return oo_OK;
+}
+
+static void
+ooServer_free_conn(struct ooServer *self,
+		   struct ooServerConn *conn)
+{
+    struct ooServerJob *job;
+
+    if (conn->prev)
+	conn->prev->next = conn->next;
+    else
+	self->conns = conn->next;
+    if (conn->next)
+	conn->next->prev = conn->prev;
+
+    while (conn->head) {
+	job = conn->head;
+	conn->head = job->next;
+	if (job->frame) free(job->frame);
+	free(job);
+    }
+
+    if (conn->buf) free(conn->buf);
+    free(conn);
+}
+
+/**
+ *  close a connection, the jobs still held by the workers
+ *  keep it until they come back
+ */
+static void
+ooServer_drop(struct ooServer *self,
+	      struct ooServerConn *conn)
+{
+    struct ooServerJob **job, *done;
+
+    if (!conn->is_dropped) {
+	close(conn->fd);
+	conn->fd = -1;
+	conn->is_dropped = true;
+	self->num_conns--;
+    }
+
+    for (job = &conn->head; *job; ) {
+	if (!(*job)->is_done) {
+	    conn->tail = *job;
+	    job = &(*job)->next;
+	    continue;
+	}
+	done = *job;
+	*job = done->next;
+	conn->num_jobs--;
+	if (done->frame) free(done->frame);
+	free(done);
+    }
+
+    if (!conn->head) conn->tail = NULL;
+
+    if (!conn->num_jobs)
+	ooServer_free_conn(self, conn);
+}
+
+/*  the state of a connection after any of its events */
+static void
+ooServer_update(struct ooServer *self,
+		struct ooServerConn *conn)
+{
+    if (conn->is_dropped) goto drop;
+
+    if (ooServer_flush(self, conn) != oo_OK) goto drop;
+
+    /* the freed pipeline slots take the buffered requests */
+    if (ooServer_parse(self, conn) != oo_OK) goto drop;
+
+    if (ooServer_flush(self, conn) != oo_OK) goto drop;
+
+    /* everything asked for has been answered */
+    if (!conn->num_jobs && (conn->is_eof || conn->is_broken)) goto drop;
+
+    if (ooServer_watch(self, conn) != oo_OK) goto drop;
+
+    return;
+
+ drop:
+    ooServer_drop(self, conn);
+}
+
+static int
+ooServer_accept(struct ooServer *self)
+{
+    struct ooServerConn *conn;
+    struct epoll_event ev;
+    int fd, one = 1;
+
+    while (1) {
+	fd = accept4(self->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0) {
+	    if (errno == EINTR) continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK) return oo_OK;
+	    fprintf(stderr, "  -- OOmnik server: accept failed: %s\n",
+		    strerror(errno));
+	    return oo_FAIL;
+	}
+
+	if (self->num_conns >= SERVER_MAX_CONNECTIONS) {
+	    close(fd);
+	    continue;
+	}
+
+	/* small pipelined responses must not wait */
+	if (!self->is_unix)
+	    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	conn = malloc(sizeof(struct ooServerConn));
+	if (!conn) {
+	    close(fd);
+	    return oo_NOMEM;
+	}
+	memset(conn, 0, sizeof(struct ooServerConn));
+	conn->fd = fd;
+
+	conn->buf = malloc(SERVER_READ_BUF_SIZE);
+	if (!conn->buf) {
+	    close(fd);
+	    free(conn);
+	    return oo_NOMEM;
+	}
+	conn->buf_size = SERVER_READ_BUF_SIZE;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.ptr = conn;
+	if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	    close(fd);
+	    free(conn->buf);
+	    free(conn);
+	    continue;
+	}
+	conn->events = EPOLLIN;
+
+	conn->next = self->conns;
+	if (self->conns) self->conns->prev = conn;
+	self->conns = conn;
+
+	self->num_conns++;
+	self->total_conns++;
+    }
+
+    return oo_OK;
+}
+
+/*  take the finished jobs back from the workers */
+static int
+ooServer_complete(struct ooServer *self)
+{
+    struct ooServerJob *job;
+    struct ooServerConn *conn, *ready = NULL;
+    uint64_t value;
+
+    if (read(self->done_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+	return oo_FAIL;
+
+    pthread_mutex_lock(&self->lock);
+    job = self->done;
+    self->done = NULL;
+    pthread_mutex_unlock(&self->lock);
+
+    for (; job; job = job->next_queued) {
+	job->is_done = true;
+	self->num_active_jobs--;
+
+	conn = job->conn;
+	if (conn->is_ready) continue;
+	conn->is_ready = true;
+	conn->next_ready = ready;
+	ready = conn;
+    }
+
+    while (ready) {
+	conn = ready;
+	ready = conn->next_ready;
+	conn->is_ready = false;
+	ooServer_update(self, conn);
+    }
+
+    return oo_OK;
+}
+
+static int
+ooServer_serve(struct ooServer *self)
+{
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    struct ooServerConn *conn;
+    bool is_stopped = false, has_done;
+    int i, num_events;
+
+    fprintf(stderr, "   OOmnik is serving on %s (%zu workers)\n",
+	    self->address, self->num_workers);
+
+    while (!is_stopped) {
+	num_events = epoll_wait(self->epoll_fd, events, SERVER_MAX_EVENTS, -1);
+	if (num_events < 0) {
+	    if (errno == EINTR) continue;
+	    return oo_FAIL;
+	}
+
+	/* the finished jobs go last:
+	 * they may free the connections of this batch */
+	has_done = false;
+
+	for (i = 0; i < num_events; i++) {
+	    if (events[i].data.ptr == &self->stop_fd) {
+		is_stopped = true;
+		continue;
+	    }
+	    if (events[i].data.ptr == &self->done_fd) {
+		has_done = true;
+		continue;
+	    }
+	    if (events[i].data.ptr == &self->listen_fd) {
+		ooServer_accept(self);
+		continue;
+	    }
+
+	    conn = (struct ooServerConn*)events[i].data.ptr;
+
+	    if ((events[i].events & (EPOLLERR | EPOLLHUP)) &&
+		!(events[i].events & EPOLLIN)) {
+		ooServer_drop(self, conn);
+		continue;
+	    }
+
+	    if (events[i].events & EPOLLIN) {
+		if (ooServer_read(self, conn) != oo_OK) {
+		    ooServer_drop(self, conn);
+		    continue;
+		}
+	    }
+
+	    ooServer_update(self, conn);
+	}
+
+	if (has_done)
+	    ooServer_complete(self);
+    }
+
+    return oo_OK;
+}
+
+static int
+ooServer_stop(struct ooServer *self)
+{
+    uint64_t one = 1;
+
+    if (write(self->stop_fd, &one, sizeof(one)) < 0) return oo_FAIL;
+
+    return oo_OK;
+}
+
+static void*
+ooServer_work(void *arg)
+{
+    struct ooServer *self = (struct ooServer*)arg;
+    struct ooServerJob *job;
+    oo_server_status status;
+    const char *result;
+    void *session;
+    uint64_t one = 1;
+    int ret;
+
+    /* output buffer of this worker */
+    session = OOmnik_open_session(self->oomnik);
+
+    pthread_mutex_lock(&self->lock);
+
+    while (!self->stopping) {
+	job = self->queue_head;
+	if (!job) {
+	    pthread_cond_wait(&self->work_cond, &self->lock);
+	    continue;
+	}
+
+	self->queue_head = job->next_queued;
+	if (!self->queue_head) self->queue_tail = NULL;
+
+	pthread_mutex_unlock(&self->lock);
+
+	result = NULL;
+	status = OO_SERVER_FAILED;
+
+	if (session) {
+	    ret = OOmnik_session_process(session, job->input, job->format,
+					 job->cs_name, &result);
+	    if (ret == oo_OK)
+		status = OO_SERVER_OK;
+	    else if (ret == oo_NO_RESULTS)
+		status = OO_SERVER_NO_CODESYSTEM;
+	}
+
+	/* a missing frame drops the connection */
+	ooServer_set_frame(job, status, result, result ? strlen(result) : 0);
+
+	pthread_mutex_lock(&self->lock);
+	job->next_queued = self->done;
+	self->done = job;
+	pthread_mutex_unlock(&self->lock);
+
+	if (write(self->done_fd, &one, sizeof(one)) < 0)
+	    fprintf(stderr, "  -- OOmnik server: worker wakeup failed\n");
+
+	pthread_mutex_lock(&self->lock);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    if (session) OOmnik_close_session(session);
+
+    return NULL;
+}
+
+static int
+ooServer_listen(struct ooServer *self)
+{
+    struct sockaddr_un un_addr;
+    struct sockaddr_in in_addr;
+    struct stat st;
+    const char *path, *port_name, *sep;
+    char host[INET_ADDRSTRLEN];
+    unsigned long port;
+    char *end;
+    size_t size;
+    int fd, one = 1;
+
+    if (!strncmp(self->address, "unix:", strlen("unix:"))) {
+	path = self->address + strlen("unix:");
+	if (!*path || strlen(path) >= sizeof(un_addr.sun_path)) return oo_FAIL;
+
+	/* a socket left by a previous run */
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+	    unlink(path);
+
+	memset(&un_addr, 0, sizeof(struct sockaddr_un));
+	un_addr.sun_family = AF_UNIX;
+	strcpy(un_addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) return oo_FAIL;
+
+	if (bind(fd, (struct sockaddr*)&un_addr, sizeof(struct sockaddr_un)) < 0)
+	    goto error;
+
+	self->is_unix = true;
+    }
+    else {
+	memset(&in_addr, 0, sizeof(struct sockaddr_in));
+	in_addr.sin_family = AF_INET;
+	in_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	port_name = self->address;
+	sep = strrchr(self->address, ':');
+	if (sep) {
+	    size = sep - self->address;
+	    if (size >= sizeof(host)) return oo_FAIL;
+	    memcpy(host, self->address, size);
+	    host[size] = '\0';
+	    port_name = sep + 1;
+
+	    if (size && strcmp(host, "localhost") &&
+		inet_pton(AF_INET, host, &in_addr.sin_addr) != 1)
+		return oo_FAIL;
+	}
+
+	port = strtoul(port_name, &end, 10);
+	if (!*port_name || *end || !port || port > 65535) return oo_FAIL;
+	in_addr.sin_port = htons((unsigned short)port);
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) return oo_FAIL;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (bind(fd, (struct sockaddr*)&in_addr, sizeof(struct sockaddr_in)) < 0)
+	    goto error;
+    }
+
+    if (listen(fd, SERVER_LISTEN_BACKLOG) < 0)
+	goto error;
+
+    self->listen_fd = fd;
+
+    return oo_OK;
+
+ error:
+    fprintf(stderr, "  -- OOmnik server: cannot listen on %s: %s\n",
+	    self->address, strerror(errno));
+    close(fd);
+    return oo_FAIL;
+}
+
+static int
+ooServer_add_fd(struct ooServer *self,
+		int *fd)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events = EPOLLIN;
+    ev.data.ptr = fd;
+
+    if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, *fd, &ev) < 0)
+	return oo_FAIL;
+
+    return oo_OK;
+}
+
+static int
+ooServer_del(struct ooServer *self)
+{
+    size_t i;
+
+    pthread_mutex_lock(&self->lock);
+    self->stopping = true;
+    pthread_cond_broadcast(&self->work_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 0; i < self->num_workers; i++)
+	pthread_join(self->workers[i], NULL);
+
+    /* every job is still kept by its connection */
+    while (self->conns) {
+	if (self->conns->fd >= 0)
+	    close(self->conns->fd);
+	ooServer_free_conn(self, self->conns);
+    }
+
+    if (self->listen_fd >= 0) {
+	close(self->listen_fd);
+	if (self->is_unix)
+	    unlink(self->address + strlen("unix:"));
+    }
+
+    if (self->epoll_fd >= 0) close(self->epoll_fd);
+    if (self->done_fd >= 0) close(self->done_fd);
+    if (self->stop_fd >= 0) close(self->stop_fd);
+
+    if (self->workers) free(self->workers);
+    if (self->address) free(self->address);
+
+    pthread_cond_destroy(&self->work_cond);
+    pthread_mutex_destroy(&self->lock);
+
+    free(self);
+
+    return oo_OK;
+}
+
+extern int
+ooServer_new(struct ooServer **server,
+	     struct OOmnik *oomnik,
+	     const char *address,
+	     size_t num_workers)
+{
+    struct ooServer *self;
+    long num_cpus;
+    size_t i;
+    int ret = oo_FAIL;
+
+    if (!oomnik || !address) return oo_FAIL;
+
+    self = malloc(sizeof(struct ooServer));
+    if (!self) return oo_NOMEM;
+
+    memset(self, 0, sizeof(struct ooServer));
+
+    self->oomnik = oomnik;
+    self->listen_fd = -1;
+    self->epoll_fd = -1;
+    self->done_fd = -1;
+    self->stop_fd = -1;
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->work_cond, NULL);
+
+    self->del = ooServer_del;
+    self->serve = ooServer_serve;
+    self->stop = ooServer_stop;
+
+    self->address = strdup(address);
+    if (!self->address) {
+	ret = oo_NOMEM;
+	goto error;
+    }
+
+    ret = ooServer_listen(self);
+    if (ret != oo_OK) goto error;
+
+    ret = oo_FAIL;
+
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (self->epoll_fd < 0) goto error;
+
+    self->done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->done_fd < 0) goto error;
+
+    self->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->stop_fd < 0) goto error;
+
+    if (ooServer_add_fd(self, &self->listen_fd) != oo_OK) goto error;
+    if (ooServer_add_fd(self, &self->done_fd) != oo_OK) goto error;
+    if (ooServer_add_fd(self, &self->stop_fd) != oo_OK) goto error;
+
+    if (!num_workers) {
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	num_workers = num_cpus > 0 ? (size_t)num_cpus : 1;
+    }
+    if (num_workers > SERVER_MAX_WORKERS)
+	num_workers = SERVER_MAX_WORKERS;
+
+    self->workers = malloc(sizeof(pthread_t) * num_workers);
+    if (!self->workers) {
+	ret = oo_NOMEM;
+	goto error;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+	if (pthread_create(&self->workers[i], NULL,
+			   ooServer_work, (void*)self) != 0)
+	    break;
+	self->num_workers++;
+    }
+
+    if (!self->num_workers) goto error;
+
+    *server = self;
+
+    return oo_OK;
+
+ error:
+    ooServer_del(self);
+    return ret;
+}
+
+#else
+
+extern int
+ooServer_new(struct ooServer **server,
+	     struct OOmnik *oomnik,
+	     const char *address,
+	     size_t num_workers)
+{
+    fprintf(stderr, "  -- OOmnik server: epoll is not available "
+	    "on this platform :(\n");
+    return oo_FAIL;
+}
+
+#endif /* __linux__ */
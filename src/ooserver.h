@@ -0,0 +1,185 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooserver.h
+ *   OOmnik socket server
+ */
+
+#ifndef OO_SERVER_H
+#define OO_SERVER_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ooconfig.h"
+
+struct OOmnik;
+
+/**
+ *  Wire protocol: every frame starts with its body size
+ *  as a 32-bit unsigned integer in network byte order.
+ *
+ *  request body:   uint8  request type
+ *                  uint8  output format
+ *                  uint16 size of the CodeSystem name
+ *                         (network byte order, 0: the default one)
+ *                  the CodeSystem name
+ *                  the input text
+ *
+ *  response body:  uint8  status
+ *                  the result
+ *
+ *  A connection may send any number of requests
+ *  without waiting, the responses come in the same order.
+ */
+typedef enum oo_server_request_type { OO_SERVER_PROCESS = 1,
+				      OO_SERVER_STATS
+} oo_server_request_type;
+
+typedef enum oo_server_status { OO_SERVER_OK,
+				OO_SERVER_FAILED,
+				OO_SERVER_NO_CODESYSTEM,
+				OO_SERVER_BAD_REQUEST
+} oo_server_status;
+
+#define OO_SERVER_FRAME_HEADER_SIZE 4
+#define OO_SERVER_REQUEST_HEADER_SIZE 4
+#define OO_SERVER_RESPONSE_HEADER_SIZE 1
+
+/* a request of a connection, owned by the event loop
+ * except while a worker is decoding it */
+typedef struct ooServerJob {
+    struct ooServerConn *conn;
+
+    unsigned char type;
+    unsigned char format;
+    const char *cs_name;
+    const char *input;
+
+    /* the complete response frame */
+    char *frame;
+    size_t frame_size;
+    size_t frame_sent;
+    bool is_done;
+
+    /* order of the connection */
+    struct ooServerJob *next;
+
+    /* work queue or the list of finished jobs */
+    struct ooServerJob *next_queued;
+} ooServerJob;
+
+typedef struct ooServerConn {
+    int fd;
+
+    /* unparsed input */
+    char *buf;
+    size_t buf_size;
+    size_t buf_used;
+
+    /* requests in the order of arrival */
+    struct ooServerJob *head;
+    struct ooServerJob *tail;
+    size_t num_jobs;
+
+    /* registered epoll events */
+    unsigned int events;
+
+    /* the peer has nothing more to send:
+     * the buffered requests are still answered */
+    bool is_eof;
+
+    /* broken framing: the rest of the stream is meaningless */
+    bool is_broken;
+
+    /* closed while the workers still hold its jobs */
+    bool is_dropped;
+
+    /* the socket buffer was full at the last write */
+    bool is_blocked;
+
+    /* collecting the connections with finished jobs */
+    bool is_ready;
+    struct ooServerConn *next_ready;
+
+    struct ooServerConn *prev;
+    struct ooServerConn *next;
+} ooServerConn;
+
+/**
+ *  Server:
+ *  a single event loop owns the sockets,
+ *  reads the pipelined requests and writes the responses,
+ *  a pool of worker threads decodes them,
+ *  each one with a session of its own.
+ *  A connection with SERVER_MAX_PIPELINE requests
+ *  in progress is not read until its responses are taken.
+ */
+typedef struct ooServer {
+    struct OOmnik *oomnik;
+
+    char *address;
+    bool is_unix;
+    int listen_fd;
+    int epoll_fd;
+
+    /* finished jobs and stop requests wake up the event loop */
+    int done_fd;
+    int stop_fd;
+
+    struct ooServerConn *conns;
+    size_t num_conns;
+
+    pthread_t *workers;
+    size_t num_workers;
+
+    /* guards the work queue and the list of finished jobs */
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    struct ooServerJob *queue_head;
+    struct ooServerJob *queue_tail;
+    struct ooServerJob *done;
+    bool stopping;
+
+    /* event loop counters */
+    size_t total_conns;
+    size_t num_requests;
+    size_t num_bad_requests;
+    size_t num_active_jobs;
+    size_t bytes_in;
+    size_t bytes_out;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooServer *self);
+
+    /* run the event loop until stop is called */
+    int (*serve)(struct ooServer *self);
+
+    /* safe to call from a signal handler */
+    int (*stop)(struct ooServer *self);
+} ooServer;
+
+/**
+ *  address: "unix:/path/to/socket", "host:port" or "port",
+ *  TCP listens on the loopback interface by default;
+ *  0 workers means one per online CPU
+ */
+extern int ooServer_new(struct ooServer **self,
+			struct OOmnik *oomnik,
+			const char *address,
+			size_t num_workers);
+
+#endif /* OO_SERVER_H */
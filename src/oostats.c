@@ -0,0 +1,269 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oostats.c
+ *   OOmnik decoding statistics implementation
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ooconfig.h"
+#include "oostats.h"
+
+const char *oo_stage_names[OO_NUM_STAGES] = { "segmentize",
+					      "atomic_parse",
+					      "cache_lookup",
+					      "denot_update",
+					      "complex_update",
+					      "solution",
+					      "presentation" };
+
+extern oo_ticks
+oo_read_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (oo_ticks)ts.tv_sec * 1000000000ULL + (oo_ticks)ts.tv_nsec;
+}
+
+/**
+ * cycle counter where available,
+ * monotonic nanoseconds otherwise
+ */
+extern oo_ticks
+oo_read_ticks(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((oo_ticks)hi << 32) | lo;
+#else
+    return oo_read_nsec();
+#endif
+}
+
+extern int
+ooStats_reset(struct ooStats *self)
+{
+    memset(self, 0, sizeof(struct ooStats));
+    return oo_OK;
+}
+
+extern int
+oo_hist_add(size_t *hist, size_t value)
+{
+    if (value >= STATS_HIST_SIZE)
+	value = STATS_HIST_SIZE - 1;
+    hist[value]++;
+    return oo_OK;
+}
+
+extern int
+oo_hist_present(const size_t *hist,
+		char *buf,
+		size_t buf_size)
+{
+    size_t i, buf_used = 0;
+    int chunk_size;
+
+    for (i = 0; i < STATS_HIST_SIZE; i++) {
+	chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			      "%s%zu", i ? "," : "[", hist[i]);
+	if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	    return oo_NOMEM;
+	buf_used += chunk_size;
+    }
+
+    if (buf_used + 2 > buf_size) return oo_NOMEM;
+    strcpy(buf + buf_used, "]");
+
+    return oo_OK;
+}
+
+static int
+ooStats_merge_cache(struct ooCacheStats *self,
+		    const struct ooCacheStats *other)
+{
+    size_t i;
+
+    self->num_lookups += other->num_lookups;
+    self->num_positions += other->num_positions;
+    self->num_hit_positions += other->num_hit_positions;
+    self->num_unrec_positions += other->num_unrec_positions;
+    self->num_matches += other->num_matches;
+    self->num_tail_scans += other->num_tail_scans;
+    self->num_tails_compared += other->num_tails_compared;
+    if (other->max_tail_scan > self->max_tail_scan)
+	self->max_tail_scan = other->max_tail_scan;
+
+    for (i = 0; i < STATS_HIST_SIZE; i++) {
+	self->match_len_hist[i] += other->match_len_hist[i];
+	self->coverage_hist[i] += other->coverage_hist[i];
+	self->pos_matches_hist[i] += other->pos_matches_hist[i];
+    }
+
+    return oo_OK;
+}
+
+static int
+ooStats_present_cache(struct ooCacheStats *self,
+		      char *buf,
+		      size_t buf_size)
+{
+    const size_t *hists[3];
+    const char *hist_names[3] = { "match_len", "coverage", "pos_matches" };
+    size_t i, buf_used = 0;
+    int chunk_size, ret;
+
+    hists[0] = self->match_len_hist;
+    hists[1] = self->coverage_hist;
+    hists[2] = self->pos_matches_hist;
+
+    chunk_size = snprintf(buf, buf_size,
+			  ",\"cache\":{\"lookups\":%zu,\"positions\":%zu,"
+			  "\"hit_positions\":%zu,\"unrec_positions\":%zu,"
+			  "\"matches\":%zu,\"tail_scans\":%zu,"
+			  "\"tails_compared\":%zu,\"max_tail_scan\":%zu",
+			  self->num_lookups, self->num_positions,
+			  self->num_hit_positions, self->num_unrec_positions,
+			  self->num_matches, self->num_tail_scans,
+			  self->num_tails_compared, self->max_tail_scan);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+    buf_used += chunk_size;
+
+    for (i = 0; i < 3; i++) {
+	chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			      ",\"%s_hist\":", hist_names[i]);
+	if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	    return oo_NOMEM;
+	buf_used += chunk_size;
+
+	ret = oo_hist_present(hists[i], buf + buf_used, buf_size - buf_used);
+	if (ret != oo_OK) return ret;
+	buf_used += strlen(buf + buf_used);
+    }
+
+    if (buf_used + 2 > buf_size) return oo_NOMEM;
+    strcpy(buf + buf_used, "}");
+
+    return oo_OK;
+}
+
+extern int
+ooStats_add_stage(struct ooStats *self,
+		  oo_stage_type stage,
+		  oo_ticks begin)
+{
+    oo_ticks end = oo_read_ticks();
+
+    self->stages[stage].num_calls++;
+    if (end > begin)
+	self->stages[stage].ticks += end - begin;
+
+    return oo_OK;
+}
+
+extern int
+ooStats_merge(struct ooStats *self,
+	      const struct ooStats *other)
+{
+    size_t i;
+
+    self->num_runs += other->num_runs;
+
+    for (i = 0; i < OO_NUM_STAGES; i++) {
+	self->stages[i].num_calls += other->stages[i].num_calls;
+	self->stages[i].ticks += other->stages[i].ticks;
+    }
+
+    self->num_units += other->num_units;
+    self->num_complexes += other->num_complexes;
+    self->num_pruned += other->num_pruned;
+    self->num_reused += other->num_reused;
+
+    if (other->max_units > self->max_units)
+	self->max_units = other->max_units;
+    if (other->max_predictions > self->max_predictions)
+	self->max_predictions = other->max_predictions;
+    if (other->max_beam_slots > self->max_beam_slots)
+	self->max_beam_slots = other->max_beam_slots;
+
+    ooStats_merge_cache(&self->cache, &other->cache);
+
+    return oo_OK;
+}
+
+extern int
+ooStats_present(struct ooStats *self,
+		const char *name,
+		double ticks_per_usec,
+		char *buf,
+		size_t buf_size)
+{
+    size_t i, buf_used = 0;
+    double usec;
+    int chunk_size, ret;
+
+    chunk_size = snprintf(buf, buf_size,
+			  "{\"name\":\"%s\",\"runs\":%zu,\"stages\":{",
+			  name, self->num_runs);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size) return oo_NOMEM;
+    buf_used += chunk_size;
+
+    for (i = 0; i < OO_NUM_STAGES; i++) {
+	usec = 0.0;
+	if (ticks_per_usec > 0.0)
+	    usec = (double)self->stages[i].ticks / ticks_per_usec;
+
+	chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			      "%s\"%s\":{\"calls\":%zu,\"usec\":%.1f}",
+			      i ? "," : "", oo_stage_names[i],
+			      self->stages[i].num_calls, usec);
+	if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	    return oo_NOMEM;
+	buf_used += chunk_size;
+    }
+
+    chunk_size = snprintf(buf + buf_used, buf_size - buf_used,
+			  "},\"units\":%zu,\"complexes\":%zu,"
+			  "\"pruned\":%zu,\"reused\":%zu,"
+			  "\"max_units\":%zu,\"max_predictions\":%zu,"
+			  "\"max_beam_slots\":%zu",
+			  self->num_units, self->num_complexes,
+			  self->num_pruned, self->num_reused,
+			  self->max_units, self->max_predictions,
+			  self->max_beam_slots);
+    if (chunk_size < 0 || (size_t)chunk_size >= buf_size - buf_used)
+	return oo_NOMEM;
+    buf_used += chunk_size;
+
+    if (self->cache.num_lookups) {
+	ret = ooStats_present_cache(&self->cache, 
+				    buf + buf_used, buf_size - buf_used);
+	if (ret != oo_OK) return ret;
+	buf_used += strlen(buf + buf_used);
+    }
+
+    if (buf_used + 2 > buf_size) return oo_NOMEM;
+    strcpy(buf + buf_used, "}");
+
+    return oo_OK;
+}
@@ -0,0 +1,138 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oostats.h
+ *   OOmnik decoding statistics
+ */
+
+#ifndef OO_STATS_H
+#define OO_STATS_H
+
+#include <stddef.h>
+
+#include "ooconfig.h"
+
+/* raw cycle counter value */
+typedef unsigned long long oo_ticks;
+
+/* decoding stages */
+typedef enum oo_stage_type { OO_STAGE_SEGMENTIZE,
+			     OO_STAGE_ATOMIC_PARSE,
+			     OO_STAGE_CACHE_LOOKUP,
+			     OO_STAGE_DENOT_UPDATE,
+			     OO_STAGE_COMPLEX_UPDATE,
+			     OO_STAGE_SOLUTION,
+			     OO_STAGE_PRESENTATION,
+			     OO_NUM_STAGES } oo_stage_type;
+
+extern const char *oo_stage_names[OO_NUM_STAGES];
+
+typedef struct ooStageStats {
+    size_t num_calls;
+    oo_ticks ticks;
+} ooStageStats;
+
+/**
+ *  Linear Cache lookup counters
+ */
+typedef struct ooCacheStats {
+    size_t num_lookups;
+
+    /* recognized input positions */
+    size_t num_positions;
+    size_t num_hit_positions;
+
+    /* positions left as unrecognized units */
+    size_t num_unrec_positions;
+
+    /* code matches registered in agenda */
+    size_t num_matches;
+
+    /* linear scans of cell tails */
+    size_t num_tail_scans;
+    size_t num_tails_compared;
+    size_t max_tail_scan;
+
+    /* histograms: units per matched sequence,
+     * atoms covered by a match, code matches per position */
+    size_t match_len_hist[STATS_HIST_SIZE];
+    size_t coverage_hist[STATS_HIST_SIZE];
+    size_t pos_matches_hist[STATS_HIST_SIZE];
+} ooCacheStats;
+
+/**
+ *  Decoding statistics:
+ *  collected by every Decoder and summed up per CodeSystem
+ */
+typedef struct ooStats {
+
+    /* number of decoder runs */
+    size_t num_runs;
+
+    /* wall time per stage: nested stages and
+     * subordinate decoders are included */
+    struct ooStageStats stages[OO_NUM_STAGES];
+
+    /* agenda counters */
+    size_t num_units;
+    size_t num_complexes;
+    size_t num_pruned;
+    size_t num_reused;
+
+    /* pool high-water marks */
+    size_t max_units;
+    size_t max_predictions;
+    size_t max_beam_slots;
+
+    /* lookups in the Linear Cache */
+    struct ooCacheStats cache;
+
+} ooStats;
+
+
+/* read the cycle counter */
+extern oo_ticks oo_read_ticks(void);
+
+/* monotonic wall clock in nanoseconds */
+extern oo_ticks oo_read_nsec(void);
+
+extern int ooStats_reset(struct ooStats *self);
+
+/* count a value in a histogram of STATS_HIST_SIZE buckets */
+extern int oo_hist_add(size_t *hist, size_t value);
+
+/* JSON array of a histogram */
+extern int oo_hist_present(const size_t *hist,
+			   char *buf,
+			   size_t buf_size);
+
+/* account the time spent in a stage since "begin" */
+extern int ooStats_add_stage(struct ooStats *self,
+			     oo_stage_type stage,
+			     oo_ticks begin);
+
+/* add up the values of another set */
+extern int ooStats_merge(struct ooStats *self,
+			 const struct ooStats *other);
+
+/* JSON representation, "ticks_per_usec" converts the cycles */
+extern int ooStats_present(struct ooStats *self,
+			   const char *name,
+			   double ticks_per_usec,
+			   char *buf,
+			   size_t buf_size);
+
+#endif /* OO_STATS_H */
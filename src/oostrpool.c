@@ -0,0 +1,235 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oostrpool.c
+ *   OOmnik pool of interned names
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ooconfig.h"
+#include "oostrpool.h"
+
+/* entries are kept aligned for their size_t fields */
+#define OO_STR_ALIGN sizeof(size_t)
+
+/*  FNV-1a */
+extern size_t
+oo_str_hash(const char *str,
+	    size_t *size)
+{
+    const unsigned char *c;
+    size_t h = (size_t)2166136261UL;
+
+    for (c = (const unsigned char*)str; *c; c++) {
+	h ^= *c;
+	h *= (size_t)16777619UL;
+    }
+
+    if (size) *size = (size_t)((const char*)c - str);
+
+    return h;
+}
+
+static const char*
+ooStrPool_lookup(struct ooStrPool *self,
+		 const char *str,
+		 size_t hash,
+		 size_t size)
+{
+    struct ooStr *entry;
+
+    for (entry = self->buckets[hash % self->num_buckets];
+	 entry;
+	 entry = entry->next) {
+	if (entry->hash != hash || entry->size != size) continue;
+	if (!memcmp(entry->str, str, size)) return entry->str;
+    }
+
+    return NULL;
+}
+
+static const char*
+ooStrPool_find(struct ooStrPool *self,
+	       const char *str)
+{
+    size_t hash, size;
+
+    if (!str) return NULL;
+
+    hash = oo_str_hash(str, &size);
+
+    return ooStrPool_lookup(self, str, hash, size);
+}
+
+/*  double the buckets using the stored hashes */
+static int
+ooStrPool_rehash(struct ooStrPool *self)
+{
+    struct ooStr **buckets;
+    struct ooStr *entry, *next;
+    size_t num_buckets;
+    size_t i, h;
+
+    num_buckets = self->num_buckets * INDEX_REALLOC_FACTOR;
+    buckets = calloc(num_buckets, sizeof(struct ooStr*));
+    if (!buckets) return oo_NOMEM;
+
+    for (i = 0; i < self->num_buckets; i++) {
+	for (entry = self->buckets[i]; entry; entry = next) {
+	    next = entry->next;
+	    h = entry->hash % num_buckets;
+	    entry->next = buckets[h];
+	    buckets[h] = entry;
+	}
+    }
+
+    free(self->buckets);
+    self->buckets = buckets;
+
+    self->total_size += (num_buckets - self->num_buckets) * sizeof(struct ooStr*);
+    self->num_buckets = num_buckets;
+
+    return oo_OK;
+}
+
+/*  room for a new entry in the current chunk */
+static struct ooStr*
+ooStrPool_alloc(struct ooStrPool *self,
+		size_t entry_size)
+{
+    char **chunks;
+    char *chunk;
+    size_t chunk_size = STRPOOL_CHUNK_SIZE;
+
+    entry_size = (entry_size + OO_STR_ALIGN - 1) & ~(OO_STR_ALIGN - 1);
+
+    if (self->num_chunks &&
+	self->chunk_used + entry_size <= STRPOOL_CHUNK_SIZE) {
+	chunk = self->chunks[self->num_chunks - 1];
+	self->chunk_used += entry_size;
+	return (struct ooStr*)(chunk + self->chunk_used - entry_size);
+    }
+
+    /* oversized names get a chunk of their own */
+    if (entry_size > chunk_size)
+	chunk_size = entry_size;
+
+    chunks = realloc(self->chunks, sizeof(char*) * (self->num_chunks + 1));
+    if (!chunks) return NULL;
+    self->chunks = chunks;
+
+    chunk = malloc(chunk_size);
+    if (!chunk) return NULL;
+
+    /* an oversized chunk is full right away
+     * and goes below the current one */
+    if (chunk_size > STRPOOL_CHUNK_SIZE && self->num_chunks) {
+	chunks[self->num_chunks] = chunks[self->num_chunks - 1];
+	chunks[self->num_chunks - 1] = chunk;
+    }
+    else {
+	chunks[self->num_chunks] = chunk;
+	self->chunk_used = entry_size;
+    }
+
+    self->num_chunks++;
+    self->total_size += chunk_size;
+
+    return (struct ooStr*)chunk;
+}
+
+static const char*
+ooStrPool_intern(struct ooStrPool *self,
+		 const char *str)
+{
+    struct ooStr *entry;
+    const char *handle;
+    size_t hash, size, h;
+
+    if (!str) return NULL;
+
+    hash = oo_str_hash(str, &size);
+
+    handle = ooStrPool_lookup(self, str, hash, size);
+    if (handle) return handle;
+
+    if (self->num_strs >= self->num_buckets) {
+	if (ooStrPool_rehash(self) != oo_OK) return NULL;
+    }
+
+    entry = ooStrPool_alloc(self, sizeof(struct ooStr) + size + 1);
+    if (!entry) return NULL;
+
+    entry->hash = hash;
+    entry->id = self->num_strs;
+    entry->size = size;
+    memcpy(entry->str, str, size + 1);
+
+    h = hash % self->num_buckets;
+    entry->next = self->buckets[h];
+    self->buckets[h] = entry;
+
+    self->num_strs++;
+
+    return entry->str;
+}
+
+static int
+ooStrPool_del(struct ooStrPool *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->num_chunks; i++)
+	free(self->chunks[i]);
+
+    if (self->chunks) free(self->chunks);
+    if (self->buckets) free(self->buckets);
+
+    free(self);
+
+    return oo_OK;
+}
+
+extern int
+ooStrPool_new(struct ooStrPool **pool)
+{
+    struct ooStrPool *self;
+
+    self = malloc(sizeof(struct ooStrPool));
+    if (!self) return oo_NOMEM;
+
+    memset(self, 0, sizeof(struct ooStrPool));
+
+    self->buckets = calloc(STRPOOL_INIT_BUCKETS, sizeof(struct ooStr*));
+    if (!self->buckets) {
+	free(self);
+	return oo_NOMEM;
+    }
+    self->num_buckets = STRPOOL_INIT_BUCKETS;
+    self->total_size = sizeof(struct ooStrPool) +\
+	STRPOOL_INIT_BUCKETS * sizeof(struct ooStr*);
+
+    self->del = ooStrPool_del;
+    self->intern = ooStrPool_intern;
+    self->find = ooStrPool_find;
+
+    *pool = self;
+
+    return oo_OK;
+}
@@ -0,0 +1,85 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   oostrpool.h
+ *   OOmnik pool of interned names
+ */
+
+#ifndef OO_STRPOOL_H
+#define OO_STRPOOL_H
+
+#include <stddef.h>
+
+#include "ooconfig.h"
+
+/**
+ *  Interned string:
+ *  handles are pointers to the str member,
+ *  so they can be used as ordinary C strings,
+ *  two handles of the same pool are equal
+ *  if and only if the strings are equal
+ */
+typedef struct ooStr {
+    struct ooStr *next;
+    size_t hash;
+    size_t id;
+    size_t size;
+    char str[];
+} ooStr;
+
+#define OO_STR_ENTRY(handle) \
+    ((const struct ooStr*)((const char*)(handle) - offsetof(struct ooStr, str)))
+
+/* precomputed hash of a handle */
+#define OO_STR_HASH(handle) (OO_STR_ENTRY(handle)->hash)
+
+/* sequential id of a handle: 0, 1, 2... */
+#define OO_STR_ID(handle) (OO_STR_ENTRY(handle)->id)
+
+/* string length of a handle */
+#define OO_STR_SIZE(handle) (OO_STR_ENTRY(handle)->size)
+
+typedef struct ooStrPool {
+    struct ooStr **buckets;
+    size_t num_buckets;
+    size_t num_strs;
+
+    /* the strings are allocated in large chunks */
+    char **chunks;
+    size_t num_chunks;
+    size_t chunk_used;
+
+    /* bytes of all the chunks and the buckets */
+    size_t total_size;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooStrPool *self);
+
+    /* stable handle of a string, NULL on memory failure */
+    const char* (*intern)(struct ooStrPool *self,
+			  const char *str);
+
+    /* handle of an already interned string or NULL,
+     * never modifies the pool */
+    const char* (*find)(struct ooStrPool *self,
+			const char *str);
+} ooStrPool;
+
+extern size_t oo_str_hash(const char *str, size_t *size);
+
+extern int ooStrPool_new(struct ooStrPool **self);
+
+#endif /* OO_STRPOOL_H */
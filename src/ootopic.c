@@ -27,6 +27,7 @@
 #include "ootopic.h"
 #include "oomindmap.h"
 #include "ooconcept.h"
+#include "oostrpool.h"
 #include "ooconfig.h"
 
 /*  Destructor */
@@ -40,7 +41,6 @@ ooTopic_del(struct ooTopic *self)
     if (self->ingredients) {
 	for (i = 0; i < self->num_ingredients; i++) {
 	    ingr = self->ingredients[i];
-	    free(ingr->name);
 	    free(ingr);
 	}
 	free(self->ingredients);
@@ -146,14 +146,12 @@ ooTopic_read_ingredients(struct ooTopic *self,
 		return oo_NOMEM;
 	    }
 
-	    ingr->name = malloc(strlen(value) + 1);
+	    ingr->name = self->names->intern(self->names, value);
+	    xmlFree(value);
 	    if (!ingr->name) {
 		free(ingr);
-		xmlFree(value);
 		return oo_NOMEM;
 	    }
-	    strcpy(ingr->name, value);
-	    xmlFree(value);
 
 	    /* default value: maximal relevance */
 	    ingr->relevance = 1.0;
@@ -183,7 +181,6 @@ ooTopic_read_ingredients(struct ooTopic *self,
 		sizeof(struct ooTopicIngredient*);
 	    ingrs = realloc(self->ingredients, ingr_size);
 	    if (!ingrs) {
-		free(ingr->name);
 		free(ingr);
 		return oo_NOMEM;
 	    }
@@ -214,7 +211,7 @@ ooTopic_resolve_refs(struct ooTopic *self,
     for (i = 0; i < self->num_ingredients; i++) {
 	ingr = self->ingredients[i];
 
-	conc = mindmap->lookup(mindmap, (const char*)ingr->name);
+	conc = mindmap->lookup_interned(mindmap, ingr->name);
 
 	if (conc) {
 	    /*printf("Updating topic index with concept %s (%d)\n",
@@ -285,6 +282,8 @@ ooTopic_new(struct ooTopic **topic)
     self->topics = NULL;
     self->num_topics = 0;
 
+    self->names = NULL;
+
     /* bind your methods */
     self->del = ooTopic_del;
     self->str = ooTopic_str;
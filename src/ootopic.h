@@ -25,13 +25,16 @@
 
 struct ooTopic;
 struct ooMindMap;
+struct ooStrPool;
 
 /** Topic Ingredient:
  *  a set of concepts
  */
 typedef struct ooTopicIngredient {
     size_t id;
-    char *name;
+
+    /* handle of the MindMap string pool */
+    const char *name;
     struct ooTopic *topic;
     struct ooConcept *conc;
     float relevance;
@@ -56,6 +59,9 @@ typedef struct ooTopic {
     struct ooTopic **topics;
     size_t num_topics;
 
+    /* pool to intern the ingredient names */
+    struct ooStrPool *names;
+
     /***********  public methods ***********/
     int (*del)(struct ooTopic *self);
     int (*str)(struct ooTopic *self);
@@ -0,0 +1,243 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ootrace.c
+ *   OOmnik runtime tracing implementation
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ooconfig.h"
+#include "ootrace.h"
+
+unsigned int oo_trace_mask = 0;
+
+static FILE *oo_trace_file = NULL;
+static oo_ticks oo_trace_start = 0;
+static size_t oo_trace_num_events = 0;
+static pthread_mutex_t oo_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *oo_trace_names[] = { "load", "decoder", "segm", "cache",
+					"agenda", "conc", "complex", "present" };
+
+#define OO_TRACE_NUM_SUBSYSTEMS (sizeof(oo_trace_names) / sizeof(oo_trace_names[0]))
+
+extern unsigned int
+oo_trace_parse_mask(const char *subsystems)
+{
+    const char *c, *end;
+    unsigned int mask = 0;
+    size_t i, len;
+
+    if (!subsystems || !*subsystems) return OO_TRACE_ALL;
+
+    for (c = subsystems; *c; c = end) {
+	end = strchr(c, ',');
+	if (!end) end = c + strlen(c);
+	len = end - c;
+	if (*end) end++;
+
+	if (len == 3 && !strncmp(c, "all", len)) {
+	    mask |= OO_TRACE_ALL;
+	    continue;
+	}
+
+	for (i = 0; i < OO_TRACE_NUM_SUBSYSTEMS; i++) {
+	    if (strlen(oo_trace_names[i]) != len) continue;
+	    if (strncmp(c, oo_trace_names[i], len)) continue;
+	    mask |= (1 << i);
+	    break;
+	}
+    }
+
+    return mask;
+}
+
+static const char*
+oo_trace_category(unsigned int subsys)
+{
+    size_t i;
+
+    for (i = 0; i < OO_TRACE_NUM_SUBSYSTEMS; i++)
+	if (subsys & (1 << i)) return oo_trace_names[i];
+
+    return "oomnik";
+}
+
+/* write a JSON string body */
+static int
+oo_trace_write_escaped(FILE *f, const char *str)
+{
+    const unsigned char *c;
+
+    for (c = (const unsigned char*)str; *c; c++) {
+	switch (*c) {
+	case '"':
+	case '\\':
+	    fputc('\\', f);
+	    fputc(*c, f);
+	    break;
+	case '\n':
+	    fputs("\\n", f);
+	    break;
+	case '\r':
+	case '\t':
+	    fputc(' ', f);
+	    break;
+	default:
+	    if (*c < 0x20) break;
+	    fputc(*c, f);
+	}
+    }
+    return oo_OK;
+}
+
+/* caller holds the lock */
+static int
+oo_trace_write_event(unsigned int subsys,
+		     const char *name,
+		     char phase,
+		     oo_ticks begin,
+		     oo_ticks end,
+		     const char *arg_name,
+		     const char *arg_value)
+{
+    FILE *f = oo_trace_file;
+
+    if (!f) return oo_FAIL;
+    if (begin < oo_trace_start) begin = oo_trace_start;
+
+    fprintf(f, "%s{\"name\":\"", oo_trace_num_events ? ",\n" : "");
+    oo_trace_write_escaped(f, name);
+    fprintf(f, "\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,",
+	    oo_trace_category(subsys), phase,
+	    (double)(begin - oo_trace_start) / 1000.0);
+
+    if (phase == 'X')
+	fprintf(f, "\"dur\":%.3f,",
+		end > begin ? (double)(end - begin) / 1000.0 : 0.0);
+    else
+	fputs("\"s\":\"t\",", f);
+
+    fprintf(f, "\"pid\":%ld,\"tid\":%lu",
+	    (long)getpid(), (unsigned long)pthread_self());
+
+    if (arg_value) {
+	fprintf(f, ",\"args\":{\"%s\":\"", arg_name);
+	oo_trace_write_escaped(f, arg_value);
+	fputs("\"}", f);
+    }
+    fputc('}', f);
+
+    oo_trace_num_events++;
+
+    return oo_OK;
+}
+
+extern int
+oo_trace_open(const char *filename,
+	      const char *subsystems)
+{
+    FILE *f;
+    unsigned int mask;
+
+    mask = oo_trace_parse_mask(subsystems);
+    if (!mask) return oo_FAIL;
+
+    f = fopen(filename, "w");
+    if (!f) {
+	fprintf(stderr, "  -- Couldn't open the trace file \"%s\" :(\n", filename);
+	return oo_FAIL;
+    }
+
+    oo_trace_close();
+
+    pthread_mutex_lock(&oo_trace_lock);
+
+    fputs("[\n", f);
+    oo_trace_file = f;
+    oo_trace_start = oo_read_nsec();
+    oo_trace_num_events = 0;
+    oo_trace_mask = mask;
+
+    pthread_mutex_unlock(&oo_trace_lock);
+
+    return oo_OK;
+}
+
+extern int
+oo_trace_close(void)
+{
+    oo_trace_mask = 0;
+
+    pthread_mutex_lock(&oo_trace_lock);
+
+    if (oo_trace_file) {
+	fputs("\n]\n", oo_trace_file);
+	fclose(oo_trace_file);
+	oo_trace_file = NULL;
+    }
+
+    pthread_mutex_unlock(&oo_trace_lock);
+
+    return oo_OK;
+}
+
+extern int
+oo_trace_span(unsigned int subsys,
+	      const char *name,
+	      const char *detail,
+	      oo_ticks begin)
+{
+    oo_ticks end = oo_read_nsec();
+    int ret;
+
+    if (!OO_TRACE_ON(subsys)) return oo_OK;
+
+    pthread_mutex_lock(&oo_trace_lock);
+    ret = oo_trace_write_event(subsys, name, 'X', begin, end,
+			       "detail", detail);
+    pthread_mutex_unlock(&oo_trace_lock);
+
+    return ret;
+}
+
+extern int
+oo_trace_msg(unsigned int subsys,
+	     const char *format, ...)
+{
+    char buf[TRACE_MSG_BUF_SIZE];
+    va_list args;
+    int ret;
+
+    if (!OO_TRACE_ON(subsys)) return oo_OK;
+
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    pthread_mutex_lock(&oo_trace_lock);
+    ret = oo_trace_write_event(subsys, "msg", 'i', oo_read_nsec(), 0,
+			       "msg", buf);
+    pthread_mutex_unlock(&oo_trace_lock);
+
+    return ret;
+}
@@ -0,0 +1,68 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ootrace.h
+ *   OOmnik runtime tracing:
+ *   Chrome trace-event JSON written to a file
+ */
+
+#ifndef OO_TRACE_H
+#define OO_TRACE_H
+
+#include "oostats.h"
+
+/* trace subsystems */
+#define OO_TRACE_LOAD     0x01
+#define OO_TRACE_DECODER  0x02
+#define OO_TRACE_SEGM     0x04
+#define OO_TRACE_CACHE    0x08
+#define OO_TRACE_AGENDA   0x10
+#define OO_TRACE_CONC     0x20
+#define OO_TRACE_COMPLEX  0x40
+#define OO_TRACE_PRESENT  0x80
+#define OO_TRACE_ALL      0xff
+
+/* enabled subsystems, zero while no trace file is open */
+extern unsigned int oo_trace_mask;
+
+#define OO_TRACE_ON(subsys) (oo_trace_mask & (subsys))
+
+/* start time of a span, zero if the subsystem is off */
+#define OO_TRACE_BEGIN(subsys) (OO_TRACE_ON(subsys) ? oo_read_nsec() : 0)
+
+#define OO_TRACE_END(subsys, name, detail, begin)			\
+    do { if (begin) oo_trace_span((subsys), (name), (detail), (begin)); } while (0)
+
+/* comma separated subsystem names or "all" */
+extern unsigned int oo_trace_parse_mask(const char *subsystems);
+
+/* start writing the events of the given subsystems */
+extern int oo_trace_open(const char *filename,
+			 const char *subsystems);
+
+extern int oo_trace_close(void);
+
+/* complete event: from "begin" till now */
+extern int oo_trace_span(unsigned int subsys,
+			 const char *name,
+			 const char *detail,
+			 oo_ticks begin);
+
+/* instant event with a formatted message */
+extern int oo_trace_msg(unsigned int subsys,
+			const char *format, ...);
+
+#endif /* OO_TRACE_H */
@@ -0,0 +1,449 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooxmlpool.c
+ *   OOmnik parallel parsing of XML include files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlversion.h>
+
+#include "ooconfig.h"
+#include "ooxmlpool.h"
+#include "ooutils.h"
+
+
+/*  find the entry of a file, the pool must be locked */
+static struct ooXMLDoc*
+ooXMLPool_find(struct ooXMLPool *self,
+	       const char *filename)
+{
+    size_t i;
+
+    for (i = 0; i < self->num_docs; i++) {
+	if (!strcmp(self->docs[i].filename, filename))
+	    return &self->docs[i];
+    }
+    return NULL;
+}
+
+/*  append a new entry, the pool must be locked */
+static struct ooXMLDoc*
+ooXMLPool_append(struct ooXMLPool *self,
+		 const char *filename,
+		 oo_xml_doc_state state)
+{
+    struct ooXMLDoc *docs;
+    struct ooXMLDoc *entry;
+    size_t docs_size;
+
+    if (self->num_docs == self->docs_size) {
+	docs_size = self->docs_size ? self->docs_size * INDEX_REALLOC_FACTOR : 16;
+	docs = realloc(self->docs, sizeof(struct ooXMLDoc) * docs_size);
+	if (!docs) return NULL;
+	self->docs = docs;
+	self->docs_size = docs_size;
+    }
+
+    entry = &self->docs[self->num_docs];
+    entry->filename = strdup(filename);
+    if (!entry->filename) return NULL;
+    entry->doc = NULL;
+    entry->state = state;
+    entry->is_prefetched = false;
+
+    self->num_docs++;
+
+    return entry;
+}
+
+static int
+ooXMLPool_add(struct ooXMLPool *self,
+	      const char *filename)
+{
+    int ret = oo_OK;
+
+    /* no workers: the file will be parsed on demand */
+    if (!self->num_workers) return oo_OK;
+
+    pthread_mutex_lock(&self->lock);
+
+    if (!ooXMLPool_find(self, filename)) {
+	if (ooXMLPool_append(self, filename, OO_XML_DOC_QUEUED))
+	    pthread_cond_signal(&self->work_cond);
+	else
+	    ret = oo_NOMEM;
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    return ret;
+}
+
+/**
+ *  collect the files the loader is going to follow:
+ *  <include filename="..."/> elements anywhere,
+ *  the names are relative to the including file
+ */
+static int
+ooXMLPool_collect_includes(xmlNode *input_node,
+			   const char *path,
+			   size_t path_size,
+			   char ***filenames,
+			   size_t *num_filenames)
+{
+    xmlNode *cur_node;
+    char *value;
+    char *filename;
+    char **names;
+    int ret;
+
+    for (cur_node = input_node; cur_node; cur_node = cur_node->next) {
+	if (cur_node->type != XML_ELEMENT_NODE) continue;
+
+	if (!xmlStrcmp(cur_node->name, (const xmlChar *)"include")) {
+	    value = (char *)xmlGetProp(cur_node,  (const xmlChar *)"filename");
+	    if (!value) continue;
+
+	    filename = malloc(path_size + strlen(value) + 1);
+	    if (!filename) {
+		xmlFree(value);
+		return oo_NOMEM;
+	    }
+	    strncpy(filename, path, path_size);
+	    strcpy(filename + path_size, value);
+	    xmlFree(value);
+
+	    names = realloc(*filenames, sizeof(char*) * (*num_filenames + 1));
+	    if (!names) {
+		free(filename);
+		return oo_NOMEM;
+	    }
+	    names[*num_filenames] = filename;
+	    *filenames = names;
+	    (*num_filenames)++;
+	    continue;
+	}
+
+	ret = ooXMLPool_collect_includes(cur_node->children,
+					 path, path_size,
+					 filenames, num_filenames);
+	if (ret != oo_OK) return ret;
+    }
+
+    return oo_OK;
+}
+
+/**
+ *  <conceptlist> files carry the codesets
+ *  which are streamed by the loader
+ *  and never held as a whole tree
+ */
+static bool
+ooXMLPool_is_streamed(const char *filename)
+{
+    xmlTextReaderPtr reader;
+    bool is_streamed = false;
+
+    reader = xmlReaderForFile(filename, NULL, 0);
+    if (!reader) return false;
+
+    while (xmlTextReaderRead(reader) == 1) {
+	if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) continue;
+	is_streamed = !xmlStrcmp(xmlTextReaderConstName(reader),
+				 (const xmlChar *)"conceptlist");
+	break;
+    }
+
+    xmlFreeTextReader(reader);
+
+    return is_streamed;
+}
+
+/*  parse a file and queue its includes */
+static xmlDocPtr
+ooXMLPool_parse(struct ooXMLPool *self,
+		const char *filename)
+{
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    char **filenames = NULL;
+    size_t num_filenames = 0;
+    char *path = NULL;
+    size_t path_size;
+    size_t i;
+
+    if (self->num_workers && ooXMLPool_is_streamed(filename))
+	return NULL;
+
+    doc = xmlParseFile(filename);
+    if (!doc) return NULL;
+
+    root = xmlDocGetRootElement(doc);
+    if (!root || !self->num_workers) return doc;
+
+    if (oo_extract_dirpath(filename, &path, &path_size) != oo_OK)
+	return doc;
+
+    ooXMLPool_collect_includes(root->children,
+			       path, path_size,
+			       &filenames, &num_filenames);
+
+    /* a failed lookahead only costs
+     * parsing in the loading thread later */
+    for (i = 0; i < num_filenames; i++) {
+	ooXMLPool_add(self, filenames[i]);
+	free(filenames[i]);
+    }
+
+    if (filenames) free(filenames);
+    free(path);
+
+    return doc;
+}
+
+static void*
+ooXMLPool_work(void *arg)
+{
+    struct ooXMLPool *self = (struct ooXMLPool*)arg;
+    struct ooXMLDoc *entry;
+    char *filename;
+    xmlDocPtr doc;
+    size_t i;
+
+    pthread_mutex_lock(&self->lock);
+
+    while (!self->stopping) {
+	entry = NULL;
+	for (i = self->next_job; i < self->num_docs; i++) {
+	    if (self->docs[i].state != OO_XML_DOC_QUEUED) continue;
+	    entry = &self->docs[i];
+	    break;
+	}
+	self->next_job = i;
+
+	if (!entry) {
+	    pthread_cond_wait(&self->work_cond, &self->lock);
+	    continue;
+	}
+
+	/* the loading thread is behind: 
+	 * wait till it releases a document */
+	if (self->num_held >= self->max_held) {
+	    pthread_cond_wait(&self->ready_cond, &self->lock);
+	    continue;
+	}
+
+	entry->state = OO_XML_DOC_PARSING;
+	entry->is_prefetched = true;
+	self->num_held++;
+
+	/* the entries may move while the pool is unlocked */
+	filename = entry->filename;
+	pthread_mutex_unlock(&self->lock);
+
+	doc = ooXMLPool_parse(self, filename);
+
+	pthread_mutex_lock(&self->lock);
+
+	entry = ooXMLPool_find(self, filename);
+	entry->doc = doc;
+	entry->state = OO_XML_DOC_READY;
+
+	/* streamed or broken: nothing to hold */
+	if (!doc) {
+	    entry->is_prefetched = false;
+	    self->num_held--;
+	}
+	pthread_cond_broadcast(&self->ready_cond);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    return NULL;
+}
+
+static xmlDocPtr
+ooXMLPool_get(struct ooXMLPool *self,
+	      const char *filename)
+{
+    struct ooXMLDoc *entry;
+    xmlDocPtr doc;
+
+    pthread_mutex_lock(&self->lock);
+
+    entry = ooXMLPool_find(self, filename);
+
+    /* not queued or already consumed */
+    if (!entry || entry->state == OO_XML_DOC_RELEASED) {
+	if (!entry)
+	    entry = ooXMLPool_append(self, filename, OO_XML_DOC_PARSING);
+	else
+	    entry->state = OO_XML_DOC_PARSING;
+	pthread_mutex_unlock(&self->lock);
+
+	if (!entry) return xmlParseFile(filename);
+	goto parse;
+    }
+
+    /* no worker has taken it yet: do it ourselves */
+    if (entry->state == OO_XML_DOC_QUEUED) {
+	entry->state = OO_XML_DOC_PARSING;
+	pthread_mutex_unlock(&self->lock);
+	goto parse;
+    }
+
+    while (entry->state != OO_XML_DOC_READY) {
+	pthread_cond_wait(&self->ready_cond, &self->lock);
+	entry = ooXMLPool_find(self, filename);
+    }
+
+    doc = entry->doc;
+    pthread_mutex_unlock(&self->lock);
+
+    return doc;
+
+parse:
+    doc = ooXMLPool_parse(self, filename);
+
+    pthread_mutex_lock(&self->lock);
+    entry = ooXMLPool_find(self, filename);
+    entry->doc = doc;
+    entry->state = OO_XML_DOC_READY;
+    pthread_mutex_unlock(&self->lock);
+
+    return doc;
+}
+
+static int
+ooXMLPool_release(struct ooXMLPool *self,
+		  xmlDocPtr doc)
+{
+    size_t i;
+
+    if (!doc) return oo_OK;
+
+    pthread_mutex_lock(&self->lock);
+
+    for (i = 0; i < self->num_docs; i++) {
+	if (self->docs[i].doc != doc) continue;
+	self->docs[i].doc = NULL;
+	self->docs[i].state = OO_XML_DOC_RELEASED;
+
+	if (self->docs[i].is_prefetched) {
+	    self->docs[i].is_prefetched = false;
+	    self->num_held--;
+	    pthread_cond_broadcast(&self->ready_cond);
+	}
+	break;
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    xmlFreeDoc(doc);
+
+    return oo_OK;
+}
+
+static int
+ooXMLPool_del(struct ooXMLPool *self)
+{
+    size_t i;
+
+    pthread_mutex_lock(&self->lock);
+    self->stopping = true;
+    pthread_cond_broadcast(&self->work_cond);
+    pthread_cond_broadcast(&self->ready_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 0; i < self->num_workers; i++)
+	pthread_join(self->workers[i], NULL);
+
+    for (i = 0; i < self->num_docs; i++) {
+	if (self->docs[i].doc)
+	    xmlFreeDoc(self->docs[i].doc);
+	free(self->docs[i].filename);
+    }
+
+    if (self->docs) free(self->docs);
+    if (self->workers) free(self->workers);
+
+    pthread_cond_destroy(&self->ready_cond);
+    pthread_cond_destroy(&self->work_cond);
+    pthread_mutex_destroy(&self->lock);
+
+    free(self);
+
+    return oo_OK;
+}
+
+extern int
+ooXMLPool_new(struct ooXMLPool **pool,
+	      size_t num_workers)
+{
+    struct ooXMLPool *self;
+    size_t i;
+
+    self = malloc(sizeof(struct ooXMLPool));
+    if (!self) return oo_NOMEM;
+
+    memset(self, 0, sizeof(struct ooXMLPool));
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->work_cond, NULL);
+    pthread_cond_init(&self->ready_cond, NULL);
+
+    self->del = ooXMLPool_del;
+    self->add = ooXMLPool_add;
+    self->get = ooXMLPool_get;
+    self->release = ooXMLPool_release;
+
+    /* libxml2 is only safe to share between threads
+     * once its global state is set up */
+#ifdef LIBXML_THREAD_ENABLED
+    xmlInitParser();
+
+    if (num_workers > MAX_XML_PARSE_THREADS)
+	num_workers = MAX_XML_PARSE_THREADS;
+#else
+    num_workers = 0;
+#endif
+
+    if (num_workers) {
+	self->workers = malloc(sizeof(pthread_t) * num_workers);
+	if (!self->workers) num_workers = 0;
+    }
+
+    self->max_held = num_workers * XML_POOL_DOCS_PER_WORKER;
+
+    for (i = 0; i < num_workers; i++) {
+	if (pthread_create(&self->workers[i], NULL,
+			   ooXMLPool_work, (void*)self) != 0)
+	    break;
+	self->num_workers++;
+    }
+
+    *pool = self;
+
+    return oo_OK;
+}
@@ -0,0 +1,93 @@
+/**
+ *   Copyright (c) 2011 by Dmitri Dmitriev
+ *   All rights reserved.
+ *
+ *   This file is part of the OOmnik Conceptual Processor,
+ *   and as such it is subject to the license stated
+ *   in the LICENSE file which you have received
+ *   as part of this distribution.
+ *
+ *   Project homepage:
+ *   <http://www.oomnik.ru>
+ *
+ *   Initial author and maintainer:
+ *         Dmitri Dmitriev aka M0nsteR <dmitri@globbie.net>
+ *
+ *   ---------
+ *   ooxmlpool.h
+ *   OOmnik parallel parsing of XML include files
+ */
+
+#ifndef OO_XMLPOOL_H
+#define OO_XMLPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <libxml/parser.h>
+
+#include "ooconfig.h"
+
+typedef enum oo_xml_doc_state { OO_XML_DOC_QUEUED,
+				OO_XML_DOC_PARSING,
+				OO_XML_DOC_READY,
+				OO_XML_DOC_RELEASED
+} oo_xml_doc_state;
+
+typedef struct ooXMLDoc {
+    char *filename;
+    xmlDocPtr doc;
+    oo_xml_doc_state state;
+
+    /* parsed by a worker and counted in num_held */
+    bool is_prefetched;
+} ooXMLDoc;
+
+/**
+ *  XML Pool:
+ *  the worker threads parse the queued files
+ *  and queue the files they include,
+ *  while the loading thread takes the ready documents
+ *  in its own order, so the registration
+ *  of the data stays sequential,
+ *  <conceptlist> files are left to the streaming loader
+ */
+typedef struct ooXMLPool {
+    struct ooXMLDoc *docs;
+    size_t num_docs;
+    size_t docs_size;
+
+    /* first entry that may still be queued */
+    size_t next_job;
+
+    /* documents parsed or being parsed by the workers
+     * and not released yet, at most max_held */
+    size_t num_held;
+    size_t max_held;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    /* a document is ready or released */
+    pthread_cond_t ready_cond;
+    bool stopping;
+
+    pthread_t *workers;
+    size_t num_workers;
+
+    /***********  public methods ***********/
+    int (*del)(struct ooXMLPool *self);
+
+    /* queue a file for parsing */
+    int (*add)(struct ooXMLPool *self, const char *filename);
+
+    /* the parsed document, waiting for it if needed,
+     * unknown files are parsed right away */
+    xmlDocPtr (*get)(struct ooXMLPool *self, const char *filename);
+
+    /* free a document obtained from get */
+    int (*release)(struct ooXMLPool *self, xmlDocPtr doc);
+} ooXMLPool;
+
+/* num_workers is limited by MAX_XML_PARSE_THREADS */
+extern int ooXMLPool_new(struct ooXMLPool **self, size_t num_workers);
+
+#endif /* OO_XMLPOOL_H */